@@ -0,0 +1,141 @@
+#!/bin/sh
+# New GROM - end-to-end benchmark
+#
+# Generates synthetic SMD corpora (ngrom_gencorpus; the same files for the
+# same seed) of each file count, on each of a tmpfs and a disk directory,
+# then times ngrom over each corpus:
+#
+#    convert  conversion of the whole corpus (-r), for each I/O mode and -j
+#    info     --info listing
+#    check    format checks (-c stop), then the conversions, each skipped as
+#             its output already exists: the check pass plus a stat per file
+#
+# and reports files/s and MB/s (of input).  Corpora are kept (and reused) in
+# ngrom-e2e-SEED/ under each directory.  Corpora of 100000 files or more only
+# use 128 KB ROMs; any corpus that wouldn't fit (with its outputs) is skipped.
+# The page cache is dropped before each disk run when run as root.
+#
+# Usage: bench/e2e.sh [-s seed] [-n "counts"] [-j "jobs"] [-m "modes"]
+#                     [-t tmpfsDir] [-d diskDir] ngrom_exe ngrom_gencorpus
+#    modes: buffered, direct (--direct-io), drop, stream (--cache-policy)
+#    ("" as a directory skips it)
+
+SEED=1
+COUNTS="1 1000 100000"
+JOBS="1 $(nproc 2>/dev/null || echo 1)"
+MODES="buffered direct drop stream"
+TMPFS_DIR=/dev/shm
+DISK_DIR=${TMPDIR:-/var/tmp}
+
+while getopts "s:n:j:m:t:d:" OPT; do
+   case $OPT in
+      s) SEED=$OPTARG ;;
+      n) COUNTS=$OPTARG ;;
+      j) JOBS=$OPTARG ;;
+      m) MODES=$OPTARG ;;
+      t) TMPFS_DIR=$OPTARG ;;
+      d) DISK_DIR=$OPTARG ;;
+      *) exit 1 ;;
+   esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -ne 2 ] || [ ! -x "$1" ] || [ ! -x "$2" ]; then
+   echo "Usage: $0 [-s seed] [-n \"counts\"] [-j \"jobs\"] [-m \"modes\"] [-t tmpfsDir] [-d diskDir] ngrom_exe ngrom_gencorpus" >&2
+   exit 1
+fi
+NGROM=$1
+GENCORPUS=$2
+
+# Prints a result line: storage, count, run, mode, jobs, start/end ns, MB
+report() {
+   ELAPSED_NS=$(( $7 - $6 ))
+   [ "$ELAPSED_NS" -gt 0 ] || ELAPSED_NS=1
+   awk -v s="$1" -v n="$2" -v r="$3" -v m="$4" -v j="$5" -v ns="$ELAPSED_NS" -v mb="$8" 'BEGIN {
+      sec = ns / 1e9
+      printf "%-6s %7d  %-8s %-9s %4s %10.3f %12.1f %10.1f\n", s, n, r, m, j, sec, n / sec, mb / sec
+   }'
+}
+
+# Drops the page cache (disk runs; root only)
+drop_cache() {
+   if [ "$1" = disk ] && [ -w /proc/sys/vm/drop_caches ]; then
+      sync
+      echo 3 > /proc/sys/vm/drop_caches
+   fi
+}
+
+printf "%-6s %7s  %-8s %-9s %4s %10s %12s %10s\n" \
+   "Store" "Files" "Run" "Mode" "-j" "Seconds" "Files/s" "MB/s"
+
+for STORE in tmpfs disk; do
+   if [ $STORE = tmpfs ]; then BASE=$TMPFS_DIR; else BASE=$DISK_DIR; fi
+   if [ -z "$BASE" ] || [ ! -d "$BASE" ]; then
+      echo "Skipping $STORE (no directory)" >&2
+      continue
+   fi
+   WORK=$BASE/ngrom-e2e-$SEED
+   mkdir -p "$WORK" || exit 2
+
+   for COUNT in $COUNTS; do
+      CORPUS=$WORK/corpus-$COUNT
+      OUT=$WORK/out
+      if [ "$COUNT" -ge 100000 ]; then
+         SIZES="--min-size 128K --max-size 128K"
+         AVG_KB=129
+      else
+         SIZES="--min-size 128K --max-size 5M"
+         AVG_KB=1800
+      fi
+
+      if [ ! -f "$CORPUS.done" ]; then
+         NEED_KB=$(( COUNT * AVG_KB * 2 ))
+         FREE_KB=$(df -Pk "$WORK" | awk 'NR == 2 { print $4 }')
+         if [ "$NEED_KB" -gt "$FREE_KB" ]; then
+            echo "Skipping $COUNT files on $STORE: needs ~$((NEED_KB / 1024)) MB, $((FREE_KB / 1024)) MB free" >&2
+            continue
+         fi
+         rm -rf "$CORPUS"
+         # shellcheck disable=SC2086
+         "$GENCORPUS" --seed "$SEED" --files "$COUNT" $SIZES "$CORPUS" > /dev/null || exit 2
+         touch "$CORPUS.done"
+      fi
+      MB=$(du -sk "$CORPUS" | awk '{ print $1 / 1024 }')
+
+      for MODE in $MODES; do
+         case $MODE in
+            buffered) MODE_OPTS="" ;;
+            direct) MODE_OPTS="--direct-io" ;;
+            drop) MODE_OPTS="--cache-policy drop" ;;
+            stream) MODE_OPTS="--cache-policy stream" ;;
+            *) echo "Unknown mode $MODE" >&2; exit 1 ;;
+         esac
+
+         for J in $JOBS; do
+            rm -rf "$OUT"
+            mkdir -p "$OUT"
+            drop_cache $STORE
+            START_NS=$(date +%s%N)
+            # shellcheck disable=SC2086
+            "$NGROM" -c skip -j "$J" $MODE_OPTS -o "$OUT" -r "$CORPUS" > /dev/null 2>&1 ||
+               echo "ngrom failed: convert $MODE -j $J ($COUNT files on $STORE)" >&2
+            report $STORE "$COUNT" convert "$MODE" "$J" "$START_NS" "$(date +%s%N)" "$MB"
+         done
+      done
+
+      drop_cache $STORE
+      START_NS=$(date +%s%N)
+      "$NGROM" -i -r "$CORPUS" > /dev/null 2>&1 ||
+         echo "ngrom failed: info ($COUNT files on $STORE)" >&2
+      report $STORE "$COUNT" info - - "$START_NS" "$(date +%s%N)" "$MB"
+
+      # (The outputs of the last conversion run are in place.)
+      drop_cache $STORE
+      START_NS=$(date +%s%N)
+      "$NGROM" -c stop -f skip -o "$OUT" -r "$CORPUS" > /dev/null 2>&1 ||
+         echo "ngrom failed: check ($COUNT files on $STORE)" >&2
+      report $STORE "$COUNT" check - - "$START_NS" "$(date +%s%N)" "$MB"
+   done
+
+   rm -rf "$WORK/out"
+done
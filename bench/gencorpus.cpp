@@ -0,0 +1,379 @@
+// New GROM - Synthetic ROM corpus generator (ngrom_gencorpus)
+//
+// Writes numFiles valid SMD files, the same for the same seed (file i only
+// depends on the seed and i, so a smaller corpus is the start of a larger
+// one), for benchmarking without real ROMs.  Each has a proper SMD header
+// (block count, 0xAA/0xBB markers) and, as BIN, a 68000 vector table and a
+// Genesis header at 0x100 (system, names, product code, checksum, ROM range,
+// regions), followed by a mix of incompressible "code", tile patterns, and
+// 0x00/0xFF padding.  Sizes are common cartridge sizes, from 128 KB to 5 MB,
+// limited by --min-size and --max-size.  Files go 1000 to a directory:
+// outDir/dNNN/romNNNNNN.smd.
+//
+// Usage: ngrom_gencorpus [--seed n] [--files n] [--min-size size]
+//                        [--max-size size] outDir
+
+#include "ngrom.h"
+#include<stdio.h>
+#include<stdlib.h> // for strtoull
+#include<string.h>
+#include<errno.h>
+#include<sys/stat.h> // for mkdir
+#include<string>
+#include<vector>
+
+// Cartridge sizes, and their weights (how common they are)
+struct RomSize
+{
+   size_t numBytes;
+   unsigned int weight;
+};
+
+static const RomSize ROM_SIZES[] =
+{
+   { 128 << 10,  1 },
+   { 256 << 10,  2 },
+   { 512 << 10,  4 },
+   { 1 << 20,    6 },
+   { 1536 << 10, 2 },
+   { 2 << 20,    6 },
+   { 2560 << 10, 2 },
+   { 3 << 20,    3 },
+   { 4 << 20,    2 },
+   { 5 << 20,    1 }
+};
+
+static const size_t CONTENT_CHUNK_BYTES = 4096;
+
+// -----------------------------------------------------------------------------
+// Class: CorpusRandom
+// Description: SplitMix64 pseudo-random numbers (the same on every system).
+// -----------------------------------------------------------------------------
+class CorpusRandom
+{
+public:
+   explicit CorpusRandom(uint64_t seed) : m_state(seed) {}
+
+   uint64_t next()
+   {
+      uint64_t z = (m_state += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+   }
+
+private:
+   uint64_t m_state;
+};
+
+// -----------------------------------------------------------------------------
+// Function: parseSize
+// Description: Parses a size in bytes, optionally followed by K or M.
+// Return: true if valid; false otherwise.
+// -----------------------------------------------------------------------------
+static bool parseSize(const char* text, size_t& numBytes)
+{
+   char* end = NULL;
+   errno = 0;
+   unsigned long long value = strtoull(text, &end, 10);
+   if ((errno != 0) || (end == text))
+   {
+      return false;
+   }
+
+   if ((*end == 'K') || (*end == 'k'))
+   {
+      value <<= 10;
+      end++;
+   }
+   else if ((*end == 'M') || (*end == 'm'))
+   {
+      value <<= 20;
+      end++;
+   }
+
+   numBytes = value;
+   return (*end == '\0');
+}
+
+// -----------------------------------------------------------------------------
+// Function: putText
+// Description: Puts text at a header field, padded with spaces to numBytes.
+// -----------------------------------------------------------------------------
+static void putText(unsigned char* field, size_t numBytes, const std::string& text)
+{
+   memset(field, ' ', numBytes);
+   memcpy(field, text.data(), (text.size() < numBytes) ? text.size() : numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: putLong
+// Description: Puts a 32-bit big-endian (68000) value.
+// -----------------------------------------------------------------------------
+static void putLong(unsigned char* bytes, uint32_t value)
+{
+   bytes[0] = (unsigned char)(value >> 24);
+   bytes[1] = (unsigned char)(value >> 16);
+   bytes[2] = (unsigned char)(value >> 8);
+   bytes[3] = (unsigned char)value;
+}
+
+// -----------------------------------------------------------------------------
+// Function: pickROMSize
+// Description: Picks a cartridge size within [minBytes, maxBytes] by weight;
+//              minBytes (in whole SMD blocks) if none is within.
+// -----------------------------------------------------------------------------
+static size_t pickROMSize(CorpusRandom& random, size_t minBytes, size_t maxBytes)
+{
+   unsigned int totalWeight = 0;
+   for (const RomSize& romSize : ROM_SIZES)
+   {
+      if ((romSize.numBytes >= minBytes) && (romSize.numBytes <= maxBytes))
+      {
+         totalWeight += romSize.weight;
+      }
+   }
+
+   if (totalWeight == 0)
+   {
+      size_t numBlocks = (minBytes + NUM_SMD_BLOCK_BYTES - 1) / NUM_SMD_BLOCK_BYTES;
+      return ((numBlocks > 0) ? numBlocks : 1) * NUM_SMD_BLOCK_BYTES;
+   }
+
+   unsigned int pick = random.next() % totalWeight;
+   for (const RomSize& romSize : ROM_SIZES)
+   {
+      if ((romSize.numBytes >= minBytes) && (romSize.numBytes <= maxBytes))
+      {
+         if (pick < romSize.weight)
+         {
+            return romSize.numBytes;
+         }
+         pick -= romSize.weight;
+      }
+   }
+
+   return minBytes;
+}
+
+// -----------------------------------------------------------------------------
+// Function: makeBINData
+// Description: Makes file fileIndex's ROM data (as BIN).
+// -----------------------------------------------------------------------------
+static void makeBINData(std::vector<unsigned char>& binBytes, CorpusRandom& random, size_t fileIndex)
+{
+   size_t numBytes = binBytes.size();
+
+   // Content: 4KB chunks of "code" (random), a repeated 32-byte tile, or
+   // padding.
+   for (size_t offset = 0; offset < numBytes; offset += CONTENT_CHUNK_BYTES)
+   {
+      unsigned char* chunk = &binBytes[offset];
+      unsigned int kind = random.next() % 20;
+      if (kind < 10)
+      {
+         for (size_t i = 0; i < CONTENT_CHUNK_BYTES; i += 8)
+         {
+            uint64_t value = random.next();
+            memcpy(chunk + i, &value, 8);
+         }
+      }
+      else if (kind < 14)
+      {
+         unsigned char tile[32];
+         for (size_t i = 0; i < sizeof(tile); i++)
+         {
+            tile[i] = (unsigned char)random.next();
+         }
+         for (size_t i = 0; i < CONTENT_CHUNK_BYTES; i += sizeof(tile))
+         {
+            memcpy(chunk + i, tile, sizeof(tile));
+         }
+      }
+      else
+      {
+         memset(chunk, (kind < 17) ? 0x00 : 0xFF, CONTENT_CHUNK_BYTES);
+      }
+   }
+
+   // 68000 vectors: initial stack pointer, then everything to the code at 0x200.
+   putLong(&binBytes[0], 0x00FFFE00);
+   for (size_t offset = 4; offset < 0x100; offset += 4)
+   {
+      putLong(&binBytes[offset], 0x00000200);
+   }
+
+   // Genesis header
+   char text[64];
+   unsigned char* header = &binBytes[0x100];
+   putText(header + 0x00, 16, "SEGA MEGA DRIVE");
+   snprintf(text, sizeof(text), "(C)NGRM %04u.JAN", (unsigned int)(1989 + (fileIndex % 10)));
+   putText(header + 0x10, 16, text);
+   snprintf(text, sizeof(text), "NGROM SYNTHETIC ROM %06zu", fileIndex);
+   putText(header + 0x20, 48, text);
+   putText(header + 0x50, 48, text);
+   snprintf(text, sizeof(text), "GM %08zu-00", fileIndex % 100000000);
+   putText(header + 0x80, 14, text);
+   putText(header + 0x90, 16, "J");
+   putLong(header + 0xA0, 0x00000000);
+   putLong(header + 0xA4, (uint32_t)(numBytes - 1));
+   putLong(header + 0xA8, 0x00FF0000);
+   putLong(header + 0xAC, 0x00FFFFFF);
+   putText(header + 0xB0, 12, "");
+   putText(header + 0xBC, 12, "");
+   putText(header + 0xC8, 40, "");
+   static const char* const REGIONS[] = { "JUE", "U", "E", "J", "UE" };
+   putText(header + 0xF0, 16, REGIONS[fileIndex % 5]);
+
+   // Checksum: the sum of the (big-endian) words after the header
+   uint16_t checksum = 0;
+   for (size_t offset = 0x200; offset + 1 < numBytes; offset += 2)
+   {
+      checksum += (uint16_t)((binBytes[offset] << 8) | binBytes[offset + 1]);
+   }
+   header[0x8E] = (unsigned char)(checksum >> 8);
+   header[0x8F] = (unsigned char)checksum;
+}
+
+// -----------------------------------------------------------------------------
+// Function: writeSMDFile
+// Description: Writes BIN data as an SMD file (header, then each 16KB block
+//              with its odd bytes in the first half and even bytes in the
+//              second; the inverse of decodeSMDBlock).
+// Return: true if written; false otherwise (errno is set).
+// -----------------------------------------------------------------------------
+static bool writeSMDFile(const std::string& path, const std::vector<unsigned char>& binBytes)
+{
+   size_t numBlocks = binBytes.size() / NUM_SMD_BLOCK_BYTES;
+
+   unsigned char smdHeader[NUM_HEADER_BYTES];
+   memset(smdHeader, 0, NUM_HEADER_BYTES);
+   smdHeader[0] = (unsigned char)numBlocks;
+   smdHeader[1] = 0x03;
+   smdHeader[8] = 0xAA;
+   smdHeader[9] = 0xBB;
+   smdHeader[10] = 0x06;
+
+   FILE* smdFile = fopen(path.c_str(), "wb");
+   if (smdFile == NULL)
+   {
+      return false;
+   }
+
+   bool writeOK = (NUM_HEADER_BYTES == fwrite(smdHeader, 1, NUM_HEADER_BYTES, smdFile));
+
+   unsigned char smdBlock[NUM_SMD_BLOCK_BYTES];
+   for (size_t block = 0; writeOK && (block < numBlocks); block++)
+   {
+      const unsigned char* binBlock = &binBytes[block * NUM_SMD_BLOCK_BYTES];
+      for (size_t i = 0; i < (NUM_SMD_BLOCK_BYTES / 2); i++)
+      {
+         smdBlock[i] = binBlock[(2 * i) + 1];
+         smdBlock[(NUM_SMD_BLOCK_BYTES / 2) + i] = binBlock[2 * i];
+      }
+      writeOK = (NUM_SMD_BLOCK_BYTES == fwrite(smdBlock, 1, NUM_SMD_BLOCK_BYTES, smdFile));
+   }
+
+   int saved_errno = errno;
+   if ((0 != fclose(smdFile)) && writeOK)
+   {
+      return false;
+   }
+   errno = saved_errno;
+   return writeOK;
+}
+
+int main(int argc, char *argv[])
+{
+   uint64_t seed = 1;
+   size_t numFiles = 1;
+   size_t minBytes = 128 << 10;
+   size_t maxBytes = 5 << 20;
+   std::string outDir;
+
+   for (int i = 1; i < argc; i++)
+   {
+      std::string arg = argv[i];
+      bool hasValue = (i + 1 < argc);
+      bool argOK = true;
+
+      if ((arg == "--seed") && hasValue)
+      {
+         seed = strtoull(argv[++i], NULL, 10);
+      }
+      else if ((arg == "--files") && hasValue)
+      {
+         numFiles = strtoull(argv[++i], NULL, 10);
+         argOK = (numFiles > 0);
+      }
+      else if ((arg == "--min-size") && hasValue)
+      {
+         argOK = parseSize(argv[++i], minBytes);
+      }
+      else if ((arg == "--max-size") && hasValue)
+      {
+         argOK = parseSize(argv[++i], maxBytes);
+      }
+      else if (outDir.empty() && (arg[0] != '-'))
+      {
+         outDir = arg;
+      }
+      else
+      {
+         argOK = false;
+      }
+
+      if (!argOK)
+      {
+         fprintf(stderr, "Usage: %s [--seed n] [--files n] [--min-size size] [--max-size size] outDir\n", argv[0]);
+         return 1;
+      }
+   }
+
+   if (outDir.empty() || (minBytes > maxBytes))
+   {
+      fprintf(stderr, "Usage: %s [--seed n] [--files n] [--min-size size] [--max-size size] outDir\n", argv[0]);
+      return 1;
+   }
+
+   if ((0 != mkdir(outDir.c_str(), 0755)) && (errno != EEXIST))
+   {
+      int saved_errno = errno;
+      fprintf(stderr, "NGROM ERROR: Failed to create %s... %s\n", outDir.c_str(), strerror(saved_errno));
+      return 2;
+   }
+
+   uint64_t totalBytes = 0;
+   std::vector<unsigned char> binBytes;
+   for (size_t fileIndex = 0; fileIndex < numFiles; fileIndex++)
+   {
+      char name[64];
+      snprintf(name, sizeof(name), "/d%03zu", fileIndex / 1000);
+      std::string dirPath = outDir + name;
+      if (((fileIndex % 1000) == 0) && (0 != mkdir(dirPath.c_str(), 0755)) && (errno != EEXIST))
+      {
+         int saved_errno = errno;
+         fprintf(stderr, "NGROM ERROR: Failed to create %s... %s\n", dirPath.c_str(), strerror(saved_errno));
+         return 2;
+      }
+
+      // (Each file's own stream: file i doesn't depend on the others.)
+      CorpusRandom random(seed ^ ((fileIndex + 1) * 0xD1B54A32D192ED03ULL));
+      binBytes.resize(pickROMSize(random, minBytes, maxBytes));
+      makeBINData(binBytes, random, fileIndex);
+
+      snprintf(name, sizeof(name), "/rom%06zu.smd", fileIndex);
+      std::string path = dirPath + name;
+      if (!writeSMDFile(path, binBytes))
+      {
+         int saved_errno = errno;
+         fprintf(stderr, "NGROM ERROR: Failed to write %s... %s\n", path.c_str(), strerror(saved_errno));
+         return 2;
+      }
+      totalBytes += NUM_HEADER_BYTES + binBytes.size();
+   }
+
+   printf("Wrote %zu SMD files (%.1f MB) to %s (seed %llu)\n",
+          numFiles, totalBytes / 1e6, outDir.c_str(), (unsigned long long)seed);
+   return 0;
+}
@@ -0,0 +1,470 @@
+// New GROM - Decoding kernel microbenchmark (ngrom_bench)
+//
+// Times each decoding kernel over working sets sized to fit the L1 data
+// cache, the L2 cache, the last-level cache, or only DRAM (source plus
+// destination bytes; sized from the system's cache sizes).  Each kernel and
+// size gets a warmup (which also picks the passes per repetition), then timed
+// repetitions; the report gives GB/s (of BIN output) as mean, standard
+// deviation, min, and max, and cycles per byte: CPU cycles if perf counters
+// are permitted, else TSC ticks.  With -o, the results are also written as
+// JSON, for tracking kernel performance across commits.
+//
+// Usage: ngrom_bench [-r repetitions] [-o jsonFile]
+
+#include "ngrom.h"
+#include<stdio.h>
+#include<stdlib.h> // for atoi, posix_memalign
+#include<string.h>
+#include<math.h>   // for sqrt
+#include<time.h>   // for clock_gettime
+#include<unistd.h> // for sysconf, syscall
+#include<sys/syscall.h> // for SYS_perf_event_open
+#include<linux/perf_event.h>
+#include<string>
+#include<vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include<x86intrin.h> // for __rdtsc
+#endif
+
+#ifndef NGROM_BENCH_COMMIT
+#define NGROM_BENCH_COMMIT "unknown"
+#endif
+
+// A kernel over numBytes of BIN output (src holds the input, after an SMD
+// header's worth of bytes)
+struct BenchKernel
+{
+   const char* name;
+   void (*run)(unsigned char* dest, const unsigned char* src, size_t numBytes);
+};
+
+// A working-set size
+struct BenchLevel
+{
+   const char* name;
+   size_t workingSetBytes;
+};
+
+// Statistics of a kernel's repetitions
+struct BenchResult
+{
+   const char* kernel;
+   const char* level;
+   size_t workingSetBytes;
+   size_t bytesPerRep;
+   double meanGBps;
+   double stddevGBps;
+   double minGBps;
+   double maxGBps;
+   double meanCyclesPerByte;
+   double stddevCyclesPerByte;
+};
+
+static const double WARMUP_SECONDS = 0.1;
+static const double MIN_REP_SECONDS = 0.02;
+
+// Cycle counter (perf_event cycles fd, or -1 for the TSC)
+static int s_cyclesFd = -1;
+
+// -----------------------------------------------------------------------------
+// Function: runSMDBlocks
+// Description: Decodes numBytes of SMD blocks, one decodeSMDBlock call each.
+// -----------------------------------------------------------------------------
+static void runSMDBlocks(unsigned char* dest, const unsigned char* src, size_t numBytes)
+{
+   for (size_t offset = 0; offset < numBytes; offset += NUM_SMD_BLOCK_BYTES)
+   {
+      decodeSMDBlock(dest + offset, src + NUM_HEADER_BYTES + offset);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: runSMDROM
+// Description: Decodes numBytes of SMD blocks as a whole ROM (one
+//              decodeROMData call; batched).
+// -----------------------------------------------------------------------------
+static void runSMDROM(unsigned char* dest, const unsigned char* src, size_t numBytes)
+{
+   decodeROMData(NGROM_NS::SMD, dest, src, numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: runMGD
+// Description: Decodes numBytes of MGD data.
+// -----------------------------------------------------------------------------
+static void runMGD(unsigned char* dest, const unsigned char* src, size_t numBytes)
+{
+   decodeMGDData(dest, src, numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: runSwapInPlace
+// Description: Word-swaps numBytes of BIN data in place (in dest; src isn't
+//              used).
+// -----------------------------------------------------------------------------
+static void runSwapInPlace(unsigned char* dest, const unsigned char*, size_t numBytes)
+{
+   swapBINWords(dest, numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: runSwappedROM
+// Description: Copies and word-swaps numBytes of word-swapped BIN data (as a
+//              whole ROM).
+// -----------------------------------------------------------------------------
+static void runSwappedROM(unsigned char* dest, const unsigned char* src, size_t numBytes)
+{
+   decodeROMData(NGROM_NS::BIN_SWAPPED, dest, src, numBytes);
+}
+
+// (New kernel variants go here.)
+static const BenchKernel KERNELS[] =
+{
+   { "smd-block",       runSMDBlocks },
+   { "smd-rom-batched", runSMDROM },
+   { "mgd",             runMGD },
+   { "swap-in-place",   runSwapInPlace },
+   { "swapped-rom",     runSwappedROM }
+};
+
+// -----------------------------------------------------------------------------
+// Function: getSeconds
+// Description: Gets the (monotonic) time in seconds.
+// -----------------------------------------------------------------------------
+static double getSeconds()
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+// -----------------------------------------------------------------------------
+// Function: openCyclesCounter
+// Description: Opens a (user-mode) CPU cycles counter for this thread.
+// Return: The counter's fd, or -1 if not permitted or available.
+// -----------------------------------------------------------------------------
+static int openCyclesCounter()
+{
+   struct perf_event_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = PERF_TYPE_HARDWARE;
+   attr.config = PERF_COUNT_HW_CPU_CYCLES;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+
+   return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+// -----------------------------------------------------------------------------
+// Function: getCycles
+// Description: Gets the cycle count: CPU cycles (with a counter), else TSC
+//              ticks (else 0).
+// -----------------------------------------------------------------------------
+static uint64_t getCycles()
+{
+   if (s_cyclesFd >= 0)
+   {
+      uint64_t cycles = 0;
+      if (sizeof(cycles) == read(s_cyclesFd, &cycles, sizeof(cycles)))
+      {
+         return cycles;
+      }
+   }
+
+#if defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#else
+   return 0;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// Function: getCacheBytes
+// Description: Gets a cache's size (sysconf name), or defaultBytes if the
+//              system doesn't say.
+// -----------------------------------------------------------------------------
+static size_t getCacheBytes(int name, size_t defaultBytes)
+{
+   long numBytes = sysconf(name);
+   return (numBytes > 0) ? (size_t)numBytes : defaultBytes;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getWorkingSetBytes
+// Description: Gets a working set (source plus destination) taking up about
+//              two thirds of cacheBytes: a whole number of SMD block pairs,
+//              at least one.
+// -----------------------------------------------------------------------------
+static size_t getWorkingSetBytes(size_t cacheBytes)
+{
+   size_t numBlockPairs = (cacheBytes * 2 / 3) / (2 * NUM_SMD_BLOCK_BYTES);
+   return ((numBlockPairs > 0) ? numBlockPairs : 1) * 2 * NUM_SMD_BLOCK_BYTES;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getCPUName
+// Description: Gets the CPU's model name (from /proc/cpuinfo).
+// -----------------------------------------------------------------------------
+static std::string getCPUName()
+{
+   std::string cpuName = "unknown";
+   FILE* cpuInfoFile = fopen("/proc/cpuinfo", "r");
+   if (cpuInfoFile == NULL)
+   {
+      return cpuName;
+   }
+
+   char line[256];
+   while (fgets(line, sizeof(line), cpuInfoFile) != NULL)
+   {
+      const char* colon = strchr(line, ':');
+      if ((0 == strncmp(line, "model name", 10)) && (colon != NULL))
+      {
+         cpuName = colon + 2;
+         cpuName.erase(cpuName.find_last_not_of("\r\n") + 1);
+         break;
+      }
+   }
+
+   fclose(cpuInfoFile);
+   return cpuName;
+}
+
+// -----------------------------------------------------------------------------
+// Function: writeJSONString
+// Description: Writes a string as a (quoted, escaped) JSON string.
+// -----------------------------------------------------------------------------
+static void writeJSONString(FILE* jsonFile, const std::string& text)
+{
+   fputc('"', jsonFile);
+   for (unsigned char c : text)
+   {
+      if ((c == '"') || (c == '\\'))
+      {
+         fputc('\\', jsonFile);
+         fputc(c, jsonFile);
+      }
+      else if (c < 0x20)
+      {
+         fprintf(jsonFile, "\\u%04x", c);
+      }
+      else
+      {
+         fputc(c, jsonFile);
+      }
+   }
+   fputc('"', jsonFile);
+}
+
+// -----------------------------------------------------------------------------
+// Function: benchKernel
+// Description: Warms up and times a kernel over a working set's buffers, for
+//              numReps repetitions.
+// -----------------------------------------------------------------------------
+static BenchResult benchKernel(const BenchKernel& kernel, const BenchLevel& level,
+                               unsigned char* dest, const unsigned char* src, int numReps)
+{
+   size_t numBytes = level.workingSetBytes / 2;
+
+   // Warm up (caches, TLB, frequency), counting passes to size the reps.
+   size_t numWarmupPasses = 0;
+   double warmupStart = getSeconds();
+   double warmupSeconds = 0;
+   do
+   {
+      kernel.run(dest, src, numBytes);
+      numWarmupPasses++;
+      warmupSeconds = getSeconds() - warmupStart;
+   } while (warmupSeconds < WARMUP_SECONDS);
+
+   double secondsPerPass = warmupSeconds / numWarmupPasses;
+   size_t numPasses = (secondsPerPass >= MIN_REP_SECONDS) ? 1 : (size_t)(MIN_REP_SECONDS / secondsPerPass) + 1;
+
+   std::vector<double> gbps;
+   std::vector<double> cyclesPerByte;
+   for (int rep = 0; rep < numReps; rep++)
+   {
+      uint64_t startCycles = getCycles();
+      double startSeconds = getSeconds();
+      for (size_t pass = 0; pass < numPasses; pass++)
+      {
+         kernel.run(dest, src, numBytes);
+      }
+      double seconds = getSeconds() - startSeconds;
+      uint64_t cycles = getCycles() - startCycles;
+
+      double repBytes = (double)numBytes * numPasses;
+      gbps.push_back(repBytes / seconds / 1e9);
+      cyclesPerByte.push_back(cycles / repBytes);
+   }
+
+   BenchResult result;
+   result.kernel = kernel.name;
+   result.level = level.name;
+   result.workingSetBytes = level.workingSetBytes;
+   result.bytesPerRep = numBytes * numPasses;
+   result.minGBps = gbps[0];
+   result.maxGBps = gbps[0];
+
+   double sumGBps = 0;
+   double sumCyclesPerByte = 0;
+   for (int rep = 0; rep < numReps; rep++)
+   {
+      sumGBps += gbps[rep];
+      sumCyclesPerByte += cyclesPerByte[rep];
+      result.minGBps = (gbps[rep] < result.minGBps) ? gbps[rep] : result.minGBps;
+      result.maxGBps = (gbps[rep] > result.maxGBps) ? gbps[rep] : result.maxGBps;
+   }
+   result.meanGBps = sumGBps / numReps;
+   result.meanCyclesPerByte = sumCyclesPerByte / numReps;
+
+   double sumSqGBps = 0;
+   double sumSqCyclesPerByte = 0;
+   for (int rep = 0; rep < numReps; rep++)
+   {
+      sumSqGBps += (gbps[rep] - result.meanGBps) * (gbps[rep] - result.meanGBps);
+      sumSqCyclesPerByte += (cyclesPerByte[rep] - result.meanCyclesPerByte) * (cyclesPerByte[rep] - result.meanCyclesPerByte);
+   }
+   result.stddevGBps = (numReps > 1) ? sqrt(sumSqGBps / (numReps - 1)) : 0;
+   result.stddevCyclesPerByte = (numReps > 1) ? sqrt(sumSqCyclesPerByte / (numReps - 1)) : 0;
+
+   return result;
+}
+
+// -----------------------------------------------------------------------------
+// Function: writeJSON
+// Description: Writes the run (system, settings, and results) as JSON.
+// Return: true if written; false otherwise.
+// -----------------------------------------------------------------------------
+static bool writeJSON(const std::string& path, const std::vector<BenchLevel>& levels, int numReps,
+                      const char* cycleSource, const std::vector<BenchResult>& results)
+{
+   FILE* jsonFile = fopen(path.c_str(), "w");
+   if (jsonFile == NULL)
+   {
+      return false;
+   }
+
+   fprintf(jsonFile, "{\n  \"benchmark\": \"ngrom_bench\",\n  \"commit\": ");
+   writeJSONString(jsonFile, NGROM_BENCH_COMMIT);
+   fprintf(jsonFile, ",\n  \"timestamp\": %lld,\n  \"cpu\": ", (long long)time(NULL));
+   writeJSONString(jsonFile, getCPUName());
+   fprintf(jsonFile, ",\n  \"repetitions\": %d,\n  \"cycleSource\": \"%s\",\n  \"workingSets\": {", numReps, cycleSource);
+   for (size_t i = 0; i < levels.size(); i++)
+   {
+      fprintf(jsonFile, "%s\"%s\": %zu", (i == 0) ? "" : ", ", levels[i].name, levels[i].workingSetBytes);
+   }
+   fprintf(jsonFile, "},\n  \"results\": [\n");
+
+   for (size_t i = 0; i < results.size(); i++)
+   {
+      const BenchResult& result = results[i];
+      fprintf(jsonFile, "    {\"kernel\": \"%s\", \"level\": \"%s\", \"workingSetBytes\": %zu, \"bytesPerRep\": %zu, "
+                        "\"gbps\": {\"mean\": %.4f, \"stddev\": %.4f, \"min\": %.4f, \"max\": %.4f}, "
+                        "\"cyclesPerByte\": {\"mean\": %.4f, \"stddev\": %.4f}}%s\n",
+              result.kernel, result.level, result.workingSetBytes, result.bytesPerRep,
+              result.meanGBps, result.stddevGBps, result.minGBps, result.maxGBps,
+              result.meanCyclesPerByte, result.stddevCyclesPerByte,
+              (i + 1 < results.size()) ? "," : "");
+   }
+   fprintf(jsonFile, "  ]\n}\n");
+
+   return (0 == fclose(jsonFile));
+}
+
+int main(int argc, char *argv[])
+{
+   int numReps = 10;
+   std::string jsonPath;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if ((0 == strcmp(argv[i], "-r")) && (i + 1 < argc) && (atoi(argv[i + 1]) > 0))
+      {
+         numReps = atoi(argv[++i]);
+      }
+      else if ((0 == strcmp(argv[i], "-o")) && (i + 1 < argc))
+      {
+         jsonPath = argv[++i];
+      }
+      else
+      {
+         fprintf(stderr, "Usage: %s [-r repetitions] [-o jsonFile]\n", argv[0]);
+         return 1;
+      }
+   }
+
+  // Size the working sets from the caches (defaults for systems that don't
+  // say).  DRAM's is well past the LLC, within reason.
+   size_t llcBytes = getCacheBytes(_SC_LEVEL3_CACHE_SIZE, getCacheBytes(_SC_LEVEL2_CACHE_SIZE, 8 << 20));
+   size_t dramBytes = 4 * llcBytes;
+   dramBytes = (dramBytes < ((size_t)256 << 20)) ? ((size_t)256 << 20) : dramBytes;
+   dramBytes = (dramBytes > ((size_t)1 << 30)) ? ((size_t)1 << 30) : dramBytes;
+
+   std::vector<BenchLevel> levels;
+   levels.push_back({ "L1",   getWorkingSetBytes(getCacheBytes(_SC_LEVEL1_DCACHE_SIZE, 32 << 10)) });
+   levels.push_back({ "L2",   getWorkingSetBytes(getCacheBytes(_SC_LEVEL2_CACHE_SIZE, 1 << 20)) });
+   levels.push_back({ "LLC",  getWorkingSetBytes(llcBytes) });
+   levels.push_back({ "DRAM", dramBytes });
+
+  // Source (with room for an SMD header before the data) and destination,
+  // filled (so their pages are mapped) with pseudo-random data.
+   size_t maxBytes = dramBytes / 2;
+   void* srcMemory = NULL;
+   void* destMemory = NULL;
+   if ((0 != posix_memalign(&srcMemory, 4096, NUM_HEADER_BYTES + maxBytes)) ||
+       (0 != posix_memalign(&destMemory, 4096, maxBytes)))
+   {
+      fprintf(stderr, "NGROM ERROR: Failed to allocate %zu-byte buffers\n", maxBytes);
+      return 2;
+   }
+   unsigned char* src = (unsigned char*)srcMemory;
+   unsigned char* dest = (unsigned char*)destMemory;
+
+   uint64_t state = 0x9E3779B97F4A7C15ULL;
+   for (size_t i = 0; i < NUM_HEADER_BYTES + maxBytes; i++)
+   {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      src[i] = (unsigned char)state;
+   }
+   memset(dest, 0, maxBytes);
+
+   s_cyclesFd = openCyclesCounter();
+   const char* cycleSource = (s_cyclesFd >= 0) ? "cycles" : "tsc";
+#if !defined(__x86_64__) && !defined(__i386__)
+   cycleSource = (s_cyclesFd >= 0) ? "cycles" : "none";
+#endif
+
+   printf("ngrom_bench (%s): %s; %d repetitions; cycles/B from %s\n",
+          NGROM_BENCH_COMMIT, getCPUName().c_str(), numReps, cycleSource);
+   printf("%-16s %-5s %12s %9s %9s %9s %9s %10s\n",
+          "Kernel", "Level", "Set (KB)", "GB/s", "+/-", "min", "max", "cycles/B");
+
+   std::vector<BenchResult> results;
+   for (const BenchKernel& kernel : KERNELS)
+   {
+      for (const BenchLevel& level : levels)
+      {
+         BenchResult result = benchKernel(kernel, level, dest, src, numReps);
+         printf("%-16s %-5s %12zu %9.3f %9.3f %9.3f %9.3f %10.3f\n",
+                result.kernel, result.level, result.workingSetBytes >> 10,
+                result.meanGBps, result.stddevGBps, result.minGBps, result.maxGBps,
+                result.meanCyclesPerByte);
+         fflush(stdout);
+         results.push_back(result);
+      }
+   }
+
+   if (!jsonPath.empty() && !writeJSON(jsonPath, levels, numReps, cycleSource, results))
+   {
+      fprintf(stderr, "NGROM ERROR: Failed to write %s\n", jsonPath.c_str());
+      return 3;
+   }
+
+   free(srcMemory);
+   free(destMemory);
+   return 0;
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+# New GROM - startup time benchmark
+#
+# Launches each supplied ngrom executable many times (with --version, so no
+# file I/O is involved) and reports the average wall time per launch.
+#
+# Usage: bench/startup.sh [-n runs] ngrom_exe [ngrom_exe...]
+
+RUNS=1000
+
+if [ "$1" = "-n" ]; then
+   RUNS=$2
+   shift 2
+fi
+
+if [ $# -eq 0 ]; then
+   echo "Usage: $0 [-n runs] ngrom_exe [ngrom_exe...]" >&2
+   exit 1
+fi
+
+for EXE in "$@"; do
+   if [ ! -x "$EXE" ]; then
+      echo "Skipping $EXE (not found or not executable)" >&2
+      continue
+   fi
+
+   START_NS=$(date +%s%N)
+   i=0
+   while [ $i -lt "$RUNS" ]; do
+      "$EXE" --version > /dev/null
+      i=$((i + 1))
+   done
+   END_NS=$(date +%s%N)
+
+   TOTAL_US=$(( (END_NS - START_NS) / 1000 ))
+   printf "%-24s %6d runs, %10d us total, %8d us/launch\n" \
+      "$EXE" "$RUNS" "$TOTAL_US" $((TOTAL_US / RUNS))
+done
@@ -1,140 +1,480 @@
 // New GROM - Genesis ROM conversion (SMD->BIN) utility
 // Based on the GROM 0.75 source code by Bart Trzynadlowski, 2000.
 
-#include<QCoreApplication>
-#include<QCommandLineParser>
-#include<QFileInfo>
+#include "ngrom.h"
+#include "ngrom_args.h"
+#include "ngrom_buffer.h"
+#include "ngrom_cache.h"
+#include "ngrom_dedup.h"
+#include "ngrom_durable.h"
+#include "ngrom_hash.h"
+#include "ngrom_index.h"
+#include "ngrom_input.h"
+#include "ngrom_io.h"
+#include "ngrom_journal.h"
+#include "ngrom_manifest.h"
+#include "ngrom_outdir.h"
+#include "ngrom_perf.h"
+#include "ngrom_probes.h"
+#include "ngrom_scan.h"
+#include "ngrom_scheduler.h"
+#include "ngrom_shard.h"
+#include "ngrom_stats.h"
+#include "ngrom_tar.h"
+#include "ngrom_walk.h"
 #include<stdio.h>  // for FILE I/O
 #include<iostream> // for std::cout and std::err
+#include<string>
+#include<vector>
+#include<algorithm>
+#include<atomic>
+#include<functional>
+#include<future>
+#include<memory>
+#include<mutex>
+#include<thread>
 #include<errno.h>
+#include<stdlib.h> // for strtoul
 #include<string.h>
-
-namespace NGROM_NS
-{
-   enum RomFormat
-   {
-      UNK_FMT,
-      SMD,
-      BIN
-   };
-
-   enum FileCheckAction
-   {
-      UNSET,
-      STOP,
-      WARN,
-      SKIP
-   };
-}
-
-// Constants
-static const size_t NUM_HEADER_BYTES = 512;
-static const size_t NUM_SMD_BLOCK_BYTES = 16384; // 16KB
-
-// Function prototypes
-NGROM_NS::FileCheckAction parseFileCheckActionString(const QString& fileCheckActionString);
-bool checkFormats(NGROM_NS::RomFormat fmt, const QStringList& filenameList);
-NGROM_NS::RomFormat getLikelyFormat(const unsigned char* headerBytes);
-void decodeSMDBlock(unsigned char* binBlock, const unsigned char* smdBlock);
-void showInfoList(const QStringList& filenameList);
-bool convertFiles(const QStringList& filenameList,
-                  const std::string& outdir,
-                  NGROM_NS::FileCheckAction fileCollisionAction);
-
+#include<strings.h> // for strcasecmp
+#include<sys/stat.h> // for stat
+#include<unistd.h>   // for unlink, pwrite
 
 // -----------------------------------------------------------------------------
 // Exit Codes:
 //    0 = No error
 //    1 = Error with command line argument(s)
 //    2 = Stopped due to integrity check
+//    3 = Error reading/writing the manifest or journal
 // -----------------------------------------------------------------------------
 int main(int argc, char *argv[])
 {
-  // Setup the application object
-   QCoreApplication theApp(argc, argv);
-   QCoreApplication::setApplicationName("ngrom");
-   QCoreApplication::setApplicationVersion("0.1.0");
-
   // Setup the command line parser
-   QCommandLineParser argsParser;
-   argsParser.setApplicationDescription("New GROM - Genesis ROM conversion utility");
-   argsParser.addHelpOption();
-   argsParser.addVersionOption();
+   NGROM_NS::ArgsParser argsParser("ngrom", "0.1.0", "New GROM - Genesis ROM conversion utility");
 
   // Specify command line arguments (strings supplied for auto-generated help text)
-   QCommandLineOption infoOption(QStringList() << "i" << "info",
+   NGROM_NS::ArgOption infoOption({"i", "info"},
       "Show information about the file(s) instead of doing conversion(s).");
    argsParser.addOption(infoOption);
 
-   QCommandLineOption doChecksOption(QStringList() << "c" << "checks",
+   NGROM_NS::ArgOption doChecksOption({"c", "checks"},
       "Performing checks of the ROM formats. Options are \"stop\", \"warn\", or \"skip\". \"stop\" [default] will stop (exit) the program if any ROM format check fails, whereas \"warn\" will simply issue a warning and attempt to continue. \"skip\" will skip performing any checks at all.",
       "checkOpt",
       "stop");
    argsParser.addOption(doChecksOption);
 
-   QCommandLineOption fileCollideOption(QStringList() << "f" << "file-collision",
+   NGROM_NS::ArgOption formatOption({"F", "format"},
+      "Format of the input files. Options are \"smd\" [default] or \"auto\". With \"auto\", each file's format is detected and picks the conversion: SMD or MGD decoding, fixing a word-swapped BIN, or passing an already correct BIN through (reflinked, or copied in-kernel, where possible). The format checks then only require each file to be in a recognized format.",
+      "inputFormat",
+      "smd");
+   argsParser.addOption(formatOption);
+
+   NGROM_NS::ArgOption fileCollideOption({"f", "file-collision"},
       "Action to perform if an output file already exists. Options are same as <checkOpt>. \"stop\" will stop (exit) the program when an output file name is found to already exist. \"warn\" will issue a warning and (attempt to) overwrite the file. \"skip\" [default] will issue a warning and skip writing the output file.",
       "fileAction",
       "skip");
    argsParser.addOption(fileCollideOption);
 
-   QCommandLineOption outdirOption(QStringList() << "o" << "outdir",
+   NGROM_NS::ArgOption outdirOption({"o", "outdir"},
       "Specifies the output directory. Default is current working directory. This option is ignored if --info is specified.",
       "outdir");
    argsParser.addOption(outdirOption);
 
+   NGROM_NS::ArgOption manifestOption({"m", "manifest"},
+      "Incremental conversion: records each conversion (input and output size, mtime, inode, and content hash) in the given manifest file, and on later runs only converts inputs that are new or have changed since, or whose output has changed. Unchanged inputs are also skipped by the format checks. The files in a zip archive are each tracked by their own size and CRC32, so changing one leaves the others alone. The manifest is saved every 10 seconds during the run, and at its end. Outputs of changed or deleted inputs are reported as stale. This option is ignored if --info is specified.",
+      "manifestFile");
+   argsParser.addOption(manifestOption);
+
+   NGROM_NS::ArgOption journalOption({"journal"},
+      "Records the run (settings, input files, and each started/completed conversion) in the given journal file, so that an interrupted run can be resumed with --resume. A conversion is recorded as completed once its output is written; only with --durable is it also synced to disk first (so a resumed run trusts it after a system crash or power loss). This option is ignored if --info is specified.",
+      "journalFile");
+   argsParser.addOption(journalOption);
+
+   NGROM_NS::ArgOption resumeOption({"resume"},
+      "Resumes the interrupted run recorded in the given journal file, with the same settings and files (no files may be specified). Completed conversions are not redone, and partially written outputs are removed and converted again.",
+      "journalFile");
+   argsParser.addOption(resumeOption);
+
+   NGROM_NS::ArgOption shardOption({"shard"},
+      "Only handles shard i of N (1 <= i <= N <= 65536) of the specified files, for splitting a collection across N independent ngrom processes or nodes. Files are told apart by their paths relative to the directories given with --recursive (files given directly, by their file names), so each node may mount the collection at a different path. Given the same files (in any order), the N shards cover every file exactly once, and are balanced by total (decompressed) file size; adding or removing files moves few of the others to another shard. Since the balancing looks at all the files, every process must be given the same set of files (e.g., the same directories), or some files may be converted twice or not at all.",
+      "i/N");
+   argsParser.addOption(shardOption);
+
+   NGROM_NS::ArgOption dedupOption({"dedup"},
+      "Converts byte-identical input files only once. Outputs of duplicates are created as \"hardlink\"s or \"reflink\"s (copy-on-write clones; plain in-kernel copies where the filesystem can't reflink) of the first output. This option is ignored if --info is specified.",
+      "linkMode");
+   argsParser.addOption(dedupOption);
+
+   NGROM_NS::ArgOption compressOption({"compress"},
+      "Writes the outputs compressed (.bin.gz or .bin.zst), never storing the BIN uncompressed. Options are \"gzip\" or \"zstd\" (if built with zstd support), optionally followed by \":level\" (gzip 1-9, default 6; zstd 1-19, default 3). The data is compressed in independent chunks on all CPUs. This option is ignored if --info is specified.",
+      "method[:level]");
+   argsParser.addOption(compressOption);
+
+   NGROM_NS::ArgOption durableOption({"durable"},
+      "Crash-safe outputs: each output is written under a temporary name and only appears under its real name once it is synced to disk (outputs are synced in groups, then renamed into place). After a crash, an output is either complete or absent (or still the previous file). With --journal, a conversion is only recorded as completed once its output is synced. This option is ignored if --info is specified.");
+   argsParser.addOption(durableOption);
+
+   NGROM_NS::ArgOption cachePolicyOption({"cache-policy"},
+      "Page cache use, for sweeps over large collections: \"keep\" (default; the kernel decides), \"drop\" (each input and output is dropped from the cache once done with, so other programs' cached data is not evicted), \"prefetch\" (the next inputs are read ahead while the current ones convert), or \"stream\" (both). \"prefetch\" and \"stream\" may be followed by \":numFiles\" (inputs read ahead; default 8). This option is ignored if --info is specified.",
+      "policy",
+      "keep");
+   argsParser.addOption(cachePolicyOption);
+
+   NGROM_NS::ArgOption directIOOption({"direct-io"},
+      "Decodes SMD files with direct I/O (O_DIRECT): large aligned reads and writes between the disk and ngrom's own buffers, bypassing the page cache entirely (e.g., for a one-time migration of a whole archive). Where the filesystem doesn't support it, the page cache is used. This option is ignored if --info is specified.");
+   argsParser.addOption(directIOOption);
+
+   NGROM_NS::ArgOption hugePagesOption({"huge-pages"},
+      "Backs large data buffers (e.g., whole MGD ROMs, direct I/O chunks) with huge pages: reserved ones (hugetlbfs) where the system has them, or else transparent huge pages. This option is ignored if --info is specified.");
+   argsParser.addOption(hugePagesOption);
+
+   NGROM_NS::ArgOption maxMemoryOption({"max-memory"},
+      "Limits the buffer memory of the conversions running at once (data buffers, decompression and compression queues) to a size in bytes, optionally followed by K, M, or G (e.g., \"512M\"). Conversions wait for memory rather than fail, so with -j, fewer may run at once. \"auto\" (default) uses half of the cgroup (container) memory limit, if there is one; \"none\" sets no limit. This option is ignored if --info is specified.",
+      "size",
+      "auto");
+   argsParser.addOption(maxMemoryOption);
+
+   NGROM_NS::ArgOption statsOption({"stats"},
+      "Prints timing statistics when done: for the format checks, the conversions, and --info, the p50/p99/max time per file of each stage (open, header read, format check, decode, write, and close), with files/s, MB/s, and read/write syscall counts. Not available with --tar-in.");
+   argsParser.addOption(statsOption);
+
+   NGROM_NS::ArgOption traceOption({"trace"},
+      "Writes a timeline of the run to traceFile, in Chrome trace-event JSON (open it in Perfetto or chrome://tracing): each file, its stages, and the reads, decodes, writes, syncs, compression chunks, and waits within them, by thread. Not available with --tar-in.",
+      "traceFile");
+   argsParser.addOption(traceOption);
+
+   NGROM_NS::ArgOption perfCountersOption({"perf-counters"},
+      "Counts CPU events (cycles, instructions, cache and branch misses) with perf_event_open around the decoding, the reads and writes of data, and each file's conversion, and prints them per byte or MB when done. Uses software events (CPU time, page faults, context switches) where hardware ones aren't available, and continues without if perf_event_paranoid allows neither. Not available with --tar-in.");
+   argsParser.addOption(perfCountersOption);
+
+   NGROM_NS::ArgOption tarInOption({"tar-in"},
+      "Converts the files in a tar stream (a tar file, possibly gzip-compressed, or \"-\" for stdin) instead of individual files. Requires --tar-out; uses the --format and --checks options only.",
+      "tarFile");
+   argsParser.addOption(tarInOption);
+
+   NGROM_NS::ArgOption tarOutOption({"tar-out"},
+      "With --tar-in, writes the BINs as a tar stream (a tar file, or \"-\" for stdout), keeping each file's directory and metadata, in one sequential stream instead of one file each.",
+      "tarFile");
+   argsParser.addOption(tarOutOption);
+
+   NGROM_NS::ArgOption recursiveOption({"r", "recursive"},
+      "Converts all files under any directories specified (symbolic links are not followed). The directories are read in parallel. When the format checks are skipped (and no --info, --journal, or --shard), conversions start while the directories are still being read; otherwise all files are found (and sorted) first.");
+   argsParser.addOption(recursiveOption);
+
+   NGROM_NS::ArgOption includeOption({"include"},
+      "With --recursive, only files whose names match the glob are used (may be given more than once; e.g., --include '*.smd').",
+      "glob");
+   argsParser.addOption(includeOption);
+
+   NGROM_NS::ArgOption excludeOption({"exclude"},
+      "With --recursive, files and directories whose names match the glob are skipped (may be given more than once).",
+      "glob");
+   argsParser.addOption(excludeOption);
+
+   NGROM_NS::ArgOption jobsOption({"j", "jobs"},
+      "Number of conversions to run at once. Default is 1; 0 uses the number of CPUs. With more than 1, each file's messages are printed once it is done.",
+      "numJobs",
+      "1");
+   argsParser.addOption(jobsOption);
+
    argsParser.addPositionalArgument("files",
-      "(SMD) Files to convert. Output file names will have the .bin extension (replacing the .smd extension, if it exists).",
+      "(SMD) Files to convert (or directories, with --recursive). Gzip-compressed files, and the files in .zip archives, are decompressed on the fly. Output file names will have the .bin extension (replacing the .smd, .mgd, or .bin extension, if it exists, after dropping any .gz). \"index build <indexFile> <files...>\" instead indexes the files' ROM headers; \"index query <indexFile> [field=value...]\" searches the index (fields: region, product, name, system, copyright, format, hash). \"scan <dirs...>\" prints a report (formats, sizes, checksums, regions, duplicates) for all files under the directories.",
       "[files...]");
 
   // Parse the command line arguments!
-   argsParser.process(theApp);
+   argsParser.process(argc, argv);
 
   // Get list of (input) files specified...
-   const QStringList argsList = argsParser.positionalArguments();
+   std::vector<std::string> argsList = argsParser.positionalArguments();
+
+  // "ngrom index build|query ..." works on a ROM header index instead.
+   if (!argsList.empty() && (argsList[0] == "index"))
+   {
+      return NGROM_NS::runIndexCommand(std::vector<std::string>(argsList.begin() + 1, argsList.end()));
+   }
+
+  // "ngrom scan DIR..." reports on a whole collection.
+   if (!argsList.empty() && (argsList[0] == "scan"))
+   {
+      return NGROM_NS::runScanCommand(std::vector<std::string>(argsList.begin() + 1, argsList.end()));
+   }
+
+   std::string checkOptString = argsParser.value(doChecksOption);
+   std::string formatString = argsParser.value(formatOption);
+   std::string fileCollideActionString = argsParser.value(fileCollideOption);
+   std::string outdir = argsParser.isSet(outdirOption) ? argsParser.value(outdirOption) : ".";
+   std::string manifestPath = argsParser.isSet(manifestOption) ? argsParser.value(manifestOption) : "";
+   std::string dedupMode = argsParser.isSet(dedupOption) ? argsParser.value(dedupOption) : "";
+   std::string compressSpec = argsParser.isSet(compressOption) ? argsParser.value(compressOption) : "";
+   bool durable = argsParser.isSet(durableOption);
+
+  // Number of conversions at once
+   char* jobsEnd = NULL;
+   std::string jobsString = argsParser.value(jobsOption);
+   unsigned long numJobs = strtoul(jobsString.c_str(), &jobsEnd, 10);
+   if (jobsString.empty() || (*jobsEnd != '\0') || (numJobs > 1024))
+   {
+      std::cerr << "NGROM ERROR: Invalid number of jobs: " << jobsString << std::endl;
+      return 1;
+   }
+   if (numJobs == 0)
+   {
+      numJobs = std::max(1u, std::thread::hardware_concurrency());
+   }
+
+  // Tar stream mode converts one tar stream into another (no files).
+   bool tarMode = argsParser.isSet(tarInOption) || argsParser.isSet(tarOutOption);
+   if (tarMode &&
+       (!argsParser.isSet(tarInOption) || !argsParser.isSet(tarOutOption) || !argsList.empty() ||
+        argsParser.isSet(infoOption) || argsParser.isSet(recursiveOption) || !manifestPath.empty() ||
+        argsParser.isSet(journalOption) || argsParser.isSet(resumeOption) || argsParser.isSet(shardOption) ||
+        !dedupMode.empty() || !compressSpec.empty() || durable))
+   {
+      std::cerr << "NGROM ERROR: --tar-in and --tar-out go together, and cannot be combined with files, --info, --recursive, --manifest, --journal, --resume, --shard, --dedup, --compress, or --durable." << std::endl;
+      return 1;
+   }
+
+  // ...or, when resuming, get the files and settings from the journal.
+   NGROM_NS::Journal journal;
+   bool resuming = argsParser.isSet(resumeOption);
+
+  // With --recursive, directories are walked for files: either now (the full
+  // list is needed for checks, info, journal, or sharding), or alongside the
+  // conversions.
+   NGROM_NS::DirectoryWalker walker;
+   for (const std::string& pattern : argsParser.values(includeOption))
+   {
+      walker.addInclude(pattern);
+   }
+   for (const std::string& pattern : argsParser.values(excludeOption))
+   {
+      walker.addExclude(pattern);
+   }
+
+   std::vector<std::string> walkDirs;
+   std::vector<std::string> rootDirs; // (Walked up front; for --shard)
+   if (argsParser.isSet(recursiveOption) && !resuming)
+   {
+      std::vector<std::string> fileList;
+      for (const std::string& arg : argsList)
+      {
+         struct stat argStat;
+         if ((0 == stat(arg.c_str(), &argStat)) && S_ISDIR(argStat.st_mode))
+         {
+            walkDirs.push_back(arg);
+         }
+         else
+         {
+            fileList.push_back(arg);
+         }
+      }
+      argsList = fileList;
+
+      bool streamInputs = (checkOptString == "skip") && !argsParser.isSet(infoOption) &&
+                          !argsParser.isSet(journalOption) && !argsParser.isSet(shardOption);
+
+      if (!walkDirs.empty() && !streamInputs)
+      {
+         std::mutex foundMutex;
+         std::vector<std::string> foundFiles;
+         walker.run(walkDirs, NGROM_NS::DirectoryWalker::defaultNumThreads(),
+            [&](unsigned int, int, const char*, const std::string& path)
+            {
+               std::lock_guard<std::mutex> lock(foundMutex);
+               foundFiles.push_back(path);
+               return true;
+            });
+
+         // (The walk order varies from run to run.)
+         std::sort(foundFiles.begin(), foundFiles.end());
+         argsList.insert(argsList.end(), foundFiles.begin(), foundFiles.end());
+         rootDirs.swap(walkDirs);
+
+         std::cout << "Found " << foundFiles.size() << " file(s) in " << walker.numDirs() << " directories" << std::endl;
+      }
+   }
+
+  // The files in a zip archive are converted one by one.
+   if (!resuming)
+   {
+      std::vector<std::string> inputList;
+      for (const std::string& arg : argsList)
+      {
+         if (!NGROM_NS::addInputFile(arg, inputList))
+         {
+            return 1;
+         }
+      }
+      argsList = inputList;
+   }
+
+   if (resuming)
+   {
+      if (!argsList.empty() || argsParser.isSet(infoOption) || argsParser.isSet(journalOption) || argsParser.isSet(shardOption))
+      {
+         std::cerr << "NGROM ERROR: --resume cannot be combined with files, --info, --journal, or --shard." << std::endl;
+         return 1;
+      }
+
+      NGROM_NS::Journal::Settings journalSettings;
+      if (!journal.resume(argsParser.value(resumeOption), argsList, journalSettings))
+      {
+         return 3;
+      }
+
+      checkOptString = journalSettings["checks"];
+      formatString = journalSettings["format"];
+      fileCollideActionString = journalSettings["file-collision"];
+      outdir = journalSettings["outdir"];
+      manifestPath = journalSettings["manifest"];
+      dedupMode = journalSettings["dedup"];
+      compressSpec = journalSettings["compress"];
+      durable = (journalSettings["durable"] == "1");
+
+      std::cout << "Resuming run from journal: " << journal.numCompleted() << " of "
+                << argsList.size() << " conversion(s) already completed." << std::endl;
+   }
+   else if (argsParser.isSet(shardOption))
+   {
+      size_t shardNumber = 0;
+      size_t numShards = 0;
+      if (!NGROM_NS::parseShardSpec(argsParser.value(shardOption), shardNumber, numShards))
+      {
+         std::cerr << "NGROM ERROR: Invalid shard (expected i/N, 1 <= i <= N <= 65536): " << argsParser.value(shardOption) << std::endl;
+         return 1;
+      }
+
+      if (!argsList.empty())
+      {
+         argsList = NGROM_NS::selectShard(argsList, rootDirs, shardNumber, numShards);
+
+         // More shards than files; nothing for this one to do.
+         if (argsList.empty())
+         {
+            return 0;
+         }
+      }
+   }
 
   // Exit if no files specified.
-   if (argsList.isEmpty())
+   if (argsList.empty() && walkDirs.empty() && !tarMode)
    {
       std::cerr << "NGROM ERROR: No files specified." << std::endl;
       return 1;
    }
 
   // Validate the file check options
-   QString checkOptString = argsParser.value(doChecksOption);
    NGROM_NS::FileCheckAction checkOpt = parseFileCheckActionString(checkOptString);
    if (checkOpt == NGROM_NS::UNSET)
    {
-      std::cerr << "NGROM ERROR: Unrecognized checkOpt: " << checkOptString.toStdString() << std::endl;
+      std::cerr << "NGROM ERROR: Unrecognized checkOpt: " << checkOptString << std::endl;
       argsParser.showHelp(1);
    }
 
-   QString fileCollideActionString = argsParser.value(fileCollideOption);
    NGROM_NS::FileCheckAction fileAction = parseFileCheckActionString(fileCollideActionString);
    if (fileAction == NGROM_NS::UNSET)
    {
-      std::cerr << "NGROM ERROR: Unrecognized fileAction: " << fileCollideActionString.toStdString() << std::endl;
+      std::cerr << "NGROM ERROR: Unrecognized fileAction: " << fileCollideActionString << std::endl;
+      argsParser.showHelp(1);
+   }
+
+   NGROM_NS::RomFormat inputFormat = NGROM_NS::SMD;
+   if (formatString == "auto")
+   {
+      inputFormat = NGROM_NS::AUTO_FMT;
+   }
+   else if (formatString != "smd")
+   {
+      std::cerr << "NGROM ERROR: Unrecognized inputFormat: " << formatString << std::endl;
+      argsParser.showHelp(1);
+   }
+
+   if (tarMode)
+   {
+      return NGROM_NS::runTarConversion(argsParser.value(tarInOption), argsParser.value(tarOutOption),
+                                        inputFormat, checkOpt);
+   }
+
+  // Time the passes below, if requested (reported, and the trace written,
+  // however the run ends).
+   if (argsParser.isSet(statsOption))
+   {
+      NGROM_NS::enableStats();
+   }
+   NGROM_NS::StatsReport statsReport(std::cout);
+
+   NGROM_NS::TraceSession traceSession;
+   if (argsParser.isSet(traceOption) && !traceSession.start(argsParser.value(traceOption)))
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to create trace file " << argsParser.value(traceOption) << "... " << strerror(saved_errno) << std::endl;
+      return 1;
+   }
+
+   NGROM_NS::PerfCounterSession perfCounterSession(std::cout);
+   if (argsParser.isSet(perfCountersOption))
+   {
+      perfCounterSession.start(std::cerr);
+   }
+
+  // Set the conversion options the checks need, too: the output compression
+  // (part of each output's name) and the manifest (incremental conversion),
+  // whose unchanged inputs are skipped, so aren't checked either.
+   NGROM_NS::ConvertOptions convertOptions;
+   convertOptions.inputFormat = inputFormat;
+   convertOptions.fileCollisionAction = fileAction;
+
+   // Set output directory
+   convertOptions.outdir = outdir;
+
+   // Set output compression, if requested
+   if (!compressSpec.empty() &&
+       !NGROM_NS::parseCompressSpec(compressSpec, convertOptions.compression, convertOptions.compressLevel))
+   {
+      std::cerr << "NGROM ERROR: Unrecognized (or unsupported) compression: " << compressSpec << std::endl;
       argsParser.showHelp(1);
    }
 
-  // Do SMD format checks, if allowed.
+   // Load manifest (incremental conversion), if requested
+   NGROM_NS::Manifest manifest;
+   if (!manifestPath.empty() && !argsParser.isSet(infoOption))
+   {
+      if (!manifest.load(manifestPath))
+      {
+         return 3;
+      }
+      convertOptions.manifest = &manifest;
+   }
+
+  // Do SMD (or any known) format checks, if allowed.
    if (checkOpt == NGROM_NS::SKIP)
    {
-      std::cout << "Skipping SMD format checks..." << std::endl;
+      std::cout << "Skipping " << getFormatName(inputFormat) << " format checks..." << std::endl;
    }
    else
    {
-      bool rc = checkFormats(NGROM_NS::SMD, argsList);
+      // (Conversions completed before (when resuming), or unchanged since
+      // (manifest), need no checking.)
+      std::vector<std::string> checkList;
+      for (size_t i = 0; i < argsList.size(); i++)
+      {
+         if (!journal.isCompleted(i) && !isUnchangedInput(argsList[i], convertOptions))
+         {
+            checkList.push_back(argsList[i]);
+         }
+      }
+
+      bool rc = checkFormats(inputFormat, checkList);
       if (rc == false)
       {
          if (checkOpt == NGROM_NS::STOP)
          {
-            std::cout << "NGROM stopping due to failed SMD format check on one or more files" << std::endl;
+            std::cout << "NGROM stopping due to failed " << getFormatName(inputFormat) << " format check on one or more files" << std::endl;
             return 2;
          }
          else if (checkOpt == NGROM_NS::WARN)
          {
-            std::cerr << "NGROM WARNING: one or more files failed SMD format check; continuing..." << std::endl;
+            std::cerr << "NGROM WARNING: one or more files failed " << getFormatName(inputFormat) << " format check; continuing..." << std::endl;
          }
       }
    }
@@ -146,21 +486,189 @@ int main(int argc, char *argv[])
    }
    else
    {
-      // Set output directory
-      std::string outdir = ".";
+      // Set up content dedup, if requested
+      NGROM_NS::DedupIndex::LinkMode dedupLinkMode = NGROM_NS::DedupIndex::REFLINK;
+      if (!dedupMode.empty() && !NGROM_NS::DedupIndex::parseLinkMode(dedupMode, dedupLinkMode))
+      {
+         std::cerr << "NGROM ERROR: Unrecognized linkMode: " << dedupMode << std::endl;
+         argsParser.showHelp(1);
+      }
+
+      NGROM_NS::DedupIndex dedupIndex(dedupLinkMode);
+      if (!dedupMode.empty())
+      {
+         convertOptions.dedup = &dedupIndex;
+      }
+
+      // Open the output directory once (outputs are then checked against
+      // one listing of it, and made relative to it); if it can't be opened,
+      // each output reports its own error.
+      NGROM_NS::OutputDirectory outputDir;
+      if (outputDir.open(outdir))
+      {
+         convertOptions.outputDir = &outputDir;
+      }
+
+      // Set up page cache hints, if requested
+      NGROM_NS::CachePolicy cachePolicy;
+      if (!NGROM_NS::parseCachePolicySpec(argsParser.value(cachePolicyOption), cachePolicy))
+      {
+         std::cerr << "NGROM ERROR: Unrecognized cache policy: " << argsParser.value(cachePolicyOption) << std::endl;
+         argsParser.showHelp(1);
+      }
+
+      std::unique_ptr<NGROM_NS::CachePrefetcher> prefetcher;
+      if (cachePolicy.numPrefetchFiles > 0)
+      {
+         prefetcher.reset(new NGROM_NS::CachePrefetcher(cachePolicy.numPrefetchFiles));
+         convertOptions.prefetcher = prefetcher.get();
+      }
 
-      if (argsParser.isSet("outdir"))
+      NGROM_NS::CacheDropper cacheDropper;
+      if (cachePolicy.dropAfterUse)
       {
-         outdir = argsParser.value("outdir").toStdString();
+         convertOptions.cacheDropper = &cacheDropper;
       }
 
+      convertOptions.directIO = argsParser.isSet(directIOOption);
+      NGROM_NS::setHugePages(argsParser.isSet(hugePagesOption));
+
+      // Set up the buffer memory budget (by default, from the cgroup's limit)
+      std::string maxMemoryString = argsParser.value(maxMemoryOption);
+      uint64_t maxMemoryBytes = 0;
+      if (maxMemoryString == "auto")
+      {
+         maxMemoryBytes = NGROM_NS::getCgroupMemoryLimit() / 2;
+      }
+      else if ((maxMemoryString != "none") && !NGROM_NS::parseMemorySize(maxMemoryString, maxMemoryBytes))
+      {
+         std::cerr << "NGROM ERROR: Unrecognized memory size: " << maxMemoryString << std::endl;
+         argsParser.showHelp(1);
+      }
+
+      std::unique_ptr<NGROM_NS::MemoryBudget> memoryBudget;
+      if (maxMemoryBytes > 0)
+      {
+         memoryBudget.reset(new NGROM_NS::MemoryBudget(maxMemoryBytes));
+         convertOptions.memoryBudget = memoryBudget.get();
+         NGROM_NS::limitPooledBytes(maxMemoryBytes, numJobs);
+      }
+
+      // Set up durable (crash-safe) outputs, if requested
+      NGROM_NS::DurableCommitter committer;
+      if (durable)
+      {
+         convertOptions.committer = &committer;
+      }
+
+      // Start journal (resumable run), if requested
+      if (argsParser.isSet(journalOption))
+      {
+         NGROM_NS::Journal::Settings journalSettings;
+         journalSettings["checks"] = checkOptString;
+         journalSettings["format"] = formatString;
+         journalSettings["file-collision"] = fileCollideActionString;
+         journalSettings["outdir"] = outdir;
+         journalSettings["manifest"] = manifestPath;
+         journalSettings["dedup"] = dedupMode;
+         journalSettings["compress"] = compressSpec;
+         journalSettings["durable"] = durable ? "1" : "";
+
+         if (!journal.create(argsParser.value(journalOption), argsList, journalSettings))
+         {
+            return 3;
+         }
+         convertOptions.journal = &journal;
+      }
+      else if (resuming)
+      {
+         convertOptions.journal = &journal;
+      }
+
+      convertOptions.numJobs = numJobs;
+
       // Do conversions!
-      bool rc = convertFiles(argsList, outdir, fileAction);
+      bool rc = true;
+      if (walkDirs.empty())
+      {
+         rc = convertFiles(argsList, convertOptions);
+      }
+      else
+      {
+         // Convert files as the walk finds them (files specified directly go first).
+         NGROM_NS::FileQueue fileQueue;
+         for (const std::string& filename : argsList)
+         {
+            fileQueue.push(filename);
+         }
+
+         std::atomic<bool> badArchive(false);
+         std::thread walkThread([&]()
+         {
+            walker.run(walkDirs, NGROM_NS::DirectoryWalker::defaultNumThreads(),
+               [&](unsigned int, int, const char*, const std::string& path)
+               {
+                  std::vector<std::string> inputList;
+                  if (!NGROM_NS::addInputFile(path, inputList))
+                  {
+                     badArchive = true;
+                     fileQueue.cancel();
+                     return false;
+                  }
+
+                  for (const std::string& inputPath : inputList)
+                  {
+                     if (!fileQueue.push(inputPath))
+                     {
+                        return false;
+                     }
+                  }
+                  return true;
+               });
+            fileQueue.close();
+         });
+
+         rc = NGROM_NS::runConversions(fileQueue, convertOptions);
+         walkThread.join();
+         rc = rc && !badArchive;
+
+         if (walker.numErrors() > 0)
+         {
+            std::cerr << "NGROM WARNING: " << walker.numErrors() << " directories could not be read" << std::endl;
+         }
+      }
+
+      if ((convertOptions.dedup != NULL) && (dedupIndex.numDuplicates() > 0))
+      {
+         std::cout << "Dedup: " << dedupIndex.numDuplicates() << " duplicate input(s) not converted ("
+                   << dedupIndex.bytesSaved() << " bytes not decoded/written)" << std::endl;
+      }
+
+      // Save the manifest even if stopping early, so completed work is kept.
+      if (convertOptions.manifest != NULL)
+      {
+         size_t numStale = manifest.reportStaleOutputs();
+         if (numStale > 0)
+         {
+            std::cerr << "NGROM WARNING: " << numStale << " stale output file(s) found" << std::endl;
+         }
+
+         if (!manifest.save())
+         {
+            return 3;
+         }
+      }
+
       if (rc == false)
       {
          std::cout << "NGROM stopping due to error writing an output file" << std::endl;
          return 2;
       }
+
+      if ((convertOptions.journal != NULL) && !journal.finish())
+      {
+         return 3;
+      }
    }
 
   // Done!
@@ -175,7 +683,7 @@ int main(int argc, char *argv[])
 // Return: NGROM_NS::FileCheckAction value based on the supplied string.
 //         UNSET if string is not recognized.
 // -----------------------------------------------------------------------------
-NGROM_NS::FileCheckAction parseFileCheckActionString(const QString& fileCheckActionString)
+NGROM_NS::FileCheckAction parseFileCheckActionString(const std::string& fileCheckActionString)
 {
    NGROM_NS::FileCheckAction retval = NGROM_NS::UNSET;
 
@@ -218,6 +726,86 @@ NGROM_NS::RomFormat getLikelyFormat(const unsigned char* headerBytes)
       retval = NGROM_NS::SMD;
    }
 
+   // Word-swapped BIN files have "ESAG" starting at byte offset 0x100.
+   else if (0 == memcmp(headerBytes + 0x100, "ESAG", 4))
+   {
+      retval = NGROM_NS::BIN_SWAPPED;
+   }
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getLikelyFileFormat
+// Description: Same as getLikelyFormat, but can also recognize MGD files,
+//              which requires peeking at the middle of the (decompressed)
+//              file.  The position of the input's stream is not changed.
+// Return: Most likely format, or UNK_FMT if indeterminate.
+// -----------------------------------------------------------------------------
+NGROM_NS::RomFormat getLikelyFileFormat(const NGROM_NS::InputFile& input, const unsigned char* headerBytes)
+{
+   NGROM_NS::RomFormat retval = getLikelyFormat(headerBytes);
+
+   // MGD files have the odd bytes of the BIN data in the first half of the
+   // file and the even bytes in the second half, so the "SEGA" at BIN offset
+   // 0x100 shows up as "EA" at 0x80 and "SG" at (half + 0x80).  (The size is
+   // only needed then; for a gzip input, finding it takes reading it.)
+   if ((retval == NGROM_NS::UNK_FMT) && (0 == memcmp(headerBytes + 0x80, "EA", 2)))
+   {
+      uint64_t fileSize = input.size();
+      unsigned char midBytes[2];
+      if (((fileSize % 2) == 0) && (fileSize >= NUM_HEADER_BYTES) &&
+          input.readAt(midBytes, 2, (fileSize / 2) + 0x80) &&
+          (0 == memcmp(midBytes, "SG", 2)))
+      {
+         retval = NGROM_NS::MGD;
+      }
+   }
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getLikelyDataFormat
+// Description: Same as getLikelyFileFormat, for ROM data held in memory.
+// Return: Most likely format, or UNK_FMT if indeterminate.
+// -----------------------------------------------------------------------------
+NGROM_NS::RomFormat getLikelyDataFormat(const unsigned char* romBytes, size_t numBytes)
+{
+   if (numBytes < NUM_HEADER_BYTES)
+   {
+      return NGROM_NS::UNK_FMT;
+   }
+
+   NGROM_NS::RomFormat retval = getLikelyFormat(romBytes);
+
+   if ((retval == NGROM_NS::UNK_FMT) && ((numBytes % 2) == 0) &&
+       (0 == memcmp(romBytes + 0x80, "EA", 2)) && (0 == memcmp(romBytes + (numBytes / 2) + 0x80, "SG", 2)))
+   {
+      retval = NGROM_NS::MGD;
+   }
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getFormatName
+// Description: Gets a displayable name for a ROM format.
+// -----------------------------------------------------------------------------
+const char* getFormatName(NGROM_NS::RomFormat fmt)
+{
+   const char* retval = "unrecognized";
+
+   switch (fmt)
+   {
+      case NGROM_NS::SMD:         retval = "SMD"; break;
+      case NGROM_NS::BIN:         retval = "BIN"; break;
+      case NGROM_NS::MGD:         retval = "MGD"; break;
+      case NGROM_NS::BIN_SWAPPED: retval = "BIN (word-swapped)"; break;
+      case NGROM_NS::AUTO_FMT:    retval = "auto"; break;
+      default: break;
+   }
+
    return retval;
 }
 
@@ -228,20 +816,28 @@ NGROM_NS::RomFormat getLikelyFormat(const unsigned char* headerBytes)
 // Return: true if all files pass the checks successfully;
 //         false if any error occurred.
 // -----------------------------------------------------------------------------
-bool checkFormats(NGROM_NS::RomFormat fmt, const QStringList& filenameList)
+bool checkFormats(NGROM_NS::RomFormat fmt, const std::vector<std::string>& filenameList)
 {
    bool retval = true;
 
    unsigned char tmpBytes[NUM_HEADER_BYTES];
    memset(tmpBytes, 0, NUM_HEADER_BYTES);
 
-   for (QString filename : filenameList)
+   NGROM_NS::StatPassTimer passTimer(NGROM_NS::CHECK_PASS);
+
+   for (const std::string& filename : filenameList)
    {
+      NGROM_NS::FileStats fileStats(NGROM_NS::CHECK_PASS, filename);
+      NGROM_NS::FileProbe fileProbe("check", filename);
+
       if (fmt == NGROM_NS::BIN)
       {
-         std::cout << "Checking file for BIN format: " << filename.toStdString() << std::endl;
+         std::cout << "Checking file for BIN format: " << filename << std::endl;
 
-         FILE* inFile = fopen(filename.toStdString().c_str(), "r");
+         NGROM_NS::StatTimer openTimer(NGROM_NS::OPEN_STAGE);
+         NGROM_NS::InputFile input;
+         FILE* inFile = input.open(filename) ? input.file() : NULL;
+         openTimer.stop();
          if (inFile == NULL)
          {
             int saved_errno = errno;
@@ -253,7 +849,13 @@ bool checkFormats(NGROM_NS::RomFormat fmt, const QStringList& filenameList)
             // Clear bytes buffer
             memset(tmpBytes, 0, NUM_HEADER_BYTES);
 
+            NGROM_NS::StatTimer headerTimer(NGROM_NS::HEADER_STAGE);
             size_t numBytesRead = fread(tmpBytes, 1, NUM_HEADER_BYTES, inFile);
+            headerTimer.stop();
+            fileStats.addBytes(numBytesRead, 0);
+            fileProbe.setBytes(input.knownSize());
+            NGROM_NS::probeHeaderParsed("check", filename, input.knownSize(), NGROM_NS::BIN);
+
             if (numBytesRead < NUM_HEADER_BYTES)
             {
                std::cerr << "  NGROM ERROR: Incomplete read..." << std::endl;
@@ -261,10 +863,13 @@ bool checkFormats(NGROM_NS::RomFormat fmt, const QStringList& filenameList)
             }
             else
             {
+               NGROM_NS::StatTimer checkTimer(NGROM_NS::CHECK_STAGE);
+
                // BIN files have "SEGA" starting at byte offset 0x100.
                if (0 == memcmp(tmpBytes + 0x100, "SEGA", 4))
                {
                   std::cout << "  ...GOOD!" << std::endl;
+                  fileProbe.setStatus(NGROM_NS::PROBE_OK);
                }
                else
                {
@@ -272,14 +877,19 @@ bool checkFormats(NGROM_NS::RomFormat fmt, const QStringList& filenameList)
                   retval = false;
                }
             }
-            fclose(inFile);
+
+            NGROM_NS::StatTimer closeTimer(NGROM_NS::CLOSE_STAGE);
+            input.close();
          }
       }
       else if (fmt == NGROM_NS::SMD)
       {
-         std::cout << "Checking file for SMD format: " << filename.toStdString() << std::endl;
+         std::cout << "Checking file for SMD format: " << filename << std::endl;
 
-         FILE* inFile = fopen(filename.toStdString().c_str(), "r");
+         NGROM_NS::StatTimer openTimer(NGROM_NS::OPEN_STAGE);
+         NGROM_NS::InputFile input;
+         FILE* inFile = input.open(filename) ? input.file() : NULL;
+         openTimer.stop();
          if (inFile == NULL)
          {
             int saved_errno = errno;
@@ -291,7 +901,13 @@ bool checkFormats(NGROM_NS::RomFormat fmt, const QStringList& filenameList)
             // Clear bytes buffer
             memset(tmpBytes, 0, NUM_HEADER_BYTES);
 
+            NGROM_NS::StatTimer headerTimer(NGROM_NS::HEADER_STAGE);
             size_t numBytesRead = fread(tmpBytes, 1, NUM_HEADER_BYTES, inFile);
+            headerTimer.stop();
+            fileStats.addBytes(numBytesRead, 0);
+            fileProbe.setBytes(input.knownSize());
+            NGROM_NS::probeHeaderParsed("check", filename, input.knownSize(), NGROM_NS::SMD);
+
             if (numBytesRead < NUM_HEADER_BYTES)
             {
                std::cerr << "  NGROM ERROR: Incomplete read..." << std::endl;
@@ -299,6 +915,8 @@ bool checkFormats(NGROM_NS::RomFormat fmt, const QStringList& filenameList)
             }
             else
             {
+               NGROM_NS::StatTimer checkTimer(NGROM_NS::CHECK_STAGE);
+
                // SMD files should have 0xAA at byte offset 8, and 0xBB at byte offset 9.
                // They should also not have the BIN "SEGA" text at byte offset 0x100.
                if ((tmpBytes[8] != 0xAA) || (tmpBytes[9] != 0xBB))
@@ -317,59 +935,246 @@ bool checkFormats(NGROM_NS::RomFormat fmt, const QStringList& filenameList)
                   else
                   {
                      std::cout << "  ...GOOD!" << std::endl;
+                     fileProbe.setStatus(NGROM_NS::PROBE_OK);
                   }
                }
             }
-            fclose(inFile);
+
+            NGROM_NS::StatTimer closeTimer(NGROM_NS::CLOSE_STAGE);
+            input.close();
          }
       }
-      else
+      else if (fmt == NGROM_NS::AUTO_FMT)
       {
-         std::cerr << "NGROM ERROR: checkFormats not implemented for specified fmt: " << fmt << std::endl;
-         return false;
-      }
-   }
-
-   return retval;
-}
+         std::cout << "Checking file for a known ROM format: " << filename << std::endl;
 
-// -----------------------------------------------------------------------------
-// Function: decodeSMDBlock
-// Description: Converts a 16KB SMD block to a BIN block.
-// -----------------------------------------------------------------------------
-void decodeSMDBlock(unsigned char* destBINBlock, const unsigned char* srcSMDBlock)
-{
-   size_t evenByte = 0;
-   size_t oddByte = 1;
+         NGROM_NS::StatTimer openTimer(NGROM_NS::OPEN_STAGE);
+         NGROM_NS::InputFile input;
+         FILE* inFile = input.open(filename) ? input.file() : NULL;
+         openTimer.stop();
+         if (inFile == NULL)
+         {
+            int saved_errno = errno;
+            std::cerr << "  NGROM ERROR: Failed to open file... " << strerror(saved_errno) << std::endl;
+            retval = false;
+         }
+         else
+         {
+            // Clear bytes buffer
+            memset(tmpBytes, 0, NUM_HEADER_BYTES);
 
-   for (int i = 0; i < 8192; oddByte += 2, evenByte += 2, i++)
-   {
-      destBINBlock[oddByte]  = srcSMDBlock[i];
-      destBINBlock[evenByte] = srcSMDBlock[i+8192];
-   }
-}
+            NGROM_NS::StatTimer headerTimer(NGROM_NS::HEADER_STAGE);
+            size_t numBytesRead = fread(tmpBytes, 1, NUM_HEADER_BYTES, inFile);
+            headerTimer.stop();
+            fileStats.addBytes(numBytesRead, 0);
+            fileProbe.setBytes(input.knownSize());
 
-// -----------------------------------------------------------------------------
+            if (numBytesRead < NUM_HEADER_BYTES)
+            {
+               std::cerr << "  NGROM ERROR: Incomplete read..." << std::endl;
+               retval = false;
+            }
+            else
+            {
+               NGROM_NS::StatTimer checkTimer(NGROM_NS::CHECK_STAGE);
+               NGROM_NS::RomFormat likelyFmt = getLikelyFileFormat(input, tmpBytes);
+               checkTimer.stop();
+               NGROM_NS::probeHeaderParsed("check", filename, input.knownSize(), likelyFmt);
+
+               if (likelyFmt == NGROM_NS::UNK_FMT)
+               {
+                  std::cout << "  ...FAILED! (unrecognized format)" << std::endl;
+                  retval = false;
+               }
+               else
+               {
+                  std::cout << "  ...GOOD! (" << getFormatName(likelyFmt) << ")" << std::endl;
+                  fileProbe.setStatus(NGROM_NS::PROBE_OK);
+               }
+            }
+
+            NGROM_NS::StatTimer closeTimer(NGROM_NS::CLOSE_STAGE);
+            input.close();
+         }
+      }
+      else
+      {
+         std::cerr << "NGROM ERROR: checkFormats not implemented for specified fmt: " << fmt << std::endl;
+         return false;
+      }
+   }
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getOutputFilename
+// Description: Determines the output (BIN) file name for an input file path.
+//              The directory part is dropped, as is a ".gz" extension (any
+//              case); then a ".smd", ".mgd", or ".bin" extension (any case) is
+//              replaced with ".bin", otherwise ".bin" is appended.
+// Return: Output file name (no directory).
+// -----------------------------------------------------------------------------
+std::string getOutputFilename(const std::string& inFilename)
+{
+   std::string outFilename = inFilename;
+
+   size_t slashPos = outFilename.rfind('/');
+   if (slashPos != std::string::npos)
+   {
+      outFilename.erase(0, slashPos + 1);
+   }
+
+   if ((outFilename.length() > 3) && (0 == strcasecmp(outFilename.c_str() + outFilename.length() - 3, ".gz")))
+   {
+      outFilename.erase(outFilename.length() - 3);
+   }
+
+   // Suffix is everything after the last '.' (same as QFileInfo::suffix).
+   std::string suffix;
+   size_t dotPos = outFilename.rfind('.');
+   if (dotPos != std::string::npos)
+   {
+      suffix = outFilename.substr(dotPos + 1);
+   }
+
+   if ((suffix.length() == 3) &&
+       ((0 == strcasecmp(suffix.c_str(), "smd")) ||
+        (0 == strcasecmp(suffix.c_str(), "mgd")) ||
+        (0 == strcasecmp(suffix.c_str(), "bin"))))
+   {
+      // Replace extension with "bin"
+      size_t fnameLen = outFilename.length();
+      outFilename.replace(fnameLen-3, 3, "bin");
+   }
+   else
+   {
+      // Append extension ".bin"
+      outFilename += ".bin";
+   }
+
+   return outFilename;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getOutputPath
+// Description: Determines the path of an input file's output: the output
+//              file name (plus any compression suffix) in the output directory.
+// Return: Output file path.
+// -----------------------------------------------------------------------------
+std::string getOutputPath(const std::string& inFilename, const NGROM_NS::ConvertOptions& options)
+{
+   return options.outdir + "/" + getOutputFilename(inFilename) + NGROM_NS::getCompressionSuffix(options.compression);
+}
+
+// -----------------------------------------------------------------------------
+// Function: isUnchangedInput
+// Description: Checks, ahead of the conversions, whether the manifest (if
+//              any) shows an input unchanged since its last conversion, with
+//              its output intact; its conversion will be skipped.  Only opens
+//              the input (for its contentStat, as the conversion does).
+// Return: true if the input's conversion will be skipped; false otherwise.
+// -----------------------------------------------------------------------------
+bool isUnchangedInput(const std::string& inFilename, const NGROM_NS::ConvertOptions& options)
+{
+   NGROM_NS::InputFile input;
+   return (options.manifest != NULL) && input.openFile(inFilename) &&
+          (options.manifest->checkInput(inFilename, input.contentStat(), getOutputPath(inFilename, options)) ==
+           NGROM_NS::Manifest::UNCHANGED_INPUT);
+}
+
+// -----------------------------------------------------------------------------
+// Function: readROMHeader
+// Description: Reads the start of the (just opened) input, determines its
+//              likely format, and decodes the first NUM_HEADER_BYTES of its
+//              ROM data (i.e., the BIN layout, with the Genesis header info at
+//              0x100) into binHeaderBytes.  For SMD, this takes decoding the
+//              first SMD block.  A compressed input is read decompressed.
+// Return: true if the header was read (fmt is UNK_FMT if the format is not
+//         recognized, in which case binHeaderBytes holds the raw bytes);
+//         false on an incomplete read.
+// -----------------------------------------------------------------------------
+bool readROMHeader(NGROM_NS::InputFile& input, unsigned char* binHeaderBytes, NGROM_NS::RomFormat& fmt)
+{
+   FILE* inFile = input.file();
+
+   // The SMD format contains the desired info within a 16 KB SMD block.  The
+   // function to decode the block will need the full allocation in the
+   // destination buffer.
+   unsigned char tmpBINBlock[NUM_SMD_BLOCK_BYTES];
+   unsigned char tmpSMDBlock[NUM_SMD_BLOCK_BYTES];
+
+   fmt = NGROM_NS::UNK_FMT;
+
+   size_t numBytesRead = fread(binHeaderBytes, 1, NUM_HEADER_BYTES, inFile);
+   if (numBytesRead < NUM_HEADER_BYTES)
+   {
+      return false;
+   }
+
+   fmt = getLikelyFileFormat(input, binHeaderBytes);
+
+   if (fmt == NGROM_NS::SMD)
+   {
+      // Get first SMD block and decode it.
+      // NOTE: at this point we've already skipped the first 512 bytes of the file.
+      memset(tmpSMDBlock, 0, NUM_SMD_BLOCK_BYTES);
+      numBytesRead = fread(tmpSMDBlock, 1, NUM_SMD_BLOCK_BYTES, inFile);
+      if (numBytesRead < NUM_HEADER_BYTES)
+      {
+         return false;
+      }
+
+      // Decode the SMD block containing the header info
+      decodeSMDBlock(tmpBINBlock, tmpSMDBlock);
+      memcpy(binHeaderBytes, tmpBINBlock, NUM_HEADER_BYTES);
+   }
+   else if (fmt == NGROM_NS::BIN_SWAPPED)
+   {
+      swapBINWords(binHeaderBytes, NUM_HEADER_BYTES);
+   }
+   else if (fmt == NGROM_NS::MGD)
+   {
+      // The header's odd bytes are at the start of the file (already read),
+      // and its even bytes are at the start of the second half; together
+      // they're a (small) MGD of just the header.
+      const size_t numHalfBytes = NUM_HEADER_BYTES / 2;
+      memcpy(tmpSMDBlock, binHeaderBytes, numHalfBytes);
+
+      if (!input.readAt(tmpSMDBlock + numHalfBytes, numHalfBytes, input.size() / 2))
+      {
+         return false;
+      }
+
+      decodeMGDData(binHeaderBytes, tmpSMDBlock, NUM_HEADER_BYTES);
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
 // Function: showInfoList
 // Description: Parses metadata embedded in each of the input files from the
 //              supplied list and displays them to STDOUT.
 // -----------------------------------------------------------------------------
-void showInfoList(const QStringList& filenameList)
+void showInfoList(const std::vector<std::string>& filenameList)
 {
-   // Header is only 512 bytes, but the SMD format contains the desired info
-   // within a 16 KB SMD block.  The function to decode the block will need the
-   // full allocation in the destination buffer.
-   unsigned char tmpHeaderBytes[NUM_SMD_BLOCK_BYTES];
-   memset(tmpHeaderBytes, 0, NUM_SMD_BLOCK_BYTES);
+   // Header is only 512 bytes (readROMHeader decodes it into the BIN layout).
+   unsigned char tmpHeaderBytes[NUM_HEADER_BYTES];
+   memset(tmpHeaderBytes, 0, NUM_HEADER_BYTES);
 
-   unsigned char tmpSMDBlock[NUM_SMD_BLOCK_BYTES];
-   memset(tmpSMDBlock, 0, NUM_SMD_BLOCK_BYTES);
+   NGROM_NS::StatPassTimer passTimer(NGROM_NS::INFO_PASS);
 
-   for (QString filename : filenameList)
+   for (const std::string& filename : filenameList)
    {
-      std::cout << "Showing info from ROM data for file: " << filename.toStdString() << std::endl;
-
-      FILE* inFile = fopen(filename.toStdString().c_str(), "r");
+      NGROM_NS::FileStats fileStats(NGROM_NS::INFO_PASS, filename);
+      NGROM_NS::FileProbe fileProbe("info", filename);
+      std::cout << "Showing info from ROM data for file: " << filename << std::endl;
+
+      NGROM_NS::StatTimer openTimer(NGROM_NS::OPEN_STAGE);
+      NGROM_NS::InputFile input;
+      FILE* inFile = input.open(filename) ? input.file() : NULL;
+      openTimer.stop();
       if (inFile == NULL)
       {
          int saved_errno = errno;
@@ -379,10 +1184,18 @@ void showInfoList(const QStringList& filenameList)
       else
       {
          // Clear bytes buffer
-         memset(tmpHeaderBytes, 0, NUM_SMD_BLOCK_BYTES);
+         memset(tmpHeaderBytes, 0, NUM_HEADER_BYTES);
+
+         NGROM_NS::RomFormat likelyFmt = NGROM_NS::UNK_FMT;
 
-         size_t numBytesRead = fread(tmpHeaderBytes, 1, NUM_HEADER_BYTES, inFile);
-         if (numBytesRead < NUM_HEADER_BYTES)
+         // (Reading the header includes detecting the format.)
+         NGROM_NS::StatTimer headerTimer(NGROM_NS::HEADER_STAGE);
+         bool headerRead = readROMHeader(input, tmpHeaderBytes, likelyFmt);
+         headerTimer.stop();
+         fileStats.addBytes(NUM_HEADER_BYTES, 0);
+         fileProbe.setBytes(input.knownSize());
+
+         if (!headerRead)
          {
             std::cerr << "  NGROM ERROR: Incomplete read..." << std::endl;
             std::cout << "  ... skipping." << std::endl;
@@ -390,7 +1203,7 @@ void showInfoList(const QStringList& filenameList)
          else
          {
             bool okToContinue = true;
-            NGROM_NS::RomFormat likelyFmt = getLikelyFormat(tmpHeaderBytes);
+            NGROM_NS::probeHeaderParsed("info", filename, input.knownSize(), likelyFmt);
 
             if (likelyFmt == NGROM_NS::UNK_FMT)
             {
@@ -398,29 +1211,11 @@ void showInfoList(const QStringList& filenameList)
                std::cout << "  ... skipping." << std::endl;
                okToContinue = false;
             }
-            else if (likelyFmt == NGROM_NS::SMD)
-            {
-               // Get first SMD block and decode it.
-               // NOTE: at this point we've already skipped the first 512 bytes of the file.
-               numBytesRead = fread(tmpSMDBlock, 1, NUM_SMD_BLOCK_BYTES, inFile);
-               if (numBytesRead < NUM_HEADER_BYTES)
-               {
-                  std::cerr << "  NGROM ERROR: Incomplete read..." << std::endl;
-                  std::cout << "  ... skipping." << std::endl;
-                  okToContinue = false;
-               }
-               else
-               {
-                  // Clear destination buffer (again)
-                  memset(tmpHeaderBytes, 0, NUM_SMD_BLOCK_BYTES);
-
-                  // Decode the SMD block containing the header info
-                  decodeSMDBlock(tmpHeaderBytes, tmpSMDBlock);
-               }
-            }
 
             if (okToContinue)
             {
+               fileProbe.setStatus(NGROM_NS::PROBE_OK);
+
                char decodedChars[50];  // It looks like from GROM, the largest string is
                                        // only 48 characters, but I like nice round numbers.
                char hexChars[10];  // Gonna use snprintf to format bytes into hex characters.
@@ -516,158 +1311,1037 @@ void showInfoList(const QStringList& filenameList)
                std::cout << "                 Countries: " << decodedChars << std::endl;
             }
          }
-         fclose(inFile);
+
+         NGROM_NS::StatTimer closeTimer(NGROM_NS::CLOSE_STAGE);
+         input.close();
       }
    }
 }
 
 // -----------------------------------------------------------------------------
-// Function: convertFiles
-// Description: Performs the (SMD->BIN) ROM format conversion on each of the
-//              input files from the supplied list.
-// Return: true if output files written successfully;
-//         false if any error occurred.
+// Function: writeBINData
+// Description: Writes BIN data at its offset in the output file: with
+//              pwrite for a plain output file (the data goes straight to its
+//              preallocated place, with no stream buffering), or through the
+//              stream for a compressed output (written in order).
+// Return: true if all written; false on error (errno is set).
 // -----------------------------------------------------------------------------
-bool convertFiles(const QStringList& filenameList,
-                  const std::string& outdir,
-                  NGROM_NS::FileCheckAction fileCollisionAction)
+static bool writeBINData(FILE* outBINFile, const unsigned char* bytes, size_t numBytes, uint64_t offset)
+{
+   NGROM_NS::StatTimer writeTimer(NGROM_NS::WRITE_STAGE);
+   NGROM_NS::PerfScope writeScope(NGROM_NS::WRITE_REGION, numBytes);
+
+   int outFd = fileno(outBINFile);
+   if (outFd < 0)
+   {
+      return (numBytes == fwrite(bytes, 1, numBytes, outBINFile));
+   }
+
+   while (numBytes > 0)
+   {
+      ssize_t numBytesWritten = pwrite(outFd, bytes, numBytes, offset);
+      if (numBytesWritten < 0)
+      {
+         if (errno == EINTR) { continue; }
+         return false;
+      }
+      bytes += numBytesWritten;
+      numBytes -= numBytesWritten;
+      offset += numBytesWritten;
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: decodeSMDFile
+// Description: Decodes the SMD blocks following the (already read) header of
+//              the input file and writes the BIN data.
+// Return: true if all blocks converted; false if any error occurred.
+// -----------------------------------------------------------------------------
+static bool decodeSMDFile(FILE* inSMDFile, FILE* outBINFile, size_t numBlocks,
+                          NGROM_NS::ContentHasher& contentHasher, std::ostream& err)
 {
-   bool retval = true;
    unsigned char smdBlockBytes[NUM_SMD_BLOCK_BYTES];
    unsigned char binBlockBytes[NUM_SMD_BLOCK_BYTES];
 
-   for (QString filename : filenameList)
+   // Convert each of the blocks.
+   for (size_t i = 0; i < numBlocks; i++)
    {
-      // Determine output file path/name
-      QFileInfo inFileInfo(filename);
+      // Reset data buffers
+      memset(smdBlockBytes, 0, NUM_SMD_BLOCK_BYTES);
+      memset(binBlockBytes, 0, NUM_SMD_BLOCK_BYTES);
+
+      // Read in SMD block
+      NGROM_NS::TraceSpan readSpan("read chunk", "io");
+      NGROM_NS::PerfScope readScope(NGROM_NS::READ_REGION, NUM_SMD_BLOCK_BYTES);
+      size_t numBytesRead = fread(smdBlockBytes, 1, NUM_SMD_BLOCK_BYTES, inSMDFile);
+      readScope.stop();
+      readSpan.end();
+      if (numBytesRead < NUM_SMD_BLOCK_BYTES)
+      {
+         err << "  NGROM ERROR: Incomplete read of SMD block!" << std::endl;
+         return false;
+      }
+
+      contentHasher.update(smdBlockBytes, NUM_SMD_BLOCK_BYTES);
 
-      QString outFilename = inFileInfo.fileName();
+      // Convert to BIN block
+      NGROM_NS::TraceSpan decodeSpan("decode batch", "cpu");
+      NGROM_NS::PerfScope decodeScope(NGROM_NS::DECODE_REGION, NUM_SMD_BLOCK_BYTES);
+      decodeSMDBlock(binBlockBytes, smdBlockBytes);
+      decodeScope.stop();
+      decodeSpan.end();
+      NGROM_NS::probeBlockDecoded(NUM_SMD_BLOCK_BYTES, (uint64_t)i * NUM_SMD_BLOCK_BYTES);
 
-      if (inFileInfo.suffix().toLower() == "smd")
+      // Write out BIN block
+      if (!writeBINData(outBINFile, binBlockBytes, NUM_SMD_BLOCK_BYTES, (uint64_t)i * NUM_SMD_BLOCK_BYTES))
       {
-         // Replace extension with "bin"
-         size_t fnameLen = outFilename.length();
-         outFilename.replace(fnameLen-3, 3, "bin");
+         err << "  NGROM ERROR: Incomplete write of BIN block!" << std::endl;
+         return false;
       }
-      else
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: waitForBINWrite
+// Description: Waits for a BIN write running on another thread, if any (the
+//              wait is timed as the conversion's writing).
+// Return: true if written (or none); false on error.
+// -----------------------------------------------------------------------------
+static bool waitForBINWrite(std::future<bool>& pendingWrite)
+{
+   NGROM_NS::StatTimer writeTimer(NGROM_NS::WRITE_STAGE);
+   return !pendingWrite.valid() || pendingWrite.get();
+}
+
+// -----------------------------------------------------------------------------
+// Function: decodeSMDFileDirect
+// Description: Like decodeSMDFile, for direct I/O: the SMD blocks are read
+//              DIRECT_CHUNK_BLOCKS at a time with large aligned preads (the
+//              odd-sized header is handled by reading an aligned superset of
+//              each chunk), and each chunk's BIN data is written while the
+//              next chunk is read and decoded.  The transfers are aligned for
+//              inFd (and the output file, unless compressed) being in
+//              O_DIRECT mode.
+// Return: true if all blocks converted; false if any error occurred.
+// -----------------------------------------------------------------------------
+static bool decodeSMDFileDirect(int inFd, FILE* outBINFile, size_t numBlocks,
+                                NGROM_NS::ContentHasher& contentHasher, std::ostream& err)
+{
+   const size_t maxChunkBytes = DIRECT_CHUNK_BLOCKS * NUM_SMD_BLOCK_BYTES;
+
+   // (Two BIN buffers: one being written while the other is filled.)
+   NGROM_NS::AlignedBuffer smdBuffer(NUM_HEADER_BYTES + maxChunkBytes);
+   NGROM_NS::AlignedBuffer binBuffer0(maxChunkBytes);
+   NGROM_NS::AlignedBuffer binBuffer1(maxChunkBytes);
+   unsigned char* binBuffers[2] = { binBuffer0.data(), binBuffer1.data() };
+   if ((smdBuffer.data() == NULL) || (binBuffers[0] == NULL) || (binBuffers[1] == NULL))
+   {
+      err << "  NGROM ERROR: Failed to allocate I/O buffers!" << std::endl;
+      return false;
+   }
+
+   std::future<bool> pendingWrite;
+   size_t chunkIndex = 0;
+
+   for (size_t firstBlock = 0; firstBlock < numBlocks; firstBlock += DIRECT_CHUNK_BLOCKS, chunkIndex++)
+   {
+      size_t numChunkBlocks = std::min(DIRECT_CHUNK_BLOCKS, numBlocks - firstBlock);
+      size_t chunkBytes = numChunkBlocks * NUM_SMD_BLOCK_BYTES;
+
+      // A block's input offset is its output offset plus the header, so the
+      // read starts at the (aligned) output offset and covers the chunk's
+      // blocks and the header's worth before them, rounded up to alignment.
+      uint64_t chunkOffset = (uint64_t)firstBlock * NUM_SMD_BLOCK_BYTES;
+      size_t neededBytes = NUM_HEADER_BYTES + chunkBytes;
+      size_t readBytes = (neededBytes + NGROM_NS::DIRECT_IO_ALIGNMENT - 1) / NGROM_NS::DIRECT_IO_ALIGNMENT * NGROM_NS::DIRECT_IO_ALIGNMENT;
+      NGROM_NS::TraceSpan readSpan("read chunk", "io");
+      NGROM_NS::PerfScope readScope(NGROM_NS::READ_REGION, readBytes);
+      size_t numBytesRead = NGROM_NS::preadUntilEnd(inFd, smdBuffer.data(), readBytes, chunkOffset);
+      readScope.stop();
+      readSpan.end();
+      if (numBytesRead < neededBytes)
+      {
+         err << "  NGROM ERROR: Incomplete read of SMD block!" << std::endl;
+         return false;
+      }
+
+      unsigned char* binBytes = binBuffers[chunkIndex % 2];
+      NGROM_NS::TraceSpan decodeSpan("decode batch", "cpu");
+      for (size_t i = 0; i < numChunkBlocks; i++)
+      {
+         const unsigned char* smdBlockBytes = smdBuffer.data() + NUM_HEADER_BYTES + (i * NUM_SMD_BLOCK_BYTES);
+         contentHasher.update(smdBlockBytes, NUM_SMD_BLOCK_BYTES);
+         NGROM_NS::PerfScope decodeScope(NGROM_NS::DECODE_REGION, NUM_SMD_BLOCK_BYTES);
+         decodeSMDBlock(binBytes + (i * NUM_SMD_BLOCK_BYTES), smdBlockBytes);
+         decodeScope.stop();
+         NGROM_NS::probeBlockDecoded(NUM_SMD_BLOCK_BYTES, chunkOffset + (i * NUM_SMD_BLOCK_BYTES));
+      }
+      decodeSpan.end();
+
+      if (!waitForBINWrite(pendingWrite))
+      {
+         err << "  NGROM ERROR: Incomplete write of BIN block!" << std::endl;
+         return false;
+      }
+      pendingWrite = std::async(std::launch::async, writeBINData, outBINFile, binBytes, chunkBytes, chunkOffset);
+   }
+
+   if (!waitForBINWrite(pendingWrite))
+   {
+      err << "  NGROM ERROR: Incomplete write of BIN block!" << std::endl;
+      return false;
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: decodeMGDFile
+// Description: Decodes an MGD input file (the first NUM_HEADER_BYTES of which
+//              were already read) and writes the BIN data.  MGD interleaves
+//              across the whole file, so the file is decoded in memory (Genesis
+//              ROMs are only a few MB).
+// Return: true if converted; false if any error occurred.
+// -----------------------------------------------------------------------------
+static bool decodeMGDFile(FILE* inMGDFile, FILE* outBINFile, size_t fileSize,
+                          const unsigned char* headerBytes,
+                          NGROM_NS::ContentHasher& contentHasher, std::ostream& err)
+{
+   // (Pooled buffers: no allocation, or zero-filling, per file.)
+   NGROM_NS::AlignedBuffer mgdBytes(fileSize);
+   NGROM_NS::AlignedBuffer binBytes(fileSize);
+   if ((mgdBytes.data() == NULL) || (binBytes.data() == NULL))
+   {
+      err << "  NGROM ERROR: Failed to allocate MGD buffers!" << std::endl;
+      return false;
+   }
+
+   memcpy(mgdBytes.data(), headerBytes, NUM_HEADER_BYTES);
+
+   NGROM_NS::TraceSpan readSpan("read chunk", "io");
+   NGROM_NS::PerfScope readScope(NGROM_NS::READ_REGION, fileSize - NUM_HEADER_BYTES);
+   size_t numBytesRead = fread(mgdBytes.data() + NUM_HEADER_BYTES, 1, fileSize - NUM_HEADER_BYTES, inMGDFile);
+   readScope.stop();
+   readSpan.end();
+   if (numBytesRead < (fileSize - NUM_HEADER_BYTES))
+   {
+      err << "  NGROM ERROR: Incomplete read of MGD data!" << std::endl;
+      return false;
+   }
+
+   contentHasher.update(mgdBytes.data() + NUM_HEADER_BYTES, fileSize - NUM_HEADER_BYTES);
+
+   NGROM_NS::TraceSpan decodeSpan("decode batch", "cpu");
+   NGROM_NS::PerfScope decodeScope(NGROM_NS::DECODE_REGION, fileSize);
+   decodeMGDData(binBytes.data(), mgdBytes.data(), fileSize);
+   decodeScope.stop();
+   decodeSpan.end();
+   NGROM_NS::probeBlockDecoded(fileSize, 0);
+
+   if (!writeBINData(outBINFile, binBytes.data(), fileSize, 0))
+   {
+      err << "  NGROM ERROR: Incomplete write of BIN data!" << std::endl;
+      return false;
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: fixSwappedBINFile
+// Description: Byte-swaps each 16-bit word of a word-swapped BIN input file
+//              (the first NUM_HEADER_BYTES of which were already read) and
+//              writes the corrected BIN data.
+// Return: true if converted; false if any error occurred.
+// -----------------------------------------------------------------------------
+static bool fixSwappedBINFile(FILE* inBINFile, FILE* outBINFile,
+                              const unsigned char* headerBytes,
+                              NGROM_NS::ContentHasher& contentHasher, std::ostream& err)
+{
+   unsigned char chunkBytes[NUM_SMD_BLOCK_BYTES];
+
+   memcpy(chunkBytes, headerBytes, NUM_HEADER_BYTES);
+   size_t numBytes = NUM_HEADER_BYTES;
+   uint64_t outOffset = 0;
+
+   while (numBytes > 0)
+   {
+      NGROM_NS::TraceSpan decodeSpan("decode batch", "cpu");
+      NGROM_NS::PerfScope decodeScope(NGROM_NS::DECODE_REGION, numBytes);
+      swapBINWords(chunkBytes, numBytes);
+      decodeScope.stop();
+      decodeSpan.end();
+      NGROM_NS::probeBlockDecoded(numBytes, outOffset);
+
+      if (!writeBINData(outBINFile, chunkBytes, numBytes, outOffset))
+      {
+         err << "  NGROM ERROR: Incomplete write of BIN data!" << std::endl;
+         return false;
+      }
+      outOffset += numBytes;
+
+      NGROM_NS::TraceSpan readSpan("read chunk", "io");
+      NGROM_NS::PerfScope readScope(NGROM_NS::READ_REGION, NUM_SMD_BLOCK_BYTES);
+      numBytes = fread(chunkBytes, 1, NUM_SMD_BLOCK_BYTES, inBINFile);
+      readScope.setBytes(numBytes);
+      readScope.stop();
+      readSpan.end();
+      contentHasher.update(chunkBytes, numBytes);
+   }
+
+   if (ferror(inBINFile))
+   {
+      err << "  NGROM ERROR: Incomplete read of BIN data!" << std::endl;
+      return false;
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: passThroughBINFile
+// Description: Copies an (already correct) BIN input file to the output file
+//              with as little data movement as possible: a reflink, or an
+//              in-kernel copy.  The input is only read (to finish the content
+//              hash) if the hash is needed.  A compressed input or output (no
+//              file descriptor) is copied through the buffers instead, after
+//              the already-read headerBytes.
+// Return: true if copied; false if any error occurred.
+// -----------------------------------------------------------------------------
+static bool passThroughBINFile(FILE* inBINFile, FILE* outBINFile, size_t fileSize,
+                               const unsigned char* headerBytes, bool needContentHash,
+                               NGROM_NS::ContentHasher& contentHasher,
+                               std::ostream& out, std::ostream& err)
+{
+   if ((fileno(inBINFile) < 0) || (fileno(outBINFile) < 0))
+   {
+      unsigned char chunkBytes[NUM_SMD_BLOCK_BYTES];
+      size_t numBytesRead;
+      uint64_t outOffset = NUM_HEADER_BYTES;
+      bool writeOK = writeBINData(outBINFile, headerBytes, NUM_HEADER_BYTES, 0);
+
+      while (writeOK && ((numBytesRead = fread(chunkBytes, 1, NUM_SMD_BLOCK_BYTES, inBINFile)) > 0))
+      {
+         contentHasher.update(chunkBytes, numBytesRead);
+         writeOK = writeBINData(outBINFile, chunkBytes, numBytesRead, outOffset);
+         outOffset += numBytesRead;
+      }
+
+      if (!writeOK)
+      {
+         int saved_errno = errno;
+         err << "  NGROM ERROR: Failed to write BIN data... " << strerror(saved_errno) << std::endl;
+         return false;
+      }
+
+      if (ferror(inBINFile))
       {
-         // Append extension ".bin"
-         outFilename += ".bin";
+         err << "  NGROM ERROR: Incomplete read of BIN data!" << std::endl;
+         return false;
       }
 
-      std::string outFileFullPath = outdir;
-      outFileFullPath += "/";
-      outFileFullPath += outFilename.toStdString();
+      out << "  Passed through (buffered)" << std::endl;
+      return true;
+   }
+
+   NGROM_NS::StatTimer writeTimer(NGROM_NS::WRITE_STAGE);
+   NGROM_NS::CloneMethod method = NGROM_NS::cloneFileRange(fileno(inBINFile), 0, fileno(outBINFile), fileSize);
+   writeTimer.stop();
+   if (method == NGROM_NS::CLONE_FAILED)
+   {
+      int saved_errno = errno;
+      err << "  NGROM ERROR: Failed to copy BIN data... " << strerror(saved_errno) << std::endl;
+      return false;
+   }
 
-      std::cout << "Converting " << filename.toStdString() << std::endl
-                << "        to " << outFileFullPath << std::endl;
+   out << ((method == NGROM_NS::CLONE_REFLINK) ? "  Passed through (reflink)" : "  Passed through (copy)") << std::endl;
 
-      // Check for existing output file
-      QFileInfo outFileInfo(outFileFullPath.c_str());
+   if (needContentHash)
+   {
+      unsigned char chunkBytes[NUM_SMD_BLOCK_BYTES];
+      size_t numBytesRead;
 
-      if (outFileInfo.exists())
+      while ((numBytesRead = fread(chunkBytes, 1, NUM_SMD_BLOCK_BYTES, inBINFile)) > 0)
       {
-         std::cerr << "  NGROM WARNING: Output file already exists!" << std::endl;
-         if (fileCollisionAction == NGROM_NS::STOP)
+         contentHasher.update(chunkBytes, numBytesRead);
+      }
+
+      if (ferror(inBINFile))
+      {
+         err << "  NGROM ERROR: Incomplete read of BIN data!" << std::endl;
+         return false;
+      }
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getConversionBufferBytes
+// Description: Gets the most buffer memory a conversion holds at once: the
+//              input's and output's buffers, plus the decoder's (a whole MGD
+//              ROM twice; direct I/O chunks; else a block or two).
+// -----------------------------------------------------------------------------
+static uint64_t getConversionBufferBytes(NGROM_NS::RomFormat inFormat, const NGROM_NS::InputFile& input,
+                                         const NGROM_NS::ConvertOptions& options)
+{
+   uint64_t numBytes = input.bufferBytes() + NGROM_NS::getOutputBufferBytes(options.compression);
+
+   if (inFormat == NGROM_NS::MGD)
+   {
+      numBytes += 2 * NGROM_NS::getAlignedBufferBytes(input.size());
+   }
+   else if ((inFormat == NGROM_NS::SMD) && options.directIO && !input.isCompressed())
+   {
+      size_t maxChunkBytes = DIRECT_CHUNK_BLOCKS * NUM_SMD_BLOCK_BYTES;
+      numBytes += NGROM_NS::getAlignedBufferBytes(NUM_HEADER_BYTES + maxChunkBytes) +
+                  (2 * NGROM_NS::getAlignedBufferBytes(maxChunkBytes));
+   }
+   else
+   {
+      numBytes += 2 * NUM_SMD_BLOCK_BYTES;
+   }
+
+   return numBytes;
+}
+
+// -----------------------------------------------------------------------------
+// Function: convertInputFile
+// Description: Performs the (SMD->BIN) ROM format conversion on one input
+//              file (fileIndex is its position in the run, for the journal).
+//              In AUTO_FMT mode, the file's format is detected and picks the
+//              conversion: SMD or MGD decoding, BIN word-swap fixing, or BIN
+//              pass-through (reflinked or copied in-kernel where possible).
+//              With a manifest, an input that is unchanged since its last
+//              conversion is skipped, and a successful conversion is recorded.
+//              With a journal, the conversion's start and completion are
+//              recorded, and work completed in an interrupted run is not
+//              redone.  With dedup, an input identical to one already
+//              converted gets its output linked to that one's output instead
+//              of being decoded again.  With a committer (durable mode), the
+//              output is only put in place, and its completion journaled,
+//              once its group commit has synced it.  With a memory budget,
+//              the conversion's buffers are reserved before it starts (which
+//              may wait for other conversions to finish).  Messages go to
+//              out and err.
+// Return: true if the output file was written (or skipped);
+//         false if any error occurred (the run should stop).
+// -----------------------------------------------------------------------------
+static bool convertInputFile(const std::string& filename, size_t fileIndex,
+                             const NGROM_NS::ConvertOptions& options, NGROM_NS::FileProbe& fileProbe,
+                             std::ostream& out, std::ostream& err)
+{
+   NGROM_NS::FileStats fileStats(NGROM_NS::CONVERT_PASS, filename);
+
+   // Determine output file path/name
+   std::string outFilename = getOutputFilename(filename) + NGROM_NS::getCompressionSuffix(options.compression);
+   std::string outFileFullPath = getOutputPath(filename, options);
+
+   out << "Converting " << filename << std::endl
+       << "        to " << outFileFullPath << std::endl;
+
+   // Journals this input's completion (durable mode: once its output is committed)
+   std::function<bool()> journalCompletion = [&options, fileIndex]()
+   {
+      NGROM_NS::ConvertStateLock completionLock(options);
+      return (options.journal == NULL) || options.journal->recordComplete(fileIndex);
+   };
+
+   // (Parallel runs share the journal, manifest, and dedup index.)
+   NGROM_NS::ConvertStateLock stateLock(options);
+
+   // Check the journal (resumed run) for previous progress on this input
+   if (options.journal != NULL)
+   {
+      if (options.journal->isCompleted(fileIndex))
+      {
+         out << "  Already completed (journal); skipping." << std::endl;
+         return true;
+      }
+      else if (options.journal->isPartial(fileIndex))
+      {
+         out << "  Removing partial output from interrupted run." << std::endl;
+         int rc = (options.outputDir != NULL) ? options.outputDir->removeOutput(outFilename)
+                                              : unlink(outFileFullPath.c_str());
+         if ((0 != rc) && (errno != ENOENT))
          {
-            // STOP; must return now.
+            int saved_errno = errno;
+            err << "  NGROM ERROR: Failed to remove partial OUTPUT file... " << strerror(saved_errno) << std::endl;
             return false;
          }
-         else if (fileCollisionAction == NGROM_NS::SKIP)
+      }
+   }
+
+   stateLock.unlock();
+
+   // Open the input file (read later, once it's known to need converting);
+   // its fstat is what the collision checks go by, and (for a zip member, its
+   // central directory record instead) what the manifest goes by.
+   NGROM_NS::InputFile input;
+   NGROM_NS::StatTimer fileOpenTimer(NGROM_NS::OPEN_STAGE);
+   if (!input.openFile(filename))
+   {
+      int saved_errno = errno;
+      err << "  NGROM ERROR: Failed to open INPUT file... " << strerror(saved_errno) << std::endl;
+
+      // Must return immediately
+      return false;
+   }
+   fileOpenTimer.stop();
+   const struct stat& inFileStat = input.fileStat();
+   const struct stat& inContentStat = input.contentStat();
+
+   // Check the manifest for a previous conversion of this input
+   bool staleOutput = false;
+   if (options.manifest != NULL)
+   {
+      // (Only the record lookup and update need the lock; checking may take
+      // hashing the input or the output.)
+      NGROM_NS::Manifest::Entry entry;
+      NGROM_NS::Manifest::InputStatus inputStatus = NGROM_NS::Manifest::NEW_INPUT;
+      stateLock.lock();
+      bool hasEntry = options.manifest->lookupInput(filename, entry);
+      stateLock.unlock();
+
+      if (hasEntry)
+      {
+         bool entryUpdated = false;
+         inputStatus = NGROM_NS::Manifest::checkEntry(entry, inContentStat, outFileFullPath, entryUpdated);
+         if (entryUpdated)
+         {
+            stateLock.lock();
+            options.manifest->updateEntry(entry);
+            stateLock.unlock();
+         }
+      }
+
+      if (inputStatus == NGROM_NS::Manifest::UNCHANGED_INPUT)
+      {
+         out << "  Unchanged since last conversion; skipping." << std::endl;
+         return true;
+      }
+      else if (inputStatus == NGROM_NS::Manifest::CHANGED_INPUT)
+      {
+         out << "  Input changed since last conversion; output is stale, regenerating." << std::endl;
+         staleOutput = true;
+      }
+      else if (inputStatus == NGROM_NS::Manifest::MISSING_OUTPUT)
+      {
+         out << "  Output missing or modified since last conversion; regenerating." << std::endl;
+         staleOutput = true;
+      }
+   }
+
+   // Another input of this (parallel) run already writing the same output?
+   if (options.sync != NULL)
+   {
+      stateLock.lock();
+      bool claimed = options.sync->claimedOutputs.insert(outFileFullPath).second;
+      stateLock.unlock();
+
+      if (!claimed)
+      {
+         err << "  NGROM WARNING: Output file is written by another input of this run!" << std::endl;
+         if (options.fileCollisionAction == NGROM_NS::STOP)
          {
-            // SKIP; move on to next input file.
-            std::cout << "  ...skipping!" << std::endl;
-            continue;
+            return false;
          }
-         // else - WARN (attempt to overwrite the file).
+         NGROM_NS::probeCollisionSkip(filename, outFileFullPath);
+         out << "  ...skipping!" << std::endl;
+         return true;
       }
+   }
 
-      // Determine number of "blocks" in the SMD file
-      size_t fileSize = inFileInfo.size();
+   // (An output of this run still waiting for its commit must be in place to be seen.)
+   if ((options.committer != NULL) && options.committer->isPending(outFileFullPath) &&
+       !options.committer->flush())
+   {
+      return false;
+   }
+
+   // Check for existing output file (a stale output of ours is not a collision)
+   struct stat outFileStat;
+   bool outFileExists = (options.outputDir != NULL) ? (0 == options.outputDir->statOutput(outFilename, outFileStat))
+                                                    : (0 == stat(outFileFullPath.c_str(), &outFileStat));
+
+   if (outFileExists && (outFileStat.st_dev == inFileStat.st_dev) && (outFileStat.st_ino == inFileStat.st_ino))
+   {
+      // E.g., a BIN input converted into its own directory.
+      err << "  NGROM WARNING: Output file is the input file itself!" << std::endl;
+      NGROM_NS::probeCollisionSkip(filename, outFileFullPath);
+      out << "  ...skipping!" << std::endl;
+      return true;
+   }
+
+   if (!staleOutput && outFileExists)
+   {
+      err << "  NGROM WARNING: Output file already exists!" << std::endl;
+      if (options.fileCollisionAction == NGROM_NS::STOP)
+      {
+         // STOP; must return now.
+         return false;
+      }
+      else if (options.fileCollisionAction == NGROM_NS::SKIP)
+      {
+         // SKIP; move on to next input file.
+         NGROM_NS::probeCollisionSkip(filename, outFileFullPath);
+         out << "  ...skipping!" << std::endl;
+         return true;
+      }
+      // else - WARN (attempt to overwrite the file).
+   }
+
+   if (options.outputDir != NULL)
+   {
+      // (However it's made, the output will exist; later checks must look.)
+      options.outputDir->addName(outFilename);
+   }
+
+   // Ready the input's contents and read its first bytes (the SMD header, or
+   // the start of the ROM data for the other formats); they're part of the
+   // content hash.  (A compressed input's size is its decompressed size.)
+   NGROM_NS::PerfScope fileScope(NGROM_NS::FILE_REGION, 0);
+   NGROM_NS::StatTimer openTimer(NGROM_NS::OPEN_STAGE);
+   if (!input.openContents())
+   {
+      int saved_errno = errno;
+      err << "  NGROM ERROR: Failed to open INPUT file... " << strerror(saved_errno) << std::endl;
+
+      // Must return immediately
+      return false;
+   }
+   openTimer.stop();
+
+   FILE* inFile = input.file();
+   size_t fileSize = input.size();
+   fileScope.setBytes(fileSize);
+   fileProbe.setBytes(fileSize);
+
+   NGROM_NS::ContentHasher contentHasher;
+   unsigned char headerBytes[NUM_HEADER_BYTES];
+
+   NGROM_NS::StatTimer headerTimer(NGROM_NS::HEADER_STAGE);
+   bool headerRead = (fileSize >= NUM_HEADER_BYTES) && (fread(headerBytes, 1, NUM_HEADER_BYTES, inFile) == NUM_HEADER_BYTES);
+   headerTimer.stop();
+
+   if (!headerRead)
+   {
+      err << "  NGROM ERROR: Input file is too small (only " << fileSize << " bytes)" << std::endl;
+      input.close();
+      return false;
+   }
+   contentHasher.update(headerBytes, NUM_HEADER_BYTES);
+
+   // Pick the conversion for this file's format (checking the file, and for
+   // duplicates, is timed as the check stage)
+   NGROM_NS::StatTimer checkTimer(NGROM_NS::CHECK_STAGE);
+   NGROM_NS::RomFormat inFormat = options.inputFormat;
+   if (inFormat == NGROM_NS::AUTO_FMT)
+   {
+      inFormat = getLikelyFileFormat(input, headerBytes);
+      out << "  Format: " << getFormatName(inFormat) << std::endl;
+   }
+   NGROM_NS::probeHeaderParsed("convert", filename, fileSize, inFormat);
+
+   // Determine output size (and validate input size)
+   size_t numBlocks = 0;
+   size_t outFileSize = fileSize;
 
+   if (inFormat == NGROM_NS::SMD)
+   {
+      // Determine number of "blocks" in the SMD file
       if (fileSize < (NUM_HEADER_BYTES + NUM_SMD_BLOCK_BYTES))
       {
-         std::cerr << "  NGROM ERROR: Input file is too small (only " << fileSize << " bytes)" << std::endl;
+         err << "  NGROM ERROR: Input file is too small (only " << fileSize << " bytes)" << std::endl;
+         input.close();
          return false;
       }
 
-      size_t numBlocks = (fileSize - NUM_HEADER_BYTES) / NUM_SMD_BLOCK_BYTES;
+      numBlocks = (fileSize - NUM_HEADER_BYTES) / NUM_SMD_BLOCK_BYTES;
       size_t extraBytes = (fileSize - NUM_HEADER_BYTES) % NUM_SMD_BLOCK_BYTES;
       if (extraBytes > 0)
       {
-         std::cerr << "  NGROM ERROR: Input file does not end on 16KB block boundary (possible data corruption)." << std::endl;
+         err << "  NGROM ERROR: Input file does not end on 16KB block boundary (possible data corruption)." << std::endl;
+         input.close();
          return false;
       }
 
-      // Open input file
-      FILE* inSMDFile = fopen(filename.toStdString().c_str(), "r");
-      if (inSMDFile == NULL)
+      outFileSize = numBlocks * NUM_SMD_BLOCK_BYTES;
+   }
+   else if ((inFormat == NGROM_NS::MGD) || (inFormat == NGROM_NS::BIN_SWAPPED))
+   {
+      if ((fileSize % 2) != 0)
       {
-         int saved_errno = errno;
-         std::cerr << "  NGROM ERROR: Failed to open INPUT file... " << strerror(saved_errno) << std::endl;
-
-         // Must return immediately
+         err << "  NGROM ERROR: Input file has an odd number of bytes (possible data corruption)." << std::endl;
+         input.close();
          return false;
       }
+   }
+   else if (inFormat != NGROM_NS::BIN)
+   {
+      err << "  NGROM ERROR: Unrecognized file format..." << std::endl;
+      out << "  ... skipping." << std::endl;
+      input.close();
+      return true;
+   }
 
-      // Open output file
-      FILE* outBINFile = fopen(outFileFullPath.c_str(), "w");
-      if (outBINFile == NULL)
+   // Identical content already converted?  (Only worth hashing up front if
+   // some converted input has the same size.)
+   stateLock.lock();
+   bool maybeDuplicate = (options.dedup != NULL) && options.dedup->hasInputSize(fileSize);
+   stateLock.unlock();
+
+   if (maybeDuplicate)
+   {
+      uint64_t contentHash = 0;
+      if (!NGROM_NS::hashInput(filename, contentHash))
       {
          int saved_errno = errno;
-         std::cerr << "  NGROM ERROR: Failed to open OUTPUT file... " << strerror(saved_errno) << std::endl;
-
-         // Must return immediately
-         fclose(inSMDFile);
+         err << "  NGROM ERROR: Failed to read INPUT file... " << strerror(saved_errno) << std::endl;
+         input.close();
          return false;
       }
 
-      // Skip header in SMD file
-      fseek(inSMDFile, NUM_HEADER_BYTES, SEEK_SET);
+      // (The lock is only held to look up the first conversion; comparing,
+      // linking or copying, syncing, and hashing are done without it.)
+      stateLock.lock();
+      const NGROM_NS::DedupIndex::Conversion* foundConversion = options.dedup->findOutput(fileSize, contentHash);
+      if ((foundConversion != NULL) && (foundConversion->outputPath != outFileFullPath) &&
+          (options.committer != NULL) && options.committer->isPending(foundConversion->outputPath))
+      {
+         // The first output must be in place to link to it.
+         stateLock.unlock();
+         if (!options.committer->flush())
+         {
+            input.close();
+            return false;
+         }
+         stateLock.lock();
+         foundConversion = options.dedup->findOutput(fileSize, contentHash);
+      }
+
+      NGROM_NS::DedupIndex::Conversion firstConversion;
+      if (foundConversion != NULL)
+      {
+         firstConversion = *foundConversion;
+      }
+      stateLock.unlock();
+
+      // (The hash only finds a candidate; the bytes must match, too.)
+      bool sameContent = (foundConversion != NULL);
+      if (sameContent && (firstConversion.inputPath != filename))
+      {
+         if (!NGROM_NS::compareInputs(filename, firstConversion.inputPath, sameContent))
+         {
+            sameContent = false; // (E.g., the first input is gone; just convert.)
+         }
+         else if (!sameContent)
+         {
+            out << "  Content hash matches " << firstConversion.inputPath << ", but the content differs." << std::endl;
+         }
+      }
 
-      // Convert each of the blocks.
-      bool okToContinue = true;
-      for (size_t i = 0; i < numBlocks; i++)
+      if (sameContent && (firstConversion.outputPath == outFileFullPath))
+      {
+         // Same input listed twice (and output overwrite allowed); already written.
+         out << "  Output already written by an identical input; skipping." << std::endl;
+         input.close();
+         return true;
+      }
+      else if (sameContent)
       {
-         // Reset data buffers
-         memset(smdBlockBytes, 0, NUM_SMD_BLOCK_BYTES);
-         memset(binBlockBytes, 0, NUM_SMD_BLOCK_BYTES);
+         out << "  Duplicate content; not converting again." << std::endl;
+         input.close();
+
+         // (Linking or cloning the first output is this output's writing.)
+         checkTimer.stop();
+         NGROM_NS::StatTimer writeTimer(NGROM_NS::WRITE_STAGE);
+
+         if (options.journal != NULL)
+         {
+            stateLock.lock();
+            bool started = options.journal->recordStart(fileIndex);
+            uint64_t startRecordNum = options.journal->numRecords();
+            stateLock.unlock();
+
+            if (!started || !options.journal->syncThrough(startRecordNum))
+            {
+               return false;
+            }
+         }
+
+         if (!options.dedup->materialize(firstConversion.outputPath, outFileFullPath, out, err))
+         {
+            return false;
+         }
+         NGROM_NS::probeWriteComplete(outFileFullPath, outFileSize, NGROM_NS::PROBE_OK);
 
-         // Read in SMD block
-         size_t numBytesRead = fread(smdBlockBytes, 1, NUM_SMD_BLOCK_BYTES, inSMDFile);
-         if (numBytesRead < NUM_SMD_BLOCK_BYTES)
+         struct stat linkedStat;
+         uint64_t outputHash = 0;
+         if ((options.manifest != NULL) &&
+             ((0 != stat(outFileFullPath.c_str(), &linkedStat)) || !NGROM_NS::hashFile(outFileFullPath, outputHash)))
          {
-            std::cerr << "  NGROM ERROR: Incomplete read of SMD block!" << std::endl;
-            okToContinue = false;
-            break;
+            int saved_errno = errno;
+            err << "  NGROM ERROR: Failed to read OUTPUT file... " << strerror(saved_errno) << std::endl;
+            return false;
          }
 
-         // Convert to BIN block
-         decodeSMDBlock(binBlockBytes, smdBlockBytes);
+         stateLock.lock();
+         options.dedup->countDuplicate(outFileSize);
+
+         if (options.manifest != NULL)
+         {
+            options.manifest->recordConversion(filename, inContentStat, contentHash,
+                                               outFileFullPath, linkedStat, outputHash);
+         }
+
+         if (options.committer != NULL)
+         {
+            stateLock.unlock();
+            return options.committer->addInPlace(outFileFullPath, journalCompletion);
+         }
 
-         // Write out BIN block
-         size_t numBytesWritten = fwrite(binBlockBytes, 1, NUM_SMD_BLOCK_BYTES, outBINFile);
-         if (numBytesWritten < NUM_SMD_BLOCK_BYTES)
+         if ((options.journal != NULL) && !options.journal->recordComplete(fileIndex))
          {
-            std::cerr << "  NGROM ERROR: Incomplete write of BIN block!" << std::endl;
-            okToContinue = false;
-            break;
+            return false;
          }
+
+         return true;
       }
+   }
+   checkTimer.stop();
+
+   // Wait for this conversion's buffer memory (never while holding anything
+   // another conversion waits on)
+   NGROM_NS::MemoryReservation memoryReservation(options.memoryBudget,
+                                                 getConversionBufferBytes(inFormat, input, options));
+
+   // Journal the start before the output file exists (synced, unless the
+   // output is durable: it only appears once complete)
+   stateLock.lock();
+   if ((options.journal != NULL) && !options.journal->recordStart(fileIndex))
+   {
+      input.close();
+      return false;
+   }
+   uint64_t startRecordNum = (options.journal != NULL) ? options.journal->numRecords() : 0;
+   stateLock.unlock();
 
-      fclose(inSMDFile);
-      fclose(outBINFile);
+   if ((options.journal != NULL) && (options.committer == NULL) && !options.journal->syncThrough(startRecordNum))
+   {
+      input.close();
+      return false;
+   }
 
-      if (okToContinue)
+   // Open output file (compressed as it's written, if requested)
+   NGROM_NS::StatTimer outputOpenTimer(NGROM_NS::OPEN_STAGE);
+   NGROM_NS::OutputFile output;
+   bool outputOpened = false;
+   if ((options.outputDir != NULL) && (options.committer == NULL))
+   {
+      // A new output is created exclusively, so a file that appeared since
+      // the directory was read is a collision, too.
+      int outFd = options.outputDir->createOutput(outFilename, !outFileExists);
+      if ((outFd < 0) && (errno == EEXIST))
       {
-         std::cout << "  Conversion complete!" << std::endl;
+         err << "  NGROM WARNING: Output file already exists!" << std::endl;
+         if (options.fileCollisionAction != NGROM_NS::WARN)
+         {
+            input.close();
+
+            // (Not ours; a resumed run must not remove it as a partial output.)
+            stateLock.lock();
+            if ((options.journal != NULL) && !options.journal->recordComplete(fileIndex))
+            {
+               return false;
+            }
+
+            if (options.fileCollisionAction == NGROM_NS::STOP)
+            {
+               return false;
+            }
+            NGROM_NS::probeCollisionSkip(filename, outFileFullPath);
+            out << "  ...skipping!" << std::endl;
+            return true;
+         }
+         outFd = options.outputDir->createOutput(outFilename, false);
       }
-      else
+
+      outputOpened = (outFd >= 0) &&
+                     output.openCreated(outFd, outFileFullPath, options.compression, options.compressLevel);
+   }
+   else
+   {
+      outputOpened = output.open(outFileFullPath, options.compression, options.compressLevel, options.committer);
+   }
+
+   if (!outputOpened)
+   {
+      int saved_errno = errno;
+      err << "  NGROM ERROR: Failed to open OUTPUT file... " << strerror(saved_errno) << std::endl;
+
+      // Must return immediately
+      input.close();
+      return false;
+   }
+   outputOpenTimer.stop();
+
+   // Reserve the output's (exact, known) size up front, so it's allocated in
+   // one piece even with many conversions writing at once.  (Not for a BIN
+   // passed through by reflink or in-kernel copy, which places its own data.)
+   NGROM_NS::StatTimer preallocateTimer(NGROM_NS::WRITE_STAGE);
+   bool preallocated = ((inFormat == NGROM_NS::BIN) && !input.isCompressed()) || output.preallocate(outFileSize);
+   preallocateTimer.stop();
+
+   if (!preallocated)
+   {
+      int saved_errno = errno;
+      err << "  NGROM ERROR: Failed to allocate OUTPUT file... " << strerror(saved_errno) << std::endl;
+      input.close();
+      output.discard();
+      return false;
+   }
+
+   // Convert!
+   FILE* outBINFile = output.file();
+   bool okToContinue = false;
+   bool needContentHash = (options.manifest != NULL) || (options.dedup != NULL);
+
+   // (Decoding is timed less the writes made while decoding.)
+   NGROM_NS::StatTimer decodeTimer(NGROM_NS::DECODE_STAGE);
+   if ((inFormat == NGROM_NS::SMD) && options.directIO && !input.isCompressed())
+   {
+      // (A compressed output is written through its stream, as always.)
+      bool directInput = NGROM_NS::setDirectIO(fileno(inFile));
+      bool directOutput = (fileno(outBINFile) < 0) || NGROM_NS::setDirectIO(fileno(outBINFile));
+      if (!directInput || !directOutput)
+      {
+         out << "  Direct I/O not supported for the " << (directInput ? "output" : "input") << "; using the page cache." << std::endl;
+      }
+
+      okToContinue = decodeSMDFileDirect(fileno(inFile), outBINFile, numBlocks, contentHasher, err);
+   }
+   else if (inFormat == NGROM_NS::SMD)
+   {
+      okToContinue = decodeSMDFile(inFile, outBINFile, numBlocks, contentHasher, err);
+   }
+   else if (inFormat == NGROM_NS::MGD)
+   {
+      okToContinue = decodeMGDFile(inFile, outBINFile, fileSize, headerBytes, contentHasher, err);
+   }
+   else if (inFormat == NGROM_NS::BIN_SWAPPED)
+   {
+      okToContinue = fixSwappedBINFile(inFile, outBINFile, headerBytes, contentHasher, err);
+   }
+   else // BIN
+   {
+      okToContinue = passThroughBINFile(inFile, outBINFile, fileSize, headerBytes, needContentHash, contentHasher, out, err);
+   }
+
+   if (okToContinue && !input.finish())
+   {
+      err << "  NGROM ERROR: Input file failed to decompress (possible data corruption)." << std::endl;
+      okToContinue = false;
+   }
+   decodeTimer.stop();
+
+   // (With direct I/O, that's just the pages the header was read through.)
+   NGROM_NS::StatTimer closeTimer(NGROM_NS::CLOSE_STAGE);
+   if ((options.cacheDropper != NULL) || options.directIO)
+   {
+      input.dropCache();
+   }
+   input.close();
+
+   uint64_t outputHash = 0;
+   if (!output.close(options.cacheDropper, (options.manifest != NULL) ? &outputHash : NULL) && okToContinue)
+   {
+      int saved_errno = errno;
+      err << "  NGROM ERROR: Failed to close OUTPUT file... " << strerror(saved_errno) << std::endl;
+      okToContinue = false;
+   }
+   memoryReservation.release();
+   fileStats.addBytes(fileSize, output.fileSize());
+   NGROM_NS::probeWriteComplete(outFileFullPath, output.fileSize(), okToContinue ? NGROM_NS::PROBE_OK : NGROM_NS::PROBE_FAILED);
+
+   if (okToContinue)
+   {
+      stateLock.lock();
+
+      if (options.dedup != NULL)
+      {
+         options.dedup->addOutput(fileSize, contentHasher.digest(), filename, outFileFullPath);
+      }
+
+      if (options.manifest != NULL)
+      {
+         options.manifest->recordConversion(filename, inContentStat, contentHasher.digest(),
+                                            outFileFullPath, output.fileStat(), outputHash);
+      }
+
+      if (options.committer != NULL)
+      {
+         // (Never commit a group while holding the state lock.)
+         stateLock.unlock();
+         if (!output.commit(journalCompletion))
+         {
+            return false;
+         }
+      }
+      else if ((options.journal != NULL) && !options.journal->recordComplete(fileIndex))
       {
          return false;
       }
+
+      out << "  Conversion complete!" << std::endl;
+   }
+   else
+   {
+      // (Nothing of a failed conversion is left behind.)
+      output.discard();
+      return false;
    }
 
-   return retval;
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: convertFile
+// Description: Converts one input file (see convertInputFile), between its
+//              file__start and file__end probes.
+// Return: true if the output file was written (or skipped);
+//         false if any error occurred (the run should stop).
+// -----------------------------------------------------------------------------
+bool convertFile(const std::string& filename, size_t fileIndex,
+                 const NGROM_NS::ConvertOptions& options,
+                 std::ostream& out, std::ostream& err)
+{
+   NGROM_NS::FileProbe fileProbe("convert", filename);
+   bool rc = convertInputFile(filename, fileIndex, options, fileProbe, out, err);
+   fileProbe.setStatus(rc ? NGROM_NS::PROBE_OK : NGROM_NS::PROBE_FAILED);
+   return rc;
 }
 
+// -----------------------------------------------------------------------------
+// Function: convertFiles
+// Description: Converts each of the input files from the supplied list (see
+//              convertFile), options.numJobs at a time.
+// Return: true if output files written successfully;
+//         false if any error occurred.
+// -----------------------------------------------------------------------------
+bool convertFiles(const std::vector<std::string>& filenameList,
+                  const NGROM_NS::ConvertOptions& options)
+{
+   NGROM_NS::FileQueue fileQueue;
+   for (const std::string& filename : filenameList)
+   {
+      fileQueue.push(filename);
+   }
+   fileQueue.close();
+
+   return NGROM_NS::runConversions(fileQueue, options);
+}
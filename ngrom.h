@@ -0,0 +1,117 @@
+// New GROM - Genesis ROM conversion (SMD->BIN) utility
+// Common types, constants, and the core conversion functions.
+
+#ifndef NGROM_H
+#define NGROM_H
+
+#include "ngrom_output.h"
+#include<stddef.h>
+#include<stdint.h>
+#include<stdio.h>  // for FILE
+#include<iosfwd>
+#include<string>
+#include<vector>
+
+namespace NGROM_NS
+{
+   enum RomFormat
+   {
+      UNK_FMT,
+      SMD,
+      BIN,
+      MGD,         // Like SMD, but no header, and interleaved across the whole file
+      BIN_SWAPPED, // BIN with the bytes of each 16-bit word swapped
+      AUTO_FMT     // Not a format; detect each file's format
+   };
+
+   enum FileCheckAction
+   {
+      UNSET,
+      STOP,
+      WARN,
+      SKIP
+   };
+
+   class Manifest;
+   class Journal;
+   class DedupIndex;
+   class FileQueue;
+   class DurableCommitter;
+   class OutputDirectory;
+   class InputFile;
+   class CachePrefetcher;
+   class CacheDropper;
+   class MemoryBudget;
+   struct ConvertSync;
+
+   // Settings for convertFiles.
+   struct ConvertOptions
+   {
+      ConvertOptions()
+       : inputFormat(SMD),
+         outdir("."),
+         fileCollisionAction(SKIP),
+         manifest(NULL),
+         journal(NULL),
+         dedup(NULL),
+         numJobs(1),
+         sync(NULL),
+         compression(NO_COMPRESSION),
+         compressLevel(0),
+         committer(NULL),
+         outputDir(NULL),
+         prefetcher(NULL),
+         cacheDropper(NULL),
+         memoryBudget(NULL),
+         directIO(false)
+      {
+      }
+
+      RomFormat inputFormat; // Format of all inputs, or AUTO_FMT to detect per file
+      std::string outdir;
+      FileCheckAction fileCollisionAction;
+      Manifest* manifest; // Optional (NULL = no incremental conversion)
+      Journal* journal;   // Optional (NULL = not resumable)
+      DedupIndex* dedup;  // Optional (NULL = convert duplicate inputs, too)
+      unsigned int numJobs; // Conversions run at once
+      ConvertSync* sync;  // Set by runConversions for parallel runs (NULL = one at a time)
+      OutputCompression compression;
+      int compressLevel;
+      DurableCommitter* committer; // Optional (NULL = outputs written in place)
+      OutputDirectory* outputDir;  // Optional (NULL = outputs made by path)
+      CachePrefetcher* prefetcher; // Optional (NULL = no read-ahead of upcoming inputs)
+      CacheDropper* cacheDropper;  // Optional (NULL = inputs and outputs left in the page cache)
+      MemoryBudget* memoryBudget;  // Optional (NULL = buffer memory not limited)
+      bool directIO;               // SMD inputs decoded with O_DIRECT I/O (bypassing the page cache)
+   };
+}
+
+// Constants
+static const size_t NUM_HEADER_BYTES = 512;
+static const size_t NUM_SMD_BLOCK_BYTES = 16384; // 16KB
+static const size_t DIRECT_CHUNK_BLOCKS = 64;    // SMD blocks per direct I/O transfer (1MB)
+
+// Function prototypes
+NGROM_NS::FileCheckAction parseFileCheckActionString(const std::string& fileCheckActionString);
+bool checkFormats(NGROM_NS::RomFormat fmt, const std::vector<std::string>& filenameList);
+NGROM_NS::RomFormat getLikelyFormat(const unsigned char* headerBytes);
+NGROM_NS::RomFormat getLikelyFileFormat(const NGROM_NS::InputFile& input, const unsigned char* headerBytes);
+NGROM_NS::RomFormat getLikelyDataFormat(const unsigned char* romBytes, size_t numBytes);
+const char* getFormatName(NGROM_NS::RomFormat fmt);
+bool readROMHeader(NGROM_NS::InputFile& input, unsigned char* binHeaderBytes, NGROM_NS::RomFormat& fmt);
+void decodeSMDBlock(unsigned char* binBlock, const unsigned char* smdBlock);
+void decodeMGDData(unsigned char* destBINBytes, const unsigned char* srcMGDBytes, size_t numBytes);
+void swapBINWords(unsigned char* bytes, size_t numBytes);
+uint64_t getROMSize(NGROM_NS::RomFormat fmt, uint64_t fileSize);
+void decodeROMData(NGROM_NS::RomFormat fmt, unsigned char* destBINBytes, const unsigned char* srcFileBytes, uint64_t romSize);
+std::string getOutputFilename(const std::string& inFilename);
+std::string getOutputPath(const std::string& inFilename, const NGROM_NS::ConvertOptions& options);
+bool isUnchangedInput(const std::string& inFilename, const NGROM_NS::ConvertOptions& options);
+void showInfoList(const std::vector<std::string>& filenameList);
+bool convertFile(const std::string& filename, size_t fileIndex,
+                 const NGROM_NS::ConvertOptions& options,
+                 std::ostream& out, std::ostream& err);
+bool convertFiles(const std::vector<std::string>& filenameList,
+                  const NGROM_NS::ConvertOptions& options);
+
+#endif // NGROM_H
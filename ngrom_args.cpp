@@ -0,0 +1,525 @@
+// New GROM - Command line argument parsing
+//
+// Default build: delegates to Qt's QCommandLineParser.
+// NGROM_LITE build: small built-in parser (no Qt), so the executable can be
+// linked fully static and starts without loading/relocating any shared libs.
+
+#include "ngrom_args.h"
+
+#ifndef NGROM_LITE
+#include<QCoreApplication>
+#include<QCommandLineParser>
+#else
+#include<stdlib.h> // for exit
+#include<string.h>
+#include<iostream> // for std::cout and std::err
+#include<map>
+#endif
+
+// -----------------------------------------------------------------------------
+// Function: ArgOption::ArgOption
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::ArgOption::ArgOption(const std::vector<std::string>& names,
+                               const std::string& description,
+                               const std::string& valueName,
+                               const std::string& defaultValue)
+ : m_names(names),
+   m_description(description),
+   m_valueName(valueName),
+   m_defaultValue(defaultValue)
+{
+}
+
+#ifndef NGROM_LITE
+// =============================================================================
+// Qt implementation
+// =============================================================================
+
+struct NGROM_NS::ArgsParser::Impl
+{
+   Impl() : app(NULL) {}
+   ~Impl() { delete app; }
+
+   QCommandLineParser parser;
+   QCoreApplication* app;
+};
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::ArgsParser
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::ArgsParser::ArgsParser(const std::string& appName,
+                                 const std::string& appVersion,
+                                 const std::string& appDescription)
+ : m_impl(new Impl),
+   m_appName(appName),
+   m_appVersion(appVersion),
+   m_appDescription(appDescription)
+{
+   m_impl->parser.setApplicationDescription(QString::fromStdString(m_appDescription));
+   m_impl->parser.addHelpOption();
+   m_impl->parser.addVersionOption();
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::~ArgsParser
+// Description: Destructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::ArgsParser::~ArgsParser()
+{
+   delete m_impl;
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::addOption
+// Description: Registers an option with the parser.
+// -----------------------------------------------------------------------------
+void NGROM_NS::ArgsParser::addOption(const ArgOption& option)
+{
+   QStringList names;
+   for (const std::string& name : option.names())
+   {
+      names << QString::fromStdString(name);
+   }
+
+   QCommandLineOption qtOption(names,
+                               QString::fromStdString(option.description()),
+                               QString::fromStdString(option.valueName()),
+                               QString::fromStdString(option.defaultValue()));
+   m_impl->parser.addOption(qtOption);
+   m_options.push_back(&option);
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::addPositionalArgument
+// Description: Registers a positional argument (for the help text).
+// -----------------------------------------------------------------------------
+void NGROM_NS::ArgsParser::addPositionalArgument(const std::string& name,
+                                                 const std::string& description,
+                                                 const std::string& syntax)
+{
+   m_impl->parser.addPositionalArgument(QString::fromStdString(name),
+                                        QString::fromStdString(description),
+                                        QString::fromStdString(syntax));
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::process
+// Description: Parses the command line.  Creates the QCoreApplication object,
+//              which must outlive the parser's use; argc must stay valid for
+//              the life of the program (i.e., main's argc).
+// -----------------------------------------------------------------------------
+void NGROM_NS::ArgsParser::process(int& argc, char* argv[])
+{
+   m_impl->app = new QCoreApplication(argc, argv);
+   QCoreApplication::setApplicationName(QString::fromStdString(m_appName));
+   QCoreApplication::setApplicationVersion(QString::fromStdString(m_appVersion));
+
+   m_impl->parser.process(*m_impl->app);
+
+   m_positionalArgs.clear();
+   for (const QString& arg : m_impl->parser.positionalArguments())
+   {
+      m_positionalArgs.push_back(arg.toStdString());
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::isSet
+// Description: Checks whether the option was supplied on the command line.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::ArgsParser::isSet(const ArgOption& option) const
+{
+   return m_impl->parser.isSet(QString::fromStdString(option.names().front()));
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::value
+// Description: Gets the option's value (or its default if not supplied).
+// -----------------------------------------------------------------------------
+std::string NGROM_NS::ArgsParser::value(const ArgOption& option) const
+{
+   return m_impl->parser.value(QString::fromStdString(option.names().front())).toStdString();
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::values
+// Description: Gets all of the option's values, in command line order (for an
+//              option that may be supplied more than once).
+// -----------------------------------------------------------------------------
+std::vector<std::string> NGROM_NS::ArgsParser::values(const ArgOption& option) const
+{
+   std::vector<std::string> optionValues;
+   for (const QString& optionValue : m_impl->parser.values(QString::fromStdString(option.names().front())))
+   {
+      optionValues.push_back(optionValue.toStdString());
+   }
+   return optionValues;
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::showHelp
+// Description: Displays the help text and exits with the supplied code.
+// -----------------------------------------------------------------------------
+void NGROM_NS::ArgsParser::showHelp(int exitCode) const
+{
+   m_impl->parser.showHelp(exitCode);
+}
+
+#else
+// =============================================================================
+// Built-in (NGROM_LITE) implementation
+// =============================================================================
+
+// Help text layout (similar to QCommandLineParser's)
+static const size_t HELP_NAMES_WIDTH = 30;
+static const size_t HELP_LINE_WIDTH = 79;
+
+struct NGROM_NS::ArgsParser::Impl
+{
+   struct Positional
+   {
+      std::string name;
+      std::string description;
+      std::string syntax;
+   };
+
+   std::vector<Positional> positionals;
+
+   // Values supplied for each (set) option; flags get an empty value.
+   std::map<const ArgOption*, std::vector<std::string> > values;
+
+   ArgOption helpOption = ArgOption({"h", "help", "?"}, "Displays help on commandline options.");
+   ArgOption versionOption = ArgOption({"v", "version"}, "Displays version information.");
+};
+
+// -----------------------------------------------------------------------------
+// Function: formatOptionNames
+// Description: Builds the "-x, --xxxx <value>" column of the help text.
+// -----------------------------------------------------------------------------
+static std::string formatOptionNames(const NGROM_NS::ArgOption& option)
+{
+   std::string retval;
+
+   for (const std::string& name : option.names())
+   {
+      if (name == "?")
+      {
+         continue; // Accepted, but not shown (same as Qt).
+      }
+
+      if (!retval.empty())
+      {
+         retval += ", ";
+      }
+      retval += (name.length() == 1) ? "-" : "--";
+      retval += name;
+   }
+
+   if (!option.valueName().empty())
+   {
+      retval += " <" + option.valueName() + ">";
+   }
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: printHelpEntry
+// Description: Prints a two-column help entry, word-wrapping the description.
+// -----------------------------------------------------------------------------
+static void printHelpEntry(const std::string& names, const std::string& description)
+{
+   std::string line = "  " + names;
+   if (line.length() + 1 > HELP_NAMES_WIDTH)
+   {
+      std::cout << line << std::endl;
+      line.clear();
+   }
+   line.resize(HELP_NAMES_WIDTH, ' ');
+
+   size_t pos = 0;
+   bool firstWord = true;
+   while (pos < description.length())
+   {
+      size_t wordEnd = description.find(' ', pos);
+      if (wordEnd == std::string::npos)
+      {
+         wordEnd = description.length();
+      }
+      std::string word = description.substr(pos, wordEnd - pos);
+      pos = wordEnd + 1;
+
+      if (!firstWord && (line.length() + 1 + word.length() > HELP_LINE_WIDTH))
+      {
+         std::cout << line << std::endl;
+         line.assign(HELP_NAMES_WIDTH, ' ');
+         firstWord = true;
+      }
+      if (!firstWord)
+      {
+         line += " ";
+      }
+      line += word;
+      firstWord = false;
+   }
+
+   std::cout << line << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::ArgsParser
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::ArgsParser::ArgsParser(const std::string& appName,
+                                 const std::string& appVersion,
+                                 const std::string& appDescription)
+ : m_impl(new Impl),
+   m_appName(appName),
+   m_appVersion(appVersion),
+   m_appDescription(appDescription)
+{
+   m_options.push_back(&m_impl->helpOption);
+   m_options.push_back(&m_impl->versionOption);
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::~ArgsParser
+// Description: Destructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::ArgsParser::~ArgsParser()
+{
+   delete m_impl;
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::addOption
+// Description: Registers an option with the parser.  The option object must
+//              outlive the parser.
+// -----------------------------------------------------------------------------
+void NGROM_NS::ArgsParser::addOption(const ArgOption& option)
+{
+   m_options.push_back(&option);
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::addPositionalArgument
+// Description: Registers a positional argument (for the help text).
+// -----------------------------------------------------------------------------
+void NGROM_NS::ArgsParser::addPositionalArgument(const std::string& name,
+                                                 const std::string& description,
+                                                 const std::string& syntax)
+{
+   Impl::Positional positional;
+   positional.name = name;
+   positional.description = description;
+   positional.syntax = syntax;
+   m_impl->positionals.push_back(positional);
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::process
+// Description: Parses the command line.  Supports "--name value",
+//              "--name=value", "-n value", "-nvalue", clustered short flags
+//              ("-ab", same as "-a -b", optionally ending with one that takes
+//              a value: "-abn value" or "-abnvalue"), and "--" to end option
+//              processing.  Handles --help and --version itself.
+// -----------------------------------------------------------------------------
+void NGROM_NS::ArgsParser::process(int& argc, char* argv[])
+{
+   bool optionsEnded = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      std::string arg = argv[i];
+
+      if (optionsEnded || (arg.length() < 2) || (arg[0] != '-'))
+      {
+         m_positionalArgs.push_back(arg);
+         continue;
+      }
+
+      if (arg == "--")
+      {
+         optionsEnded = true;
+         continue;
+      }
+
+      // A cluster of short flags ("-ab") is taken one option at a time; the
+      // rest of the cluster is then parsed as if it were its own argument.
+      bool moreInCluster = true;
+      while (moreInCluster)
+      {
+         moreInCluster = false;
+
+         // Split into option name and (optional) attached value.
+         std::string name;
+         std::string attachedValue;
+         bool hasAttachedValue = false;
+         bool isClusterable = false;
+
+         if (arg[1] == '-')
+         {
+            name = arg.substr(2);
+            size_t equalsPos = name.find('=');
+            if (equalsPos != std::string::npos)
+            {
+               attachedValue = name.substr(equalsPos + 1);
+               name.erase(equalsPos);
+               hasAttachedValue = true;
+            }
+         }
+         else
+         {
+            name = arg.substr(1, 1);
+            if (arg.length() > 2)
+            {
+               isClusterable = (arg[2] != '=');
+               attachedValue = arg.substr(isClusterable ? 2 : 3);
+               hasAttachedValue = true;
+            }
+         }
+
+         // Look up the option
+         const ArgOption* option = NULL;
+         for (const ArgOption* candidate : m_options)
+         {
+            for (const std::string& candidateName : candidate->names())
+            {
+               if (candidateName == name)
+               {
+                  option = candidate;
+                  break;
+               }
+            }
+            if (option != NULL)
+            {
+               break;
+            }
+         }
+
+         if (option == NULL)
+         {
+            std::cerr << "Unknown option '" << name << "'." << std::endl;
+            exit(1);
+         }
+
+         if (option->valueName().empty())
+         {
+            if (hasAttachedValue)
+            {
+               if (!isClusterable)
+               {
+                  std::cerr << "Unexpected value after '" << arg << "'." << std::endl;
+                  exit(1);
+               }
+               arg = "-" + attachedValue;
+               moreInCluster = true;
+            }
+            m_impl->values[option].push_back(std::string());
+         }
+         else
+         {
+            if (!hasAttachedValue)
+            {
+               if (i + 1 >= argc)
+               {
+                  std::cerr << "Missing value after '" << arg << "'." << std::endl;
+                  exit(1);
+               }
+               attachedValue = argv[++i];
+            }
+            m_impl->values[option].push_back(attachedValue);
+         }
+      }
+   }
+
+   if (isSet(m_impl->helpOption))
+   {
+      showHelp(0);
+   }
+
+   if (isSet(m_impl->versionOption))
+   {
+      std::cout << m_appName << " " << m_appVersion << std::endl;
+      exit(0);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::isSet
+// Description: Checks whether the option was supplied on the command line.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::ArgsParser::isSet(const ArgOption& option) const
+{
+   return (m_impl->values.find(&option) != m_impl->values.end());
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::value
+// Description: Gets the option's value (or its default if not supplied).  If
+//              supplied more than once, the last value wins.
+// -----------------------------------------------------------------------------
+std::string NGROM_NS::ArgsParser::value(const ArgOption& option) const
+{
+   std::map<const ArgOption*, std::vector<std::string> >::const_iterator iter = m_impl->values.find(&option);
+
+   if ((iter == m_impl->values.end()) || iter->second.empty())
+   {
+      return option.defaultValue();
+   }
+
+   return iter->second.back();
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::values
+// Description: Gets all of the option's values, in command line order (for an
+//              option that may be supplied more than once).
+// -----------------------------------------------------------------------------
+std::vector<std::string> NGROM_NS::ArgsParser::values(const ArgOption& option) const
+{
+   std::map<const ArgOption*, std::vector<std::string> >::const_iterator iter = m_impl->values.find(&option);
+
+   if (iter == m_impl->values.end())
+   {
+      return std::vector<std::string>();
+   }
+
+   return iter->second;
+}
+
+// -----------------------------------------------------------------------------
+// Function: ArgsParser::showHelp
+// Description: Displays the help text and exits with the supplied code.
+// -----------------------------------------------------------------------------
+void NGROM_NS::ArgsParser::showHelp(int exitCode) const
+{
+   std::cout << "Usage: " << m_appName << " [options]";
+   for (const Impl::Positional& positional : m_impl->positionals)
+   {
+      std::cout << " " << positional.syntax;
+   }
+   std::cout << std::endl;
+   std::cout << m_appDescription << std::endl << std::endl;
+
+   std::cout << "Options:" << std::endl;
+   for (const ArgOption* option : m_options)
+   {
+      printHelpEntry(formatOptionNames(*option), option->description());
+   }
+
+   if (!m_impl->positionals.empty())
+   {
+      std::cout << std::endl << "Arguments:" << std::endl;
+      for (const Impl::Positional& positional : m_impl->positionals)
+      {
+         printHelpEntry(positional.name, positional.description);
+      }
+   }
+
+   exit(exitCode);
+}
+
+#endif // NGROM_LITE
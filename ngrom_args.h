@@ -0,0 +1,84 @@
+// New GROM - Command line argument parsing
+//
+// Thin wrapper so that main() can be written once and built either against
+// Qt's QCommandLineParser (default build) or against a small built-in parser
+// with no Qt dependency (NGROM_LITE build, see the "ngrom-lite" make target).
+
+#ifndef NGROM_ARGS_H
+#define NGROM_ARGS_H
+
+#include<string>
+#include<vector>
+
+namespace NGROM_NS
+{
+   // --------------------------------------------------------------------------
+   // Class: ArgOption
+   // Description: Describes a single command line option. Mirrors the parts of
+   //              QCommandLineOption that NGROM uses.  An option with an empty
+   //              valueName is a flag (takes no value).
+   // --------------------------------------------------------------------------
+   class ArgOption
+   {
+   public:
+      ArgOption(const std::vector<std::string>& names,
+                const std::string& description,
+                const std::string& valueName = std::string(),
+                const std::string& defaultValue = std::string());
+
+      const std::vector<std::string>& names() const { return m_names; }
+      const std::string& description() const { return m_description; }
+      const std::string& valueName() const { return m_valueName; }
+      const std::string& defaultValue() const { return m_defaultValue; }
+
+   private:
+      std::vector<std::string> m_names;
+      std::string m_description;
+      std::string m_valueName;
+      std::string m_defaultValue;
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: ArgsParser
+   // Description: Command line parser.  Mirrors the parts of QCommandLineParser
+   //              that NGROM uses; process() handles --help and --version and
+   //              exits (code 1) on unrecognized options.
+   // --------------------------------------------------------------------------
+   class ArgsParser
+   {
+   public:
+      ArgsParser(const std::string& appName,
+                 const std::string& appVersion,
+                 const std::string& appDescription);
+      ~ArgsParser();
+
+      void addOption(const ArgOption& option);
+      void addPositionalArgument(const std::string& name,
+                                 const std::string& description,
+                                 const std::string& syntax);
+
+      void process(int& argc, char* argv[]);
+
+      bool isSet(const ArgOption& option) const;
+      std::string value(const ArgOption& option) const;
+      std::vector<std::string> values(const ArgOption& option) const;
+      const std::vector<std::string>& positionalArguments() const { return m_positionalArgs; }
+
+      void showHelp(int exitCode) const;
+
+      ArgsParser(const ArgsParser&) = delete;
+      ArgsParser& operator=(const ArgsParser&) = delete;
+
+   private:
+      struct Impl;
+      Impl* m_impl;
+
+      std::string m_appName;
+      std::string m_appVersion;
+      std::string m_appDescription;
+      std::vector<const ArgOption*> m_options;
+      std::vector<std::string> m_positionalArgs;
+   };
+}
+
+#endif // NGROM_ARGS_H
@@ -0,0 +1,337 @@
+// New GROM - Aligned I/O buffers
+
+#include "ngrom_buffer.h"
+#include "ngrom_io.h"
+#include<map>
+#include<mutex>
+#include<vector>
+#include<atomic>
+#include<stdlib.h>   // for posix_memalign, free
+#include<sys/mman.h> // for mmap, madvise, munmap
+
+// Smallest slab
+static const size_t MIN_SLAB_BYTES = 4096;
+
+// Slabs this size or larger are mapped (and can have huge pages)
+static const size_t HUGE_PAGE_BYTES = 2 * 1024 * 1024;
+
+// Free slabs kept for reuse: by each thread, and shared (beyond these, slabs
+// are freed; the byte limits can be lowered by limitPooledBytes)
+static const size_t MAX_THREAD_SLABS = 4;
+static std::atomic<size_t> s_maxThreadBytes(64 * 1024 * 1024);
+static std::atomic<size_t> s_maxPooledBytes(256 * 1024 * 1024);
+
+// Large slabs backed by huge pages?
+static std::atomic<bool> s_useHugePages(false);
+
+namespace
+{
+   // -------------------------------------------------------------------------
+   // Class: BufferPool
+   // Description: Free slabs shared by all threads, by size.
+   // -------------------------------------------------------------------------
+   class BufferPool
+   {
+   public:
+      static BufferPool& instance();
+
+      unsigned char* take(size_t numBytes);
+      void give(unsigned char* bytes, size_t numBytes);
+
+   private:
+      BufferPool();
+      ~BufferPool();
+
+      std::mutex m_mutex;
+      std::multimap<size_t, unsigned char*> m_freeSlabs;
+      size_t m_numFreeBytes;
+   };
+
+   // -------------------------------------------------------------------------
+   // Class: ThreadSlabCache
+   // Description: A thread's own few free slabs (taken and given without
+   //              locking); given to the shared pool when the thread ends.
+   // -------------------------------------------------------------------------
+   class ThreadSlabCache
+   {
+   public:
+      ThreadSlabCache();
+      ~ThreadSlabCache();
+
+      unsigned char* take(size_t numBytes);
+      bool give(unsigned char* bytes, size_t numBytes);
+
+   private:
+      std::vector<std::pair<size_t, unsigned char*> > m_freeSlabs;
+      size_t m_numFreeBytes;
+   };
+
+   thread_local ThreadSlabCache t_slabCache;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getSlabBytes
+// Description: Gets the slab size for a buffer: a power of two, at least
+//              MIN_SLAB_BYTES (so freed slabs fit later requests).
+// -----------------------------------------------------------------------------
+static size_t getSlabBytes(size_t numBytes)
+{
+   size_t slabBytes = MIN_SLAB_BYTES;
+   while (slabBytes < numBytes)
+   {
+      slabBytes *= 2;
+   }
+   return slabBytes;
+}
+
+// -----------------------------------------------------------------------------
+// Function: allocateSlab
+// Description: Allocates a new slab: a large one is mapped (from reserved
+//              huge pages, or transparent huge pages, if enabled); a small
+//              one comes from the heap.
+// Return: The slab, or NULL if out of memory.
+// -----------------------------------------------------------------------------
+static unsigned char* allocateSlab(size_t numBytes)
+{
+   if (numBytes < HUGE_PAGE_BYTES)
+   {
+      void* bytes = NULL;
+      return (0 == posix_memalign(&bytes, NGROM_NS::DIRECT_IO_ALIGNMENT, numBytes))
+           ? static_cast<unsigned char*>(bytes) : NULL;
+   }
+
+   void* bytes = MAP_FAILED;
+   if (s_useHugePages)
+   {
+      bytes = mmap(NULL, numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+   }
+
+   if (bytes == MAP_FAILED)
+   {
+      bytes = mmap(NULL, numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (bytes == MAP_FAILED)
+      {
+         return NULL;
+      }
+
+      if (s_useHugePages)
+      {
+         madvise(bytes, numBytes, MADV_HUGEPAGE);
+      }
+   }
+
+   return static_cast<unsigned char*>(bytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: freeSlab
+// Description: Frees a slab from allocateSlab.
+// -----------------------------------------------------------------------------
+static void freeSlab(unsigned char* bytes, size_t numBytes)
+{
+   if (numBytes < HUGE_PAGE_BYTES)
+   {
+      free(bytes);
+   }
+   else
+   {
+      munmap(bytes, numBytes);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: BufferPool::instance
+// Description: Gets the pool.
+// -----------------------------------------------------------------------------
+BufferPool& BufferPool::instance()
+{
+   static BufferPool s_pool;
+   return s_pool;
+}
+
+// -----------------------------------------------------------------------------
+// Function: BufferPool::BufferPool
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+BufferPool::BufferPool()
+ : m_numFreeBytes(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: BufferPool::~BufferPool
+// Description: Destructor; frees the pooled slabs.
+// -----------------------------------------------------------------------------
+BufferPool::~BufferPool()
+{
+   for (auto& entry : m_freeSlabs)
+   {
+      freeSlab(entry.second, entry.first);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: BufferPool::take
+// Description: Takes a free slab of numBytes (a slab size), or allocates one.
+// Return: The slab, or NULL if out of memory.
+// -----------------------------------------------------------------------------
+unsigned char* BufferPool::take(size_t numBytes)
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto entryIter = m_freeSlabs.find(numBytes);
+      if (entryIter != m_freeSlabs.end())
+      {
+         unsigned char* bytes = entryIter->second;
+         m_freeSlabs.erase(entryIter);
+         m_numFreeBytes -= numBytes;
+         return bytes;
+      }
+   }
+
+   return allocateSlab(numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: BufferPool::give
+// Description: Puts a slab back (or frees it, if the pool is full).
+// -----------------------------------------------------------------------------
+void BufferPool::give(unsigned char* bytes, size_t numBytes)
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if ((m_numFreeBytes + numBytes) <= s_maxPooledBytes)
+      {
+         m_freeSlabs.insert(std::make_pair(numBytes, bytes));
+         m_numFreeBytes += numBytes;
+         return;
+      }
+   }
+
+   freeSlab(bytes, numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: ThreadSlabCache::ThreadSlabCache
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+ThreadSlabCache::ThreadSlabCache()
+ : m_numFreeBytes(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: ThreadSlabCache::~ThreadSlabCache
+// Description: Destructor; gives the slabs to the shared pool.
+// -----------------------------------------------------------------------------
+ThreadSlabCache::~ThreadSlabCache()
+{
+   for (auto& entry : m_freeSlabs)
+   {
+      BufferPool::instance().give(entry.second, entry.first);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: ThreadSlabCache::take
+// Description: Takes one of the thread's free slabs of numBytes.
+// Return: The slab, or NULL if the thread has none.
+// -----------------------------------------------------------------------------
+unsigned char* ThreadSlabCache::take(size_t numBytes)
+{
+   for (size_t i = 0; i < m_freeSlabs.size(); i++)
+   {
+      if (m_freeSlabs[i].first == numBytes)
+      {
+         unsigned char* bytes = m_freeSlabs[i].second;
+         m_freeSlabs.erase(m_freeSlabs.begin() + i);
+         m_numFreeBytes -= numBytes;
+         return bytes;
+      }
+   }
+   return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// Function: ThreadSlabCache::give
+// Description: Keeps a free slab for the thread, if it has room.
+// Return: true if kept; false if full.
+// -----------------------------------------------------------------------------
+bool ThreadSlabCache::give(unsigned char* bytes, size_t numBytes)
+{
+   if ((m_freeSlabs.size() >= MAX_THREAD_SLABS) || ((m_numFreeBytes + numBytes) > s_maxThreadBytes))
+   {
+      return false;
+   }
+
+   m_freeSlabs.push_back(std::make_pair(numBytes, bytes));
+   m_numFreeBytes += numBytes;
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: AlignedBuffer::AlignedBuffer
+// Description: Constructor; takes a slab of at least numBytes: the thread's
+//              own, else a shared one, else a new one.  data() is NULL if out
+//              of memory.
+// -----------------------------------------------------------------------------
+NGROM_NS::AlignedBuffer::AlignedBuffer(size_t numBytes)
+ : m_numBytes(getSlabBytes(numBytes))
+{
+   m_bytes = t_slabCache.take(m_numBytes);
+   if (m_bytes == NULL)
+   {
+      m_bytes = BufferPool::instance().take(m_numBytes);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: AlignedBuffer::~AlignedBuffer
+// Description: Destructor; gives the slab back (to the thread, or else the
+//              shared pool).
+// -----------------------------------------------------------------------------
+NGROM_NS::AlignedBuffer::~AlignedBuffer()
+{
+   if ((m_bytes != NULL) && !t_slabCache.give(m_bytes, m_numBytes))
+   {
+      BufferPool::instance().give(m_bytes, m_numBytes);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: getAlignedBufferBytes
+// Description: Gets the memory an AlignedBuffer of numBytes takes (its slab).
+// -----------------------------------------------------------------------------
+size_t NGROM_NS::getAlignedBufferBytes(size_t numBytes)
+{
+   return getSlabBytes(numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: limitPooledBytes
+// Description: Keeps the free slabs held for reuse within maxBytes in all:
+//              half shared, half split among numThreads threads.  (Only ever
+//              lowers the limits.)
+// -----------------------------------------------------------------------------
+void NGROM_NS::limitPooledBytes(size_t maxBytes, unsigned int numThreads)
+{
+   size_t maxThreadBytes = maxBytes / (2 * ((numThreads > 0) ? numThreads : 1));
+   if (maxThreadBytes < s_maxThreadBytes)
+   {
+      s_maxThreadBytes = maxThreadBytes;
+   }
+
+   if ((maxBytes / 2) < s_maxPooledBytes)
+   {
+      s_maxPooledBytes = maxBytes / 2;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: setHugePages
+// Description: Enables (or disables) huge pages for new large slabs.
+// -----------------------------------------------------------------------------
+void NGROM_NS::setHugePages(bool enable)
+{
+   s_useHugePages = enable;
+}
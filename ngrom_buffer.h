@@ -0,0 +1,47 @@
+// New GROM - Aligned I/O buffers
+//
+// Buffers for file data (direct I/O chunks, whole decoded ROMs, ...) come
+// from a process-wide pool of slabs aligned to DIRECT_IO_ALIGNMENT (and so to
+// cache lines, for vectorized loops).  Slab sizes are powers of two, and
+// freed slabs are kept for reuse: each thread keeps a few of its own (no
+// locking), the rest are shared.  So once a run is under way, conversions
+// (one after another, or in parallel) reuse already-faulted-in memory with no
+// allocator calls.  With huge pages enabled, large slabs are backed by
+// reserved huge pages (MAP_HUGETLB) where the system has them, or else by
+// transparent huge pages, which cuts TLB misses when decoding whole ROMs.
+
+#ifndef NGROM_BUFFER_H
+#define NGROM_BUFFER_H
+
+#include<stddef.h>
+
+namespace NGROM_NS
+{
+   // --------------------------------------------------------------------------
+   // Class: AlignedBuffer
+   // Description: A buffer of at least the requested size, aligned for direct
+   //              I/O; taken from the pool, and given back on destruction.
+   // --------------------------------------------------------------------------
+   class AlignedBuffer
+   {
+   public:
+      explicit AlignedBuffer(size_t numBytes);
+      ~AlignedBuffer();
+
+      unsigned char* data() const { return m_bytes; }
+      size_t size() const { return m_numBytes; }
+
+      AlignedBuffer(const AlignedBuffer&) = delete;
+      AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+   private:
+      unsigned char* m_bytes; // NULL if out of memory
+      size_t m_numBytes;      // Slab size (may be more than requested)
+   };
+
+   size_t getAlignedBufferBytes(size_t numBytes);
+   void limitPooledBytes(size_t maxBytes, unsigned int numThreads);
+   void setHugePages(bool enable);
+}
+
+#endif // NGROM_BUFFER_H
@@ -0,0 +1,226 @@
+// New GROM - Page cache policy
+
+#include "ngrom_cache.h"
+#include "ngrom_walk.h"
+#include<vector>
+#include<errno.h>
+#include<stdlib.h> // for strtoul
+#include<fcntl.h>  // for open, posix_fadvise, sync_file_range
+#include<unistd.h> // for close
+
+// Upcoming inputs read ahead, by default
+static const unsigned int DEFAULT_PREFETCH_FILES = 8;
+
+// Outputs whose writeback may still be running before the oldest is waited for
+static const size_t MAX_WRITEBACK_OUTPUTS = 8;
+
+// -----------------------------------------------------------------------------
+// Function: parseCachePolicySpec
+// Description: Parses a --cache-policy: "keep" (the default; no hints),
+//              "drop" (drop inputs and outputs when done), "prefetch" (read
+//              ahead the next inputs), or "stream" (both); "prefetch" and
+//              "stream" may be followed by ":numFiles".
+// Return: true if valid; false otherwise.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::parseCachePolicySpec(const std::string& spec, CachePolicy& policy)
+{
+   size_t colonPos = spec.find(':');
+   std::string name = spec.substr(0, colonPos);
+
+   policy = CachePolicy();
+   bool hasPrefetch = false;
+
+   if (name == "keep")
+   {
+   }
+   else if (name == "drop")
+   {
+      policy.dropAfterUse = true;
+   }
+   else if (name == "prefetch")
+   {
+      hasPrefetch = true;
+   }
+   else if (name == "stream")
+   {
+      hasPrefetch = true;
+      policy.dropAfterUse = true;
+   }
+   else
+   {
+      return false;
+   }
+
+   if (hasPrefetch)
+   {
+      policy.numPrefetchFiles = DEFAULT_PREFETCH_FILES;
+   }
+
+   if (colonPos != std::string::npos)
+   {
+      std::string numString = spec.substr(colonPos + 1);
+      char* numEnd = NULL;
+      unsigned long numFiles = strtoul(numString.c_str(), &numEnd, 10);
+      if (!hasPrefetch || numString.empty() || (*numEnd != '\0') || (numFiles < 1) || (numFiles > 1024))
+      {
+         return false;
+      }
+      policy.numPrefetchFiles = numFiles;
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: CachePrefetcher::CachePrefetcher
+// Description: Constructor; starts the read-ahead thread.
+// -----------------------------------------------------------------------------
+NGROM_NS::CachePrefetcher::CachePrefetcher(unsigned int numFiles)
+ : m_numFiles(numFiles),
+   m_nextIndex(0),
+   m_stopped(false)
+{
+   m_thread = std::thread(&CachePrefetcher::work, this);
+}
+
+// -----------------------------------------------------------------------------
+// Function: CachePrefetcher::~CachePrefetcher
+// Description: Destructor; stops the read-ahead thread.
+// -----------------------------------------------------------------------------
+NGROM_NS::CachePrefetcher::~CachePrefetcher()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopped = true;
+      m_paths.clear();
+      m_cond.notify_all();
+   }
+   m_thread.join();
+}
+
+// -----------------------------------------------------------------------------
+// Function: CachePrefetcher::update
+// Description: Queues the read-ahead of the queue's next inputs (those not
+//              already queued).
+// -----------------------------------------------------------------------------
+void NGROM_NS::CachePrefetcher::update(FileQueue& fileQueue)
+{
+   std::vector<std::string> filenames;
+   size_t firstIndex = fileQueue.peek(m_numFiles, filenames);
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   for (size_t i = 0; i < filenames.size(); i++)
+   {
+      if ((firstIndex + i) >= m_nextIndex)
+      {
+         m_paths.push_back(filenames[i]);
+         m_nextIndex = firstIndex + i + 1;
+      }
+   }
+   m_cond.notify_all();
+}
+
+// -----------------------------------------------------------------------------
+// Function: CachePrefetcher::work
+// Description: Thread body: asks the kernel to read in each queued input.
+//              (An input it can't open, e.g., a zip member, is left alone.)
+// -----------------------------------------------------------------------------
+void NGROM_NS::CachePrefetcher::work()
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+   for (;;)
+   {
+      m_cond.wait(lock, [this] { return !m_paths.empty() || m_stopped; });
+      if (m_stopped)
+      {
+         return;
+      }
+
+      std::string path = m_paths.front();
+      m_paths.pop_front();
+      lock.unlock();
+
+      int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd >= 0)
+      {
+         posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+         close(fd);
+      }
+
+      lock.lock();
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: CacheDropper::CacheDropper
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::CacheDropper::CacheDropper()
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: CacheDropper::~CacheDropper
+// Description: Destructor; drops any outputs still waiting.
+// -----------------------------------------------------------------------------
+NGROM_NS::CacheDropper::~CacheDropper()
+{
+   finish();
+}
+
+// -----------------------------------------------------------------------------
+// Function: CacheDropper::addOutput
+// Description: Starts the writeback of a finished output (fd, which is taken
+//              over), and drops the oldest waiting output if there are more
+//              than MAX_WRITEBACK_OUTPUTS.
+// -----------------------------------------------------------------------------
+void NGROM_NS::CacheDropper::addOutput(int fd)
+{
+   sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+
+   int oldestFd = -1;
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_outputFds.push_back(fd);
+      if (m_outputFds.size() > MAX_WRITEBACK_OUTPUTS)
+      {
+         oldestFd = m_outputFds.front();
+         m_outputFds.pop_front();
+      }
+   }
+
+   if (oldestFd >= 0)
+   {
+      dropOutput(oldestFd);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: CacheDropper::finish
+// Description: Drops all waiting outputs.
+// -----------------------------------------------------------------------------
+void NGROM_NS::CacheDropper::finish()
+{
+   std::deque<int> outputFds;
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      outputFds.swap(m_outputFds);
+   }
+
+   for (int fd : outputFds)
+   {
+      dropOutput(fd);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: CacheDropper::dropOutput
+// Description: Waits for an output's writeback, drops its pages (dirty pages
+//              can't be dropped), and closes fd.
+// -----------------------------------------------------------------------------
+void NGROM_NS::CacheDropper::dropOutput(int fd)
+{
+   sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+   posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+   close(fd);
+}
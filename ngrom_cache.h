@@ -0,0 +1,89 @@
+// New GROM - Page cache policy
+//
+// A sweep over a large collection reads and writes every byte once, so by
+// default it fills the page cache with pages that are never used again
+// (evicting everything else on the host), and waits on each cold input in
+// turn.  With --cache-policy, upcoming inputs are read ahead on a background
+// thread (POSIX_FADV_WILLNEED) while the current ones convert, and each
+// input and output is dropped from the cache (POSIX_FADV_DONTNEED) once it's
+// done with: inputs right away, outputs once their writeback has finished
+// (a few outputs behind, so writeback is never waited on while it's busy).
+
+#ifndef NGROM_CACHE_H
+#define NGROM_CACHE_H
+
+#include<string>
+#include<deque>
+#include<mutex>
+#include<condition_variable>
+#include<thread>
+
+namespace NGROM_NS
+{
+   class FileQueue;
+
+   // --cache-policy settings
+   struct CachePolicy
+   {
+      CachePolicy() : numPrefetchFiles(0), dropAfterUse(false) {}
+
+      unsigned int numPrefetchFiles; // Upcoming inputs read ahead (0 = none)
+      bool dropAfterUse;             // Inputs and outputs dropped from the cache when done
+   };
+
+   bool parseCachePolicySpec(const std::string& spec, CachePolicy& policy);
+
+   // --------------------------------------------------------------------------
+   // Class: CachePrefetcher
+   // Description: Reads ahead the next inputs of a file queue, on its own
+   //              thread; update() is called as files are taken.
+   // --------------------------------------------------------------------------
+   class CachePrefetcher
+   {
+   public:
+      explicit CachePrefetcher(unsigned int numFiles);
+      ~CachePrefetcher();
+
+      void update(FileQueue& fileQueue);
+
+      CachePrefetcher(const CachePrefetcher&) = delete;
+      CachePrefetcher& operator=(const CachePrefetcher&) = delete;
+
+   private:
+      void work();
+
+      unsigned int m_numFiles;
+      std::mutex m_mutex; // Guards the members below
+      std::condition_variable m_cond;
+      std::deque<std::string> m_paths; // To be read ahead
+      size_t m_nextIndex;              // fileIndex of the first input not yet queued here
+      bool m_stopped;
+      std::thread m_thread;
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: CacheDropper
+   // Description: Drops finished outputs from the page cache once written
+   //              back (the last few are only dropped by finish()).
+   // --------------------------------------------------------------------------
+   class CacheDropper
+   {
+   public:
+      CacheDropper();
+      ~CacheDropper();
+
+      void addOutput(int fd); // Takes over fd
+      void finish();
+
+      CacheDropper(const CacheDropper&) = delete;
+      CacheDropper& operator=(const CacheDropper&) = delete;
+
+   private:
+      static void dropOutput(int fd);
+
+      std::mutex m_mutex; // Guards m_outputFds
+      std::deque<int> m_outputFds; // Written, writeback started
+   };
+}
+
+#endif // NGROM_CACHE_H
@@ -0,0 +1,104 @@
+// New GROM - Decoding kernels (in-memory format conversions; no I/O, so
+// ngrom_bench can link them too)
+
+#include "ngrom.h"
+#include<string.h> // for memcpy
+
+// -----------------------------------------------------------------------------
+// Function: decodeSMDBlock
+// Description: Converts a 16KB SMD block to a BIN block.
+// -----------------------------------------------------------------------------
+void decodeSMDBlock(unsigned char* destBINBlock, const unsigned char* srcSMDBlock)
+{
+   size_t evenByte = 0;
+   size_t oddByte = 1;
+
+   for (int i = 0; i < 8192; oddByte += 2, evenByte += 2, i++)
+   {
+      destBINBlock[oddByte]  = srcSMDBlock[i];
+      destBINBlock[evenByte] = srcSMDBlock[i+8192];
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: decodeMGDData
+// Description: Converts MGD data (odd BIN bytes in the first half, even BIN
+//              bytes in the second half) to BIN data.  numBytes must be even.
+// -----------------------------------------------------------------------------
+void decodeMGDData(unsigned char* destBINBytes, const unsigned char* srcMGDBytes, size_t numBytes)
+{
+   size_t halfBytes = numBytes / 2;
+
+   for (size_t i = 0; i < halfBytes; i++)
+   {
+      destBINBytes[(2 * i) + 1] = srcMGDBytes[i];
+      destBINBytes[2 * i]       = srcMGDBytes[halfBytes + i];
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: swapBINWords
+// Description: Swaps the two bytes of each 16-bit word, in place.  numBytes
+//              must be even.
+// -----------------------------------------------------------------------------
+void swapBINWords(unsigned char* bytes, size_t numBytes)
+{
+   for (size_t i = 0; i + 1 < numBytes; i += 2)
+   {
+      unsigned char tmpByte = bytes[i];
+      bytes[i] = bytes[i + 1];
+      bytes[i + 1] = tmpByte;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: getROMSize
+// Description: Gets the size of the ROM data (as BIN) within a file.
+// Return: ROM size, or 0 if the file size isn't valid for its format.
+// -----------------------------------------------------------------------------
+uint64_t getROMSize(NGROM_NS::RomFormat fmt, uint64_t fileSize)
+{
+   if (fmt == NGROM_NS::SMD)
+   {
+      if ((fileSize < (NUM_HEADER_BYTES + NUM_SMD_BLOCK_BYTES)) ||
+          (((fileSize - NUM_HEADER_BYTES) % NUM_SMD_BLOCK_BYTES) != 0))
+      {
+         return 0;
+      }
+      return fileSize - NUM_HEADER_BYTES;
+   }
+   else if ((fmt == NGROM_NS::MGD) || (fmt == NGROM_NS::BIN_SWAPPED))
+   {
+      return ((fileSize % 2) == 0) ? fileSize : 0;
+   }
+
+   return fileSize;
+}
+
+// -----------------------------------------------------------------------------
+// Function: decodeROMData
+// Description: Converts a whole file's contents, held in memory, to BIN data.
+//              romSize is from getROMSize (and must not be 0).
+// -----------------------------------------------------------------------------
+void decodeROMData(NGROM_NS::RomFormat fmt, unsigned char* destBINBytes, const unsigned char* srcFileBytes, uint64_t romSize)
+{
+   if (fmt == NGROM_NS::SMD)
+   {
+      for (uint64_t offset = 0; offset < romSize; offset += NUM_SMD_BLOCK_BYTES)
+      {
+         decodeSMDBlock(destBINBytes + offset, srcFileBytes + NUM_HEADER_BYTES + offset);
+      }
+   }
+   else if (fmt == NGROM_NS::MGD)
+   {
+      decodeMGDData(destBINBytes, srcFileBytes, romSize);
+   }
+   else
+   {
+      memcpy(destBINBytes, srcFileBytes, romSize);
+      if (fmt == NGROM_NS::BIN_SWAPPED)
+      {
+         swapBINWords(destBINBytes, romSize);
+      }
+   }
+}
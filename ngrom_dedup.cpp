@@ -0,0 +1,135 @@
+// New GROM - Content-addressed deduplication
+
+#include "ngrom_dedup.h"
+#include "ngrom_io.h"
+#include<ostream>
+#include<errno.h>
+#include<string.h>
+#include<unistd.h> // for link, unlink
+
+// -----------------------------------------------------------------------------
+// Function: DedupIndex::DedupIndex
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::DedupIndex::DedupIndex(LinkMode linkMode)
+ : m_linkMode(linkMode),
+   m_numDuplicates(0),
+   m_bytesSaved(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: DedupIndex::parseLinkMode
+// Description: Converts an argument string ("hardlink" or "reflink") into a
+//              LinkMode value.
+// Return: true if the string is recognized; false otherwise.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::DedupIndex::parseLinkMode(const std::string& modeString, LinkMode& linkMode)
+{
+   bool retval = true;
+
+   if (modeString == "hardlink")
+   {
+      linkMode = HARDLINK;
+   }
+   else if (modeString == "reflink")
+   {
+      linkMode = REFLINK;
+   }
+   else
+   {
+      retval = false;
+   }
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: DedupIndex::hasInputSize
+// Description: Checks whether any input of the supplied size has been
+//              converted (i.e., whether a new input could be a duplicate).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::DedupIndex::hasInputSize(uint64_t inputSize) const
+{
+   return (m_sizeCounts.find(inputSize) != m_sizeCounts.end());
+}
+
+// -----------------------------------------------------------------------------
+// Function: DedupIndex::findOutput
+// Description: Looks up the conversion of an already converted input with
+//              the supplied size and content hash.
+// Return: Pointer to the conversion (its input and output paths), or NULL if
+//         no such input was converted.
+// -----------------------------------------------------------------------------
+const NGROM_NS::DedupIndex::Conversion* NGROM_NS::DedupIndex::findOutput(uint64_t inputSize, uint64_t contentHash) const
+{
+   ContentKey key = { inputSize, contentHash };
+
+   std::unordered_map<ContentKey, Conversion, ContentKeyHash>::const_iterator iter = m_outputs.find(key);
+   if (iter == m_outputs.end())
+   {
+      return NULL;
+   }
+   return &iter->second;
+}
+
+// -----------------------------------------------------------------------------
+// Function: DedupIndex::addOutput
+// Description: Records a converted input's content and its output.  The first
+//              conversion recorded for a given content is kept.
+// -----------------------------------------------------------------------------
+void NGROM_NS::DedupIndex::addOutput(uint64_t inputSize, uint64_t contentHash,
+                                     const std::string& inputPath, const std::string& outputPath)
+{
+   ContentKey key = { inputSize, contentHash };
+   Conversion conversion = { inputPath, outputPath };
+
+   if (m_outputs.insert(std::make_pair(key, conversion)).second)
+   {
+      m_sizeCounts[inputSize]++;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: DedupIndex::materialize
+// Description: Creates outputPath from the first output of identical content,
+//              as a hardlink or reflink (per the link mode).  Any existing
+//              outputPath is replaced.  A reflink falls back to an in-kernel
+//              copy on filesystems without reflink support.  Messages go to
+//              out and err.
+// Return: true if created; false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::DedupIndex::materialize(const std::string& firstOutputPath, const std::string& outputPath,
+                                       std::ostream& out, std::ostream& err) const
+{
+   if ((0 != unlink(outputPath.c_str())) && (errno != ENOENT))
+   {
+      int saved_errno = errno;
+      err << "  NGROM ERROR: Failed to replace OUTPUT file... " << strerror(saved_errno) << std::endl;
+      return false;
+   }
+
+   if (m_linkMode == HARDLINK)
+   {
+      if (0 != link(firstOutputPath.c_str(), outputPath.c_str()))
+      {
+         int saved_errno = errno;
+         err << "  NGROM ERROR: Failed to hardlink OUTPUT file... " << strerror(saved_errno) << std::endl;
+         return false;
+      }
+      out << "  Hardlinked to " << firstOutputPath << std::endl;
+   }
+   else
+   {
+      CloneMethod method = cloneFile(firstOutputPath, outputPath);
+      if (method == CLONE_FAILED)
+      {
+         int saved_errno = errno;
+         err << "  NGROM ERROR: Failed to clone OUTPUT file... " << strerror(saved_errno) << std::endl;
+         return false;
+      }
+      out << ((method == CLONE_REFLINK) ? "  Reflinked to " : "  Copied from ") << firstOutputPath << std::endl;
+   }
+
+   return true;
+}
@@ -0,0 +1,85 @@
+// New GROM - Content-addressed deduplication
+//
+// Tracks the content (size + hash) of each input converted during a run, so a
+// byte-identical input met later is not decoded again; its output is made a
+// hardlink or reflink of the first output instead.
+
+#ifndef NGROM_DEDUP_H
+#define NGROM_DEDUP_H
+
+#include<stdint.h>
+#include<iosfwd>
+#include<string>
+#include<unordered_map>
+
+namespace NGROM_NS
+{
+   // --------------------------------------------------------------------------
+   // Class: DedupIndex
+   // Description: Index of converted input contents.  Inputs are only hashed
+   //              up front when another input of the same size has already
+   //              been converted (otherwise the hash comes for free from the
+   //              conversion reads).  A hash match is only a candidate: the
+   //              caller compares the inputs' bytes before linking.
+   // --------------------------------------------------------------------------
+   class DedupIndex
+   {
+   public:
+      enum LinkMode
+      {
+         HARDLINK, // Duplicate outputs share the first output's inode
+         REFLINK   // Duplicate outputs are copy-on-write clones (or copies)
+      };
+
+      // The first conversion of a content
+      struct Conversion
+      {
+         std::string inputPath;
+         std::string outputPath;
+      };
+
+      explicit DedupIndex(LinkMode linkMode);
+
+      static bool parseLinkMode(const std::string& modeString, LinkMode& linkMode);
+
+      bool hasInputSize(uint64_t inputSize) const;
+      const Conversion* findOutput(uint64_t inputSize, uint64_t contentHash) const;
+      void addOutput(uint64_t inputSize, uint64_t contentHash,
+                     const std::string& inputPath, const std::string& outputPath);
+
+      bool materialize(const std::string& firstOutputPath, const std::string& outputPath,
+                       std::ostream& out, std::ostream& err) const;
+
+      uint64_t numDuplicates() const { return m_numDuplicates; }
+      uint64_t bytesSaved() const { return m_bytesSaved; }
+      void countDuplicate(uint64_t outputSize) { m_numDuplicates++; m_bytesSaved += outputSize; }
+
+   private:
+      struct ContentKey
+      {
+         uint64_t inputSize;
+         uint64_t contentHash;
+
+         bool operator==(const ContentKey& rhs) const
+         {
+            return (inputSize == rhs.inputSize) && (contentHash == rhs.contentHash);
+         }
+      };
+
+      struct ContentKeyHash
+      {
+         size_t operator()(const ContentKey& key) const
+         {
+            return key.contentHash ^ (key.inputSize * 0x9E3779B97F4A7C15ULL);
+         }
+      };
+
+      LinkMode m_linkMode;
+      std::unordered_map<uint64_t, size_t> m_sizeCounts;
+      std::unordered_map<ContentKey, Conversion, ContentKeyHash> m_outputs;
+      uint64_t m_numDuplicates;
+      uint64_t m_bytesSaved;
+   };
+}
+
+#endif // NGROM_DEDUP_H
@@ -0,0 +1,354 @@
+// New GROM - Durable (crash-safe) output commits
+
+#include "ngrom_durable.h"
+#include "ngrom_trace.h"
+#include<iostream> // for std::err
+#include<algorithm>
+#include<thread>
+#include<atomic>
+#include<errno.h>
+#include<stdio.h>     // for snprintf, rename
+#include<stdlib.h>    // for mkostemp
+#include<string.h>
+#include<fcntl.h>     // for open, O_TMPFILE, linkat
+#include<unistd.h>    // for fdatasync, fsync, close, unlink, getpid
+#include<sys/stat.h>  // for umask, fchmod
+
+// Group commit thresholds
+static const size_t DURABLE_GROUP_FILES = 64;
+static const uint64_t DURABLE_GROUP_BYTES = 256 * 1024 * 1024;
+
+// Files fdatasync'ed at once within a group
+static const size_t DURABLE_SYNC_THREADS = 8;
+
+// -----------------------------------------------------------------------------
+// Function: getDirectory
+// Description: Gets the directory part of a path ("." if there is none).
+// -----------------------------------------------------------------------------
+static std::string getDirectory(const std::string& path)
+{
+   size_t slashPos = path.rfind('/');
+   if (slashPos == std::string::npos)
+   {
+      return ".";
+   }
+   return (slashPos == 0) ? "/" : path.substr(0, slashPos);
+}
+
+// -----------------------------------------------------------------------------
+// Function: getHiddenTempPath
+// Description: Gets a temporary name next to finalPath: ".<name>.<suffix>".
+// -----------------------------------------------------------------------------
+static std::string getHiddenTempPath(const std::string& finalPath, const std::string& suffix)
+{
+   size_t slashPos = finalPath.rfind('/');
+   size_t nameStart = (slashPos == std::string::npos) ? 0 : (slashPos + 1);
+   return finalPath.substr(0, nameStart) + "." + finalPath.substr(nameStart) + "." + suffix;
+}
+
+// -----------------------------------------------------------------------------
+// Function: DurableCommitter::DurableCommitter
+// Description: Constructor.  (Reads the umask; construct before starting
+//              threads that create files.)
+// -----------------------------------------------------------------------------
+NGROM_NS::DurableCommitter::DurableCommitter()
+ : m_pendingBytes(0)
+{
+   mode_t mask = umask(0);
+   umask(mask);
+   m_fileMode = 0666 & ~mask;
+}
+
+// -----------------------------------------------------------------------------
+// Function: DurableCommitter::~DurableCommitter
+// Description: Destructor; outputs never committed are thrown away.
+// -----------------------------------------------------------------------------
+NGROM_NS::DurableCommitter::~DurableCommitter()
+{
+   discard(m_pending);
+}
+
+// -----------------------------------------------------------------------------
+// Function: DurableCommitter::createTempFile
+// Description: Creates the file an output is written to: unnamed (O_TMPFILE)
+//              in the output's directory, or else under a hidden temporary
+//              name there.
+// Return: File descriptor (tempPath is empty if unnamed), or -1 on error
+//         (errno is set).
+// -----------------------------------------------------------------------------
+int NGROM_NS::DurableCommitter::createTempFile(const std::string& finalPath, std::string& tempPath) const
+{
+   tempPath.clear();
+
+#ifdef O_TMPFILE
+   int fd = open(getDirectory(finalPath).c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0666);
+   if ((fd >= 0) || ((errno != EOPNOTSUPP) && (errno != EISDIR) && (errno != EINVAL)))
+   {
+      return fd;
+   }
+#endif
+
+   std::string pattern = getHiddenTempPath(finalPath, "XXXXXX");
+   std::vector<char> pathBytes(pattern.begin(), pattern.end());
+   pathBytes.push_back('\0');
+
+   int tempFd = mkostemp(pathBytes.data(), O_CLOEXEC);
+   if (tempFd < 0)
+   {
+      return -1;
+   }
+
+   // (mkostemp creates the file private; give it the usual permissions.)
+   fchmod(tempFd, m_fileMode);
+   tempPath = pathBytes.data();
+   return tempFd;
+}
+
+// -----------------------------------------------------------------------------
+// Function: DurableCommitter::add
+// Description: Queues a finished output (its fd, and tempPath as from
+//              createTempFile) to be committed as finalPath, committing the
+//              group if it's full.
+// Return: true if queued (and any group commit succeeded); false otherwise.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::DurableCommitter::add(int fd, const std::string& tempPath, const std::string& finalPath,
+                                     uint64_t numBytes, const std::function<bool()>& onCommitted)
+{
+   PendingOutput output;
+   output.fd = fd;
+   output.tempPath = tempPath;
+   output.finalPath = finalPath;
+   output.inPlace = false;
+   output.onCommitted = onCommitted;
+
+   bool groupFull = false;
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_pending.push_back(output);
+      m_pendingPaths.insert(finalPath);
+      m_pendingBytes += numBytes;
+      groupFull = (m_pending.size() >= DURABLE_GROUP_FILES) || (m_pendingBytes >= DURABLE_GROUP_BYTES);
+   }
+
+   return !groupFull || flush();
+}
+
+// -----------------------------------------------------------------------------
+// Function: DurableCommitter::addInPlace
+// Description: Queues an output already under its final name (e.g., a dedup
+//              link or clone) to be synced with the next group.
+// Return: true if queued; false on error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::DurableCommitter::addInPlace(const std::string& finalPath, const std::function<bool()>& onCommitted)
+{
+   int fd = open(finalPath.c_str(), O_RDONLY | O_CLOEXEC);
+   if (fd < 0)
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to open output " << finalPath << " for syncing... " << strerror(saved_errno) << std::endl;
+      return false;
+   }
+
+   PendingOutput output;
+   output.fd = fd;
+   output.finalPath = finalPath;
+   output.inPlace = true;
+   output.onCommitted = onCommitted;
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_pending.push_back(output);
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: DurableCommitter::isPending
+// Description: Checks whether an output is written but not yet in place.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::DurableCommitter::isPending(const std::string& finalPath) const
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   return (m_pendingPaths.count(finalPath) > 0);
+}
+
+// -----------------------------------------------------------------------------
+// Function: DurableCommitter::flush
+// Description: Commits all outputs queued so far (including any group
+//              another thread is already committing).
+// Return: true if all committed; false on any error (the outputs that were
+//         not committed are thrown away).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::DurableCommitter::flush()
+{
+   std::lock_guard<std::mutex> commitLock(m_commitMutex);
+
+   std::vector<PendingOutput> group;
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      group.swap(m_pending);
+      m_pendingBytes = 0;
+   }
+
+   if (group.empty())
+   {
+      return true;
+   }
+
+   bool retval = commitGroup(group);
+
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (const PendingOutput& output : group)
+      {
+         m_pendingPaths.erase(output.finalPath);
+      }
+   }
+
+   if (!retval)
+   {
+      discard(group);
+      return false;
+   }
+
+   for (PendingOutput& output : group)
+   {
+      if (output.onCommitted && !output.onCommitted())
+      {
+         retval = false;
+      }
+   }
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: DurableCommitter::commitGroup
+// Description: Syncs the group's data, puts each output in place, and syncs
+//              their directories.  The fds are closed (and set to -1), and
+//              temporary names cleared, as each output is put in place.
+// Return: true if all committed; false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::DurableCommitter::commitGroup(std::vector<PendingOutput>& group)
+{
+   // Data first (several files at once, so their journal commits coalesce)
+   std::atomic<size_t> nextIndex(0);
+   std::atomic<bool> syncFailed(false);
+   std::vector<std::thread> threads;
+   size_t numThreads = (group.size() < DURABLE_SYNC_THREADS) ? group.size() : DURABLE_SYNC_THREADS;
+
+   for (size_t i = 0; i < numThreads; i++)
+   {
+      threads.push_back(std::thread([&]()
+      {
+         for (size_t index = nextIndex++; index < group.size(); index = nextIndex++)
+         {
+            NGROM_NS::TraceSpan syncSpan("fsync", "io", group[index].finalPath);
+            if (0 != fdatasync(group[index].fd))
+            {
+               int saved_errno = errno;
+               std::cerr << "NGROM ERROR: Failed to sync output " << group[index].finalPath << "... " << strerror(saved_errno) << std::endl;
+               syncFailed = true;
+            }
+         }
+      }));
+   }
+
+   for (std::thread& thread : threads)
+   {
+      thread.join();
+   }
+
+   if (syncFailed)
+   {
+      return false;
+   }
+
+   // Then the names
+   std::vector<std::string> dirPaths;
+   for (PendingOutput& output : group)
+   {
+      int rc = 0;
+      if (output.inPlace)
+      {
+         // Nothing to do
+      }
+      else if (output.tempPath.empty())
+      {
+         char fdPath[64];
+         snprintf(fdPath, sizeof(fdPath), "/proc/self/fd/%d", output.fd);
+         rc = linkat(AT_FDCWD, fdPath, AT_FDCWD, output.finalPath.c_str(), AT_SYMLINK_FOLLOW);
+
+         if ((rc != 0) && (errno == EEXIST))
+         {
+            // Replacing an output: link under a temporary name, then rename.
+            static std::atomic<unsigned long> s_numLinks(0);
+            output.tempPath = getHiddenTempPath(output.finalPath,
+                                                std::to_string(getpid()) + "." + std::to_string(s_numLinks++));
+            rc = linkat(AT_FDCWD, fdPath, AT_FDCWD, output.tempPath.c_str(), AT_SYMLINK_FOLLOW);
+            if (rc == 0)
+            {
+               rc = rename(output.tempPath.c_str(), output.finalPath.c_str());
+            }
+         }
+      }
+      else
+      {
+         rc = rename(output.tempPath.c_str(), output.finalPath.c_str());
+      }
+
+      if (rc != 0)
+      {
+         int saved_errno = errno;
+         std::cerr << "NGROM ERROR: Failed to put output " << output.finalPath << " in place... " << strerror(saved_errno) << std::endl;
+         return false;
+      }
+
+      output.tempPath.clear();
+      close(output.fd);
+      output.fd = -1;
+
+      std::string dirPath = getDirectory(output.finalPath);
+      if (std::find(dirPaths.begin(), dirPaths.end(), dirPath) == dirPaths.end())
+      {
+         dirPaths.push_back(dirPath);
+      }
+   }
+
+   // Then each directory, once
+   for (const std::string& dirPath : dirPaths)
+   {
+      NGROM_NS::TraceSpan syncSpan("fsync dir", "io", dirPath);
+      int dirFd = open(dirPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if ((dirFd < 0) || (0 != fsync(dirFd)))
+      {
+         int saved_errno = errno;
+         std::cerr << "NGROM ERROR: Failed to sync directory " << dirPath << "... " << strerror(saved_errno) << std::endl;
+         if (dirFd >= 0) { close(dirFd); }
+         return false;
+      }
+      close(dirFd);
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: DurableCommitter::discard
+// Description: Throws away outputs that weren't put in place.
+// -----------------------------------------------------------------------------
+void NGROM_NS::DurableCommitter::discard(std::vector<PendingOutput>& group)
+{
+   for (PendingOutput& output : group)
+   {
+      if (output.fd >= 0)
+      {
+         close(output.fd);
+         output.fd = -1;
+      }
+      if (!output.tempPath.empty())
+      {
+         unlink(output.tempPath.c_str());
+         output.tempPath.clear();
+      }
+   }
+   group.clear();
+}
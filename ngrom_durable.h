@@ -0,0 +1,73 @@
+// New GROM - Durable (crash-safe) output commits
+//
+// In durable mode, each output is written to an unnamed O_TMPFILE (or a
+// hidden temporary name, where the filesystem has no O_TMPFILE) in its
+// output directory, and only appears under its real name once its data is
+// on stable storage.  Finished outputs are committed in groups: all of a
+// group's files are fsynced at once (so the filesystem can batch them into
+// few journal commits), then each is linked or renamed into place, then each
+// directory is fsynced once.  A crash therefore leaves either the complete
+// new output or the previous state, never a truncated BIN.
+
+#ifndef NGROM_DURABLE_H
+#define NGROM_DURABLE_H
+
+#include<stdint.h>
+#include<sys/types.h> // for mode_t
+#include<functional>
+#include<mutex>
+#include<string>
+#include<unordered_set>
+#include<vector>
+
+namespace NGROM_NS
+{
+   // --------------------------------------------------------------------------
+   // Class: DurableCommitter
+   // Description: Group commit of finished outputs.  A group is committed
+   //              once it has DURABLE_GROUP_FILES files or DURABLE_GROUP_BYTES
+   //              bytes, and by flush() (e.g., at the end of a run).  Each
+   //              output's onCommitted callback runs after its group is
+   //              durable (in the order added).
+   // --------------------------------------------------------------------------
+   class DurableCommitter
+   {
+   public:
+      DurableCommitter();
+      ~DurableCommitter();
+
+      DurableCommitter(const DurableCommitter&) = delete;
+      DurableCommitter& operator=(const DurableCommitter&) = delete;
+
+      int createTempFile(const std::string& finalPath, std::string& tempPath) const;
+      bool add(int fd, const std::string& tempPath, const std::string& finalPath, uint64_t numBytes,
+               const std::function<bool()>& onCommitted);
+      bool addInPlace(const std::string& finalPath, const std::function<bool()>& onCommitted);
+      bool flush();
+      bool isPending(const std::string& finalPath) const;
+
+   private:
+      struct PendingOutput
+      {
+         int fd;                // Open on the output's data (owned)
+         std::string tempPath;  // Temporary name; empty for O_TMPFILE (or already in place)
+         std::string finalPath;
+         bool inPlace;          // Already under its final name (only needs syncing)
+         std::function<bool()> onCommitted;
+      };
+
+      bool commitGroup(std::vector<PendingOutput>& group);
+      static void discard(std::vector<PendingOutput>& group);
+
+      mode_t m_fileMode; // For named temporary files (0666 less the umask)
+
+      mutable std::mutex m_mutex; // Guards the members below
+      std::vector<PendingOutput> m_pending;
+      uint64_t m_pendingBytes;
+      std::unordered_set<std::string> m_pendingPaths; // Final paths of outputs not yet in place
+
+      std::mutex m_commitMutex; // One group commit at a time (keeps them in order)
+   };
+}
+
+#endif // NGROM_DURABLE_H
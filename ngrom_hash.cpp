@@ -0,0 +1,286 @@
+// New GROM - Content hashing (XXH64)
+
+#include "ngrom_hash.h"
+#include<stdio.h>  // for FILE I/O and snprintf
+#include<stdlib.h> // for strtoull
+#include<string.h>
+#include<errno.h>
+#include<unistd.h> // for pread
+
+// XXH64 primes
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+// Read buffer size for hashFile and hashFd
+static const size_t HASH_FILE_CHUNK_BYTES = 65536;
+
+static inline uint64_t rotl64(uint64_t value, int bits)
+{
+   return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read64(const unsigned char* bytes)
+{
+   uint64_t value;
+   memcpy(&value, bytes, sizeof(value)); // (little-endian host assumed)
+   return value;
+}
+
+static inline uint32_t read32(const unsigned char* bytes)
+{
+   uint32_t value;
+   memcpy(&value, bytes, sizeof(value));
+   return value;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+   acc += input * PRIME64_2;
+   acc = rotl64(acc, 31);
+   acc *= PRIME64_1;
+   return acc;
+}
+
+static inline uint64_t mergeRound64(uint64_t acc, uint64_t value)
+{
+   value = round64(0, value);
+   acc ^= value;
+   acc = acc * PRIME64_1 + PRIME64_4;
+   return acc;
+}
+
+// -----------------------------------------------------------------------------
+// Function: ContentHasher::ContentHasher
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::ContentHasher::ContentHasher(uint64_t seed)
+{
+   reset(seed);
+}
+
+// -----------------------------------------------------------------------------
+// Function: ContentHasher::reset
+// Description: Restarts hashing with the supplied seed.
+// -----------------------------------------------------------------------------
+void NGROM_NS::ContentHasher::reset(uint64_t seed)
+{
+   m_totalBytes = 0;
+   m_seed = seed;
+   m_acc[0] = seed + PRIME64_1 + PRIME64_2;
+   m_acc[1] = seed + PRIME64_2;
+   m_acc[2] = seed;
+   m_acc[3] = seed - PRIME64_1;
+   m_bufferedBytes = 0;
+}
+
+// -----------------------------------------------------------------------------
+// Function: ContentHasher::update
+// Description: Feeds more data into the hash.
+// -----------------------------------------------------------------------------
+void NGROM_NS::ContentHasher::update(const void* data, size_t numBytes)
+{
+   const unsigned char* bytes = static_cast<const unsigned char*>(data);
+   const unsigned char* bytesEnd = bytes + numBytes;
+
+   m_totalBytes += numBytes;
+
+   // Top off a partially filled stripe first
+   if (m_bufferedBytes > 0)
+   {
+      size_t fillBytes = sizeof(m_buffer) - m_bufferedBytes;
+      if (numBytes < fillBytes)
+      {
+         memcpy(m_buffer + m_bufferedBytes, bytes, numBytes);
+         m_bufferedBytes += numBytes;
+         return;
+      }
+
+      memcpy(m_buffer + m_bufferedBytes, bytes, fillBytes);
+      bytes += fillBytes;
+
+      m_acc[0] = round64(m_acc[0], read64(m_buffer));
+      m_acc[1] = round64(m_acc[1], read64(m_buffer + 8));
+      m_acc[2] = round64(m_acc[2], read64(m_buffer + 16));
+      m_acc[3] = round64(m_acc[3], read64(m_buffer + 24));
+      m_bufferedBytes = 0;
+   }
+
+   // Whole 32 byte stripes
+   while (bytes + 32 <= bytesEnd)
+   {
+      m_acc[0] = round64(m_acc[0], read64(bytes));
+      m_acc[1] = round64(m_acc[1], read64(bytes + 8));
+      m_acc[2] = round64(m_acc[2], read64(bytes + 16));
+      m_acc[3] = round64(m_acc[3], read64(bytes + 24));
+      bytes += 32;
+   }
+
+   // Save the tail for later
+   if (bytes < bytesEnd)
+   {
+      m_bufferedBytes = bytesEnd - bytes;
+      memcpy(m_buffer, bytes, m_bufferedBytes);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: ContentHasher::digest
+// Description: Computes the hash of all data supplied so far.
+// Return: 64-bit hash value.
+// -----------------------------------------------------------------------------
+uint64_t NGROM_NS::ContentHasher::digest() const
+{
+   uint64_t hashValue;
+
+   if (m_totalBytes >= 32)
+   {
+      hashValue = rotl64(m_acc[0], 1) + rotl64(m_acc[1], 7) +
+                  rotl64(m_acc[2], 12) + rotl64(m_acc[3], 18);
+      hashValue = mergeRound64(hashValue, m_acc[0]);
+      hashValue = mergeRound64(hashValue, m_acc[1]);
+      hashValue = mergeRound64(hashValue, m_acc[2]);
+      hashValue = mergeRound64(hashValue, m_acc[3]);
+   }
+   else
+   {
+      hashValue = m_seed + PRIME64_5;
+   }
+
+   hashValue += m_totalBytes;
+
+   const unsigned char* bytes = m_buffer;
+   const unsigned char* bytesEnd = m_buffer + m_bufferedBytes;
+
+   while (bytes + 8 <= bytesEnd)
+   {
+      hashValue ^= round64(0, read64(bytes));
+      hashValue = rotl64(hashValue, 27) * PRIME64_1 + PRIME64_4;
+      bytes += 8;
+   }
+
+   if (bytes + 4 <= bytesEnd)
+   {
+      hashValue ^= (uint64_t)read32(bytes) * PRIME64_1;
+      hashValue = rotl64(hashValue, 23) * PRIME64_2 + PRIME64_3;
+      bytes += 4;
+   }
+
+   while (bytes < bytesEnd)
+   {
+      hashValue ^= (*bytes) * PRIME64_5;
+      hashValue = rotl64(hashValue, 11) * PRIME64_1;
+      bytes++;
+   }
+
+   hashValue ^= hashValue >> 33;
+   hashValue *= PRIME64_2;
+   hashValue ^= hashValue >> 29;
+   hashValue *= PRIME64_3;
+   hashValue ^= hashValue >> 32;
+
+   return hashValue;
+}
+
+// -----------------------------------------------------------------------------
+// Function: ContentHasher::hash
+// Description: One-shot hash of a buffer.
+// Return: 64-bit hash value.
+// -----------------------------------------------------------------------------
+uint64_t NGROM_NS::ContentHasher::hash(const void* data, size_t numBytes, uint64_t seed)
+{
+   ContentHasher hasher(seed);
+   hasher.update(data, numBytes);
+   return hasher.digest();
+}
+
+// -----------------------------------------------------------------------------
+// Function: hashToString
+// Description: Formats a hash value as 16 (lowercase) hex characters.
+// -----------------------------------------------------------------------------
+std::string NGROM_NS::hashToString(uint64_t hashValue)
+{
+   char hexChars[20];
+   snprintf(hexChars, sizeof(hexChars), "%016llx", (unsigned long long)hashValue);
+   return std::string(hexChars);
+}
+
+// -----------------------------------------------------------------------------
+// Function: hashFromString
+// Description: Parses a hash value formatted by hashToString.
+// Return: true if the string is a valid hash; false otherwise.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::hashFromString(const std::string& hexString, uint64_t& hashValue)
+{
+   if (hexString.length() != 16)
+   {
+      return false;
+   }
+
+   char* endPtr = NULL;
+   hashValue = strtoull(hexString.c_str(), &endPtr, 16);
+
+   return (endPtr != NULL) && (*endPtr == '\0');
+}
+
+// -----------------------------------------------------------------------------
+// Function: hashFile
+// Description: Hashes the full contents of the named file.
+// Return: true if the whole file was read; false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::hashFile(const std::string& filename, uint64_t& hashValue)
+{
+   FILE* inFile = fopen(filename.c_str(), "r");
+   if (inFile == NULL)
+   {
+      return false;
+   }
+
+   ContentHasher hasher;
+   unsigned char chunkBytes[HASH_FILE_CHUNK_BYTES];
+   size_t numBytesRead;
+
+   while ((numBytesRead = fread(chunkBytes, 1, HASH_FILE_CHUNK_BYTES, inFile)) > 0)
+   {
+      hasher.update(chunkBytes, numBytesRead);
+   }
+
+   bool retval = (ferror(inFile) == 0);
+   fclose(inFile);
+
+   hashValue = hasher.digest();
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: hashFd
+// Description: Hashes the full contents of an open file (read from its start
+//              with pread; the file offset is left alone).
+// Return: true if the whole file was read; false on any error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::hashFd(int fd, uint64_t& hashValue)
+{
+   ContentHasher hasher;
+   unsigned char chunkBytes[HASH_FILE_CHUNK_BYTES];
+   off_t offset = 0;
+   ssize_t numBytesRead;
+
+   while ((numBytesRead = pread(fd, chunkBytes, HASH_FILE_CHUNK_BYTES, offset)) != 0)
+   {
+      if (numBytesRead < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         return false;
+      }
+      hasher.update(chunkBytes, numBytesRead);
+      offset += numBytesRead;
+   }
+
+   hashValue = hasher.digest();
+   return true;
+}
@@ -0,0 +1,49 @@
+// New GROM - Content hashing
+//
+// Fast, non-cryptographic 64-bit hash (the XXH64 algorithm), usable either in
+// one shot or streamed block by block alongside the conversion reads.
+
+#ifndef NGROM_HASH_H
+#define NGROM_HASH_H
+
+#include<stddef.h>
+#include<stdint.h>
+#include<string>
+
+namespace NGROM_NS
+{
+   // --------------------------------------------------------------------------
+   // Class: ContentHasher
+   // Description: Streaming XXH64 hasher.  Feed data with update(); digest()
+   //              may be called at any point and does not alter the state.
+   // --------------------------------------------------------------------------
+   class ContentHasher
+   {
+   public:
+      explicit ContentHasher(uint64_t seed = 0);
+
+      void reset(uint64_t seed = 0);
+      void update(const void* data, size_t numBytes);
+      uint64_t digest() const;
+
+      static uint64_t hash(const void* data, size_t numBytes, uint64_t seed = 0);
+
+   private:
+      uint64_t m_totalBytes;
+      uint64_t m_seed;
+      uint64_t m_acc[4];
+      unsigned char m_buffer[32];
+      size_t m_bufferedBytes;
+   };
+
+   // Formats/parses a hash as 16 hex characters.
+   std::string hashToString(uint64_t hashValue);
+   bool hashFromString(const std::string& hexString, uint64_t& hashValue);
+
+   // Hashes the full contents of a file (by name, or open).  Returns false on
+   // any I/O error.
+   bool hashFile(const std::string& filename, uint64_t& hashValue);
+   bool hashFd(int fd, uint64_t& hashValue);
+}
+
+#endif // NGROM_HASH_H
@@ -0,0 +1,552 @@
+// New GROM - ROM header index
+//
+// Usage:
+//    ngrom index build <indexFile> <files...>
+//    ngrom index query <indexFile> [field=value...]
+//
+// A rebuild only re-reads files whose size, mtime, or inode changed since the
+// previous index; files no longer listed are dropped from the index.
+
+#include "ngrom_index.h"
+#include "ngrom.h"
+#include "ngrom_hash.h"
+#include "ngrom_input.h"
+#include<stdio.h>  // for FILE I/O
+#include<iostream> // for std::cout and std::err
+#include<unordered_map>
+#include<errno.h>
+#include<string.h>
+#include<strings.h>  // for strncasecmp
+#include<fcntl.h>    // for open
+#include<unistd.h>   // for close, fsync
+#include<sys/mman.h> // for mmap
+#include<sys/stat.h> // for stat
+#include<time.h>     // for clock_gettime
+
+static const char INDEX_MAGIC[8] = { 'N', 'G', 'R', 'O', 'M', 'I', 'D', 'X' };
+static const uint32_t INDEX_VERSION = 1;
+
+static_assert(sizeof(NGROM_NS::IndexFileHeader) == 64, "IndexFileHeader layout");
+static_assert(sizeof(NGROM_NS::IndexRecord) == 320, "IndexRecord layout");
+
+// Genesis header field locations, relative to IndexRecord::header (0x100)
+static const size_t HDR_SYSTEM_OFFSET    = 0x00;
+static const size_t HDR_SYSTEM_LEN       = 16;
+static const size_t HDR_COPYRIGHT_OFFSET = 0x10;
+static const size_t HDR_COPYRIGHT_LEN    = 16;
+static const size_t HDR_DOMESTIC_OFFSET  = 0x20;
+static const size_t HDR_OVERSEAS_OFFSET  = 0x50;
+static const size_t HDR_NAME_LEN         = 48;
+static const size_t HDR_PRODUCT_OFFSET   = 0x80; // Software type + product code and version
+static const size_t HDR_PRODUCT_LEN      = 14;
+static const size_t HDR_COUNTRIES_OFFSET = 0xF0;
+static const size_t HDR_COUNTRIES_LEN    = 3;
+
+namespace
+{
+   // --------------------------------------------------------------------------
+   // Class: MappedIndex
+   // Description: Read-only memory mapping of an index file.
+   // --------------------------------------------------------------------------
+   class MappedIndex
+   {
+   public:
+      MappedIndex() : m_data(NULL), m_size(0), m_header(NULL), m_records(NULL), m_strings(NULL) {}
+      ~MappedIndex() { if (m_data != NULL) { munmap(m_data, m_size); } }
+
+      MappedIndex(const MappedIndex&) = delete;
+      MappedIndex& operator=(const MappedIndex&) = delete;
+
+      bool open(const std::string& indexPath, bool reportMissing);
+
+      uint64_t numRecords() const { return (m_header != NULL) ? m_header->numRecords : 0; }
+      const NGROM_NS::IndexRecord& record(uint64_t i) const { return m_records[i]; }
+      std::string path(const NGROM_NS::IndexRecord& rec) const { return std::string(m_strings + rec.pathOffset, rec.pathLength); }
+
+   private:
+      void* m_data;
+      size_t m_size;
+      const NGROM_NS::IndexFileHeader* m_header;
+      const NGROM_NS::IndexRecord* m_records;
+      const char* m_strings;
+   };
+
+   // A single query filter (field=value)
+   struct QueryFilter
+   {
+      std::string field;
+      std::string value;
+   };
+}
+
+// -----------------------------------------------------------------------------
+// Function: MappedIndex::open
+// Description: Maps and validates the index file.
+// Return: true if mapped; false on any error (or if missing).
+// -----------------------------------------------------------------------------
+bool MappedIndex::open(const std::string& indexPath, bool reportMissing)
+{
+   int fd = ::open(indexPath.c_str(), O_RDONLY | O_CLOEXEC);
+   if (fd < 0)
+   {
+      int saved_errno = errno;
+      if (reportMissing || (saved_errno != ENOENT))
+      {
+         std::cerr << "NGROM ERROR: Failed to open index " << indexPath << "... " << strerror(saved_errno) << std::endl;
+      }
+      return false;
+   }
+
+   struct stat indexStat;
+   bool retval = (0 == fstat(fd, &indexStat)) && ((size_t)indexStat.st_size >= sizeof(NGROM_NS::IndexFileHeader));
+   if (retval)
+   {
+      m_size = indexStat.st_size;
+      m_data = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (m_data == MAP_FAILED)
+      {
+         m_data = NULL;
+         retval = false;
+      }
+   }
+   close(fd);
+
+   if (retval)
+   {
+      // The records are scanned front to back.
+      madvise(m_data, m_size, MADV_SEQUENTIAL);
+
+      m_header = static_cast<const NGROM_NS::IndexFileHeader*>(m_data);
+      m_records = reinterpret_cast<const NGROM_NS::IndexRecord*>(static_cast<const char*>(m_data) + sizeof(NGROM_NS::IndexFileHeader));
+      m_strings = static_cast<const char*>(m_data) + m_header->stringTableOffset;
+
+      retval = (0 == memcmp(m_header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC))) &&
+               (m_header->version == INDEX_VERSION) &&
+               (m_header->recordSize == sizeof(NGROM_NS::IndexRecord)) &&
+               (m_header->stringTableOffset == sizeof(NGROM_NS::IndexFileHeader) + (m_header->numRecords * sizeof(NGROM_NS::IndexRecord))) &&
+               (m_header->stringTableOffset + m_header->stringTableSize <= m_size);
+   }
+
+   if (!retval)
+   {
+      std::cerr << "NGROM ERROR: " << indexPath << " is not a valid ngrom index." << std::endl;
+      m_header = NULL;
+   }
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getRegionMask
+// Description: Decodes the header's countries field (either "JUE" style
+//              letters, or a single hex digit of region bits) into REGION_*
+//              bits.  countries points at ROM offset 0x1F0.
+// -----------------------------------------------------------------------------
+uint8_t NGROM_NS::getRegionMask(const unsigned char* countries)
+{
+   uint8_t regionMask = 0;
+
+   bool hasLetters = false;
+   for (size_t i = 0; i < HDR_COUNTRIES_LEN; i++)
+   {
+      if (countries[i] == 'J') { regionMask |= NGROM_NS::REGION_JAPAN; hasLetters = true; }
+      if (countries[i] == 'U') { regionMask |= NGROM_NS::REGION_USA; hasLetters = true; }
+      if (countries[i] == 'E') { regionMask |= NGROM_NS::REGION_EUROPE; hasLetters = true; }
+   }
+
+   // Newer style: hex digit; bit 0 = Japan, bit 2 = Americas, bit 3 = Europe.
+   if (!hasLetters)
+   {
+      int digit = -1;
+      if ((countries[0] >= '0') && (countries[0] <= '9')) { digit = countries[0] - '0'; }
+      if ((countries[0] >= 'A') && (countries[0] <= 'F')) { digit = countries[0] - 'A' + 10; }
+
+      if (digit > 0)
+      {
+         if (digit & 0x1) { regionMask |= NGROM_NS::REGION_JAPAN; }
+         if (digit & 0x4) { regionMask |= NGROM_NS::REGION_USA; }
+         if (digit & 0x8) { regionMask |= NGROM_NS::REGION_EUROPE; }
+      }
+   }
+
+   return regionMask;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getHeaderText
+// Description: Gets a header text field, with trailing spaces/NULs removed
+//              (and any other unprintable bytes shown as '?').
+// -----------------------------------------------------------------------------
+static std::string getHeaderText(const NGROM_NS::IndexRecord& rec, size_t offset, size_t length)
+{
+   std::string text(reinterpret_cast<const char*>(rec.header + offset), length);
+
+   size_t textEnd = text.find_last_not_of(std::string(" \0", 2));
+   text.erase((textEnd == std::string::npos) ? 0 : textEnd + 1);
+
+   for (char& c : text)
+   {
+      if (((unsigned char)c < 0x20) || ((unsigned char)c >= 0x7F))
+      {
+         c = '?';
+      }
+   }
+
+   return text;
+}
+
+// -----------------------------------------------------------------------------
+// Function: containsNoCase
+// Description: Case-insensitive search for needle within a header field.
+// -----------------------------------------------------------------------------
+static bool containsNoCase(const unsigned char* field, size_t fieldLen, const std::string& needle)
+{
+   if (needle.length() > fieldLen)
+   {
+      return false;
+   }
+
+   for (size_t i = 0; i + needle.length() <= fieldLen; i++)
+   {
+      if (0 == strncasecmp(reinterpret_cast<const char*>(field + i), needle.c_str(), needle.length()))
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+// -----------------------------------------------------------------------------
+// Function: indexFile
+// Description: Reads one ROM file's header and content hash into a record.
+// Return: true if indexed; false if the file can't be read.
+// -----------------------------------------------------------------------------
+static bool indexFile(const std::string& filename, const struct stat& fileStat, NGROM_NS::IndexRecord& rec)
+{
+   NGROM_NS::InputFile input;
+   int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+   if ((fd < 0) || !input.openFd(fd))
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to open file " << filename << "... " << strerror(saved_errno) << std::endl;
+      return false;
+   }
+
+   unsigned char binHeaderBytes[NUM_HEADER_BYTES];
+   memset(binHeaderBytes, 0, NUM_HEADER_BYTES);
+
+   NGROM_NS::RomFormat fmt = NGROM_NS::UNK_FMT;
+   bool retval = readROMHeader(input, binHeaderBytes, fmt);
+   input.close();
+
+   uint64_t contentHash = 0;
+   if (retval)
+   {
+      retval = NGROM_NS::hashFile(filename, contentHash);
+   }
+
+   if (!retval)
+   {
+      std::cerr << "NGROM ERROR: Incomplete read of file " << filename << std::endl;
+      return false;
+   }
+
+   memset(&rec, 0, sizeof(rec));
+   rec.format = fmt;
+   rec.fileSize = fileStat.st_size;
+   rec.mtimeSec = fileStat.st_mtim.tv_sec;
+   rec.mtimeNsec = fileStat.st_mtim.tv_nsec;
+   rec.inode = fileStat.st_ino;
+   rec.contentHash = contentHash;
+   memcpy(rec.header, binHeaderBytes + 0x100, sizeof(rec.header));
+   rec.regionMask = (fmt == NGROM_NS::UNK_FMT) ? 0 : NGROM_NS::getRegionMask(rec.header + HDR_COUNTRIES_OFFSET);
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: buildIndex
+// Description: (Re)builds the index file for the supplied files.
+// Return: Exit code (0 = success).
+// -----------------------------------------------------------------------------
+static int buildIndex(const std::string& indexPath, const std::vector<std::string>& filenameList)
+{
+   // Previous index (if any), for the incremental rebuild
+   MappedIndex oldIndex;
+   std::unordered_map<std::string, uint64_t> oldRecords;
+   if (oldIndex.open(indexPath, false))
+   {
+      for (uint64_t i = 0; i < oldIndex.numRecords(); i++)
+      {
+         oldRecords[oldIndex.path(oldIndex.record(i))] = i;
+      }
+   }
+
+   std::vector<NGROM_NS::IndexRecord> records;
+   std::string stringTable;
+   size_t numReused = 0;
+   size_t numFailed = 0;
+
+   records.reserve(filenameList.size());
+
+   for (const std::string& filename : filenameList)
+   {
+      struct stat fileStat;
+      if (0 != stat(filename.c_str(), &fileStat))
+      {
+         int saved_errno = errno;
+         std::cerr << "NGROM ERROR: Failed to stat file " << filename << "... " << strerror(saved_errno) << std::endl;
+         numFailed++;
+         continue;
+      }
+
+      NGROM_NS::IndexRecord rec;
+      bool haveRecord = false;
+
+      std::unordered_map<std::string, uint64_t>::const_iterator iter = oldRecords.find(filename);
+      if (iter != oldRecords.end())
+      {
+         const NGROM_NS::IndexRecord& oldRec = oldIndex.record(iter->second);
+         if ((oldRec.fileSize == (uint64_t)fileStat.st_size) &&
+             (oldRec.mtimeSec == fileStat.st_mtim.tv_sec) &&
+             (oldRec.mtimeNsec == (uint32_t)fileStat.st_mtim.tv_nsec) &&
+             (oldRec.inode == (uint64_t)fileStat.st_ino))
+         {
+            rec = oldRec;
+            haveRecord = true;
+            numReused++;
+         }
+      }
+
+      if (!haveRecord && !indexFile(filename, fileStat, rec))
+      {
+         numFailed++;
+         continue;
+      }
+
+      rec.pathOffset = stringTable.length();
+      rec.pathLength = filename.length();
+      stringTable += filename;
+      records.push_back(rec);
+   }
+
+   // Write the new index to a temporary file, then rename it into place.
+   NGROM_NS::IndexFileHeader fileHeader;
+   memset(&fileHeader, 0, sizeof(fileHeader));
+   memcpy(fileHeader.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+   fileHeader.version = INDEX_VERSION;
+   fileHeader.recordSize = sizeof(NGROM_NS::IndexRecord);
+   fileHeader.numRecords = records.size();
+   fileHeader.stringTableOffset = sizeof(fileHeader) + (records.size() * sizeof(NGROM_NS::IndexRecord));
+   fileHeader.stringTableSize = stringTable.length();
+
+   std::string tmpPath = indexPath + ".tmp";
+   FILE* outFile = fopen(tmpPath.c_str(), "w");
+   if (outFile == NULL)
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to create index " << tmpPath << "... " << strerror(saved_errno) << std::endl;
+      return 3;
+   }
+
+   bool writeOk = (1 == fwrite(&fileHeader, sizeof(fileHeader), 1, outFile)) &&
+                  (records.size() == fwrite(records.data(), sizeof(NGROM_NS::IndexRecord), records.size(), outFile)) &&
+                  (stringTable.length() == fwrite(stringTable.data(), 1, stringTable.length(), outFile)) &&
+                  (0 == fflush(outFile)) &&
+                  (0 == fsync(fileno(outFile)));
+   int saved_errno = errno;
+   writeOk = (0 == fclose(outFile)) && writeOk;
+
+   if (writeOk && (0 != rename(tmpPath.c_str(), indexPath.c_str())))
+   {
+      saved_errno = errno;
+      writeOk = false;
+   }
+
+   if (!writeOk)
+   {
+      std::cerr << "NGROM ERROR: Failed to write index " << indexPath << "... " << strerror(saved_errno) << std::endl;
+      unlink(tmpPath.c_str());
+      return 3;
+   }
+
+   std::cout << "Indexed " << records.size() << " file(s) (" << (records.size() - numReused)
+             << " new or changed, " << numReused << " unchanged) into " << indexPath << std::endl;
+
+   if (numFailed > 0)
+   {
+      std::cerr << "NGROM WARNING: " << numFailed << " file(s) could not be indexed" << std::endl;
+      return 2;
+   }
+
+   return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Function: queryIndex
+// Description: Prints the index records matching all of the filters.
+//              Filters (field=value): region (J, U, or E), product (prefix of
+//              software type + product code, e.g., "GM T-"), name (substring
+//              of either game name), system (prefix), copyright (substring),
+//              format (smd, bin, mgd, swapped, or unknown), hash (content hash).
+// Return: Exit code (0 = success).
+// -----------------------------------------------------------------------------
+static int queryIndex(const std::string& indexPath, const std::vector<std::string>& filterArgs)
+{
+   // Parse the filters (cheap integer filters are applied first).
+   int formatFilter = -1;
+   uint8_t regionFilter = 0;
+   bool hashFilterSet = false;
+   uint64_t hashFilter = 0;
+   std::vector<QueryFilter> textFilters;
+
+   for (const std::string& filterArg : filterArgs)
+   {
+      size_t equalsPos = filterArg.find('=');
+      if ((equalsPos == std::string::npos) || (equalsPos == 0))
+      {
+         std::cerr << "NGROM ERROR: Invalid query filter (expected field=value): " << filterArg << std::endl;
+         return 1;
+      }
+
+      QueryFilter filter;
+      filter.field = filterArg.substr(0, equalsPos);
+      filter.value = filterArg.substr(equalsPos + 1);
+
+      bool validFilter = true;
+
+      if (filter.field == "region")
+      {
+         if      (filter.value == "J") { regionFilter |= NGROM_NS::REGION_JAPAN; }
+         else if (filter.value == "U") { regionFilter |= NGROM_NS::REGION_USA; }
+         else if (filter.value == "E") { regionFilter |= NGROM_NS::REGION_EUROPE; }
+         else { validFilter = false; }
+      }
+      else if (filter.field == "format")
+      {
+         if      (filter.value == "smd")     { formatFilter = NGROM_NS::SMD; }
+         else if (filter.value == "bin")     { formatFilter = NGROM_NS::BIN; }
+         else if (filter.value == "mgd")     { formatFilter = NGROM_NS::MGD; }
+         else if (filter.value == "swapped") { formatFilter = NGROM_NS::BIN_SWAPPED; }
+         else if (filter.value == "unknown") { formatFilter = NGROM_NS::UNK_FMT; }
+         else { validFilter = false; }
+      }
+      else if (filter.field == "hash")
+      {
+         validFilter = NGROM_NS::hashFromString(filter.value, hashFilter);
+         hashFilterSet = true;
+      }
+      else if ((filter.field == "product") || (filter.field == "name") ||
+               (filter.field == "system") || (filter.field == "copyright"))
+      {
+         textFilters.push_back(filter);
+      }
+      else
+      {
+         validFilter = false;
+      }
+
+      if (!validFilter)
+      {
+         std::cerr << "NGROM ERROR: Invalid query filter: " << filterArg << std::endl;
+         return 1;
+      }
+   }
+
+   MappedIndex index;
+   if (!index.open(indexPath, true))
+   {
+      return 3;
+   }
+
+   struct timespec startTime;
+   clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+   uint64_t numMatches = 0;
+
+   for (uint64_t i = 0; i < index.numRecords(); i++)
+   {
+      const NGROM_NS::IndexRecord& rec = index.record(i);
+
+      if (((formatFilter >= 0) && (rec.format != formatFilter)) ||
+          ((rec.regionMask & regionFilter) != regionFilter) ||
+          (hashFilterSet && (rec.contentHash != hashFilter)))
+      {
+         continue;
+      }
+
+      bool matched = true;
+      for (const QueryFilter& filter : textFilters)
+      {
+         if (filter.field == "product")
+         {
+            matched = (filter.value.length() <= HDR_PRODUCT_LEN) &&
+                      (0 == memcmp(rec.header + HDR_PRODUCT_OFFSET, filter.value.data(), filter.value.length()));
+         }
+         else if (filter.field == "system")
+         {
+            matched = (filter.value.length() <= HDR_SYSTEM_LEN) &&
+                      (0 == memcmp(rec.header + HDR_SYSTEM_OFFSET, filter.value.data(), filter.value.length()));
+         }
+         else if (filter.field == "copyright")
+         {
+            matched = containsNoCase(rec.header + HDR_COPYRIGHT_OFFSET, HDR_COPYRIGHT_LEN, filter.value);
+         }
+         else // name
+         {
+            matched = containsNoCase(rec.header + HDR_DOMESTIC_OFFSET, HDR_NAME_LEN, filter.value) ||
+                      containsNoCase(rec.header + HDR_OVERSEAS_OFFSET, HDR_NAME_LEN, filter.value);
+         }
+
+         if (!matched)
+         {
+            break;
+         }
+      }
+
+      if (!matched)
+      {
+         continue;
+      }
+
+      numMatches++;
+      std::cout << index.path(rec) << "\t"
+                << getFormatName((NGROM_NS::RomFormat)rec.format) << "\t"
+                << getHeaderText(rec, HDR_PRODUCT_OFFSET, HDR_PRODUCT_LEN) << "\t"
+                << getHeaderText(rec, HDR_COUNTRIES_OFFSET, HDR_COUNTRIES_LEN) << "\t"
+                << getHeaderText(rec, HDR_OVERSEAS_OFFSET, HDR_NAME_LEN) << "\t"
+                << NGROM_NS::hashToString(rec.contentHash) << std::endl;
+   }
+
+   struct timespec endTime;
+   clock_gettime(CLOCK_MONOTONIC, &endTime);
+   double elapsedMs = ((endTime.tv_sec - startTime.tv_sec) * 1000.0) + ((endTime.tv_nsec - startTime.tv_nsec) / 1000000.0);
+
+   std::cerr << numMatches << " of " << index.numRecords() << " record(s) matched ("
+             << elapsedMs << " ms)" << std::endl;
+
+   return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Function: runIndexCommand
+// Description: Runs "ngrom index ..."; args are the arguments after "index".
+// Return: Exit code (0 = success, 1 = usage error, 2 = some files could not be
+//         indexed, 3 = index file error).
+// -----------------------------------------------------------------------------
+int NGROM_NS::runIndexCommand(const std::vector<std::string>& args)
+{
+   if ((args.size() >= 3) && (args[0] == "build"))
+   {
+      return buildIndex(args[1], std::vector<std::string>(args.begin() + 2, args.end()));
+   }
+   else if ((args.size() >= 2) && (args[0] == "query"))
+   {
+      return queryIndex(args[1], std::vector<std::string>(args.begin() + 2, args.end()));
+   }
+
+   std::cerr << "NGROM ERROR: Usage: ngrom index build <indexFile> <files...>" << std::endl
+             << "                    ngrom index query <indexFile> [field=value...]" << std::endl;
+   return 1;
+}
@@ -0,0 +1,58 @@
+// New GROM - ROM header index
+//
+// "ngrom index build" writes a compact index of every file's Genesis header
+// (all the fields --info shows) plus path, size, format, and content hash, as
+// fixed-size records.  "ngrom index query" memory-maps the index and filters
+// the records, so questions about a whole collection need no ROM file I/O.
+
+#ifndef NGROM_INDEX_H
+#define NGROM_INDEX_H
+
+#include<stdint.h>
+#include<string>
+#include<vector>
+
+namespace NGROM_NS
+{
+   // Index file layout: IndexFileHeader, then numRecords IndexRecords, then
+   // the string table (the paths; not NUL terminated).
+   struct IndexFileHeader
+   {
+      char magic[8];              // "NGROMIDX"
+      uint32_t version;
+      uint32_t recordSize;        // sizeof(IndexRecord)
+      uint64_t numRecords;
+      uint64_t stringTableOffset;
+      uint64_t stringTableSize;
+      unsigned char reserved[24];
+   };
+
+   struct IndexRecord
+   {
+      uint64_t pathOffset;        // Into the string table
+      uint32_t pathLength;
+      uint8_t format;             // RomFormat
+      uint8_t regionMask;         // REGION_* bits, from the countries field
+      uint16_t reserved1;
+      uint64_t fileSize;
+      int64_t mtimeSec;
+      uint32_t mtimeNsec;
+      uint32_t reserved2;
+      uint64_t inode;
+      uint64_t contentHash;
+      unsigned char header[256];  // ROM data 0x100-0x1FF (the Genesis header)
+      unsigned char reserved3[8];
+   };
+
+   // IndexRecord regionMask bits
+   static const uint8_t REGION_JAPAN  = 0x01;
+   static const uint8_t REGION_USA    = 0x02;
+   static const uint8_t REGION_EUROPE = 0x04;
+
+   // Decodes the header's countries field (ROM 0x1F0-0x1F2) into REGION_* bits.
+   uint8_t getRegionMask(const unsigned char* countries);
+
+   int runIndexCommand(const std::vector<std::string>& args);
+}
+
+#endif // NGROM_INDEX_H
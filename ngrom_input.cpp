@@ -0,0 +1,1490 @@
+// New GROM - Input files (plain, gzip, or zip archive members)
+
+#include "ngrom_input.h"
+#include "ngrom_hash.h"
+#include "ngrom_trace.h"
+#include<iostream> // for std::err
+#include<deque>
+#include<map>
+#include<memory>
+#include<mutex>
+#include<condition_variable>
+#include<thread>
+#include<errno.h>
+#include<string.h>
+#include<strings.h> // for strcasecmp
+#include<fcntl.h>   // for open, posix_fadvise
+#include<unistd.h>  // for pread, close
+#include<zlib.h>
+
+// Decompression pipeline sizes: compressed reads, and decompressed chunks
+// (at most MAX_QUEUED_CHUNKS of which are waiting for the reader).
+static const size_t INFLATE_IN_BYTES = 256 * 1024;
+static const size_t INFLATE_OUT_BYTES = 256 * 1024;
+static const size_t MAX_QUEUED_CHUNKS = 4;
+
+// zlib's inflate state and window (about)
+static const size_t INFLATE_STATE_BYTES = 48 * 1024;
+
+// Smallest gzip member (header and trailer), and deflate's largest expansion
+static const uint64_t GZIP_MIN_MEMBER_BYTES = 18;
+static const uint64_t GZIP_MAX_RATIO = 1032;
+
+// Zip record signatures and sizes
+static const uint32_t ZIP_LOCAL_HEADER_SIG = 0x04034b50;
+static const uint32_t ZIP_CENTRAL_HEADER_SIG = 0x02014b50;
+static const uint32_t ZIP_END_OF_DIR_SIG = 0x06054b50;
+static const size_t ZIP_LOCAL_HEADER_BYTES = 30;
+static const size_t ZIP_CENTRAL_HEADER_BYTES = 46;
+static const size_t ZIP_END_OF_DIR_BYTES = 22;
+static const size_t ZIP_MAX_COMMENT_BYTES = 65535;
+static const uint16_t ZIP_METHOD_STORED = 0;
+static const uint16_t ZIP_METHOD_DEFLATED = 8;
+
+namespace NGROM_NS
+{
+   // --------------------------------------------------------------------------
+   // Class: RangeInflater
+   // Description: Decompresses a gzip file (every member) or a deflated zip
+   //              member on the calling thread, for reads at any offset.  It
+   //              keeps its place (and the last two chunks), so reads at
+   //              increasing offsets decompress the data only once.
+   // --------------------------------------------------------------------------
+   class RangeInflater
+   {
+   public:
+      RangeInflater(int fd, const ZipMember& member, bool isGzip);
+      ~RangeInflater();
+
+      bool read(unsigned char* bytes, size_t numBytes, uint64_t offset);
+      bool total(uint64_t& totalBytes);
+
+      RangeInflater(const RangeInflater&) = delete;
+      RangeInflater& operator=(const RangeInflater&) = delete;
+
+   private:
+      bool restart();
+      bool nextChunk();
+
+      int m_fd;
+      ZipMember m_member;
+      bool m_isGzip;
+      z_stream m_zstream;
+      bool m_started;
+      bool m_streamEnd;
+
+      std::vector<unsigned char> m_inBytes;
+      uint64_t m_inOffset;
+      uint64_t m_inRemaining;
+
+      std::vector<unsigned char> m_prevChunk;
+      std::vector<unsigned char> m_chunk;
+      std::vector<unsigned char> m_spareChunk;
+      uint64_t m_chunkStart; // Offset of m_chunk (m_prevChunk is just before it)
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: Inflater
+   // Description: Decompresses a gzip file or a zip member on its own thread,
+   //              up to MAX_QUEUED_CHUNKS ahead of the reader.
+   // --------------------------------------------------------------------------
+   class Inflater
+   {
+   public:
+      Inflater(int fd, const ZipMember& member, bool isGzip);
+      ~Inflater();
+
+      void start() { m_thread = std::thread(&Inflater::produce, this); }
+      ssize_t read(char* buffer, size_t numBytes);
+      bool finish();
+      void dropCache();
+      bool readAt(unsigned char* bytes, size_t numBytes, uint64_t offset) const;
+      bool dataSize(uint64_t& numBytes) const;
+      uint64_t readAtBytes() const;
+
+      Inflater(const Inflater&) = delete;
+      Inflater& operator=(const Inflater&) = delete;
+
+   private:
+      void produce();
+      bool pushChunk(std::vector<unsigned char>& chunk);
+
+      int m_fd;
+      ZipMember m_member; // (For gzip: the whole file as one deflated "member".)
+      bool m_isGzip;
+      std::thread m_thread;
+
+      mutable std::unique_ptr<RangeInflater> m_rangeInflater; // For readAt (reader thread only)
+
+      std::mutex m_mutex;
+      std::condition_variable m_cond;
+      std::deque<std::vector<unsigned char> > m_chunks;
+      bool m_done;
+      bool m_failed;
+      bool m_cancelled;
+
+      std::vector<unsigned char> m_readChunk; // Chunk being read (reader thread only)
+      size_t m_readPos;
+   };
+}
+
+// Directory cache: each archive's central directory is read once per run.
+static std::mutex s_zipDirMutex;
+static std::map<std::string, std::shared_ptr<const std::vector<NGROM_NS::ZipMember> > > s_zipDirs;
+
+// -----------------------------------------------------------------------------
+// Function: getLE16 / getLE32
+// Description: Reads a little-endian value (zip and gzip fields).
+// -----------------------------------------------------------------------------
+static uint16_t getLE16(const unsigned char* bytes)
+{
+   return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static uint32_t getLE32(const unsigned char* bytes)
+{
+   return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+// -----------------------------------------------------------------------------
+// Function: preadFully
+// Description: Reads numBytes at the given offset.
+// Return: true if all bytes were read; false otherwise.
+// -----------------------------------------------------------------------------
+static bool preadFully(int fd, unsigned char* bytes, size_t numBytes, uint64_t offset)
+{
+   while (numBytes > 0)
+   {
+      ssize_t rc = pread(fd, bytes, numBytes, offset);
+      if (rc < 0)
+      {
+         if (errno == EINTR) { continue; }
+         return false;
+      }
+      if (rc == 0)
+      {
+         errno = EIO; // Shorter than expected
+         return false;
+      }
+      bytes += rc;
+      numBytes -= rc;
+      offset += rc;
+   }
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: readZipDirectory
+// Description: Reads the central directory of a zip archive (not zip64).
+// Return: true if read; false on any error (errno is set).
+// -----------------------------------------------------------------------------
+static bool readZipDirectory(int fd, std::vector<NGROM_NS::ZipMember>& members)
+{
+   struct stat zipStat;
+   if (0 != fstat(fd, &zipStat))
+   {
+      return false;
+   }
+
+   uint64_t zipSize = zipStat.st_size;
+   if (zipSize < ZIP_END_OF_DIR_BYTES)
+   {
+      errno = EINVAL;
+      return false;
+   }
+
+   // The end of directory record is last, followed only by the archive comment.
+   size_t tailSize = (zipSize < (ZIP_END_OF_DIR_BYTES + ZIP_MAX_COMMENT_BYTES)) ? zipSize : (ZIP_END_OF_DIR_BYTES + ZIP_MAX_COMMENT_BYTES);
+   std::vector<unsigned char> tailBytes(tailSize);
+   if (!preadFully(fd, tailBytes.data(), tailSize, zipSize - tailSize))
+   {
+      return false;
+   }
+
+   const unsigned char* endOfDir = NULL;
+   for (size_t pos = tailSize - ZIP_END_OF_DIR_BYTES + 1; pos-- > 0; )
+   {
+      if (getLE32(&tailBytes[pos]) == ZIP_END_OF_DIR_SIG)
+      {
+         endOfDir = &tailBytes[pos];
+         break;
+      }
+   }
+
+   if (endOfDir == NULL)
+   {
+      errno = EINVAL;
+      return false;
+   }
+
+   uint16_t numEntries = getLE16(endOfDir + 10);
+   uint32_t dirSize = getLE32(endOfDir + 12);
+   uint32_t dirOffset = getLE32(endOfDir + 16);
+
+   if ((numEntries == 0xFFFF) || (dirSize == 0xFFFFFFFF) || (dirOffset == 0xFFFFFFFF) ||
+       ((uint64_t)dirOffset + dirSize > zipSize))
+   {
+      errno = ENOTSUP; // zip64 (or corrupt)
+      return false;
+   }
+
+   std::vector<unsigned char> dirBytes(dirSize);
+   if (!preadFully(fd, dirBytes.data(), dirSize, dirOffset))
+   {
+      return false;
+   }
+
+   members.clear();
+   size_t pos = 0;
+   for (uint16_t i = 0; i < numEntries; i++)
+   {
+      if ((pos + ZIP_CENTRAL_HEADER_BYTES > dirSize) || (getLE32(&dirBytes[pos]) != ZIP_CENTRAL_HEADER_SIG))
+      {
+         errno = EINVAL;
+         return false;
+      }
+
+      const unsigned char* entry = &dirBytes[pos];
+      uint16_t nameLength = getLE16(entry + 28);
+      uint16_t extraLength = getLE16(entry + 30);
+      uint16_t commentLength = getLE16(entry + 32);
+
+      if (pos + ZIP_CENTRAL_HEADER_BYTES + nameLength > dirSize)
+      {
+         errno = EINVAL;
+         return false;
+      }
+
+      NGROM_NS::ZipMember member;
+      member.name.assign(reinterpret_cast<const char*>(entry + ZIP_CENTRAL_HEADER_BYTES), nameLength);
+      member.method = getLE16(entry + 10);
+      member.crc32 = getLE32(entry + 16);
+      member.compressedSize = getLE32(entry + 20);
+      member.uncompressedSize = getLE32(entry + 24);
+      member.localHeaderOffset = getLE32(entry + 42);
+      members.push_back(member);
+
+      pos += ZIP_CENTRAL_HEADER_BYTES + nameLength + extraLength + commentLength;
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getZipDirectory
+// Description: Gets an archive's central directory (read on first use).
+// Return: The members, or NULL on error (errno is set).
+// -----------------------------------------------------------------------------
+static std::shared_ptr<const std::vector<NGROM_NS::ZipMember> > getZipDirectory(const std::string& archivePath)
+{
+   std::lock_guard<std::mutex> lock(s_zipDirMutex);
+
+   std::map<std::string, std::shared_ptr<const std::vector<NGROM_NS::ZipMember> > >::const_iterator iter = s_zipDirs.find(archivePath);
+   if (iter != s_zipDirs.end())
+   {
+      return iter->second;
+   }
+
+   int fd = open(archivePath.c_str(), O_RDONLY | O_CLOEXEC);
+   if (fd < 0)
+   {
+      return NULL;
+   }
+
+   std::shared_ptr<std::vector<NGROM_NS::ZipMember> > members = std::make_shared<std::vector<NGROM_NS::ZipMember> >();
+   bool rc = readZipDirectory(fd, *members);
+   int saved_errno = errno;
+   close(fd);
+
+   if (!rc)
+   {
+      errno = saved_errno;
+      return NULL;
+   }
+
+   s_zipDirs[archivePath] = members;
+   return members;
+}
+
+// -----------------------------------------------------------------------------
+// Function: splitZipMemberPath
+// Description: Splits "<archive>/<member>" at the (regular) archive file.
+// Return: true if the path names a file inside an existing file.
+// -----------------------------------------------------------------------------
+static bool splitZipMemberPath(const std::string& path, std::string& archivePath, std::string& memberName)
+{
+   for (size_t slashPos = path.find('/', 1); slashPos != std::string::npos; slashPos = path.find('/', slashPos + 1))
+   {
+      struct stat prefixStat;
+      std::string prefix = path.substr(0, slashPos);
+      if (0 != stat(prefix.c_str(), &prefixStat))
+      {
+         return false;
+      }
+
+      if (S_ISREG(prefixStat.st_mode))
+      {
+         archivePath = prefix;
+         memberName = path.substr(slashPos + 1);
+         return true;
+      }
+   }
+
+   return false;
+}
+
+// -----------------------------------------------------------------------------
+// Function: RangeInflater::RangeInflater
+// Description: Constructor.  The fd is not owned.
+// -----------------------------------------------------------------------------
+NGROM_NS::RangeInflater::RangeInflater(int fd, const ZipMember& member, bool isGzip)
+ : m_fd(fd),
+   m_member(member),
+   m_isGzip(isGzip),
+   m_started(false),
+   m_streamEnd(false),
+   m_inOffset(0),
+   m_inRemaining(0),
+   m_chunkStart(0)
+{
+   memset(&m_zstream, 0, sizeof(m_zstream));
+}
+
+// -----------------------------------------------------------------------------
+// Function: RangeInflater::~RangeInflater
+// Description: Destructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::RangeInflater::~RangeInflater()
+{
+   if (m_started)
+   {
+      inflateEnd(&m_zstream);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: RangeInflater::restart
+// Description: Goes back to the start of the data.
+// Return: true if restarted; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::RangeInflater::restart()
+{
+   if (m_started)
+   {
+      inflateEnd(&m_zstream);
+      m_started = false;
+   }
+
+   memset(&m_zstream, 0, sizeof(m_zstream));
+   if (Z_OK != inflateInit2(&m_zstream, m_isGzip ? (MAX_WBITS + 16) : -MAX_WBITS))
+   {
+      errno = ENOMEM;
+      return false;
+   }
+
+   m_started = true;
+   m_streamEnd = false;
+   m_inBytes.resize(INFLATE_IN_BYTES);
+   m_inOffset = m_member.localHeaderOffset;
+   m_inRemaining = m_member.compressedSize;
+   m_prevChunk.clear();
+   m_chunk.clear();
+   m_chunkStart = 0;
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: RangeInflater::nextChunk
+// Description: Decompresses the next chunk; the one before it is kept.
+// Return: true if decompressed (or at the end); false on a read or
+//         decompression error (errno is set; a restart is needed).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::RangeInflater::nextChunk()
+{
+   m_spareChunk.resize(INFLATE_OUT_BYTES);
+   m_zstream.next_out = m_spareChunk.data();
+   m_zstream.avail_out = INFLATE_OUT_BYTES;
+
+   while (!m_streamEnd && (m_zstream.avail_out > 0))
+   {
+      if ((m_zstream.avail_in == 0) && (m_inRemaining > 0))
+      {
+         size_t numRead = (m_inRemaining < INFLATE_IN_BYTES) ? m_inRemaining : INFLATE_IN_BYTES;
+         if (!preadFully(m_fd, m_inBytes.data(), numRead, m_inOffset))
+         {
+            inflateEnd(&m_zstream);
+            m_started = false;
+            return false;
+         }
+         m_inOffset += numRead;
+         m_inRemaining -= numRead;
+         m_zstream.next_in = m_inBytes.data();
+         m_zstream.avail_in = numRead;
+      }
+
+      int rc = inflate(&m_zstream, Z_NO_FLUSH);
+      if (rc == Z_STREAM_END)
+      {
+         // (A gzip file may hold several concatenated members.)
+         if (m_isGzip && ((m_zstream.avail_in > 0) || (m_inRemaining > 0)))
+         {
+            rc = inflateReset(&m_zstream);
+         }
+         else
+         {
+            m_streamEnd = true;
+            rc = Z_OK;
+         }
+      }
+
+      if ((rc != Z_OK) && !((rc == Z_BUF_ERROR) && (m_inRemaining > 0)))
+      {
+         inflateEnd(&m_zstream);
+         m_started = false;
+         errno = EIO; // Corrupt or truncated data
+         return false;
+      }
+   }
+
+   m_spareChunk.resize(INFLATE_OUT_BYTES - m_zstream.avail_out);
+   if (!m_spareChunk.empty())
+   {
+      m_chunkStart += m_chunk.size();
+      m_prevChunk.swap(m_chunk);
+      m_chunk.swap(m_spareChunk);
+   }
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: RangeInflater::read
+// Description: Copies the decompressed bytes at [offset, offset + numBytes)
+//              to bytes, going on from the last read: only an offset before
+//              the last two chunks decompressed takes starting over.
+// Return: true if the range was copied; false on a read or decompression
+//         error, or a range past the end (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::RangeInflater::read(unsigned char* bytes, size_t numBytes, uint64_t offset)
+{
+   if ((!m_started || (offset < m_chunkStart - m_prevChunk.size())) && !restart())
+   {
+      return false;
+   }
+
+   size_t numCopied = 0;
+   for (;;)
+   {
+      const std::vector<unsigned char>* chunks[2] = { &m_prevChunk, &m_chunk };
+      uint64_t chunkStart = m_chunkStart - m_prevChunk.size();
+      for (const std::vector<unsigned char>* chunk : chunks)
+      {
+         uint64_t position = offset + numCopied;
+         if ((numCopied < numBytes) && (position >= chunkStart) && (position < chunkStart + chunk->size()))
+         {
+            size_t count = (chunkStart + chunk->size()) - position;
+            if (count > numBytes - numCopied)
+            {
+               count = numBytes - numCopied;
+            }
+            memcpy(bytes + numCopied, chunk->data() + (position - chunkStart), count);
+            numCopied += count;
+         }
+         chunkStart += chunk->size();
+      }
+
+      if (numCopied == numBytes)
+      {
+         return true;
+      }
+
+      if (m_streamEnd)
+      {
+         errno = EIO; // Range past the end
+         return false;
+      }
+
+      if (!nextChunk())
+      {
+         return false;
+      }
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: RangeInflater::total
+// Description: Decompresses (from the last read) to the end.
+// Return: true if the total (decompressed) size was found; false on a read or
+//         decompression error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::RangeInflater::total(uint64_t& totalBytes)
+{
+   if (!m_started && !restart())
+   {
+      return false;
+   }
+
+   while (!m_streamEnd)
+   {
+      if (!nextChunk())
+      {
+         return false;
+      }
+   }
+
+   totalBytes = m_chunkStart + m_chunk.size();
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: mayHoldGzipMembers
+// Description: Checks whether a gzip file may hold more than one member, by
+//              looking for another member's header (1F 8B 08, flags with the
+//              reserved bits clear) after the first; some are just compressed
+//              data, but one can't be missed.
+// Return: true if one is found, or on a read error.
+// -----------------------------------------------------------------------------
+static bool mayHoldGzipMembers(int fd, uint64_t fileSize)
+{
+   // (A member takes at least GZIP_MIN_MEMBER_BYTES.)
+   std::vector<unsigned char> bytes(INFLATE_IN_BYTES);
+   uint64_t offset = GZIP_MIN_MEMBER_BYTES;
+   uint64_t endOffset = fileSize - GZIP_MIN_MEMBER_BYTES + 4; // (End of the last possible header's 4 bytes.)
+
+   while (offset + 4 <= endOffset)
+   {
+      size_t numBytes = ((endOffset - offset) < INFLATE_IN_BYTES) ? (endOffset - offset) : INFLATE_IN_BYTES;
+      if (!preadFully(fd, bytes.data(), numBytes, offset))
+      {
+         return true;
+      }
+
+      const unsigned char* end = bytes.data() + numBytes - 3;
+      for (const unsigned char* pos = bytes.data();
+           (pos < end) && (NULL != (pos = (const unsigned char*)memchr(pos, 0x1F, end - pos)));
+           pos++)
+      {
+         if ((pos[1] == 0x8B) && (pos[2] == 0x08) && ((pos[3] & 0xE0) == 0))
+         {
+            return true;
+         }
+      }
+
+      // (The next read overlaps this one by a header's 4 bytes, less one.)
+      offset += numBytes - 3;
+   }
+
+   return false;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getGzipDataSize
+// Description: Gets the decompressed size of a gzip file.  The trailer only
+//              has the last member's size, mod 2^32, so it's taken only for a
+//              file with one member that can't reach 4 GB (deflate expands
+//              at most GZIP_MAX_RATIO:1); any other file is decompressed to
+//              count it.
+// Return: true if found; false on a read or decompression error (errno is
+//         set).
+// -----------------------------------------------------------------------------
+static bool getGzipDataSize(int fd, uint64_t fileSize, uint64_t& dataSize)
+{
+   unsigned char sizeBytes[4];
+   if ((fileSize >= GZIP_MIN_MEMBER_BYTES) && (fileSize < (1ULL << 32) / GZIP_MAX_RATIO) &&
+       !mayHoldGzipMembers(fd, fileSize))
+   {
+      if (!preadFully(fd, sizeBytes, 4, fileSize - 4))
+      {
+         return false;
+      }
+      dataSize = getLE32(sizeBytes);
+      return true;
+   }
+
+   NGROM_NS::ZipMember gzipData;
+   gzipData.method = ZIP_METHOD_DEFLATED;
+   gzipData.crc32 = 0;
+   gzipData.compressedSize = fileSize;
+   gzipData.uncompressedSize = 0;
+   gzipData.localHeaderOffset = 0;
+
+   NGROM_NS::TraceSpan sizeSpan("size gzip", "cpu");
+   NGROM_NS::RangeInflater rangeInflater(fd, gzipData, true);
+   return rangeInflater.total(dataSize);
+}
+
+// -----------------------------------------------------------------------------
+// Function: Inflater::Inflater
+// Description: Constructor.  The fd is owned (closed) by the Inflater.
+// -----------------------------------------------------------------------------
+NGROM_NS::Inflater::Inflater(int fd, const ZipMember& member, bool isGzip)
+ : m_fd(fd),
+   m_member(member),
+   m_isGzip(isGzip),
+   m_done(false),
+   m_failed(false),
+   m_cancelled(false),
+   m_readPos(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: Inflater::~Inflater
+// Description: Destructor; stops the decompression thread if the reader
+//              stopped early.
+// -----------------------------------------------------------------------------
+NGROM_NS::Inflater::~Inflater()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_cancelled = true;
+      m_cond.notify_all();
+   }
+
+   if (m_thread.joinable())
+   {
+      m_thread.join();
+   }
+
+   close(m_fd);
+}
+
+// -----------------------------------------------------------------------------
+// Function: Inflater::dropCache
+// Description: Drops the compressed data read from the page cache (only the
+//              member's part of a zip archive).
+// -----------------------------------------------------------------------------
+void NGROM_NS::Inflater::dropCache()
+{
+   posix_fadvise(m_fd, m_member.localHeaderOffset, m_member.compressedSize, POSIX_FADV_DONTNEED);
+}
+
+// -----------------------------------------------------------------------------
+// Function: Inflater::readAt
+// Description: Reads decompressed bytes at any offset, apart from the stream
+//              (decompressing them on the calling thread; see RangeInflater).
+// Return: true if read; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Inflater::readAt(unsigned char* bytes, size_t numBytes, uint64_t offset) const
+{
+   if (!m_isGzip && (m_member.method == ZIP_METHOD_STORED))
+   {
+      // (Stored data is just read where it is.)
+      if (offset + numBytes > m_member.compressedSize)
+      {
+         errno = EIO;
+         return false;
+      }
+      return preadFully(m_fd, bytes, numBytes, m_member.localHeaderOffset + offset);
+   }
+
+   if (!m_rangeInflater)
+   {
+      m_rangeInflater.reset(new RangeInflater(m_fd, m_member, m_isGzip));
+   }
+   return m_rangeInflater->read(bytes, numBytes, offset);
+}
+
+// -----------------------------------------------------------------------------
+// Function: Inflater::dataSize
+// Description: Gets the decompressed size (for gzip, see getGzipDataSize).
+// Return: true if found; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Inflater::dataSize(uint64_t& numBytes) const
+{
+   if (!m_isGzip)
+   {
+      numBytes = m_member.uncompressedSize;
+      return true;
+   }
+
+   return getGzipDataSize(m_fd, m_member.compressedSize, numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: Inflater::readAtBytes
+// Description: Gets the memory held for readAt (once it's been used).
+// -----------------------------------------------------------------------------
+uint64_t NGROM_NS::Inflater::readAtBytes() const
+{
+   return m_rangeInflater ? (INFLATE_IN_BYTES + INFLATE_STATE_BYTES + (3 * INFLATE_OUT_BYTES)) : 0;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Inflater::pushChunk
+// Description: Hands a decompressed chunk to the reader, waiting while the
+//              reader is MAX_QUEUED_CHUNKS behind.
+// Return: false if the reader has gone away.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Inflater::pushChunk(std::vector<unsigned char>& chunk)
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+   m_cond.wait(lock, [this] { return (m_chunks.size() < MAX_QUEUED_CHUNKS) || m_cancelled; });
+   if (m_cancelled)
+   {
+      return false;
+   }
+
+   m_chunks.push_back(std::vector<unsigned char>());
+   m_chunks.back().swap(chunk);
+   m_cond.notify_all();
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Inflater::produce
+// Description: Thread body: reads and decompresses the data, then verifies
+//              its size (and, for zip members, its CRC; zlib checks gzip's).
+// -----------------------------------------------------------------------------
+void NGROM_NS::Inflater::produce()
+{
+   z_stream zstream;
+   memset(&zstream, 0, sizeof(zstream));
+
+   bool stored = !m_isGzip && (m_member.method == ZIP_METHOD_STORED);
+   bool ok = stored || (Z_OK == inflateInit2(&zstream, m_isGzip ? (MAX_WBITS + 16) : -MAX_WBITS));
+
+   std::vector<unsigned char> inBytes(INFLATE_IN_BYTES);
+   uint64_t inOffset = m_member.localHeaderOffset; // (Start of the data, here.)
+   uint64_t inRemaining = m_member.compressedSize;
+   uLong crc = crc32(0L, Z_NULL, 0);
+   uint64_t outTotal = 0;
+   bool streamEnd = false;
+
+   while (ok && !streamEnd)
+   {
+      // Refill the input
+      if ((stored || (zstream.avail_in == 0)) && (inRemaining > 0))
+      {
+         size_t numBytes = (inRemaining < INFLATE_IN_BYTES) ? inRemaining : INFLATE_IN_BYTES;
+         if (!preadFully(m_fd, inBytes.data(), numBytes, inOffset))
+         {
+            ok = false;
+            break;
+         }
+         inOffset += numBytes;
+         inRemaining -= numBytes;
+         zstream.next_in = inBytes.data();
+         zstream.avail_in = numBytes;
+      }
+
+      std::vector<unsigned char> outChunk;
+
+      if (stored)
+      {
+         outChunk.assign(zstream.next_in, zstream.next_in + zstream.avail_in);
+         zstream.avail_in = 0;
+         streamEnd = (inRemaining == 0);
+      }
+      else
+      {
+         outChunk.resize(INFLATE_OUT_BYTES);
+         zstream.next_out = outChunk.data();
+         zstream.avail_out = INFLATE_OUT_BYTES;
+
+         NGROM_NS::TraceSpan inflateSpan("inflate chunk", "cpu");
+         int rc = inflate(&zstream, Z_NO_FLUSH);
+         inflateSpan.end();
+         outChunk.resize(INFLATE_OUT_BYTES - zstream.avail_out);
+
+         if (rc == Z_STREAM_END)
+         {
+            // (A gzip file may hold several concatenated members.)
+            if (m_isGzip && ((zstream.avail_in > 0) || (inRemaining > 0)))
+            {
+               ok = (Z_OK == inflateReset(&zstream));
+            }
+            else
+            {
+               streamEnd = true;
+            }
+         }
+         else if ((rc != Z_OK) && !((rc == Z_BUF_ERROR) && (inRemaining > 0)))
+         {
+            ok = false; // Corrupt or truncated data
+         }
+      }
+
+      if (!outChunk.empty())
+      {
+         crc = crc32(crc, outChunk.data(), outChunk.size());
+         outTotal += outChunk.size();
+         if (ok && !pushChunk(outChunk))
+         {
+            ok = false;
+         }
+      }
+   }
+
+   if (!stored)
+   {
+      inflateEnd(&zstream);
+   }
+
+   if (ok && !m_isGzip)
+   {
+      // (zlib checks each gzip member's own CRC and size.)
+      ok = (outTotal == m_member.uncompressedSize) && (crc == m_member.crc32);
+   }
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_done = true;
+   m_failed = !ok;
+   m_cond.notify_all();
+}
+
+// -----------------------------------------------------------------------------
+// Function: Inflater::read
+// Description: Reads decompressed data (the FILE* stream's read function).
+// Return: Number of bytes read (0 at the end), or -1 on a decompression error.
+// -----------------------------------------------------------------------------
+ssize_t NGROM_NS::Inflater::read(char* buffer, size_t numBytes)
+{
+   while (m_readPos >= m_readChunk.size())
+   {
+      // (Waiting here means decompression is behind.)
+      NGROM_NS::TraceSpan waitSpan("wait for inflate", "wait");
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this] { return !m_chunks.empty() || m_done; });
+      waitSpan.end();
+
+      if (m_chunks.empty())
+      {
+         if (m_failed)
+         {
+            errno = EIO;
+            return -1;
+         }
+         return 0;
+      }
+
+      m_readChunk.swap(m_chunks.front());
+      m_chunks.pop_front();
+      m_readPos = 0;
+      m_cond.notify_all();
+   }
+
+   size_t numCopied = m_readChunk.size() - m_readPos;
+   if (numCopied > numBytes)
+   {
+      numCopied = numBytes;
+   }
+   memcpy(buffer, m_readChunk.data() + m_readPos, numCopied);
+   m_readPos += numCopied;
+
+   return numCopied;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Inflater::finish
+// Description: Waits for the decompression to end.
+// Return: true if all data decompressed and verified; false otherwise.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Inflater::finish()
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+   m_cond.wait(lock, [this] { return m_done || (m_chunks.size() >= MAX_QUEUED_CHUNKS); });
+   return m_done && !m_failed;
+}
+
+// -----------------------------------------------------------------------------
+// Function: inflaterRead
+// Description: fopencookie read function.
+// -----------------------------------------------------------------------------
+static ssize_t inflaterRead(void* cookie, char* buffer, size_t numBytes)
+{
+   return static_cast<NGROM_NS::Inflater*>(cookie)->read(buffer, numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::InputFile
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::InputFile::InputFile()
+ : m_file(NULL),
+   m_size(0),
+   m_sizeKnown(false),
+   m_inflater(NULL),
+   m_fd(-1)
+{
+   memset(&m_fileStat, 0, sizeof(m_fileStat));
+   memset(&m_contentStat, 0, sizeof(m_contentStat));
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::~InputFile
+// Description: Destructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::InputFile::~InputFile()
+{
+   close();
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::startInflater
+// Description: Starts decompressing (takes ownership of fd).
+// Return: true if started; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::InputFile::startInflater(int fd, const ZipMember& member, bool isGzip)
+{
+   m_inflater = new Inflater(fd, member, isGzip);
+
+   cookie_io_functions_t cookieFunctions;
+   memset(&cookieFunctions, 0, sizeof(cookieFunctions));
+   cookieFunctions.read = inflaterRead;
+
+   m_file = fopencookie(m_inflater, "r", cookieFunctions);
+   if (m_file == NULL)
+   {
+      int saved_errno = errno;
+      delete m_inflater;
+      m_inflater = NULL;
+      errno = saved_errno;
+      return false;
+   }
+
+   m_size = member.uncompressedSize;
+   m_sizeKnown = !isGzip;
+   m_inflater->start();
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: findZipMember
+// Description: Looks up a file in a zip archive's central directory.
+// Return: true if found (and supported); false on error (errno is set).
+// -----------------------------------------------------------------------------
+static bool findZipMember(const std::string& archivePath, const std::string& memberName, NGROM_NS::ZipMember& member)
+{
+   std::shared_ptr<const std::vector<NGROM_NS::ZipMember> > members = getZipDirectory(archivePath);
+   if (!members)
+   {
+      return false;
+   }
+
+   for (const NGROM_NS::ZipMember& candidate : *members)
+   {
+      if (candidate.name == memberName)
+      {
+         if ((candidate.method != ZIP_METHOD_STORED) && (candidate.method != ZIP_METHOD_DEFLATED))
+         {
+            errno = ENOTSUP;
+            return false;
+         }
+
+         member = candidate;
+         return true;
+      }
+   }
+
+   errno = ENOENT;
+   return false;
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::openZipMember
+// Description: Opens a file inside a zip archive, given the open archive (fd
+//              is taken over; closed on error) and the file's central
+//              directory record.
+// Return: true if opened; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::InputFile::openZipMember(int fd, const ZipMember& member)
+{
+   // The data follows the local header (whose name/extra lengths may differ
+   // from the central directory's).
+   unsigned char localHeader[ZIP_LOCAL_HEADER_BYTES];
+   if (!preadFully(fd, localHeader, ZIP_LOCAL_HEADER_BYTES, member.localHeaderOffset) ||
+       (getLE32(localHeader) != ZIP_LOCAL_HEADER_SIG))
+   {
+      ::close(fd);
+      errno = EINVAL;
+      return false;
+   }
+
+   ZipMember dataMember = member;
+   dataMember.localHeaderOffset += ZIP_LOCAL_HEADER_BYTES + getLE16(localHeader + 26) + getLE16(localHeader + 28);
+
+   return startInflater(fd, dataMember, false);
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::open
+// Description: Opens an input: a plain file, a gzip file, or "<archive>/
+//              <member>" for a file inside a zip archive.
+// Return: true if opened; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::InputFile::open(const std::string& filename)
+{
+   return openFile(filename) && openContents();
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::openFile
+// Description: First step of open(): opens the file (for a zip member, its
+//              archive, and looks the member up in the central directory) and
+//              gets its fileStat() and contentStat(); nothing else is read yet.
+// Return: true if opened; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::InputFile::openFile(const std::string& filename)
+{
+   close();
+
+   m_fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+   if (m_fd < 0)
+   {
+      if ((errno != ENOTDIR) || !splitZipMemberPath(filename, m_archivePath, m_memberName))
+      {
+         return false;
+      }
+
+      m_fd = ::open(m_archivePath.c_str(), O_RDONLY | O_CLOEXEC);
+      if (m_fd < 0)
+      {
+         return false;
+      }
+   }
+
+   if ((0 != fstat(m_fd, &m_fileStat)) ||
+       (!m_memberName.empty() && !findZipMember(m_archivePath, m_memberName, m_member)))
+   {
+      int saved_errno = errno;
+      close();
+      errno = saved_errno;
+      return false;
+   }
+
+   m_contentStat = m_fileStat;
+   if (!m_memberName.empty())
+   {
+      // (The archive's own metadata changes with any of its members.)
+      m_contentStat.st_ino = 0;
+      m_contentStat.st_size = m_member.uncompressedSize;
+      m_contentStat.st_mtim.tv_sec = m_member.crc32;
+      m_contentStat.st_mtim.tv_nsec = 0;
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::openContents
+// Description: Second step of open() (after openFile): gets the input's
+//              (decompressed) size and makes file() ready to read.
+// Return: true if opened; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::InputFile::openContents()
+{
+   int fd = m_fd;
+   m_fd = -1;
+
+   if (fd < 0)
+   {
+      errno = EBADF;
+      return false;
+   }
+
+   if (!m_memberName.empty())
+   {
+      return openZipMember(fd, m_member);
+   }
+
+   unsigned char magicBytes[2];
+   if (((uint64_t)m_fileStat.st_size >= GZIP_MIN_MEMBER_BYTES) &&
+       (2 == pread(fd, magicBytes, 2, 0)) && (magicBytes[0] == 0x1F) && (magicBytes[1] == 0x8B))
+   {
+      // gzip: the (uncompressed) size is only found when asked for (size()).
+      ZipMember gzipData;
+      gzipData.method = ZIP_METHOD_DEFLATED;
+      gzipData.crc32 = 0;
+      gzipData.compressedSize = m_fileStat.st_size;
+      gzipData.uncompressedSize = 0;
+      gzipData.localHeaderOffset = 0;
+
+      return startInflater(fd, gzipData, true);
+   }
+
+   m_file = fdopen(fd, "r");
+   if (m_file == NULL)
+   {
+      int saved_errno = errno;
+      ::close(fd);
+      errno = saved_errno;
+      return false;
+   }
+
+   m_size = m_fileStat.st_size;
+   m_sizeKnown = true;
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::openFd
+// Description: Opens an already open plain (uncompressed) file; fd is taken
+//              over (closed on error).
+// Return: true if opened; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::InputFile::openFd(int fd)
+{
+   close();
+
+   m_file = (0 == fstat(fd, &m_fileStat)) ? fdopen(fd, "r") : NULL;
+   if (m_file == NULL)
+   {
+      int saved_errno = errno;
+      ::close(fd);
+      errno = saved_errno;
+      return false;
+   }
+
+   m_contentStat = m_fileStat;
+
+   m_size = m_fileStat.st_size;
+   m_sizeKnown = true;
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::size
+// Description: Gets the input's size; for a gzip input, its decompressed size
+//              is found on the first call (see getGzipDataSize).
+// Return: Size in bytes; 0 if it could not be found (errno is set).
+// -----------------------------------------------------------------------------
+uint64_t NGROM_NS::InputFile::size() const
+{
+   if (!m_sizeKnown && (m_inflater != NULL))
+   {
+      m_sizeKnown = m_inflater->dataSize(m_size);
+   }
+
+   return m_size;
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::readAt
+// Description: Reads (decompressed) bytes at any offset, without moving the
+//              stream (file()); for a compressed input, that takes
+//              decompressing up to them again, so it's for a few bytes, once.
+// Return: true if all bytes were read; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::InputFile::readAt(unsigned char* bytes, size_t numBytes, uint64_t offset) const
+{
+   if (m_inflater != NULL)
+   {
+      return m_inflater->readAt(bytes, numBytes, offset);
+   }
+
+   if (m_file == NULL)
+   {
+      errno = EBADF;
+      return false;
+   }
+
+   return preadFully(fileno(m_file), bytes, numBytes, offset);
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::finish
+// Description: For a compressed input, reads (and drops) any data not yet
+//              read, and waits for the decompressed data to be verified.
+// Return: true if the input is good; false if it failed to decompress or
+//         did not match its recorded size or CRC.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::InputFile::finish()
+{
+   if ((m_file == NULL) || (m_inflater == NULL))
+   {
+      return true;
+   }
+
+   char discardBytes[4096];
+   while (fread(discardBytes, 1, sizeof(discardBytes), m_file) > 0)
+   {
+   }
+
+   return (ferror(m_file) == 0) && m_inflater->finish();
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::dropCache
+// Description: Drops the input's data from the page cache (once it's read).
+// -----------------------------------------------------------------------------
+void NGROM_NS::InputFile::dropCache()
+{
+   if (m_inflater != NULL)
+   {
+      m_inflater->dropCache();
+   }
+   else if (m_file != NULL)
+   {
+      posix_fadvise(fileno(m_file), 0, 0, POSIX_FADV_DONTNEED);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::bufferBytes
+// Description: Gets the most memory the open input's buffers can hold: the
+//              stream buffer, plus, for compressed inputs, the decompression
+//              thread's input buffer, its queued chunks, and the chunks being
+//              filled and read, and what readAt holds.
+// -----------------------------------------------------------------------------
+uint64_t NGROM_NS::InputFile::bufferBytes() const
+{
+   uint64_t numBytes = BUFSIZ;
+
+   if (m_inflater != NULL)
+   {
+      numBytes += INFLATE_IN_BYTES + INFLATE_STATE_BYTES + ((MAX_QUEUED_CHUNKS + 2) * INFLATE_OUT_BYTES) +
+                  m_inflater->readAtBytes();
+   }
+
+   return numBytes;
+}
+
+// -----------------------------------------------------------------------------
+// Function: InputFile::close
+// Description: Closes the input (stopping any decompression still running).
+// -----------------------------------------------------------------------------
+void NGROM_NS::InputFile::close()
+{
+   if (m_file != NULL)
+   {
+      fclose(m_file);
+      m_file = NULL;
+   }
+
+   if (m_fd >= 0)
+   {
+      ::close(m_fd);
+      m_fd = -1;
+   }
+
+   delete m_inflater;
+   m_inflater = NULL;
+   m_size = 0;
+   m_sizeKnown = false;
+   m_archivePath.clear();
+   m_memberName.clear();
+}
+
+// -----------------------------------------------------------------------------
+// Function: isZipFilename
+// Description: Checks for the .zip extension (case-insensitive).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::isZipFilename(const std::string& filename)
+{
+   return (filename.length() > 4) && (0 == strcasecmp(filename.c_str() + filename.length() - 4, ".zip"));
+}
+
+// -----------------------------------------------------------------------------
+// Function: addInputFile
+// Description: Appends an input to the list: the file itself, or for a zip
+//              archive, "<archive>/<member>" for each file inside it.
+// Return: true if added; false if a zip archive could not be read.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::addInputFile(const std::string& filename, std::vector<std::string>& inputList)
+{
+   if (!isZipFilename(filename))
+   {
+      inputList.push_back(filename);
+      return true;
+   }
+
+   std::shared_ptr<const std::vector<ZipMember> > members = getZipDirectory(filename);
+   if (!members)
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to read zip archive " << filename << "... " << strerror(saved_errno) << std::endl;
+      return false;
+   }
+
+   for (const ZipMember& member : *members)
+   {
+      if (!member.name.empty() && (member.name.back() != '/'))
+      {
+         inputList.push_back(filename + "/" + member.name);
+      }
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getRelativeInputPath
+// Description: Gets an input's path relative to the (longest) root directory
+//              it was found under, or, for an input given directly, its file
+//              name (a zip member's: its archive's file name, "/", and the
+//              member name).  It's the same wherever the files are mounted.
+// -----------------------------------------------------------------------------
+std::string NGROM_NS::getRelativeInputPath(const std::string& filename, const std::vector<std::string>& rootDirs)
+{
+   size_t relativeStart = 0;
+
+   for (const std::string& rootDir : rootDirs)
+   {
+      std::string prefix = rootDir;
+      while ((prefix.length() > 1) && (prefix[prefix.length() - 1] == '/'))
+      {
+         prefix.erase(prefix.length() - 1);
+      }
+      if (prefix != "/")
+      {
+         prefix += '/';
+      }
+
+      if ((filename.compare(0, prefix.length(), prefix) == 0) && (prefix.length() > relativeStart))
+      {
+         relativeStart = prefix.length();
+      }
+   }
+
+   if (relativeStart == 0)
+   {
+      struct stat fileStat;
+      std::string archivePath;
+      std::string memberName;
+      std::string filePath = filename;
+      if ((0 != stat(filename.c_str(), &fileStat)) && (errno == ENOTDIR) &&
+          splitZipMemberPath(filename, archivePath, memberName))
+      {
+         filePath = archivePath;
+      }
+
+      size_t slashPos = filePath.rfind('/');
+      relativeStart = (slashPos == std::string::npos) ? 0 : (slashPos + 1);
+   }
+
+   while ((relativeStart < filename.length()) && (filename[relativeStart] == '/'))
+   {
+      relativeStart++;
+   }
+
+   return filename.substr(relativeStart);
+}
+
+// -----------------------------------------------------------------------------
+// Function: getInputDataSize
+// Description: Gets the size of an input's (decompressed) data: a zip
+//              member's from the archive's directory, a gzip file's the same
+//              way as a conversion (getGzipDataSize), a plain file's from
+//              stat.
+// Return: Size in bytes, or 0 if the input can't be read.
+// -----------------------------------------------------------------------------
+uint64_t NGROM_NS::getInputDataSize(const std::string& filename)
+{
+   int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+   if (fd < 0)
+   {
+      std::string archivePath;
+      std::string memberName;
+      std::shared_ptr<const std::vector<ZipMember> > members;
+      if ((errno == ENOTDIR) && splitZipMemberPath(filename, archivePath, memberName) &&
+          (members = getZipDirectory(archivePath)))
+      {
+         for (const ZipMember& member : *members)
+         {
+            if (member.name == memberName)
+            {
+               return member.uncompressedSize;
+            }
+         }
+      }
+      return 0;
+   }
+
+   uint64_t retval = 0;
+   struct stat fileStat;
+   unsigned char magicBytes[2];
+   if (0 == fstat(fd, &fileStat))
+   {
+      retval = fileStat.st_size;
+      if (((uint64_t)fileStat.st_size >= GZIP_MIN_MEMBER_BYTES) &&
+          preadFully(fd, magicBytes, 2, 0) && (magicBytes[0] == 0x1F) && (magicBytes[1] == 0x8B) &&
+          !getGzipDataSize(fd, fileStat.st_size, retval))
+      {
+         retval = 0;
+      }
+   }
+
+   ::close(fd);
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: hashInput
+// Description: Hashes the full (decompressed) contents of an input.
+// Return: true if hashed; false on any I/O or decompression error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::hashInput(const std::string& filename, uint64_t& hashValue)
+{
+   InputFile input;
+   if (!input.open(filename))
+   {
+      return false;
+   }
+
+   ContentHasher hasher;
+   std::vector<unsigned char> chunkBytes(INFLATE_OUT_BYTES);
+   size_t numBytesRead;
+
+   while ((numBytesRead = fread(chunkBytes.data(), 1, chunkBytes.size(), input.file())) > 0)
+   {
+      hasher.update(chunkBytes.data(), numBytesRead);
+   }
+
+   bool retval = (ferror(input.file()) == 0);
+   if (retval && !input.finish())
+   {
+      errno = EIO;
+      retval = false;
+   }
+
+   hashValue = hasher.digest();
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: compareInputs
+// Description: Compares the full (decompressed) contents of two inputs, byte
+//              for byte.
+// Return: true if compared (same is set); false on any I/O or decompression
+//         error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::compareInputs(const std::string& filename1, const std::string& filename2, bool& same)
+{
+   InputFile input1;
+   InputFile input2;
+   if (!input1.open(filename1) || !input2.open(filename2))
+   {
+      return false;
+   }
+
+   same = (input1.size() == input2.size());
+
+   std::vector<unsigned char> chunkBytes1(INFLATE_OUT_BYTES);
+   std::vector<unsigned char> chunkBytes2(INFLATE_OUT_BYTES);
+   while (same)
+   {
+      size_t numBytesRead1 = fread(chunkBytes1.data(), 1, chunkBytes1.size(), input1.file());
+      size_t numBytesRead2 = fread(chunkBytes2.data(), 1, chunkBytes2.size(), input2.file());
+
+      same = (numBytesRead1 == numBytesRead2) &&
+             (0 == memcmp(chunkBytes1.data(), chunkBytes2.data(), numBytesRead1));
+      if (numBytesRead1 == 0)
+      {
+         break;
+      }
+   }
+
+   if ((ferror(input1.file()) != 0) || (ferror(input2.file()) != 0))
+   {
+      return false;
+   }
+
+   // (Only a stream read to its end can be checked.)
+   if (same && (!input1.finish() || !input2.finish()))
+   {
+      errno = EIO;
+      return false;
+   }
+
+   return true;
+}
@@ -0,0 +1,104 @@
+// New GROM - Input files (plain, gzip, or zip archive members)
+//
+// Compressed inputs are decompressed on the fly: a thread inflates a few
+// chunks ahead of the reader, which sees an ordinary FILE*, so the decoders
+// run unchanged and nothing is written to temporary files.  A gzip input is
+// detected by its magic bytes; its size is its trailer's when it provably
+// holds a single member of under 4 GB, otherwise (several concatenated
+// members; the trailer only gives the last one's) it takes a decompression
+// pass.  The files in a zip archive are converted as separate inputs, named
+// "<archive>/<member>" (the archive acts as a directory); each archive's
+// central directory is read only once.
+
+#ifndef NGROM_INPUT_H
+#define NGROM_INPUT_H
+
+#include<stdint.h>
+#include<stdio.h>  // for FILE
+#include<string>
+#include<vector>
+#include<sys/stat.h>
+
+namespace NGROM_NS
+{
+   // A file in a zip archive (from the central directory)
+   struct ZipMember
+   {
+      std::string name;
+      uint16_t method;            // 0 = stored, 8 = deflated
+      uint32_t crc32;
+      uint64_t compressedSize;
+      uint64_t uncompressedSize;
+      uint64_t localHeaderOffset;
+   };
+
+   class Inflater;
+
+   // --------------------------------------------------------------------------
+   // Class: InputFile
+   // Description: An open input file.  For compressed inputs, file() is a
+   //              read-only stream (fileno() is -1) of the decompressed data
+   //              and size() its decompressed size (knownSize() is 0 for a
+   //              gzip input until size() finds it); readAt reads at any
+   //              offset either way.  open() is openFile() (the open and its
+   //              fstat, for a zip member its archive's) then openContents()
+   //              (sizing a gzip input, starting decompression), so that a
+   //              caller can decide from fileStat() whether to go on.
+   //              contentStat() is fileStat(), except that for a zip member,
+   //              its inode is 0, its size the member's, and its mtime
+   //              (seconds) the member's CRC32 (from the central directory),
+   //              so that it only changes with the member's own content.
+   // --------------------------------------------------------------------------
+   class InputFile
+   {
+   public:
+      InputFile();
+      ~InputFile();
+
+      bool open(const std::string& filename);
+      bool openFile(const std::string& filename);
+      bool openContents();
+      bool openFd(int fd);
+      bool readAt(unsigned char* bytes, size_t numBytes, uint64_t offset) const;
+      bool finish();
+      void dropCache();
+      void close();
+
+      FILE* file() const { return m_file; }
+      uint64_t size() const;
+      uint64_t knownSize() const { return m_sizeKnown ? m_size : 0; }
+      const struct stat& fileStat() const { return m_fileStat; }
+      const struct stat& contentStat() const { return m_contentStat; }
+      bool isCompressed() const { return m_inflater != NULL; }
+      uint64_t bufferBytes() const;
+
+      InputFile(const InputFile&) = delete;
+      InputFile& operator=(const InputFile&) = delete;
+
+   private:
+      bool openZipMember(int fd, const ZipMember& member);
+      bool startInflater(int fd, const ZipMember& member, bool isGzip);
+
+      FILE* m_file;
+      mutable uint64_t m_size;
+      mutable bool m_sizeKnown; // (A gzip input's is found when first asked for.)
+      Inflater* m_inflater;
+
+      // Opened by openFile, until openContents takes it
+      int m_fd;
+      std::string m_archivePath;
+      std::string m_memberName;
+      ZipMember m_member;
+      struct stat m_fileStat;
+      struct stat m_contentStat;
+   };
+
+   bool isZipFilename(const std::string& filename);
+   bool addInputFile(const std::string& filename, std::vector<std::string>& inputList);
+   std::string getRelativeInputPath(const std::string& filename, const std::vector<std::string>& rootDirs);
+   uint64_t getInputDataSize(const std::string& filename);
+   bool hashInput(const std::string& filename, uint64_t& hashValue);
+   bool compareInputs(const std::string& filename1, const std::string& filename2, bool& same);
+}
+
+#endif // NGROM_INPUT_H
@@ -0,0 +1,219 @@
+// New GROM - File I/O helpers (Linux)
+
+#include "ngrom_io.h"
+#include<vector>
+#include<errno.h>
+#include<fcntl.h>     // for open, fcntl
+#include<unistd.h>    // for copy_file_range, pread, write
+#include<sys/ioctl.h> // for ioctl
+#include<sys/stat.h>  // for fstat
+#include<linux/fs.h>  // for FICLONE, FICLONERANGE
+
+// Chunk size for the copy fallbacks
+static const size_t COPY_CHUNK_BYTES = 1024 * 1024;
+
+// -----------------------------------------------------------------------------
+// Function: copyRangeReadWrite
+// Description: Last-resort user-space copy (pread/write).
+// Return: true if all bytes were copied; false on any error (errno is set).
+// -----------------------------------------------------------------------------
+static bool copyRangeReadWrite(int srcFd, uint64_t srcOffset, int destFd, uint64_t numBytes)
+{
+   std::vector<unsigned char> chunkBytes((numBytes < COPY_CHUNK_BYTES) ? numBytes : COPY_CHUNK_BYTES);
+
+   while (numBytes > 0)
+   {
+      size_t chunkSize = (numBytes < COPY_CHUNK_BYTES) ? numBytes : COPY_CHUNK_BYTES;
+
+      ssize_t numRead = pread(srcFd, chunkBytes.data(), chunkSize, srcOffset);
+      if (numRead < 0)
+      {
+         if (errno == EINTR) { continue; }
+         return false;
+      }
+      if (numRead == 0)
+      {
+         errno = EIO; // Source shorter than expected
+         return false;
+      }
+
+      ssize_t numWritten = 0;
+      while (numWritten < numRead)
+      {
+         ssize_t rc = write(destFd, chunkBytes.data() + numWritten, numRead - numWritten);
+         if (rc < 0)
+         {
+            if (errno == EINTR) { continue; }
+            return false;
+         }
+         numWritten += rc;
+      }
+
+      srcOffset += numRead;
+      numBytes -= numRead;
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: cloneFileRange
+// Description: Copies numBytes from srcFd (at srcOffset) to the current
+//              position of destFd (expected to be an empty file, at offset 0)
+//              while moving as little data as possible: a reflink if the
+//              filesystem supports it (the whole file, or block aligned
+//              ranges), otherwise an in-kernel copy_file_range, and as a last
+//              resort a user-space copy.
+// Return: Method used, or CLONE_FAILED on error (errno is set).
+// -----------------------------------------------------------------------------
+NGROM_NS::CloneMethod NGROM_NS::cloneFileRange(int srcFd, uint64_t srcOffset, int destFd, uint64_t numBytes)
+{
+   struct stat srcStat;
+   if (0 != fstat(srcFd, &srcStat))
+   {
+      return CLONE_FAILED;
+   }
+
+   // Reflink
+   if ((srcOffset == 0) && (numBytes == (uint64_t)srcStat.st_size))
+   {
+      if (0 == ioctl(destFd, FICLONE, srcFd))
+      {
+         return CLONE_REFLINK;
+      }
+   }
+   else if ((srcOffset % srcStat.st_blksize) == 0)
+   {
+      struct file_clone_range cloneRange;
+      cloneRange.src_fd = srcFd;
+      cloneRange.src_offset = srcOffset;
+      cloneRange.src_length = numBytes;
+      cloneRange.dest_offset = 0;
+
+      // (Ranges must end on a block boundary, unless at the end of the source.)
+      if (((srcOffset + numBytes) == (uint64_t)srcStat.st_size) ||
+          ((numBytes % srcStat.st_blksize) == 0))
+      {
+         if (0 == ioctl(destFd, FICLONERANGE, &cloneRange))
+         {
+            return CLONE_REFLINK;
+         }
+      }
+   }
+
+   // In-kernel copy
+   loff_t srcPos = srcOffset;
+   uint64_t bytesLeft = numBytes;
+   while (bytesLeft > 0)
+   {
+      size_t chunkSize = (bytesLeft < COPY_CHUNK_BYTES) ? bytesLeft : COPY_CHUNK_BYTES;
+      ssize_t numCopied = copy_file_range(srcFd, &srcPos, destFd, NULL, chunkSize, 0);
+      if (numCopied <= 0)
+      {
+         if ((numCopied < 0) && (errno == EINTR))
+         {
+            continue;
+         }
+         break;
+      }
+      bytesLeft -= numCopied;
+   }
+
+   if (bytesLeft == 0)
+   {
+      return CLONE_COPY;
+   }
+
+   // Not supported here (e.g., older kernel, cross-filesystem); copy the rest.
+   if (copyRangeReadWrite(srcFd, srcOffset + (numBytes - bytesLeft), destFd, bytesLeft))
+   {
+      return CLONE_COPY;
+   }
+
+   return CLONE_FAILED;
+}
+
+// -----------------------------------------------------------------------------
+// Function: cloneFile
+// Description: Creates (or truncates) destPath as a copy of srcPath, using
+//              cloneFileRange.
+// Return: Method used, or CLONE_FAILED on error (errno is set).
+// -----------------------------------------------------------------------------
+NGROM_NS::CloneMethod NGROM_NS::cloneFile(const std::string& srcPath, const std::string& destPath)
+{
+   int srcFd = open(srcPath.c_str(), O_RDONLY | O_CLOEXEC);
+   if (srcFd < 0)
+   {
+      return CLONE_FAILED;
+   }
+
+   int destFd = open(destPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+   if (destFd < 0)
+   {
+      int saved_errno = errno;
+      close(srcFd);
+      errno = saved_errno;
+      return CLONE_FAILED;
+   }
+
+   CloneMethod retval = CLONE_FAILED;
+   struct stat srcStat;
+   if (0 == fstat(srcFd, &srcStat))
+   {
+      retval = cloneFileRange(srcFd, 0, destFd, srcStat.st_size);
+   }
+
+   int saved_errno = errno;
+   close(srcFd);
+   if ((0 != close(destFd)) && (retval != CLONE_FAILED))
+   {
+      saved_errno = errno;
+      retval = CLONE_FAILED;
+   }
+   errno = saved_errno;
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: setDirectIO
+// Description: Switches an open file to direct I/O (O_DIRECT: transfers go
+//              between the device and the caller's aligned buffers, bypassing
+//              the page cache).
+// Return: true if switched; false if the filesystem can't (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::setDirectIO(int fd)
+{
+   int flags = fcntl(fd, F_GETFL);
+   return (flags != -1) && (0 == fcntl(fd, F_SETFL, flags | O_DIRECT));
+}
+
+// -----------------------------------------------------------------------------
+// Function: preadUntilEnd
+// Description: Reads up to numBytes at offset, stopping early only at the end
+//              of the file.
+// Return: Number of bytes read (errno is set if fewer than numBytes, and not
+//         at the end of the file).
+// -----------------------------------------------------------------------------
+size_t NGROM_NS::preadUntilEnd(int fd, unsigned char* bytes, size_t numBytes, uint64_t offset)
+{
+   size_t numBytesRead = 0;
+   errno = 0;
+
+   while (numBytesRead < numBytes)
+   {
+      ssize_t rc = pread(fd, bytes + numBytesRead, numBytes - numBytesRead, offset + numBytesRead);
+      if (rc < 0)
+      {
+         if (errno == EINTR) { continue; }
+         break;
+      }
+      if (rc == 0)
+      {
+         break;
+      }
+      numBytesRead += rc;
+   }
+
+   return numBytesRead;
+}
@@ -0,0 +1,29 @@
+// New GROM - File I/O helpers (Linux)
+
+#ifndef NGROM_IO_H
+#define NGROM_IO_H
+
+#include<stddef.h>
+#include<stdint.h>
+#include<string>
+
+namespace NGROM_NS
+{
+   enum CloneMethod
+   {
+      CLONE_FAILED,
+      CLONE_REFLINK,  // FICLONE; shares the source's extents (no data copied)
+      CLONE_COPY      // copy_file_range (in-kernel copy; may still share extents)
+   };
+
+   CloneMethod cloneFileRange(int srcFd, uint64_t srcOffset, int destFd, uint64_t numBytes);
+   CloneMethod cloneFile(const std::string& srcPath, const std::string& destPath);
+
+   // O_DIRECT transfers need buffers, offsets, and sizes aligned to this
+   static const size_t DIRECT_IO_ALIGNMENT = 4096;
+
+   bool setDirectIO(int fd);
+   size_t preadUntilEnd(int fd, unsigned char* bytes, size_t numBytes, uint64_t offset);
+}
+
+#endif // NGROM_IO_H
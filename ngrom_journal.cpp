@@ -0,0 +1,439 @@
+// New GROM - Resumable batch journal
+//
+// File format (one record per line, tab-separated fields):
+//    # ngrom journal v1
+//    O <key> <value>     Run setting (e.g., outdir)
+//    F <input path>      Input file; its index is its order among F records
+//    P                   Plan complete (all settings/inputs written)
+//    S <index>           Conversion of input <index> started
+//    C <index>           Conversion of input <index> completed
+//    E                   Run finished
+
+#include "ngrom_journal.h"
+#include<stdio.h>  // for FILE I/O
+#include<stdlib.h> // for strtoull, free
+#include<iostream> // for std::cout and std::err
+#include<errno.h>
+#include<string.h>
+#include<fcntl.h>  // for open
+#include<unistd.h> // for write, fdatasync
+#include<time.h>   // for clock_gettime
+
+static const char* JOURNAL_HEADER_LINE = "# ngrom journal v1";
+
+// Group sync thresholds
+static const size_t JOURNAL_SYNC_RECORDS = 256;
+static const uint64_t JOURNAL_SYNC_INTERVAL_MS = 1000;
+
+// -----------------------------------------------------------------------------
+// Function: getMonotonicMs
+// Description: Gets a monotonic clock reading.
+// Return: Milliseconds (arbitrary epoch).
+// -----------------------------------------------------------------------------
+static uint64_t getMonotonicMs()
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return ((uint64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::Journal
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::Journal::Journal()
+ : m_fd(-1),
+   m_unsyncedRecords(0),
+   m_lastSyncMs(0),
+   m_numRecords(0),
+   m_numSynced(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::~Journal
+// Description: Destructor; syncs and closes the journal file.
+// -----------------------------------------------------------------------------
+NGROM_NS::Journal::~Journal()
+{
+   close();
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::close
+// Description: Syncs (if needed) and closes the journal file.
+// -----------------------------------------------------------------------------
+void NGROM_NS::Journal::close()
+{
+   if (m_fd >= 0)
+   {
+      sync();
+      ::close(m_fd);
+      m_fd = -1;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::create
+// Description: Starts a new journal for a run over the supplied inputs.  The
+//              settings and full input list are written (and synced) up front
+//              so the run can be resumed from the journal alone.
+// Return: true if the journal was created; false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Journal::create(const std::string& journalPath,
+                               const std::vector<std::string>& inputs,
+                               const Settings& settings)
+{
+   close();
+   m_path = journalPath;
+   m_inputStates.assign(inputs.size(), NOT_STARTED);
+
+   m_fd = open(m_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+   if (m_fd < 0)
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to create journal " << m_path << "... " << strerror(saved_errno) << std::endl;
+      return false;
+   }
+
+   // Paths and values are stored tab separated, one record per line.
+   std::string plan = JOURNAL_HEADER_LINE;
+   plan += "\n";
+
+   for (Settings::const_iterator iter = settings.begin(); iter != settings.end(); ++iter)
+   {
+      if ((iter->first + iter->second).find_first_of("\t\n") != std::string::npos)
+      {
+         std::cerr << "NGROM ERROR: Journal setting contains a tab or newline: " << iter->first << std::endl;
+         return false;
+      }
+      plan += "O\t" + iter->first + "\t" + iter->second + "\n";
+   }
+
+   for (const std::string& input : inputs)
+   {
+      if (input.find_first_of("\t\n") != std::string::npos)
+      {
+         std::cerr << "NGROM ERROR: File name contains a tab or newline; cannot journal: " << input << std::endl;
+         return false;
+      }
+      plan += "F\t" + input + "\n";
+   }
+
+   plan += "P\n";
+
+   if (!appendRecord(plan) || !sync())
+   {
+      return false;
+   }
+
+   // Make sure the journal's directory entry is durable, too.
+   std::string journalDir = ".";
+   size_t slashPos = m_path.rfind('/');
+   if (slashPos != std::string::npos)
+   {
+      journalDir = (slashPos == 0) ? "/" : m_path.substr(0, slashPos);
+   }
+
+   int dirFd = open(journalDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if (dirFd >= 0)
+   {
+      fsync(dirFd);
+      ::close(dirFd);
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::resume
+// Description: Loads an existing journal (its settings, inputs, and the state
+//              of each input) and reopens it to append further records.
+// Return: true if the journal was loaded; false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Journal::resume(const std::string& journalPath,
+                               std::vector<std::string>& inputs,
+                               Settings& settings)
+{
+   close();
+   m_path = journalPath;
+   inputs.clear();
+   settings.clear();
+   m_inputStates.clear();
+
+   FILE* inFile = fopen(m_path.c_str(), "r");
+   if (inFile == NULL)
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to open journal " << m_path << "... " << strerror(saved_errno) << std::endl;
+      return false;
+   }
+
+   bool retval = true;
+   bool planComplete = false;
+   char* lineBuf = NULL;
+   size_t lineBufSize = 0;
+   ssize_t lineLen;
+   size_t lineNum = 0;
+
+   while (retval && ((lineLen = getline(&lineBuf, &lineBufSize, inFile)) >= 0))
+   {
+      lineNum++;
+
+      // A record without its newline was cut off mid-write; ignore it.
+      if ((lineLen == 0) || (lineBuf[lineLen - 1] != '\n'))
+      {
+         break;
+      }
+      std::string line(lineBuf, lineLen - 1);
+
+      if (lineNum == 1)
+      {
+         if (line != JOURNAL_HEADER_LINE)
+         {
+            std::cerr << "NGROM ERROR: " << m_path << " is not an ngrom journal." << std::endl;
+            retval = false;
+         }
+         continue;
+      }
+
+      char recordType = line.empty() ? '\0' : line[0];
+      std::string recordData = (line.length() > 2) ? line.substr(2) : std::string();
+
+      if (!planComplete)
+      {
+         if (recordType == 'O')
+         {
+            size_t tabPos = recordData.find('\t');
+            if (tabPos == std::string::npos)
+            {
+               retval = false;
+            }
+            else
+            {
+               settings[recordData.substr(0, tabPos)] = recordData.substr(tabPos + 1);
+            }
+         }
+         else if (recordType == 'F')
+         {
+            inputs.push_back(recordData);
+         }
+         else if (recordType == 'P')
+         {
+            planComplete = true;
+            m_inputStates.assign(inputs.size(), NOT_STARTED);
+         }
+         else
+         {
+            retval = false;
+         }
+      }
+      else if ((recordType == 'S') || (recordType == 'C'))
+      {
+         char* endPtr = NULL;
+         unsigned long long index = strtoull(recordData.c_str(), &endPtr, 10);
+         if (recordData.empty() || (*endPtr != '\0') || (index >= m_inputStates.size()))
+         {
+            retval = false;
+         }
+         else
+         {
+            m_inputStates[index] = (recordType == 'S') ? STARTED : COMPLETED;
+         }
+      }
+      else if (recordType != 'E')
+      {
+         retval = false;
+      }
+
+      if (!retval)
+      {
+         std::cerr << "NGROM ERROR: Malformed journal record at line " << lineNum << std::endl;
+      }
+   }
+
+   free(lineBuf);
+   fclose(inFile);
+
+   if (retval && !planComplete)
+   {
+      std::cerr << "NGROM ERROR: Journal " << m_path << " is incomplete (run never started); nothing to resume." << std::endl;
+      retval = false;
+   }
+
+   if (retval)
+   {
+      m_fd = open(m_path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+      if (m_fd < 0)
+      {
+         int saved_errno = errno;
+         std::cerr << "NGROM ERROR: Failed to open journal " << m_path << "... " << strerror(saved_errno) << std::endl;
+         retval = false;
+      }
+      m_lastSyncMs = getMonotonicMs();
+   }
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::isCompleted
+// Description: Checks whether the input's conversion was completed.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Journal::isCompleted(size_t inputIndex) const
+{
+   return (inputIndex < m_inputStates.size()) && (m_inputStates[inputIndex] == COMPLETED);
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::isPartial
+// Description: Checks whether the input's conversion was started, but never
+//              completed (i.e., its output may be partially written).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Journal::isPartial(size_t inputIndex) const
+{
+   return (inputIndex < m_inputStates.size()) && (m_inputStates[inputIndex] == STARTED);
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::numCompleted
+// Description: Counts completed conversions.
+// -----------------------------------------------------------------------------
+size_t NGROM_NS::Journal::numCompleted() const
+{
+   size_t count = 0;
+   for (unsigned char state : m_inputStates)
+   {
+      if (state == COMPLETED)
+      {
+         count++;
+      }
+   }
+   return count;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::recordStart
+// Description: Records that the input's output is about to be written.  The
+//              record must be synced (syncThrough numRecords()) before the
+//              output is created.
+// Return: true if recorded; false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Journal::recordStart(size_t inputIndex)
+{
+   m_inputStates[inputIndex] = STARTED;
+   return appendRecord("S\t" + std::to_string(inputIndex) + "\n");
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::recordComplete
+// Description: Records that the input's output was completely written.
+// Return: true if recorded; false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Journal::recordComplete(size_t inputIndex)
+{
+   m_inputStates[inputIndex] = COMPLETED;
+   return appendRecord("C\t" + std::to_string(inputIndex) + "\n");
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::finish
+// Description: Records the end of the run and syncs the journal.
+// Return: true if recorded; false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Journal::finish()
+{
+   return appendRecord("E\n") && sync();
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::appendRecord
+// Description: Appends record(s) with a single write, then syncs if the group
+//              thresholds have been reached.
+// Return: true if written; false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Journal::appendRecord(const std::string& record)
+{
+   const char* bytes = record.data();
+   size_t bytesLeft = record.length();
+
+   while (bytesLeft > 0)
+   {
+      ssize_t numWritten = write(m_fd, bytes, bytesLeft);
+      if (numWritten < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+
+         int saved_errno = errno;
+         std::cerr << "NGROM ERROR: Failed to write journal " << m_path << "... " << strerror(saved_errno) << std::endl;
+         return false;
+      }
+      bytes += numWritten;
+      bytesLeft -= numWritten;
+   }
+
+   m_unsyncedRecords++;
+   m_numRecords++;
+
+   if ((m_unsyncedRecords >= JOURNAL_SYNC_RECORDS) ||
+       (getMonotonicMs() - m_lastSyncMs >= JOURNAL_SYNC_INTERVAL_MS))
+   {
+      return sync();
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::sync
+// Description: Forces all records written so far to stable storage.
+// Return: true if synced; false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Journal::sync()
+{
+   if ((m_fd < 0) || (m_unsyncedRecords == 0))
+   {
+      return true;
+   }
+
+   if (!syncThrough(m_numRecords))
+   {
+      return false;
+   }
+
+   m_unsyncedRecords = 0;
+   m_lastSyncMs = getMonotonicMs();
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Journal::syncThrough
+// Description: Makes sure the first recordNum records appended are on stable
+//              storage: nothing to do if an earlier sync covered them;
+//              otherwise, one fdatasync covers every record appended so far
+//              (so parallel conversions waiting on it share it).
+// Return: true if synced; false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Journal::syncThrough(uint64_t recordNum)
+{
+   std::lock_guard<std::mutex> lock(m_syncMutex);
+
+   if ((m_fd < 0) || (m_numSynced >= recordNum))
+   {
+      return true;
+   }
+
+   uint64_t numRecords = m_numRecords;
+   if (0 != fdatasync(m_fd))
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to sync journal " << m_path << "... " << strerror(saved_errno) << std::endl;
+      return false;
+   }
+
+   m_numSynced = numRecords;
+   return true;
+}
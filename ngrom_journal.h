@@ -0,0 +1,93 @@
+// New GROM - Resumable batch journal
+//
+// Write-ahead journal of a conversion run: the run's settings and input list,
+// followed by "started" and "completed" records for each conversion.  After a
+// crash, the journal tells which outputs are complete, which are partial (and
+// must be thrown away), and which inputs were never started.
+//
+// A "started" record is synced before its output is created (syncThrough), so
+// no output outlives a crash without it.  A "completed" record says the
+// output was fully written by the process; only with durable outputs (whose
+// completion is recorded once they're synced) does it also mean the output's
+// data survived a system crash or power loss.
+
+#ifndef NGROM_JOURNAL_H
+#define NGROM_JOURNAL_H
+
+#include<stddef.h>
+#include<stdint.h>
+#include<string>
+#include<vector>
+#include<map>
+#include<atomic>
+#include<mutex>
+
+namespace NGROM_NS
+{
+   // --------------------------------------------------------------------------
+   // Class: Journal
+   // Description: Append-only journal file.  Each record is appended with a
+   //              single write(), so it survives the process being killed;
+   //              fdatasync is done in groups (every JOURNAL_SYNC_RECORDS
+   //              records or JOURNAL_SYNC_INTERVAL_MS, whichever is first) so
+   //              the journal costs next to nothing per file.  Records that
+   //              must be durable before going on are synced with
+   //              syncThrough, which (called without the caller's lock) lets
+   //              one fdatasync cover the records of all parallel
+   //              conversions written before it.  The record methods need
+   //              the caller's lock; syncThrough doesn't.
+   // --------------------------------------------------------------------------
+   class Journal
+   {
+   public:
+      typedef std::map<std::string, std::string> Settings;
+
+      Journal();
+      ~Journal();
+
+      Journal(const Journal&) = delete;
+      Journal& operator=(const Journal&) = delete;
+
+      bool create(const std::string& journalPath,
+                  const std::vector<std::string>& inputs,
+                  const Settings& settings);
+      bool resume(const std::string& journalPath,
+                  std::vector<std::string>& inputs,
+                  Settings& settings);
+
+      bool isCompleted(size_t inputIndex) const;
+      bool isPartial(size_t inputIndex) const; // Started, but not completed
+
+      size_t numCompleted() const;
+
+      bool recordStart(size_t inputIndex);
+      bool recordComplete(size_t inputIndex);
+      bool finish();
+
+      bool sync();
+      uint64_t numRecords() const { return m_numRecords; }
+      bool syncThrough(uint64_t recordNum);
+
+   private:
+      enum InputState
+      {
+         NOT_STARTED,
+         STARTED,
+         COMPLETED
+      };
+
+      bool appendRecord(const std::string& record);
+      void close();
+
+      std::string m_path;
+      int m_fd;
+      std::vector<unsigned char> m_inputStates; // InputState per input
+      size_t m_unsyncedRecords;
+      uint64_t m_lastSyncMs;
+      std::atomic<uint64_t> m_numRecords; // Records appended (by this process)
+      std::mutex m_syncMutex;             // Guards m_numSynced (and serializes syncs)
+      uint64_t m_numSynced;               // Records known to be on stable storage
+   };
+}
+
+#endif // NGROM_JOURNAL_H
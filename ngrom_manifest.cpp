@@ -0,0 +1,530 @@
+// New GROM - Incremental conversion manifest
+//
+// File format: one header line, then one line per conversion with
+// tab-separated fields:
+//    inode  size  mtime_sec.mtime_nsec  content_hash
+//    output_size  output_inode  output_mtime_sec.output_mtime_nsec  output_hash
+//    input  output
+// (A v1 manifest has no output_inode, output_mtime, or output_hash; it's
+// rewritten as v2.)  A zip member's inode, size, and mtime are those of its
+// InputFile::contentStat (0, its size, and its CRC32), not the archive's.
+// The manifest is rewritten (see save) at the end of a run, and every
+// MANIFEST_SAVE_INTERVAL_MS during one, so an interrupted run keeps most of
+// its progress.
+
+#include "ngrom_manifest.h"
+#include "ngrom_hash.h"
+#include "ngrom_input.h"
+#include<stdio.h>  // for FILE I/O
+#include<stdlib.h> // for strtoull, free
+#include<iostream> // for std::cout and std::err
+#include<errno.h>
+#include<string.h>
+#include<unistd.h> // for fsync
+#include<time.h>   // for clock_gettime
+
+static const char* MANIFEST_HEADER_LINE = "# ngrom manifest v2";
+static const char* MANIFEST_V1_HEADER_LINE = "# ngrom manifest v1";
+
+// Periodic save interval (each save rewrites the whole manifest)
+static const uint64_t MANIFEST_SAVE_INTERVAL_MS = 10000;
+
+// -----------------------------------------------------------------------------
+// Function: getMonotonicMs
+// Description: Gets a monotonic clock reading.
+// Return: Milliseconds (arbitrary epoch).
+// -----------------------------------------------------------------------------
+static uint64_t getMonotonicMs()
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return ((uint64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+// -----------------------------------------------------------------------------
+// Function: Manifest::Manifest
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::Manifest::Manifest()
+ : m_modified(false),
+   m_lastSaveMs(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: Manifest::load
+// Description: Loads the manifest from the supplied path and builds the
+//              in-memory index.  A non-existent file is an empty manifest
+//              (i.e., first run).
+// Return: true if loaded (or new); false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Manifest::load(const std::string& manifestPath)
+{
+   m_path = manifestPath;
+   m_entries.clear();
+   m_index.clear();
+   m_modified = false;
+   m_lastSaveMs = getMonotonicMs();
+
+   FILE* inFile = fopen(m_path.c_str(), "r");
+   if (inFile == NULL)
+   {
+      int saved_errno = errno;
+      if (saved_errno == ENOENT)
+      {
+         return true;
+      }
+
+      std::cerr << "NGROM ERROR: Failed to open manifest " << m_path << "... " << strerror(saved_errno) << std::endl;
+      return false;
+   }
+
+   bool retval = true;
+   char* lineBuf = NULL;
+   size_t lineBufSize = 0;
+   ssize_t lineLen;
+   size_t lineNum = 0;
+   bool hasOutputFields = true;
+
+   while ((lineLen = getline(&lineBuf, &lineBufSize, inFile)) >= 0)
+   {
+      lineNum++;
+
+      std::string line(lineBuf, lineLen);
+      if (!line.empty() && (line[line.length() - 1] == '\n'))
+      {
+         line.erase(line.length() - 1);
+      }
+
+      if (lineNum == 1)
+      {
+         if (line == MANIFEST_V1_HEADER_LINE)
+         {
+            hasOutputFields = false;
+            m_modified = true; // Rewrite as v2
+         }
+         else if (line != MANIFEST_HEADER_LINE)
+         {
+            std::cerr << "NGROM ERROR: " << m_path << " is not an ngrom manifest." << std::endl;
+            retval = false;
+            break;
+         }
+         continue;
+      }
+
+      Entry entry;
+      if (!parseLine(line, hasOutputFields, entry))
+      {
+         std::cerr << "NGROM WARNING: Ignoring malformed manifest line " << lineNum << std::endl;
+         m_modified = true; // Rewrite without it
+         continue;
+      }
+
+      std::unordered_map<std::string, size_t>::iterator iter = m_index.find(entry.inputPath);
+      if (iter != m_index.end())
+      {
+         m_entries[iter->second] = entry; // Later line wins
+      }
+      else
+      {
+         m_index[entry.inputPath] = m_entries.size();
+         m_entries.push_back(entry);
+      }
+   }
+
+   free(lineBuf);
+   fclose(inFile);
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Manifest::parseLine
+// Description: Parses a single manifest record line (of a v2 manifest, or
+//              of a v1 manifest, without the output's inode, mtime, and hash).
+// Return: true if the line is well formed.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Manifest::parseLine(const std::string& line, bool hasOutputFields, Entry& entry) const
+{
+   std::vector<std::string> fields;
+   size_t pos = 0;
+   size_t numFields = hasOutputFields ? 10 : 7;
+
+   while (fields.size() < (numFields - 1))
+   {
+      size_t tabPos = line.find('\t', pos);
+      if (tabPos == std::string::npos)
+      {
+         return false;
+      }
+      fields.push_back(line.substr(pos, tabPos - pos));
+      pos = tabPos + 1;
+   }
+   fields.push_back(line.substr(pos)); // Output path (last field)
+
+   char* endPtr = NULL;
+
+   entry.inode = strtoull(fields[0].c_str(), &endPtr, 10);
+   if (*endPtr != '\0') { return false; }
+
+   entry.size = strtoull(fields[1].c_str(), &endPtr, 10);
+   if (*endPtr != '\0') { return false; }
+
+   entry.mtimeSec = strtoll(fields[2].c_str(), &endPtr, 10);
+   if (*endPtr != '.') { return false; }
+   entry.mtimeNsec = strtoll(endPtr + 1, &endPtr, 10);
+   if (*endPtr != '\0') { return false; }
+
+   if (!hashFromString(fields[3], entry.contentHash)) { return false; }
+
+   entry.outputSize = strtoull(fields[4].c_str(), &endPtr, 10);
+   if (*endPtr != '\0') { return false; }
+
+   entry.outputInode = 0;
+   entry.outputMtimeSec = 0;
+   entry.outputMtimeNsec = 0;
+   entry.outputHash = 0;
+   if (hasOutputFields)
+   {
+      entry.outputInode = strtoull(fields[5].c_str(), &endPtr, 10);
+      if (*endPtr != '\0') { return false; }
+
+      entry.outputMtimeSec = strtoll(fields[6].c_str(), &endPtr, 10);
+      if (*endPtr != '.') { return false; }
+      entry.outputMtimeNsec = strtoll(endPtr + 1, &endPtr, 10);
+      if (*endPtr != '\0') { return false; }
+
+      if (!hashFromString(fields[7], entry.outputHash)) { return false; }
+   }
+
+   entry.inputPath = fields[numFields - 2];
+   entry.outputPath = fields[numFields - 1];
+   entry.seen = false;
+
+   return !entry.inputPath.empty() && !entry.outputPath.empty();
+}
+
+// -----------------------------------------------------------------------------
+// Function: Manifest::save
+// Description: Writes the manifest (if modified) to a temporary file, syncs
+//              it, and renames it over the previous manifest, so a crash never
+//              leaves a partially written manifest behind.
+// Return: true if saved (or nothing to save); false on any error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Manifest::save()
+{
+   if (!m_modified)
+   {
+      return true;
+   }
+
+   std::string tmpPath = m_path + ".tmp";
+
+   FILE* outFile = fopen(tmpPath.c_str(), "w");
+   if (outFile == NULL)
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to open manifest " << tmpPath << "... " << strerror(saved_errno) << std::endl;
+      return false;
+   }
+
+   fprintf(outFile, "%s\n", MANIFEST_HEADER_LINE);
+
+   for (const Entry& entry : m_entries)
+   {
+      fprintf(outFile, "%llu\t%llu\t%lld.%09lld\t%s\t%llu\t%llu\t%lld.%09lld\t%s\t%s\t%s\n",
+              (unsigned long long)entry.inode,
+              (unsigned long long)entry.size,
+              (long long)entry.mtimeSec,
+              (long long)entry.mtimeNsec,
+              hashToString(entry.contentHash).c_str(),
+              (unsigned long long)entry.outputSize,
+              (unsigned long long)entry.outputInode,
+              (long long)entry.outputMtimeSec,
+              (long long)entry.outputMtimeNsec,
+              hashToString(entry.outputHash).c_str(),
+              entry.inputPath.c_str(),
+              entry.outputPath.c_str());
+   }
+
+   bool retval = (fflush(outFile) == 0) && (fsync(fileno(outFile)) == 0);
+   int saved_errno = errno;
+   fclose(outFile);
+
+   if (retval && (0 != rename(tmpPath.c_str(), m_path.c_str())))
+   {
+      saved_errno = errno;
+      retval = false;
+   }
+
+   if (!retval)
+   {
+      std::cerr << "NGROM ERROR: Failed to write manifest " << m_path << "... " << strerror(saved_errno) << std::endl;
+      unlink(tmpPath.c_str());
+   }
+   else
+   {
+      m_modified = false;
+   }
+
+   m_lastSaveMs = getMonotonicMs();
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Manifest::checkInput
+// Description: Decides whether an input needs (re)converting to the supplied
+//              output path, based on the manifest record for the input (i.e.,
+//              lookupInput, checkEntry, and updateEntry in one; a caller
+//              sharing the manifest between threads should call those
+//              itself, so that no lock is held while checkEntry reads files).
+// Return: InputStatus value; only UNCHANGED_INPUT means no work is needed.
+// -----------------------------------------------------------------------------
+NGROM_NS::Manifest::InputStatus NGROM_NS::Manifest::checkInput(const std::string& inputPath,
+                                                               const struct stat& inStat,
+                                                               const std::string& outputPath)
+{
+   Entry entry;
+   if (!lookupInput(inputPath, entry))
+   {
+      return NEW_INPUT;
+   }
+
+   bool entryUpdated = false;
+   InputStatus inputStatus = checkEntry(entry, inStat, outputPath, entryUpdated);
+   if (entryUpdated)
+   {
+      updateEntry(entry);
+   }
+
+   return inputStatus;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Manifest::lookupInput
+// Description: Copies the record for an input (and marks it seen this run).
+// Return: true if the input has a record; false if not.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::Manifest::lookupInput(const std::string& inputPath, Entry& entry)
+{
+   std::unordered_map<std::string, size_t>::iterator iter = m_index.find(inputPath);
+   if (iter == m_index.end())
+   {
+      return false;
+   }
+
+   m_entries[iter->second].seen = true;
+   entry = m_entries[iter->second];
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Manifest::checkEntry
+// Description: Decides whether an input needs (re)converting to the supplied
+//              output path, given its record (from lookupInput).  Reads the
+//              input (or the output) only when its metadata changed but its
+//              size did not; if the content turns out the same, the record's
+//              metadata is refreshed (entryUpdated is set), for updateEntry.
+//              Uses no manifest state, so needs no lock.
+// Return: InputStatus value; only UNCHANGED_INPUT means no work is needed.
+// -----------------------------------------------------------------------------
+NGROM_NS::Manifest::InputStatus NGROM_NS::Manifest::checkEntry(Entry& entry,
+                                                               const struct stat& inStat,
+                                                               const std::string& outputPath,
+                                                               bool& entryUpdated)
+{
+   entryUpdated = false;
+
+   if (entry.outputPath != outputPath)
+   {
+      // Converted elsewhere before; treat as new for this output location.
+      return NEW_INPUT;
+   }
+
+   if ((uint64_t)inStat.st_size != entry.size)
+   {
+      return CHANGED_INPUT;
+   }
+
+   bool sameMetadata = ((uint64_t)inStat.st_ino == entry.inode) &&
+                       (inStat.st_mtim.tv_sec == entry.mtimeSec) &&
+                       (inStat.st_mtim.tv_nsec == entry.mtimeNsec);
+
+   if (!sameMetadata)
+   {
+      // Same size, but touched/replaced; only the content can tell.
+      uint64_t contentHash = 0;
+      if (!hashInput(entry.inputPath, contentHash) || (contentHash != entry.contentHash))
+      {
+         return CHANGED_INPUT;
+      }
+
+      // Content identical; refresh the metadata so the next run is fast.
+      entry.inode = inStat.st_ino;
+      entry.mtimeSec = inStat.st_mtim.tv_sec;
+      entry.mtimeNsec = inStat.st_mtim.tv_nsec;
+      entryUpdated = true;
+   }
+
+   struct stat outStat;
+   if ((0 != stat(outputPath.c_str(), &outStat)) || ((uint64_t)outStat.st_size != entry.outputSize))
+   {
+      return MISSING_OUTPUT;
+   }
+
+   if (entry.outputInode == 0)
+   {
+      // (Recorded by a v1 manifest: only the output's size is known.)
+      return UNCHANGED_INPUT;
+   }
+
+   bool sameOutputMetadata = ((uint64_t)outStat.st_ino == entry.outputInode) &&
+                             (outStat.st_mtim.tv_sec == entry.outputMtimeSec) &&
+                             (outStat.st_mtim.tv_nsec == entry.outputMtimeNsec);
+
+   if (!sameOutputMetadata)
+   {
+      // Same size, but replaced or rewritten (e.g., through a hardlink).
+      uint64_t outputHash = 0;
+      if (!hashFile(outputPath, outputHash) || (outputHash != entry.outputHash))
+      {
+         return MISSING_OUTPUT;
+      }
+
+      entry.outputInode = outStat.st_ino;
+      entry.outputMtimeSec = outStat.st_mtim.tv_sec;
+      entry.outputMtimeNsec = outStat.st_mtim.tv_nsec;
+      entryUpdated = true;
+   }
+
+   return UNCHANGED_INPUT;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Manifest::updateEntry
+// Description: Stores the metadata refreshed by checkEntry, unless the record
+//              was replaced in the meantime (a new conversion recorded).
+// -----------------------------------------------------------------------------
+void NGROM_NS::Manifest::updateEntry(const Entry& entry)
+{
+   std::unordered_map<std::string, size_t>::iterator iter = m_index.find(entry.inputPath);
+   if (iter == m_index.end())
+   {
+      return;
+   }
+
+   Entry& storedEntry = m_entries[iter->second];
+   if ((storedEntry.contentHash != entry.contentHash) || (storedEntry.outputHash != entry.outputHash) ||
+       (storedEntry.outputPath != entry.outputPath))
+   {
+      return;
+   }
+
+   storedEntry.inode = entry.inode;
+   storedEntry.mtimeSec = entry.mtimeSec;
+   storedEntry.mtimeNsec = entry.mtimeNsec;
+   storedEntry.outputInode = entry.outputInode;
+   storedEntry.outputMtimeSec = entry.outputMtimeSec;
+   storedEntry.outputMtimeNsec = entry.outputMtimeNsec;
+   m_modified = true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: Manifest::recordConversion
+// Description: Adds (or updates) the record for a successful conversion,
+//              and saves the manifest if the last save was more than
+//              MANIFEST_SAVE_INTERVAL_MS ago (a failed save is reported, and
+//              retried next time).
+// -----------------------------------------------------------------------------
+void NGROM_NS::Manifest::recordConversion(const std::string& inputPath,
+                                          const struct stat& inStat,
+                                          uint64_t contentHash,
+                                          const std::string& outputPath,
+                                          const struct stat& outStat,
+                                          uint64_t outputHash)
+{
+   // Paths are stored tab separated, one record per line.
+   if ((inputPath.find_first_of("\t\n") != std::string::npos) ||
+       (outputPath.find_first_of("\t\n") != std::string::npos))
+   {
+      std::cerr << "  NGROM WARNING: File name contains a tab or newline; not recorded in manifest." << std::endl;
+      return;
+   }
+
+   Entry entry;
+   entry.inputPath = inputPath;
+   entry.outputPath = outputPath;
+   entry.inode = inStat.st_ino;
+   entry.size = inStat.st_size;
+   entry.mtimeSec = inStat.st_mtim.tv_sec;
+   entry.mtimeNsec = inStat.st_mtim.tv_nsec;
+   entry.contentHash = contentHash;
+   entry.outputSize = outStat.st_size;
+   entry.outputInode = outStat.st_ino;
+   entry.outputMtimeSec = outStat.st_mtim.tv_sec;
+   entry.outputMtimeNsec = outStat.st_mtim.tv_nsec;
+   entry.outputHash = outputHash;
+   entry.seen = true;
+
+   std::unordered_map<std::string, size_t>::iterator iter = m_index.find(inputPath);
+   if (iter != m_index.end())
+   {
+      m_entries[iter->second] = entry;
+   }
+   else
+   {
+      m_index[inputPath] = m_entries.size();
+      m_entries.push_back(entry);
+   }
+
+   m_modified = true;
+
+   if (getMonotonicMs() - m_lastSaveMs >= MANIFEST_SAVE_INTERVAL_MS)
+   {
+      save();
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: Manifest::findEntry
+// Description: Looks up the record for an input path.
+// Return: Pointer to the record, or NULL if there is none.
+// -----------------------------------------------------------------------------
+const NGROM_NS::Manifest::Entry* NGROM_NS::Manifest::findEntry(const std::string& inputPath) const
+{
+   std::unordered_map<std::string, size_t>::const_iterator iter = m_index.find(inputPath);
+   if (iter == m_index.end())
+   {
+      return NULL;
+   }
+   return &m_entries[iter->second];
+}
+
+// -----------------------------------------------------------------------------
+// Function: Manifest::reportStaleOutputs
+// Description: Reports outputs whose input was not part of this run and no
+//              longer exists.  (Outputs of changed inputs are reported, and
+//              regenerated, as they are encountered.)  Nothing is deleted.
+// Return: Number of stale outputs found.
+// -----------------------------------------------------------------------------
+size_t NGROM_NS::Manifest::reportStaleOutputs() const
+{
+   size_t numStale = 0;
+
+   for (const Entry& entry : m_entries)
+   {
+      if (entry.seen)
+      {
+         continue;
+      }
+
+      struct stat inStat;
+      if ((0 != stat(entry.inputPath.c_str(), &inStat)) && (errno == ENOENT))
+      {
+         std::cout << "Stale output (input no longer exists): " << entry.outputPath << std::endl;
+         numStale++;
+      }
+   }
+
+   return numStale;
+}
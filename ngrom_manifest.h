@@ -0,0 +1,97 @@
+// New GROM - Incremental conversion manifest
+//
+// Persistent record of previous conversions (input path, size, mtime, inode,
+// and content hash, mapped to the output written, with its size, mtime, inode,
+// and content hash), so that reruns over the same collection only convert new
+// or changed inputs, and regenerate outputs changed since.
+
+#ifndef NGROM_MANIFEST_H
+#define NGROM_MANIFEST_H
+
+#include<stdint.h>
+#include<sys/stat.h>
+#include<string>
+#include<vector>
+#include<unordered_map>
+
+namespace NGROM_NS
+{
+   // --------------------------------------------------------------------------
+   // Class: Manifest
+   // Description: On-disk manifest plus an in-memory index keyed on the input
+   //              path.  Deciding whether an input is unchanged costs one
+   //              hash lookup plus a stat of the output; the input (or the
+   //              output) is only re-hashed when its metadata changed but its
+   //              size did not (e.g., the file was touched or copied, or
+   //              rewritten through another hardlink).  Not thread safe:
+   //              callers sharing one serialize all calls but checkEntry.
+   // --------------------------------------------------------------------------
+   class Manifest
+   {
+   public:
+      enum InputStatus
+      {
+         NEW_INPUT,       // Not in the manifest
+         CHANGED_INPUT,   // Input changed; existing output is stale
+         MISSING_OUTPUT,  // Input unchanged, but output is gone or modified
+         UNCHANGED_INPUT  // Input unchanged and output intact; no work needed
+      };
+
+      struct Entry
+      {
+         std::string inputPath;
+         std::string outputPath;
+         uint64_t inode;
+         uint64_t size;
+         int64_t mtimeSec;
+         int64_t mtimeNsec;
+         uint64_t contentHash;
+         uint64_t outputSize;
+         uint64_t outputInode; // (0: not recorded, by a v1 manifest)
+         int64_t outputMtimeSec;
+         int64_t outputMtimeNsec;
+         uint64_t outputHash;
+         bool seen; // Checked during this run
+      };
+
+      Manifest();
+
+      bool load(const std::string& manifestPath);
+      bool save();
+
+      InputStatus checkInput(const std::string& inputPath,
+                             const struct stat& inStat,
+                             const std::string& outputPath);
+
+      bool lookupInput(const std::string& inputPath, Entry& entry);
+      static InputStatus checkEntry(Entry& entry,
+                                    const struct stat& inStat,
+                                    const std::string& outputPath,
+                                    bool& entryUpdated);
+      void updateEntry(const Entry& entry);
+
+      void recordConversion(const std::string& inputPath,
+                            const struct stat& inStat,
+                            uint64_t contentHash,
+                            const std::string& outputPath,
+                            const struct stat& outStat,
+                            uint64_t outputHash);
+
+      const Entry* findEntry(const std::string& inputPath) const;
+
+      size_t reportStaleOutputs() const;
+
+      size_t size() const { return m_entries.size(); }
+
+   private:
+      bool parseLine(const std::string& line, bool hasOutputFields, Entry& entry) const;
+
+      std::string m_path;
+      std::vector<Entry> m_entries;
+      std::unordered_map<std::string, size_t> m_index; // input path -> m_entries index
+      bool m_modified;
+      uint64_t m_lastSaveMs; // (Monotonic clock)
+   };
+}
+
+#endif // NGROM_MANIFEST_H
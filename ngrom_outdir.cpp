@@ -0,0 +1,188 @@
+// New GROM - Output directory
+
+#include "ngrom_outdir.h"
+#include<errno.h>
+#include<string.h>
+#include<dirent.h>        // for fdopendir, readdir
+#include<fcntl.h>         // for open, openat, fcntl
+#include<unistd.h>        // for close, unlinkat
+#include<sys/sysmacros.h> // for makedev
+
+// -----------------------------------------------------------------------------
+// Function: OutputDirectory::OutputDirectory
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::OutputDirectory::OutputDirectory()
+ : m_fd(-1)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputDirectory::~OutputDirectory
+// Description: Destructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::OutputDirectory::~OutputDirectory()
+{
+   if (m_fd >= 0)
+   {
+      close(m_fd);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputDirectory::open
+// Description: Opens the directory and reads the names of its entries.
+// Return: true if opened; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::OutputDirectory::open(const std::string& path)
+{
+   int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if (fd < 0)
+   {
+      return false;
+   }
+
+   // (Listed through a duplicate; closedir closes it, and m_fd stays open.)
+   int listFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+   DIR* dir = (listFd < 0) ? NULL : fdopendir(listFd);
+   if (dir == NULL)
+   {
+      int saved_errno = errno;
+      if (listFd >= 0) { close(listFd); }
+      close(fd);
+      errno = saved_errno;
+      return false;
+   }
+
+   std::unordered_set<std::string> names;
+   errno = 0;
+   for (struct dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir))
+   {
+      if ((0 != strcmp(entry->d_name, ".")) && (0 != strcmp(entry->d_name, "..")))
+      {
+         names.insert(entry->d_name);
+      }
+   }
+
+   int saved_errno = errno;
+   closedir(dir);
+   if (saved_errno != 0)
+   {
+      close(fd);
+      errno = saved_errno;
+      return false;
+   }
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   if (m_fd >= 0)
+   {
+      close(m_fd);
+   }
+   m_fd = fd;
+   m_names.swap(names);
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputDirectory::statOutput
+// Description: stat() for an entry of the directory.  A name that's not in
+//              the snapshot (nor made since) is missing without asking the
+//              filesystem; otherwise the attributes may come from the
+//              client's cache (statx with AT_STATX_DONT_SYNC; on NFS, no
+//              round-trip to the server).
+// Return: 0 on success; -1 on error (errno is set).
+// -----------------------------------------------------------------------------
+int NGROM_NS::OutputDirectory::statOutput(const std::string& name, struct stat& outStat) const
+{
+   if (!hasName(name))
+   {
+      errno = ENOENT;
+      return -1;
+   }
+
+   struct statx outStatx;
+   if (0 != statx(m_fd, name.c_str(), AT_STATX_DONT_SYNC, STATX_BASIC_STATS, &outStatx))
+   {
+      return (errno == ENOSYS) ? fstatat(m_fd, name.c_str(), &outStat, 0) : -1;
+   }
+
+   memset(&outStat, 0, sizeof(outStat));
+   outStat.st_dev = makedev(outStatx.stx_dev_major, outStatx.stx_dev_minor);
+   outStat.st_ino = outStatx.stx_ino;
+   outStat.st_mode = outStatx.stx_mode;
+   outStat.st_nlink = outStatx.stx_nlink;
+   outStat.st_uid = outStatx.stx_uid;
+   outStat.st_gid = outStatx.stx_gid;
+   outStat.st_size = outStatx.stx_size;
+   outStat.st_blksize = outStatx.stx_blksize;
+   outStat.st_blocks = outStatx.stx_blocks;
+   outStat.st_mtim.tv_sec = outStatx.stx_mtime.tv_sec;
+   outStat.st_mtim.tv_nsec = outStatx.stx_mtime.tv_nsec;
+   outStat.st_ctim.tv_sec = outStatx.stx_ctime.tv_sec;
+   outStat.st_ctim.tv_nsec = outStatx.stx_ctime.tv_nsec;
+   outStat.st_atim.tv_sec = outStatx.stx_atime.tv_sec;
+   outStat.st_atim.tv_nsec = outStatx.stx_atime.tv_nsec;
+   return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputDirectory::createOutput
+// Description: Creates an output for writing (and reading back):
+//              exclusively (fails with EEXIST if the name exists after all),
+//              or replacing any existing file.  A replaced file is unlinked
+//              and a new one created, never rewritten in place: it may be a
+//              hardlink shared with other outputs.
+// Return: File descriptor, or -1 on error (errno is set).
+// -----------------------------------------------------------------------------
+int NGROM_NS::OutputDirectory::createOutput(const std::string& name, bool exclusive)
+{
+   if (!exclusive && (0 != unlinkat(m_fd, name.c_str(), 0)) && (errno != ENOENT))
+   {
+      return -1;
+   }
+
+   int fd = openat(m_fd, name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+   if ((fd >= 0) || (errno == EEXIST))
+   {
+      int saved_errno = errno;
+      addName(name);
+      errno = saved_errno;
+   }
+   return fd;
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputDirectory::removeOutput
+// Description: Removes an entry of the directory.
+// Return: 0 on success; -1 on error (errno is set).
+// -----------------------------------------------------------------------------
+int NGROM_NS::OutputDirectory::removeOutput(const std::string& name)
+{
+   if (!hasName(name))
+   {
+      errno = ENOENT;
+      return -1;
+   }
+   return unlinkat(m_fd, name.c_str(), 0);
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputDirectory::addName
+// Description: Notes a name made in the directory since the snapshot (e.g.,
+//              a dedup link or a durable commit).
+// -----------------------------------------------------------------------------
+void NGROM_NS::OutputDirectory::addName(const std::string& name)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_names.insert(name);
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputDirectory::hasName
+// Description: Checks whether a name may exist in the directory.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::OutputDirectory::hasName(const std::string& name) const
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   return (m_names.count(name) > 0);
+}
@@ -0,0 +1,50 @@
+// New GROM - Output directory
+//
+// The output directory is opened once per run, and its entries are read in
+// one pass (a snapshot of the names already there).  Each output's collision
+// check is then answered from the snapshot, and outputs are stat'ed, created,
+// and removed relative to the directory's fd (statx/openat/unlinkat, no path
+// lookups from the root).  A new output is created with O_EXCL, so a file
+// that appears after the snapshot is still caught as a collision.
+
+#ifndef NGROM_OUTDIR_H
+#define NGROM_OUTDIR_H
+
+#include<sys/stat.h> // for struct stat
+#include<mutex>
+#include<string>
+#include<unordered_set>
+
+namespace NGROM_NS
+{
+   // --------------------------------------------------------------------------
+   // Class: OutputDirectory
+   // Description: An open output directory and the snapshot of its names.
+   //              Thread-safe.
+   // --------------------------------------------------------------------------
+   class OutputDirectory
+   {
+   public:
+      OutputDirectory();
+      ~OutputDirectory();
+
+      bool open(const std::string& path);
+
+      int statOutput(const std::string& name, struct stat& outStat) const;
+      int createOutput(const std::string& name, bool exclusive);
+      int removeOutput(const std::string& name);
+      void addName(const std::string& name);
+
+      OutputDirectory(const OutputDirectory&) = delete;
+      OutputDirectory& operator=(const OutputDirectory&) = delete;
+
+   private:
+      bool hasName(const std::string& name) const;
+
+      int m_fd;
+      mutable std::mutex m_mutex; // Guards m_names
+      std::unordered_set<std::string> m_names; // Names that may exist (snapshot, plus outputs made since)
+   };
+}
+
+#endif // NGROM_OUTDIR_H
@@ -0,0 +1,900 @@
+// New GROM - Output files (plain, or compressed as they are written)
+
+#include "ngrom_output.h"
+#include "ngrom_cache.h"
+#include "ngrom_durable.h"
+#include "ngrom_hash.h"
+#include "ngrom_trace.h"
+#include<deque>
+#include<future>
+#include<memory>
+#include<mutex>
+#include<condition_variable>
+#include<thread>
+#include<vector>
+#include<errno.h>
+#include<stdlib.h> // for strtol
+#include<string.h>
+#include<fcntl.h>      // for open, fcntl, fallocate
+#include<unistd.h>     // for write, close, unlink
+#include<sys/stat.h>   // for fstat
+#include<zlib.h>
+#ifdef NGROM_HAVE_ZSTD
+#include<zstd.h>
+#endif
+
+// Uncompressed bytes per independently compressed chunk (as pigz; zstd
+// frames don't share history, so they're bigger).
+static const size_t GZIP_CHUNK_BYTES = 128 * 1024;
+static const size_t ZSTD_CHUNK_BYTES = 512 * 1024;
+
+// Deflate history carried into the next chunk
+static const size_t DEFLATE_WINDOW_BYTES = 32 * 1024;
+
+// Compression levels
+static const int GZIP_DEFAULT_LEVEL = 6;
+static const int GZIP_MAX_LEVEL = 9;
+static const int ZSTD_DEFAULT_LEVEL = 3;
+static const int ZSTD_MAX_LEVEL = 19;
+
+namespace
+{
+   // One chunk to compress (and its result)
+   struct CompressJob
+   {
+      NGROM_NS::OutputCompression compression;
+      int level;
+      bool last;
+      std::vector<unsigned char> input;
+      std::vector<unsigned char> dictionary; // gzip: end of the previous chunk
+      std::vector<unsigned char> output;
+      uLong crc;                             // gzip: CRC32 of input
+      std::promise<bool> result;
+   };
+
+   // -------------------------------------------------------------------------
+   // Class: CompressPool
+   // Description: Threads compressing the chunks of all compressed outputs.
+   // -------------------------------------------------------------------------
+   class CompressPool
+   {
+   public:
+      static CompressPool& instance();
+
+      void submit(const std::shared_ptr<CompressJob>& job);
+      unsigned int numThreads() const { return m_threads.size(); }
+
+   private:
+      CompressPool();
+      ~CompressPool();
+      void work();
+
+      std::mutex m_mutex;
+      std::condition_variable m_cond;
+      std::deque<std::shared_ptr<CompressJob> > m_jobs;
+      bool m_stopping;
+      std::vector<std::thread> m_threads;
+   };
+}
+
+namespace NGROM_NS
+{
+   // --------------------------------------------------------------------------
+   // Class: BlockCompressor
+   // Description: Cuts the data written to a compressed output into chunks,
+   //              has the pool compress them, and writes the results in order.
+   // --------------------------------------------------------------------------
+   class BlockCompressor
+   {
+   public:
+      BlockCompressor(int fd, OutputCompression compression, int level);
+      ~BlockCompressor();
+
+      bool start();
+      ssize_t write(const char* bytes, size_t numBytes);
+      bool finish();
+      uint64_t numBytesWritten() const { return m_numBytesWritten; }
+      int fd() const { return m_fd; }
+
+      BlockCompressor(const BlockCompressor&) = delete;
+      BlockCompressor& operator=(const BlockCompressor&) = delete;
+
+   private:
+      struct PendingChunk
+      {
+         std::shared_ptr<CompressJob> job;
+         std::future<bool> result;
+      };
+
+      bool submitChunk(bool last);
+      bool writeOldestChunk();
+      bool writeFully(const unsigned char* bytes, size_t numBytes);
+
+      int m_fd;
+      OutputCompression m_compression;
+      int m_level;
+      size_t m_chunkBytes;
+      std::vector<unsigned char> m_chunk;  // Being filled
+      std::vector<unsigned char> m_window; // gzip: end of the last chunk submitted
+      std::deque<PendingChunk> m_pending;  // Submitted, not yet written
+      uLong m_crc;
+      uint64_t m_numBytesIn;
+      uint64_t m_numBytesWritten;
+      int m_errno; // First error (0 = none)
+   };
+}
+
+// -----------------------------------------------------------------------------
+// Function: compressChunk
+// Description: Compresses one chunk (on a pool thread).  A gzip chunk is raw
+//              deflate data ending on a byte boundary (sync flush), or with
+//              the final block if it's the last chunk.
+// Return: true if compressed; false on error.
+// -----------------------------------------------------------------------------
+static bool compressChunk(CompressJob& job)
+{
+   NGROM_NS::TraceSpan compressSpan("compress chunk", "cpu");
+
+#ifdef NGROM_HAVE_ZSTD
+   if (job.compression == NGROM_NS::ZSTD_COMPRESSION)
+   {
+      job.output.resize(ZSTD_compressBound(job.input.size()));
+      size_t rc = ZSTD_compress(job.output.data(), job.output.size(), job.input.data(), job.input.size(), job.level);
+      if (ZSTD_isError(rc))
+      {
+         return false;
+      }
+      job.output.resize(rc);
+      return true;
+   }
+#endif
+
+   z_stream zstream;
+   memset(&zstream, 0, sizeof(zstream));
+   if (Z_OK != deflateInit2(&zstream, job.level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY))
+   {
+      return false;
+   }
+
+   bool retval = true;
+   if (!job.dictionary.empty())
+   {
+      retval = (Z_OK == deflateSetDictionary(&zstream, job.dictionary.data(), job.dictionary.size()));
+   }
+
+   int flush = job.last ? Z_FINISH : Z_SYNC_FLUSH;
+   size_t numOut = 0;
+   job.output.resize(deflateBound(&zstream, job.input.size()) + 16);
+   zstream.next_in = job.input.data();
+   zstream.avail_in = job.input.size();
+
+   while (retval)
+   {
+      zstream.next_out = job.output.data() + numOut;
+      zstream.avail_out = job.output.size() - numOut;
+
+      int rc = deflate(&zstream, flush);
+      numOut = job.output.size() - zstream.avail_out;
+
+      if (rc == Z_STREAM_END)
+      {
+         break; // Last chunk done
+      }
+      else if (zstream.avail_out > 0)
+      {
+         // (Room left over means the flush is complete.)
+         retval = (flush == Z_SYNC_FLUSH) && (rc == Z_OK);
+         break;
+      }
+
+      job.output.resize(job.output.size() * 2);
+   }
+
+   deflateEnd(&zstream);
+   job.output.resize(numOut);
+   job.crc = crc32(crc32(0L, Z_NULL, 0), job.input.data(), job.input.size());
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: CompressPool::instance
+// Description: Gets the pool (started on first use: one thread per CPU).
+// -----------------------------------------------------------------------------
+CompressPool& CompressPool::instance()
+{
+   static CompressPool s_pool;
+   return s_pool;
+}
+
+// -----------------------------------------------------------------------------
+// Function: CompressPool::CompressPool
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+CompressPool::CompressPool()
+ : m_stopping(false)
+{
+   unsigned int numThreads = std::thread::hardware_concurrency();
+   for (unsigned int i = 0; (i < numThreads) || (i == 0); i++)
+   {
+      m_threads.push_back(std::thread(&CompressPool::work, this));
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: CompressPool::~CompressPool
+// Description: Destructor (at exit).
+// -----------------------------------------------------------------------------
+CompressPool::~CompressPool()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+      m_cond.notify_all();
+   }
+
+   for (std::thread& thread : m_threads)
+   {
+      thread.join();
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: CompressPool::submit
+// Description: Queues a chunk; its result is set once it's compressed.
+// -----------------------------------------------------------------------------
+void CompressPool::submit(const std::shared_ptr<CompressJob>& job)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_jobs.push_back(job);
+   m_cond.notify_one();
+}
+
+// -----------------------------------------------------------------------------
+// Function: CompressPool::work
+// Description: Thread body: compresses queued chunks.
+// -----------------------------------------------------------------------------
+void CompressPool::work()
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+   for (;;)
+   {
+      m_cond.wait(lock, [this] { return !m_jobs.empty() || m_stopping; });
+      if (m_jobs.empty())
+      {
+         break; // Stopping
+      }
+
+      std::shared_ptr<CompressJob> job = m_jobs.front();
+      m_jobs.pop_front();
+
+      lock.unlock();
+      job->result.set_value(compressChunk(*job));
+      lock.lock();
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: BlockCompressor::BlockCompressor
+// Description: Constructor.  The fd is owned (closed) by the BlockCompressor.
+// -----------------------------------------------------------------------------
+NGROM_NS::BlockCompressor::BlockCompressor(int fd, OutputCompression compression, int level)
+ : m_fd(fd),
+   m_compression(compression),
+   m_level(level),
+   m_chunkBytes((compression == ZSTD_COMPRESSION) ? ZSTD_CHUNK_BYTES : GZIP_CHUNK_BYTES),
+   m_crc(crc32(0L, Z_NULL, 0)),
+   m_numBytesIn(0),
+   m_numBytesWritten(0),
+   m_errno(0)
+{
+   m_chunk.reserve(m_chunkBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: BlockCompressor::~BlockCompressor
+// Description: Destructor; waits for any chunks still being compressed.
+// -----------------------------------------------------------------------------
+NGROM_NS::BlockCompressor::~BlockCompressor()
+{
+   for (PendingChunk& pending : m_pending)
+   {
+      pending.result.wait();
+   }
+
+   if (m_fd >= 0)
+   {
+      ::close(m_fd);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: BlockCompressor::writeFully
+// Description: Writes bytes to the output file.
+// Return: true if written; false on error (m_errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::BlockCompressor::writeFully(const unsigned char* bytes, size_t numBytes)
+{
+   while (numBytes > 0)
+   {
+      ssize_t rc = ::write(m_fd, bytes, numBytes);
+      if (rc < 0)
+      {
+         if (errno == EINTR) { continue; }
+         m_errno = errno;
+         return false;
+      }
+      bytes += rc;
+      numBytes -= rc;
+      m_numBytesWritten += rc;
+   }
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: BlockCompressor::start
+// Description: Writes the gzip header (zstd frames have their own).
+// Return: true if written; false on error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::BlockCompressor::start()
+{
+   if (m_compression != GZIP_COMPRESSION)
+   {
+      return true;
+   }
+
+   // Magic, deflate, no flags, no mtime, no extra flags, OS = Unix
+   static const unsigned char gzipHeader[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 3 };
+   return writeFully(gzipHeader, sizeof(gzipHeader));
+}
+
+// -----------------------------------------------------------------------------
+// Function: BlockCompressor::writeOldestChunk
+// Description: Waits for the oldest submitted chunk and writes it.
+// Return: true if written; false on error (m_errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::BlockCompressor::writeOldestChunk()
+{
+   PendingChunk pending = std::move(m_pending.front());
+   m_pending.pop_front();
+
+   // (Waiting here means the pool is behind.)
+   NGROM_NS::TraceSpan waitSpan("wait for compress", "wait");
+   bool compressed = pending.result.get();
+   waitSpan.end();
+
+   if (!compressed)
+   {
+      m_errno = EIO;
+      return false;
+   }
+
+   m_crc = crc32_combine(m_crc, pending.job->crc, pending.job->input.size());
+   return writeFully(pending.job->output.data(), pending.job->output.size());
+}
+
+// -----------------------------------------------------------------------------
+// Function: BlockCompressor::submitChunk
+// Description: Hands the current chunk to the pool, first writing finished
+//              chunks while too many are in flight (this output's share of
+//              the pool).
+// Return: true if submitted; false on error.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::BlockCompressor::submitChunk(bool last)
+{
+   std::shared_ptr<CompressJob> job = std::make_shared<CompressJob>();
+   job->compression = m_compression;
+   job->level = m_level;
+   job->last = last;
+   job->crc = 0;
+   job->input.swap(m_chunk);
+   job->dictionary = m_window;
+
+   if (m_compression == GZIP_COMPRESSION)
+   {
+      size_t keepBytes = (job->input.size() < DEFLATE_WINDOW_BYTES) ? job->input.size() : DEFLATE_WINDOW_BYTES;
+      m_window.assign(job->input.end() - keepBytes, job->input.end());
+   }
+
+   m_numBytesIn += job->input.size();
+   m_chunk.clear();
+   m_chunk.reserve(m_chunkBytes);
+
+   PendingChunk pending;
+   pending.job = job;
+   pending.result = job->result.get_future();
+   m_pending.push_back(std::move(pending));
+   CompressPool::instance().submit(job);
+
+   while (m_pending.size() > (2 * CompressPool::instance().numThreads()))
+   {
+      if (!writeOldestChunk())
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: BlockCompressor::write
+// Description: Takes uncompressed data (the FILE* stream's write function).
+// Return: numBytes, or -1 on error.
+// -----------------------------------------------------------------------------
+ssize_t NGROM_NS::BlockCompressor::write(const char* bytes, size_t numBytes)
+{
+   const unsigned char* nextBytes = reinterpret_cast<const unsigned char*>(bytes);
+   size_t numLeft = numBytes;
+
+   while ((m_errno == 0) && (numLeft > 0))
+   {
+      size_t numCopied = m_chunkBytes - m_chunk.size();
+      if (numCopied > numLeft)
+      {
+         numCopied = numLeft;
+      }
+      m_chunk.insert(m_chunk.end(), nextBytes, nextBytes + numCopied);
+      nextBytes += numCopied;
+      numLeft -= numCopied;
+
+      if ((m_chunk.size() == m_chunkBytes) && !submitChunk(false))
+      {
+         break;
+      }
+   }
+
+   if (m_errno != 0)
+   {
+      errno = m_errno;
+      return -1;
+   }
+   return numBytes;
+}
+
+// -----------------------------------------------------------------------------
+// Function: BlockCompressor::finish
+// Description: Compresses the last chunk, writes everything (and the gzip
+//              trailer), and closes the file.
+// Return: true if the whole output was written; false on error (errno is
+//         set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::BlockCompressor::finish()
+{
+   bool retval = (m_errno == 0) && submitChunk(true);
+
+   while (retval && !m_pending.empty())
+   {
+      retval = writeOldestChunk();
+   }
+
+   if (retval && (m_compression == GZIP_COMPRESSION))
+   {
+      // CRC32 and size (mod 2^32) of the uncompressed data
+      unsigned char gzipTrailer[8];
+      for (int i = 0; i < 4; i++)
+      {
+         gzipTrailer[i] = (m_crc >> (8 * i)) & 0xFF;
+         gzipTrailer[4 + i] = (m_numBytesIn >> (8 * i)) & 0xFF;
+      }
+      retval = writeFully(gzipTrailer, sizeof(gzipTrailer));
+   }
+
+   if ((0 != ::close(m_fd)) && retval)
+   {
+      m_errno = errno;
+      retval = false;
+   }
+   m_fd = -1;
+
+   if (!retval)
+   {
+      errno = (m_errno != 0) ? m_errno : EIO;
+   }
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: blockCompressorWrite
+// Description: fopencookie write function.
+// -----------------------------------------------------------------------------
+static ssize_t blockCompressorWrite(void* cookie, const char* bytes, size_t numBytes)
+{
+   return static_cast<NGROM_NS::BlockCompressor*>(cookie)->write(bytes, numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputFile::OutputFile
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::OutputFile::OutputFile()
+ : m_file(NULL),
+   m_fileSize(0),
+   m_fileStat(),
+   m_compressor(NULL),
+   m_committer(NULL),
+   m_durableFd(-1)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputFile::~OutputFile
+// Description: Destructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::OutputFile::~OutputFile()
+{
+   close();
+   discardDurable();
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputFile::open
+// Description: Creates an output file (an existing one is unlinked and
+//              replaced by a new file, never rewritten in place: it may be a
+//              hardlink shared with other outputs); with compression, the
+//              data written to file() is compressed at the given level.  With
+//              a committer, the data goes to a temporary file instead (see
+//              commit()).
+// Return: true if opened; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::OutputFile::open(const std::string& filename, OutputCompression compression, int level,
+                                DurableCommitter* committer)
+{
+   close();
+   discardDurable();
+   m_filename = filename;
+   m_committer = committer;
+
+   int fd = -1;
+   if (committer == NULL)
+   {
+      if ((0 == unlink(filename.c_str())) || (errno == ENOENT))
+      {
+         fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+      }
+   }
+   else
+   {
+      fd = committer->createTempFile(filename, m_tempPath);
+      if (fd >= 0)
+      {
+         // (Kept for the commit; the stream or compressor closes fd.)
+         m_durableFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+         if (m_durableFd < 0)
+         {
+            int saved_errno = errno;
+            ::close(fd);
+            discardDurable();
+            errno = saved_errno;
+            return false;
+         }
+      }
+   }
+
+   if (fd < 0)
+   {
+      return false;
+   }
+
+   return attach(fd, compression, level);
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputFile::openCreated
+// Description: Like open (without a committer), for an output file the
+//              caller already created; fd is taken over (closed on error).
+// Return: true if opened; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::OutputFile::openCreated(int fd, const std::string& filename, OutputCompression compression, int level)
+{
+   close();
+   discardDurable();
+   m_filename = filename;
+   m_committer = NULL;
+
+   return attach(fd, compression, level);
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputFile::attach
+// Description: Sets up file() to write fd (compressed, if requested); fd is
+//              taken over (closed on error).
+// Return: true if set up; false on error (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::OutputFile::attach(int fd, OutputCompression compression, int level)
+{
+   if (compression == NO_COMPRESSION)
+   {
+      m_file = fdopen(fd, "w");
+      if (m_file == NULL)
+      {
+         int saved_errno = errno;
+         ::close(fd);
+         discardDurable();
+         errno = saved_errno;
+         return false;
+      }
+      return true;
+   }
+
+   m_compressor = new BlockCompressor(fd, compression, level);
+
+   cookie_io_functions_t cookieFunctions;
+   memset(&cookieFunctions, 0, sizeof(cookieFunctions));
+   cookieFunctions.write = blockCompressorWrite;
+
+   m_file = fopencookie(m_compressor, "w", cookieFunctions);
+   if ((m_file == NULL) || !m_compressor->start())
+   {
+      int saved_errno = errno;
+      close();
+      discardDurable();
+      errno = saved_errno;
+      return false;
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputFile::preallocate
+// Description: Allocates the blocks for an uncompressed output of numBytes
+//              before it's written (fallocate, keeping the file size as
+//              written so far, so a failed conversion never leaves a
+//              full-size file behind).  Nothing to do for a compressed
+//              output, whose size isn't known, or where the filesystem can't
+//              allocate ahead.
+// Return: true if allocated (or nothing to do); false on error (errno is
+//         set; e.g., ENOSPC).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::OutputFile::preallocate(uint64_t numBytes)
+{
+   if ((m_file == NULL) || (m_compressor != NULL) || (numBytes == 0))
+   {
+      return true;
+   }
+
+   int fd = fileno(m_file);
+   if (0 == fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, numBytes))
+   {
+      return true;
+   }
+
+   return (errno == EOPNOTSUPP) || (errno == ENOSYS);
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputFile::close
+// Description: Finishes and closes the output; fileSize() is then the size
+//              of the file written, and fileStat() its attributes.  With
+//              contentHash, the file written is hashed (read back while
+//              still in the page cache).  With a cacheDropper, the output is
+//              handed to it to be dropped from the page cache.
+// Return: true if all data was written (and hashed); false on error (errno
+//         is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::OutputFile::close(CacheDropper* cacheDropper, uint64_t* contentHash)
+{
+   bool retval = true;
+
+   // (Kept past the stream's close, for the file's attributes, hash, and cache.)
+   int keptFd = -1;
+   if (m_file != NULL)
+   {
+      int fd = (m_compressor != NULL) ? m_compressor->fd() : fileno(m_file);
+      keptFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+   }
+
+   if (m_file != NULL)
+   {
+      struct stat outStat;
+      if ((m_compressor == NULL) && (0 == fflush(m_file)) && (0 == fstat(fileno(m_file), &outStat)))
+      {
+         m_fileSize = outStat.st_size;
+      }
+
+      retval = (0 == fclose(m_file));
+      m_file = NULL;
+   }
+
+   if (m_compressor != NULL)
+   {
+      int saved_errno = errno;
+      bool finished = retval && m_compressor->finish();
+      if (!finished && retval)
+      {
+         saved_errno = errno;
+      }
+
+      m_fileSize = m_compressor->numBytesWritten();
+      delete m_compressor;
+      m_compressor = NULL;
+
+      retval = finished;
+      errno = saved_errno;
+   }
+
+   if (keptFd >= 0)
+   {
+      int saved_errno = errno;
+      if (0 != fstat(keptFd, &m_fileStat))
+      {
+         memset(&m_fileStat, 0, sizeof(m_fileStat));
+      }
+
+      if (retval && (contentHash != NULL))
+      {
+         // (Read through the page cache, even if written with direct I/O.)
+         int flags = fcntl(keptFd, F_GETFL);
+         if ((flags >= 0) && ((flags & O_DIRECT) != 0))
+         {
+            fcntl(keptFd, F_SETFL, flags & ~O_DIRECT);
+         }
+
+         retval = hashFd(keptFd, *contentHash);
+         saved_errno = errno;
+      }
+
+      if (cacheDropper != NULL)
+      {
+         cacheDropper->addOutput(keptFd);
+      }
+      else
+      {
+         ::close(keptFd);
+      }
+      errno = saved_errno;
+   }
+   else if (retval && (contentHash != NULL))
+   {
+      retval = false; // (Nothing was open, or the duplicate failed.)
+   }
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputFile::discard
+// Description: Closes (if still open) and removes an output that failed: a
+//              durable output's temporary file is thrown away; any other
+//              output is unlinked (with any blocks allocated ahead for it).
+// -----------------------------------------------------------------------------
+void NGROM_NS::OutputFile::discard()
+{
+   int saved_errno = errno;
+   close();
+
+   if (m_committer != NULL)
+   {
+      discardDurable();
+   }
+   else if (!m_filename.empty())
+   {
+      unlink(m_filename.c_str());
+   }
+   m_filename.clear();
+   errno = saved_errno;
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputFile::commit
+// Description: Hands a closed durable output to its committer, which puts it
+//              in place (and then calls onCommitted) with its group.
+// Return: true if handed over (and any group commit succeeded); false
+//         otherwise.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::OutputFile::commit(const std::function<bool()>& onCommitted)
+{
+   if ((m_committer == NULL) || (m_durableFd < 0))
+   {
+      return false;
+   }
+
+   int fd = m_durableFd;
+   std::string tempPath = m_tempPath;
+   m_durableFd = -1;
+   m_tempPath.clear();
+
+   return m_committer->add(fd, tempPath, m_filename, m_fileSize, onCommitted);
+}
+
+// -----------------------------------------------------------------------------
+// Function: OutputFile::discardDurable
+// Description: Throws away a durable output that wasn't committed.
+// -----------------------------------------------------------------------------
+void NGROM_NS::OutputFile::discardDurable()
+{
+   if (m_durableFd >= 0)
+   {
+      ::close(m_durableFd);
+      m_durableFd = -1;
+   }
+   if (!m_tempPath.empty())
+   {
+      unlink(m_tempPath.c_str());
+      m_tempPath.clear();
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: parseCompressSpec
+// Description: Parses "gzip" or "zstd", optionally followed by ":level".
+// Return: true if valid (and supported by this build); false otherwise.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::parseCompressSpec(const std::string& spec, OutputCompression& compression, int& level)
+{
+   std::string method = spec.substr(0, spec.find(':'));
+   int maxLevel = 0;
+
+   if (method == "gzip")
+   {
+      compression = GZIP_COMPRESSION;
+      level = GZIP_DEFAULT_LEVEL;
+      maxLevel = GZIP_MAX_LEVEL;
+   }
+#ifdef NGROM_HAVE_ZSTD
+   else if (method == "zstd")
+   {
+      compression = ZSTD_COMPRESSION;
+      level = ZSTD_DEFAULT_LEVEL;
+      maxLevel = ZSTD_MAX_LEVEL;
+   }
+#endif
+   else
+   {
+      return false;
+   }
+
+   if (method.length() < spec.length())
+   {
+      const char* levelString = spec.c_str() + method.length() + 1;
+      char* levelEnd = NULL;
+      long levelValue = strtol(levelString, &levelEnd, 10);
+      if ((*levelString == '\0') || (*levelEnd != '\0') || (levelValue < 1) || (levelValue > maxLevel))
+      {
+         return false;
+      }
+      level = levelValue;
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getOutputBufferBytes
+// Description: Gets the most memory an output's buffers can hold: the stream
+//              buffer, plus, when compressed, the chunk being filled and the
+//              chunks in flight (each with its compressed result and, for
+//              gzip, its dictionary).
+// -----------------------------------------------------------------------------
+uint64_t NGROM_NS::getOutputBufferBytes(OutputCompression compression)
+{
+   uint64_t numBytes = BUFSIZ;
+
+   if (compression != NO_COMPRESSION)
+   {
+      size_t chunkBytes = (compression == ZSTD_COMPRESSION) ? ZSTD_CHUNK_BYTES : GZIP_CHUNK_BYTES;
+      uint64_t numInFlight = (2 * CompressPool::instance().numThreads()) + 1;
+      numBytes += chunkBytes + (numInFlight * ((2 * chunkBytes) + DEFLATE_WINDOW_BYTES));
+   }
+
+   return numBytes;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getCompressionSuffix
+// Description: Gets the file name extension for an output compression.
+// -----------------------------------------------------------------------------
+const char* NGROM_NS::getCompressionSuffix(OutputCompression compression)
+{
+   const char* retval = "";
+
+   switch (compression)
+   {
+      case GZIP_COMPRESSION: retval = ".gz"; break;
+      case ZSTD_COMPRESSION: retval = ".zst"; break;
+      default: break;
+   }
+
+   return retval;
+}
@@ -0,0 +1,81 @@
+// New GROM - Output files (plain, or compressed as they are written)
+//
+// A compressed output is never written uncompressed: the BIN data written
+// to file() is cut into chunks that are compressed in parallel (by a pool
+// shared by all outputs, pigz/zstdmt style) and written in order.  A gzip
+// output is one gzip member, each chunk being raw deflate data primed with
+// the previous chunk's last 32 KB; a zstd output is a series of zstd frames.
+// Either way, standard tools decompress the result.
+
+#ifndef NGROM_OUTPUT_H
+#define NGROM_OUTPUT_H
+
+#include<stdint.h>
+#include<stdio.h>  // for FILE
+#include<sys/stat.h>
+#include<functional>
+#include<string>
+
+namespace NGROM_NS
+{
+   enum OutputCompression
+   {
+      NO_COMPRESSION,
+      GZIP_COMPRESSION,
+      ZSTD_COMPRESSION // Only with a zstd build (NGROM_HAVE_ZSTD)
+   };
+
+   class BlockCompressor;
+   class DurableCommitter;
+   class CacheDropper;
+
+   // --------------------------------------------------------------------------
+   // Class: OutputFile
+   // Description: An output file being written.  For compressed outputs,
+   //              file() is a write-only stream (fileno() is -1) of the
+   //              uncompressed data.  A durable output (opened with a
+   //              committer) is written to a temporary file, which commit()
+   //              hands to the committer after close(); it's thrown away if
+   //              not committed.
+   // --------------------------------------------------------------------------
+   class OutputFile
+   {
+   public:
+      OutputFile();
+      ~OutputFile();
+
+      bool open(const std::string& filename, OutputCompression compression, int level,
+                DurableCommitter* committer = NULL);
+      bool openCreated(int fd, const std::string& filename, OutputCompression compression, int level);
+      bool preallocate(uint64_t numBytes);
+      bool close(CacheDropper* cacheDropper = NULL, uint64_t* contentHash = NULL);
+      bool commit(const std::function<bool()>& onCommitted);
+      void discard();
+
+      FILE* file() const { return m_file; }
+      uint64_t fileSize() const { return m_fileSize; }
+      const struct stat& fileStat() const { return m_fileStat; }
+
+      OutputFile(const OutputFile&) = delete;
+      OutputFile& operator=(const OutputFile&) = delete;
+
+   private:
+      bool attach(int fd, OutputCompression compression, int level);
+      void discardDurable();
+
+      FILE* m_file;
+      uint64_t m_fileSize;      // (Set by close.)
+      struct stat m_fileStat;   // (Set by close.)
+      BlockCompressor* m_compressor;
+      std::string m_filename;
+      DurableCommitter* m_committer;
+      int m_durableFd;        // Durable output's file, kept open for the commit
+      std::string m_tempPath; // Durable output's temporary name (empty for O_TMPFILE)
+   };
+
+   bool parseCompressSpec(const std::string& spec, OutputCompression& compression, int& level);
+   const char* getCompressionSuffix(OutputCompression compression);
+   uint64_t getOutputBufferBytes(OutputCompression compression);
+}
+
+#endif // NGROM_OUTPUT_H
@@ -0,0 +1,430 @@
+// New GROM - Hardware performance counters (--perf-counters)
+
+#include "ngrom_perf.h"
+#include<atomic>
+#include<iomanip>
+#include<iostream> // for std::endl
+#include<memory>
+#include<mutex>
+#include<vector>
+#include<errno.h>
+#include<string.h>
+#include<unistd.h>      // for read, close, syscall
+#include<sys/syscall.h> // for SYS_perf_event_open
+#include<linux/perf_event.h>
+
+namespace
+{
+   // A counter to open, and how it's reported
+   struct CounterSpec
+   {
+      uint32_t type;
+      uint64_t config;
+      const char* reportName;
+      bool perByte; // Reported per byte (else per MB)
+   };
+
+   // -------------------------------------------------------------------------
+   // Struct: RegionTotals
+   // Description: A thread's counts for a region (only it writes them).
+   // -------------------------------------------------------------------------
+   struct RegionTotals
+   {
+      RegionTotals() : numBytes(0), numScopes(0)
+      {
+         for (unsigned int i = 0; i < NGROM_NS::PerfScope::MAX_COUNTERS; i++) { counts[i] = 0; }
+      }
+
+      std::atomic<uint64_t> counts[NGROM_NS::PerfScope::MAX_COUNTERS];
+      std::atomic<uint64_t> numBytes;
+      std::atomic<uint64_t> numScopes;
+   };
+
+   // -------------------------------------------------------------------------
+   // Class: PerfRegistry
+   // Description: Every thread's totals (kept after the thread ends).
+   // -------------------------------------------------------------------------
+   class PerfRegistry
+   {
+   public:
+      static PerfRegistry& instance();
+
+      RegionTotals* addThread();
+      void print(std::ostream& out);
+
+   private:
+      PerfRegistry() {}
+
+      std::mutex m_mutex; // Guards m_threads
+      std::vector<std::unique_ptr<RegionTotals[]> > m_threads;
+   };
+
+   // -------------------------------------------------------------------------
+   // Class: ThreadCounters
+   // Description: A thread's counter group (opened on first use; closed when
+   //              the thread ends).
+   // -------------------------------------------------------------------------
+   class ThreadCounters
+   {
+   public:
+      ThreadCounters();
+      ~ThreadCounters();
+
+      bool read(NGROM_NS::PerfScope::Reading& reading);
+      RegionTotals* totals() const { return m_totals; }
+
+   private:
+      bool open();
+
+      bool m_opened;
+      bool m_failed;
+      int m_fds[NGROM_NS::PerfScope::MAX_COUNTERS];
+      int m_slots[NGROM_NS::PerfScope::MAX_COUNTERS]; // Position of each counter in a group read (-1 = not opened)
+      unsigned int m_numOpened;
+      RegionTotals* m_totals;
+   };
+
+   thread_local ThreadCounters t_counters;
+}
+
+static const CounterSpec HARDWARE_COUNTERS[] =
+{
+   { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,    "cycles/B",       true },
+   { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,  "instr/B",        true },
+   { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,  "cache-miss/MB",  false },
+   { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch-miss/MB", false }
+};
+
+static const CounterSpec SOFTWARE_COUNTERS[] =
+{
+   { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK,       "cpu-ns/B",  true },
+   { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,      "faults/MB", false },
+   { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "ctx-sw/MB", false }
+};
+
+static const char* const REGION_NAMES[NGROM_NS::NUM_PERF_REGIONS] = { "file", "decode", "read", "write" };
+
+// Counters chosen by PerfCounterSession::start
+static const CounterSpec* s_counters = HARDWARE_COUNTERS;
+static unsigned int s_numCounters = 0;
+static bool s_excludeKernel = false;
+
+// Regions counted?
+static std::atomic<bool> s_perfEnabled(false);
+
+// -----------------------------------------------------------------------------
+// Function: openCounter
+// Description: Opens a counter of the calling thread (any CPU), in the group
+//              led by groupFd (-1 to lead a new group).
+// Return: The counter's fd, or -1 on error (errno is set).
+// -----------------------------------------------------------------------------
+static int openCounter(const CounterSpec& spec, int groupFd, bool excludeKernel)
+{
+   struct perf_event_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = spec.type;
+   attr.config = spec.config;
+   attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+   attr.exclude_kernel = excludeKernel ? 1 : 0;
+   attr.exclude_hv = 1;
+
+   return syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC);
+}
+
+// -----------------------------------------------------------------------------
+// Function: PerfRegistry::instance
+// Description: Gets the registry.
+// -----------------------------------------------------------------------------
+PerfRegistry& PerfRegistry::instance()
+{
+   static PerfRegistry s_registry;
+   return s_registry;
+}
+
+// -----------------------------------------------------------------------------
+// Function: PerfRegistry::addThread
+// Description: Registers a thread's (new) region totals.
+// -----------------------------------------------------------------------------
+RegionTotals* PerfRegistry::addThread()
+{
+   std::unique_ptr<RegionTotals[]> totals(new RegionTotals[NGROM_NS::NUM_PERF_REGIONS]);
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_threads.push_back(std::move(totals));
+   return m_threads.back().get();
+}
+
+// -----------------------------------------------------------------------------
+// Function: PerfRegistry::print
+// Description: Merges the threads' totals and prints each counted region's
+//              counts, normalized by its bytes (and IPC, with hardware
+//              counters).
+// -----------------------------------------------------------------------------
+void PerfRegistry::print(std::ostream& out)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   bool hardware = (s_counters == HARDWARE_COUNTERS);
+   std::ios_base::fmtflags savedFlags = out.flags();
+   std::streamsize savedPrecision = out.precision();
+   out << std::fixed << std::setprecision(2);
+
+   out << "NGROM perf counters (" << (hardware ? "hardware" : "software; no hardware counters available")
+       << (s_excludeKernel ? ", user only" : ", user and kernel") << "):" << std::endl;
+   out << "  Region         MB   Regions";
+   for (unsigned int i = 0; i < s_numCounters; i++)
+   {
+      out << std::setw(16) << s_counters[i].reportName;
+   }
+   out << (hardware ? "         IPC" : "") << std::endl;
+
+   for (unsigned int region = 0; region < NGROM_NS::NUM_PERF_REGIONS; region++)
+   {
+      uint64_t counts[NGROM_NS::PerfScope::MAX_COUNTERS] = { 0, 0, 0, 0 };
+      uint64_t numBytes = 0;
+      uint64_t numScopes = 0;
+      for (const std::unique_ptr<RegionTotals[]>& totals : m_threads)
+      {
+         for (unsigned int i = 0; i < s_numCounters; i++)
+         {
+            counts[i] += totals[region].counts[i];
+         }
+         numBytes += totals[region].numBytes;
+         numScopes += totals[region].numScopes;
+      }
+
+      if ((numScopes == 0) || (numBytes == 0))
+      {
+         continue;
+      }
+
+      out << "  " << std::left << std::setw(8) << REGION_NAMES[region] << std::right
+          << std::setw(10) << (numBytes / 1e6) << std::setw(10) << numScopes;
+      for (unsigned int i = 0; i < s_numCounters; i++)
+      {
+         out << std::setw(16) << (s_counters[i].perByte ? ((double)counts[i] / numBytes) : (counts[i] / (numBytes / 1e6)));
+      }
+      if (hardware)
+      {
+         out << std::setw(12) << ((counts[0] > 0) ? ((double)counts[1] / counts[0]) : 0.0);
+      }
+      out << std::endl;
+   }
+
+   out.flags(savedFlags);
+   out.precision(savedPrecision);
+}
+
+// -----------------------------------------------------------------------------
+// Function: ThreadCounters::ThreadCounters
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+ThreadCounters::ThreadCounters()
+ : m_opened(false),
+   m_failed(false),
+   m_numOpened(0),
+   m_totals(NULL)
+{
+   for (unsigned int i = 0; i < NGROM_NS::PerfScope::MAX_COUNTERS; i++)
+   {
+      m_fds[i] = -1;
+      m_slots[i] = -1;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: ThreadCounters::~ThreadCounters
+// Description: Destructor; closes the counters.
+// -----------------------------------------------------------------------------
+ThreadCounters::~ThreadCounters()
+{
+   for (unsigned int i = 0; i < NGROM_NS::PerfScope::MAX_COUNTERS; i++)
+   {
+      if (m_fds[i] >= 0)
+      {
+         close(m_fds[i]);
+      }
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: ThreadCounters::open
+// Description: Opens the thread's group: the first counter leads it; any
+//              other one the CPU lacks is left out.
+// Return: true if opened; false otherwise.
+// -----------------------------------------------------------------------------
+bool ThreadCounters::open()
+{
+   m_fds[0] = openCounter(s_counters[0], -1, s_excludeKernel);
+   if (m_fds[0] < 0)
+   {
+      return false;
+   }
+   m_slots[0] = m_numOpened++;
+
+   for (unsigned int i = 1; i < s_numCounters; i++)
+   {
+      m_fds[i] = openCounter(s_counters[i], m_fds[0], s_excludeKernel);
+      if (m_fds[i] >= 0)
+      {
+         m_slots[i] = m_numOpened++;
+      }
+   }
+
+   m_totals = PerfRegistry::instance().addThread();
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: ThreadCounters::read
+// Description: Reads the thread's counters (opening them on first use).
+// Return: true if read; false if the thread can't count.
+// -----------------------------------------------------------------------------
+bool ThreadCounters::read(NGROM_NS::PerfScope::Reading& reading)
+{
+   if (!m_opened && !m_failed)
+   {
+      m_opened = open();
+      m_failed = !m_opened;
+   }
+   if (!m_opened)
+   {
+      return false;
+   }
+
+   // { nr, time_enabled, time_running, values[nr] }
+   uint64_t groupValues[3 + NGROM_NS::PerfScope::MAX_COUNTERS];
+   ssize_t numBytesRead = ::read(m_fds[0], groupValues, sizeof(groupValues));
+   if (numBytesRead < (ssize_t)((3 + m_numOpened) * sizeof(uint64_t)))
+   {
+      return false;
+   }
+
+   reading.timeEnabled = groupValues[1];
+   reading.timeRunning = groupValues[2];
+   for (unsigned int i = 0; i < NGROM_NS::PerfScope::MAX_COUNTERS; i++)
+   {
+      reading.values[i] = (m_slots[i] >= 0) ? groupValues[3 + m_slots[i]] : 0;
+   }
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: PerfCounterSession::PerfCounterSession
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::PerfCounterSession::PerfCounterSession(std::ostream& out)
+ : m_out(out),
+   m_started(false)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: PerfCounterSession::~PerfCounterSession
+// Description: Destructor; turns the counters off and prints the report.
+// -----------------------------------------------------------------------------
+NGROM_NS::PerfCounterSession::~PerfCounterSession()
+{
+   if (m_started)
+   {
+      s_perfEnabled = false;
+      PerfRegistry::instance().print(m_out);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: PerfCounterSession::start
+// Description: Picks the counters this system allows: hardware ones if it
+//              has them, else software ones; counting the kernel's work for
+//              the thread too, unless perf_event_paranoid forbids it.  Then
+//              turns them on.
+// Return: true if on; false (with a warning to err) if no counters can be
+//         opened.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::PerfCounterSession::start(std::ostream& err)
+{
+   struct CounterSet { const CounterSpec* counters; unsigned int numCounters; };
+   const CounterSet counterSets[2] =
+   {
+      { HARDWARE_COUNTERS, sizeof(HARDWARE_COUNTERS) / sizeof(HARDWARE_COUNTERS[0]) },
+      { SOFTWARE_COUNTERS, sizeof(SOFTWARE_COUNTERS) / sizeof(SOFTWARE_COUNTERS[0]) }
+   };
+
+   int saved_errno = 0;
+   for (const CounterSet& counterSet : counterSets)
+   {
+      for (bool excludeKernel : { false, true })
+      {
+         int fd = openCounter(counterSet.counters[0], -1, excludeKernel);
+         if (fd >= 0)
+         {
+            close(fd);
+            s_counters = counterSet.counters;
+            s_numCounters = counterSet.numCounters;
+            s_excludeKernel = excludeKernel;
+            s_perfEnabled = true;
+            m_started = true;
+            return true;
+         }
+
+         // (Only a permission error is worth retrying for user mode only.)
+         saved_errno = errno;
+         if ((saved_errno != EACCES) && (saved_errno != EPERM))
+         {
+            break;
+         }
+      }
+   }
+
+   err << "NGROM WARNING: Performance counters not available (" << strerror(saved_errno)
+       << "; see /proc/sys/kernel/perf_event_paranoid); continuing without them." << std::endl;
+   return false;
+}
+
+// -----------------------------------------------------------------------------
+// Function: PerfScope::PerfScope
+// Description: Constructor; starts counting (if the counters are on).
+// -----------------------------------------------------------------------------
+NGROM_NS::PerfScope::PerfScope(PerfRegion region, uint64_t numBytes)
+ : m_counting(false),
+   m_region(region),
+   m_numBytes(numBytes)
+{
+   if (s_perfEnabled.load(std::memory_order_relaxed))
+   {
+      m_counting = t_counters.read(m_start);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: PerfScope::stop
+// Description: Stops counting; adds the counts (scaled up if the counters
+//              were multiplexed) and bytes to the thread's region totals.
+// -----------------------------------------------------------------------------
+void NGROM_NS::PerfScope::stop()
+{
+   if (!m_counting)
+   {
+      return;
+   }
+   m_counting = false;
+
+   Reading end;
+   if (!t_counters.read(end))
+   {
+      return;
+   }
+
+   uint64_t timeEnabled = end.timeEnabled - m_start.timeEnabled;
+   uint64_t timeRunning = end.timeRunning - m_start.timeRunning;
+   double scale = ((timeRunning > 0) && (timeRunning < timeEnabled)) ? ((double)timeEnabled / timeRunning) : 1.0;
+
+   RegionTotals& totals = t_counters.totals()[m_region];
+   for (unsigned int i = 0; i < MAX_COUNTERS; i++)
+   {
+      uint64_t count = (uint64_t)((end.values[i] - m_start.values[i]) * scale);
+      totals.counts[i].store(totals.counts[i].load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+   }
+   totals.numBytes.store(totals.numBytes.load(std::memory_order_relaxed) + m_numBytes, std::memory_order_relaxed);
+   totals.numScopes.store(totals.numScopes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
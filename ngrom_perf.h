@@ -0,0 +1,87 @@
+// New GROM - Hardware performance counters (--perf-counters)
+//
+// Each thread opens its own perf_event_open group (cycles, instructions,
+// cache misses, branch misses), counting only itself, and reads the group
+// (one read() of all counters) at the start and end of each measured region:
+// the decodeSMDBlock calls (and MGD and word-swap decoding), the reads and
+// writes of file data, and whole-file conversions.  The regions' counts and
+// bytes are summed per thread and reported at the end, normalized per byte
+// or MB.  Where hardware counters aren't available (e.g., in a VM), software
+// ones (task clock, page faults, context switches) are used; where
+// perf_event_paranoid allows neither, a warning says so and the run goes on
+// without.  With the counters off, a region costs one flag check.
+
+#ifndef NGROM_PERF_H
+#define NGROM_PERF_H
+
+#include<stdint.h>
+#include<iosfwd>
+
+namespace NGROM_NS
+{
+   enum PerfRegion
+   {
+      FILE_REGION,   // Whole-file conversion
+      DECODE_REGION, // decodeSMDBlock calls (or MGD / word-swap decoding)
+      READ_REGION,   // Reads of input data
+      WRITE_REGION,  // Writes of BIN data
+      NUM_PERF_REGIONS
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: PerfCounterSession
+   // Description: The counters of a run: start() checks they can be opened
+   //              and turns them on; the report is printed on destruction.
+   // --------------------------------------------------------------------------
+   class PerfCounterSession
+   {
+   public:
+      explicit PerfCounterSession(std::ostream& out);
+      ~PerfCounterSession();
+
+      bool start(std::ostream& err);
+
+      PerfCounterSession(const PerfCounterSession&) = delete;
+      PerfCounterSession& operator=(const PerfCounterSession&) = delete;
+
+   private:
+      std::ostream& m_out;
+      bool m_started;
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: PerfScope
+   // Description: Counts a region on the calling thread, from construction
+   //              to stop() (or destruction), for numBytes of data.
+   // --------------------------------------------------------------------------
+   class PerfScope
+   {
+   public:
+      PerfScope(PerfRegion region, uint64_t numBytes);
+      ~PerfScope() { stop(); }
+
+      void setBytes(uint64_t numBytes) { m_numBytes = numBytes; }
+      void stop();
+
+      PerfScope(const PerfScope&) = delete;
+      PerfScope& operator=(const PerfScope&) = delete;
+
+      static const unsigned int MAX_COUNTERS = 4;
+
+      // A read of the thread's counter group
+      struct Reading
+      {
+         uint64_t values[MAX_COUNTERS];
+         uint64_t timeEnabled; // (Times let multiplexed counts be scaled.)
+         uint64_t timeRunning;
+      };
+
+   private:
+      bool m_counting;
+      PerfRegion m_region;
+      uint64_t m_numBytes;
+      Reading m_start;
+   };
+}
+
+#endif // NGROM_PERF_H
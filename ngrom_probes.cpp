@@ -0,0 +1,71 @@
+// New GROM - Static (USDT) tracepoints
+
+#include "ngrom_probes.h"
+
+#if NGROM_PROBES
+// (A tracer finds each semaphore through its probes' notes, and raises it.)
+#define NGROM_PROBE_SEMAPHORE(name) \
+   volatile unsigned short ngrom_##name##_semaphore __attribute__((section(".probes"), used)) = 0
+
+extern "C"
+{
+   NGROM_PROBE_SEMAPHORE(file__start);
+   NGROM_PROBE_SEMAPHORE(header__parsed);
+   NGROM_PROBE_SEMAPHORE(block__decoded);
+   NGROM_PROBE_SEMAPHORE(write__complete);
+   NGROM_PROBE_SEMAPHORE(collision__skip);
+   NGROM_PROBE_SEMAPHORE(file__end);
+}
+#endif
+
+// Name of the file the thread is handling (for probes without one at hand)
+static thread_local const char* t_probeFilename = "";
+
+// -----------------------------------------------------------------------------
+// Function: getProbeFilename
+// Description: Gets the name of the file the calling thread is handling ("" if
+//              none).
+// -----------------------------------------------------------------------------
+const char* NGROM_NS::getProbeFilename()
+{
+   return t_probeFilename;
+}
+
+// -----------------------------------------------------------------------------
+// Function: FileProbe::FileProbe
+// Description: Constructor; fires file__start.
+// -----------------------------------------------------------------------------
+NGROM_NS::FileProbe::FileProbe(const char* pass, const std::string& filename)
+ : m_pass(pass),
+   m_filename(filename),
+   m_outerFilename(t_probeFilename),
+   m_numBytes(0),
+   m_status(PROBE_FAILED)
+{
+   t_probeFilename = m_filename.c_str();
+
+#if NGROM_PROBES
+   if (NGROM_PROBE_ENABLED(file__start))
+   {
+      NGROM_PROBE(file__start, "8@%0 8@%1", "r"(m_pass), "r"(t_probeFilename));
+   }
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// Function: FileProbe::~FileProbe
+// Description: Destructor; fires file__end.
+// -----------------------------------------------------------------------------
+NGROM_NS::FileProbe::~FileProbe()
+{
+#if NGROM_PROBES
+   if (NGROM_PROBE_ENABLED(file__end))
+   {
+      int64_t status = m_status;
+      NGROM_PROBE(file__end, "8@%0 8@%1 8@%2 -8@%3",
+                  "r"(m_pass), "r"(t_probeFilename), "r"(m_numBytes), "r"(status));
+   }
+#endif
+
+   t_probeFilename = m_outerFilename;
+}
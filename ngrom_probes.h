@@ -0,0 +1,192 @@
+// New GROM - Static (USDT) tracepoints
+//
+// Probes of provider "ngrom", for attaching bpftrace (or perf, SystemTap) to
+// a running ngrom, e.g.:
+//
+//    bpftrace -p PID -e 'usdt:./ngrom:ngrom:file__start { @s[tid] = nsecs; }
+//       usdt:./ngrom:ngrom:file__end /@s[tid]/ {
+//          @us[str(arg0)] = hist((nsecs - @s[tid]) / 1000); delete(@s[tid]); }'
+//
+//    file__start     (pass, filename)
+//    header__parsed  (pass, filename, bytes = file size, status = RomFormat)
+//    block__decoded  (filename, bytes, offset = output offset)
+//    write__complete (filename, bytes = output size, status)
+//    collision__skip (filename, outputPath)
+//    file__end       (pass, filename, bytes = input size, status)
+//
+// pass is "check", "convert", or "info"; status is a ProbeStatus, unless
+// noted.  The probes are recorded the sys/sdt.h way (a nop, and a
+// .note.stapsdt ELF note giving its address and argument locations), each
+// with a semaphore that the tracer raises while attached: with no tracer, a
+// probe costs one (untaken) test of its semaphore.  Without x86-64 or AArch64
+// Linux (or with NGROM_NO_PROBES defined), the probes compile to nothing.
+
+#ifndef NGROM_PROBES_H
+#define NGROM_PROBES_H
+
+#include<stdint.h>
+#include<string>
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__)) && !defined(NGROM_NO_PROBES)
+#define NGROM_PROBES 1
+#else
+#define NGROM_PROBES 0
+#endif
+
+#if NGROM_PROBES
+// Semaphores (counts of attached tracers), in the ".probes" section
+extern "C"
+{
+   extern volatile unsigned short ngrom_file__start_semaphore;
+   extern volatile unsigned short ngrom_header__parsed_semaphore;
+   extern volatile unsigned short ngrom_block__decoded_semaphore;
+   extern volatile unsigned short ngrom_write__complete_semaphore;
+   extern volatile unsigned short ngrom_collision__skip_semaphore;
+   extern volatile unsigned short ngrom_file__end_semaphore;
+}
+
+// Is a tracer attached to the probe?
+#define NGROM_PROBE_ENABLED(name) __builtin_expect(ngrom_##name##_semaphore != 0, 0)
+
+// The probe point: a nop, described by a stapsdt note (as sys/sdt.h makes
+// them).  args is the argument locations (e.g., "8@%0 -8@%1": size, signed if
+// negative, @ operand), for the "r" operands that follow.
+#define NGROM_PROBE(name, args, ...) \
+   __asm__ __volatile__("990: nop\n" \
+                        ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+                        ".balign 4\n" \
+                        ".4byte 992f-991f, 994f-993f, 3\n" \
+                        "991: .asciz \"stapsdt\"\n" \
+                        "992: .balign 4\n" \
+                        "993: .8byte 990b\n" \
+                        ".8byte _.stapsdt.base\n" \
+                        ".8byte ngrom_" #name "_semaphore\n" \
+                        ".asciz \"ngrom\"\n" \
+                        ".asciz \"" #name "\"\n" \
+                        ".asciz \"" args "\"\n" \
+                        "994: .balign 4\n" \
+                        ".popsection\n" \
+                        ".ifndef _.stapsdt.base\n" \
+                        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+                        ".weak _.stapsdt.base\n" \
+                        ".hidden _.stapsdt.base\n" \
+                        "_.stapsdt.base: .space 1\n" \
+                        ".size _.stapsdt.base, 1\n" \
+                        ".popsection\n" \
+                        ".endif\n" \
+                        : : __VA_ARGS__)
+#endif
+
+namespace NGROM_NS
+{
+   enum ProbeStatus
+   {
+      PROBE_OK = 0,
+      PROBE_FAILED = 1
+   };
+
+   const char* getProbeFilename();
+
+   // --------------------------------------------------------------------------
+   // Class: FileProbe
+   // Description: Fires file__start on construction and file__end (with the
+   //              bytes and status set) on destruction, for the file the
+   //              calling thread is handling; meanwhile, its name is the
+   //              thread's probe filename.  pass must be a string literal.
+   // --------------------------------------------------------------------------
+   class FileProbe
+   {
+   public:
+      FileProbe(const char* pass, const std::string& filename);
+      ~FileProbe();
+
+      void setBytes(uint64_t numBytes) { m_numBytes = numBytes; }
+      void setStatus(ProbeStatus status) { m_status = status; }
+
+      FileProbe(const FileProbe&) = delete;
+      FileProbe& operator=(const FileProbe&) = delete;
+
+   private:
+      const char* m_pass;
+      const std::string& m_filename;
+      const char* m_outerFilename; // Thread's probe filename before this one
+      uint64_t m_numBytes;
+      ProbeStatus m_status;
+   };
+
+   // --------------------------------------------------------------------------
+   // Function: probeHeaderParsed
+   // Description: Fires header__parsed (status: the detected RomFormat).
+   // --------------------------------------------------------------------------
+   inline void probeHeaderParsed(const char* pass, const std::string& filename, uint64_t numBytes, int format)
+   {
+#if NGROM_PROBES
+      if (NGROM_PROBE_ENABLED(header__parsed))
+      {
+         int64_t status = format;
+         NGROM_PROBE(header__parsed, "8@%0 8@%1 8@%2 -8@%3",
+                     "r"(pass), "r"(filename.c_str()), "r"(numBytes), "r"(status));
+      }
+#else
+      (void)pass; (void)filename; (void)numBytes; (void)format;
+#endif
+   }
+
+   // --------------------------------------------------------------------------
+   // Function: probeBlockDecoded
+   // Description: Fires block__decoded, for numBytes decoded to the output
+   //              at outOffset (of the thread's probe file).
+   // --------------------------------------------------------------------------
+   inline void probeBlockDecoded(uint64_t numBytes, uint64_t outOffset)
+   {
+#if NGROM_PROBES
+      if (NGROM_PROBE_ENABLED(block__decoded))
+      {
+         const char* filename = getProbeFilename();
+         NGROM_PROBE(block__decoded, "8@%0 8@%1 8@%2",
+                     "r"(filename), "r"(numBytes), "r"(outOffset));
+      }
+#else
+      (void)numBytes; (void)outOffset;
+#endif
+   }
+
+   // --------------------------------------------------------------------------
+   // Function: probeWriteComplete
+   // Description: Fires write__complete, once an output file is written (and
+   //              closed).
+   // --------------------------------------------------------------------------
+   inline void probeWriteComplete(const std::string& outFilename, uint64_t numBytes, ProbeStatus status)
+   {
+#if NGROM_PROBES
+      if (NGROM_PROBE_ENABLED(write__complete))
+      {
+         int64_t statusValue = status;
+         NGROM_PROBE(write__complete, "8@%0 8@%1 -8@%2",
+                     "r"(outFilename.c_str()), "r"(numBytes), "r"(statusValue));
+      }
+#else
+      (void)outFilename; (void)numBytes; (void)status;
+#endif
+   }
+
+   // --------------------------------------------------------------------------
+   // Function: probeCollisionSkip
+   // Description: Fires collision__skip, when an input is skipped for its
+   //              output's collision with an existing file.
+   // --------------------------------------------------------------------------
+   inline void probeCollisionSkip(const std::string& filename, const std::string& outFilename)
+   {
+#if NGROM_PROBES
+      if (NGROM_PROBE_ENABLED(collision__skip))
+      {
+         NGROM_PROBE(collision__skip, "8@%0 8@%1",
+                     "r"(filename.c_str()), "r"(outFilename.c_str()));
+      }
+#else
+      (void)filename; (void)outFilename;
+#endif
+   }
+}
+
+#endif // NGROM_PROBES_H
@@ -0,0 +1,378 @@
+// New GROM - Collection scan
+
+#include "ngrom_scan.h"
+#include "ngrom.h"
+#include "ngrom_hash.h"
+#include "ngrom_input.h"
+#include "ngrom_index.h"
+#include "ngrom_walk.h"
+#include<stdio.h>  // for FILE I/O
+#include<iostream> // for std::cout and std::err
+#include<iomanip>  // for std::setw
+#include<sstream>
+#include<algorithm>
+#include<errno.h>
+#include<string.h>
+#include<fcntl.h>       // for openat
+#include<unistd.h>      // for close, pread
+#include<sys/stat.h>    // for stat, fstat
+#include<time.h>        // for clock_gettime
+
+// ROM size histogram: <= 128 KB, <= 256 KB, ... <= 4 MB, and larger.
+static const size_t NUM_SIZE_BUCKETS = 7;
+static const uint64_t SMALLEST_SIZE_BUCKET_BYTES = 128 * 1024;
+
+// Location of the checksum in the (BIN) ROM header, and start of the summed data
+static const size_t ROM_CHECKSUM_OFFSET = 0x18E;
+static const size_t ROM_CHECKSUM_START = 0x200;
+
+namespace
+{
+   // Totals for (part of) the scan
+   struct ScanStats
+   {
+      ScanStats()
+       : numDirs(0), numFiles(0), numBytes(0), numErrors(0),
+         numChecksumValid(0), numChecksumInvalid(0), numChecksumUnchecked(0),
+         numNoRegion(0)
+      {
+         memset(formatCounts, 0, sizeof(formatCounts));
+         memset(sizeCounts, 0, sizeof(sizeCounts));
+         memset(regionCounts, 0, sizeof(regionCounts));
+      }
+
+      void merge(const ScanStats& rhs);
+
+      uint64_t numDirs;
+      uint64_t numFiles;
+      uint64_t numBytes;
+      uint64_t numErrors;
+      uint64_t formatCounts[NGROM_NS::AUTO_FMT]; // Indexed by (detected) RomFormat
+      uint64_t sizeCounts[NUM_SIZE_BUCKETS];
+      uint64_t numChecksumValid;
+      uint64_t numChecksumInvalid;
+      uint64_t numChecksumUnchecked;
+      uint64_t regionCounts[3]; // Japan, USA, Europe
+      uint64_t numNoRegion;
+      std::vector<std::pair<uint64_t, uint64_t> > contents; // (size, hash) of each ROM
+   };
+}
+
+// -----------------------------------------------------------------------------
+// Function: ScanStats::merge
+// Description: Adds another thread's totals to these.
+// -----------------------------------------------------------------------------
+void ScanStats::merge(const ScanStats& rhs)
+{
+   numFiles += rhs.numFiles;
+   numBytes += rhs.numBytes;
+   for (size_t i = 0; i < NGROM_NS::AUTO_FMT; i++) { formatCounts[i] += rhs.formatCounts[i]; }
+   for (size_t i = 0; i < NUM_SIZE_BUCKETS; i++) { sizeCounts[i] += rhs.sizeCounts[i]; }
+   numChecksumValid += rhs.numChecksumValid;
+   numChecksumInvalid += rhs.numChecksumInvalid;
+   numChecksumUnchecked += rhs.numChecksumUnchecked;
+   for (size_t i = 0; i < 3; i++) { regionCounts[i] += rhs.regionCounts[i]; }
+   numNoRegion += rhs.numNoRegion;
+   contents.insert(contents.end(), rhs.contents.begin(), rhs.contents.end());
+}
+
+// -----------------------------------------------------------------------------
+// Function: readFully
+// Description: Reads numBytes from the start of the file.
+// Return: true if all bytes were read; false otherwise.
+// -----------------------------------------------------------------------------
+static bool readFully(int fd, unsigned char* bytes, size_t numBytes)
+{
+   size_t numRead = 0;
+   while (numRead < numBytes)
+   {
+      ssize_t rc = pread(fd, bytes + numRead, numBytes - numRead, numRead);
+      if (rc < 0)
+      {
+         if (errno == EINTR) { continue; }
+         return false;
+      }
+      if (rc == 0)
+      {
+         return false;
+      }
+      numRead += rc;
+   }
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: checkROMChecksum
+// Description: Decodes the file contents (as needed) and compares the sum of
+//              the ROM's 16-bit words from 0x200 on with the header checksum.
+// Return: true if the checksum matches; false otherwise.
+// -----------------------------------------------------------------------------
+static bool checkROMChecksum(NGROM_NS::RomFormat fmt, const unsigned char* fileBytes, uint64_t romSize,
+                             std::vector<unsigned char>& binBytes)
+{
+   const unsigned char* romBytes = fileBytes;
+
+   if (fmt != NGROM_NS::BIN)
+   {
+      binBytes.resize(romSize);
+      romBytes = binBytes.data();
+      decodeROMData(fmt, binBytes.data(), fileBytes, romSize);
+   }
+
+   uint16_t checksum = 0;
+   for (uint64_t offset = ROM_CHECKSUM_START; offset + 1 < romSize; offset += 2)
+   {
+      checksum += (uint16_t)((romBytes[offset] << 8) | romBytes[offset + 1]);
+   }
+
+   return (checksum == (uint16_t)((romBytes[ROM_CHECKSUM_OFFSET] << 8) | romBytes[ROM_CHECKSUM_OFFSET + 1]));
+}
+
+// -----------------------------------------------------------------------------
+// Function: inspectFile
+// Description: Adds one file (opened by the caller) to the totals.
+// Return: true if inspected; false on a read error.
+// -----------------------------------------------------------------------------
+static bool inspectFile(int fd, uint64_t fileSize, ScanStats& stats,
+                        std::vector<unsigned char>& fileBytes,
+                        std::vector<unsigned char>& binBytes)
+{
+   stats.numFiles++;
+   stats.numBytes += fileSize;
+
+   NGROM_NS::RomFormat fmt = NGROM_NS::UNK_FMT;
+   unsigned char binHeaderBytes[NUM_HEADER_BYTES];
+   memset(binHeaderBytes, 0, NUM_HEADER_BYTES);
+
+   if (fileSize >= NUM_HEADER_BYTES)
+   {
+      // (readROMHeader reads through an InputFile; the caller still owns fd.)
+      NGROM_NS::InputFile input;
+      int dupFd = dup(fd);
+      if ((dupFd < 0) || !input.openFd(dupFd))
+      {
+         return false;
+      }
+
+      if (!readROMHeader(input, binHeaderBytes, fmt))
+      {
+         fmt = NGROM_NS::UNK_FMT;
+      }
+      input.close();
+   }
+
+   uint64_t romSize = getROMSize(fmt, fileSize);
+   if ((fmt == NGROM_NS::UNK_FMT) || (romSize == 0))
+   {
+      stats.formatCounts[NGROM_NS::UNK_FMT]++;
+      return true;
+   }
+
+   stats.formatCounts[fmt]++;
+
+   size_t sizeBucket = 0;
+   while ((sizeBucket < NUM_SIZE_BUCKETS - 1) && (romSize > (SMALLEST_SIZE_BUCKET_BYTES << sizeBucket)))
+   {
+      sizeBucket++;
+   }
+   stats.sizeCounts[sizeBucket]++;
+
+   uint8_t regionMask = NGROM_NS::getRegionMask(binHeaderBytes + 0x1F0);
+   if (regionMask & NGROM_NS::REGION_JAPAN)  { stats.regionCounts[0]++; }
+   if (regionMask & NGROM_NS::REGION_USA)    { stats.regionCounts[1]++; }
+   if (regionMask & NGROM_NS::REGION_EUROPE) { stats.regionCounts[2]++; }
+   if (regionMask == 0) { stats.numNoRegion++; }
+
+   // The content hash and checksum both need the whole file.
+   fileBytes.resize(fileSize);
+   if (!readFully(fd, fileBytes.data(), fileSize))
+   {
+      stats.numChecksumUnchecked++;
+      return false;
+   }
+
+   stats.contents.push_back(std::make_pair(fileSize, NGROM_NS::ContentHasher::hash(fileBytes.data(), fileSize)));
+
+   if (romSize <= ROM_CHECKSUM_START)
+   {
+      stats.numChecksumUnchecked++;
+   }
+   else if (checkROMChecksum(fmt, fileBytes.data(), romSize, binBytes))
+   {
+      stats.numChecksumValid++;
+   }
+   else
+   {
+      stats.numChecksumInvalid++;
+   }
+
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: printCount
+// Description: Prints one report line: label, count, and percent of total.
+// -----------------------------------------------------------------------------
+static void printCount(const std::string& label, uint64_t count, uint64_t total)
+{
+   std::cout << "   " << std::left << std::setw(20) << label << std::right << std::setw(10) << count;
+   if (total > 0)
+   {
+      std::cout << std::setw(8) << std::fixed << std::setprecision(1) << (100.0 * count / total) << "%";
+   }
+   std::cout << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// Function: printReport
+// Description: Prints the aggregate report to STDOUT.
+// -----------------------------------------------------------------------------
+static void printReport(ScanStats& totals, double elapsedSec, unsigned int numThreads)
+{
+   const double bytesPerMB = 1024.0 * 1024.0;
+
+   std::cout << std::fixed << std::setprecision(1)
+             << "Scanned " << totals.numFiles << " file(s) in " << totals.numDirs << " directories ("
+             << (totals.numBytes / bytesPerMB) << " MB) in " << std::setprecision(3) << elapsedSec << " s ("
+             << std::setprecision(1) << ((elapsedSec > 0) ? (totals.numBytes / bytesPerMB / elapsedSec) : 0.0)
+             << " MB/s, " << numThreads << " threads)" << std::endl;
+
+   uint64_t numROMs = totals.numFiles - totals.formatCounts[NGROM_NS::UNK_FMT];
+
+   std::cout << "Formats:" << std::endl;
+   const NGROM_NS::RomFormat reportFormats[] = { NGROM_NS::SMD, NGROM_NS::BIN, NGROM_NS::MGD, NGROM_NS::BIN_SWAPPED, NGROM_NS::UNK_FMT };
+   for (NGROM_NS::RomFormat fmt : reportFormats)
+   {
+      printCount(getFormatName(fmt), totals.formatCounts[fmt], totals.numFiles);
+   }
+
+   std::cout << "ROM sizes:" << std::endl;
+   for (size_t i = 0; i < NUM_SIZE_BUCKETS; i++)
+   {
+      uint64_t bucketKB = (SMALLEST_SIZE_BUCKET_BYTES << ((i < NUM_SIZE_BUCKETS - 1) ? i : (i - 1))) / 1024;
+      std::ostringstream label;
+      label << ((i < NUM_SIZE_BUCKETS - 1) ? "<= " : "> ");
+      if (bucketKB >= 1024) { label << (bucketKB / 1024) << " MB"; }
+      else                  { label << bucketKB << " KB"; }
+      printCount(label.str(), totals.sizeCounts[i], numROMs);
+   }
+
+   uint64_t numChecked = totals.numChecksumValid + totals.numChecksumInvalid;
+   std::cout << "Checksums:" << std::endl;
+   printCount("valid", totals.numChecksumValid, numChecked);
+   printCount("invalid", totals.numChecksumInvalid, numChecked);
+   if (totals.numChecksumUnchecked > 0)
+   {
+      printCount("not checked", totals.numChecksumUnchecked, 0);
+   }
+
+   std::cout << "Regions:" << std::endl;
+   printCount("Japan", totals.regionCounts[0], numROMs);
+   printCount("USA", totals.regionCounts[1], numROMs);
+   printCount("Europe", totals.regionCounts[2], numROMs);
+   printCount("(none)", totals.numNoRegion, numROMs);
+
+   // Identical contents sort next to each other.
+   std::sort(totals.contents.begin(), totals.contents.end());
+
+   uint64_t numDuplicateFiles = 0;
+   uint64_t numDuplicatedContents = 0;
+   uint64_t duplicateBytes = 0;
+   for (size_t i = 1; i < totals.contents.size(); i++)
+   {
+      if (totals.contents[i] == totals.contents[i - 1])
+      {
+         numDuplicateFiles++;
+         duplicateBytes += totals.contents[i].first;
+         if ((i < 2) || (totals.contents[i - 1] != totals.contents[i - 2]))
+         {
+            numDuplicatedContents++;
+         }
+      }
+   }
+
+   std::cout << "Duplicates:" << std::endl;
+   printCount("duplicate files", numDuplicateFiles, numROMs);
+   printCount("distinct ROMs", totals.contents.size() - numDuplicateFiles, numROMs);
+   std::cout << "   (" << numDuplicateFiles << " extra cop(ies) of " << numDuplicatedContents << " ROM(s), "
+             << std::setprecision(1) << (duplicateBytes / bytesPerMB) << " MB)" << std::endl;
+
+   if (totals.numErrors > 0)
+   {
+      std::cout << totals.numErrors << " file(s) or directories could not be read." << std::endl;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: runScanCommand
+// Description: Runs "ngrom scan DIR..."; args are the arguments after "scan".
+// Return: Exit code (0 = success, 1 = usage error or DIR not a directory,
+//         2 = some files or directories could not be read).
+// -----------------------------------------------------------------------------
+int NGROM_NS::runScanCommand(const std::vector<std::string>& args)
+{
+   if (args.empty())
+   {
+      std::cerr << "NGROM ERROR: Usage: ngrom scan <dirs...>" << std::endl;
+      return 1;
+   }
+
+   for (const std::string& dirPath : args)
+   {
+      struct stat dirStat;
+      if ((0 != stat(dirPath.c_str(), &dirStat)) || !S_ISDIR(dirStat.st_mode))
+      {
+         std::cerr << "NGROM ERROR: Not a directory: " << dirPath << std::endl;
+         return 1;
+      }
+   }
+
+   unsigned int numThreads = NGROM_NS::DirectoryWalker::defaultNumThreads();
+
+   struct timespec startTime;
+   clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+   // Each thread keeps its own totals (and buffers); they're summed at the end.
+   std::vector<ScanStats> threadStats(numThreads);
+   std::vector<std::vector<unsigned char> > threadFileBytes(numThreads);
+   std::vector<std::vector<unsigned char> > threadBinBytes(numThreads);
+
+   NGROM_NS::DirectoryWalker walker;
+   walker.run(args, numThreads,
+      [&](unsigned int workerIndex, int dirFd, const char* name, const std::string& path)
+      {
+         int fd = openat(dirFd, name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+         struct stat fileStat;
+         if ((fd < 0) || (0 != fstat(fd, &fileStat)))
+         {
+            walker.reportError("open file", path, errno);
+         }
+         else if (!inspectFile(fd, fileStat.st_size, threadStats[workerIndex],
+                               threadFileBytes[workerIndex], threadBinBytes[workerIndex]))
+         {
+            walker.reportError("read file", path, errno);
+         }
+
+         if (fd >= 0)
+         {
+            close(fd);
+         }
+         return true;
+      });
+
+   ScanStats totals;
+   for (const ScanStats& stats : threadStats)
+   {
+      totals.merge(stats);
+   }
+   totals.numDirs = walker.numDirs();
+   totals.numErrors = walker.numErrors();
+
+   struct timespec endTime;
+   clock_gettime(CLOCK_MONOTONIC, &endTime);
+   double elapsedSec = (endTime.tv_sec - startTime.tv_sec) + ((endTime.tv_nsec - startTime.tv_nsec) / 1000000000.0);
+
+   printReport(totals, elapsedSec, numThreads);
+
+   return (totals.numErrors > 0) ? 2 : 0;
+}
@@ -0,0 +1,18 @@
+// New GROM - Collection scan
+//
+// "ngrom scan DIR..." walks the directory trees (several threads at once),
+// inspects every file, and prints one aggregate report for the collection:
+// formats, sizes, checksum validity, regions, and duplicate contents.
+
+#ifndef NGROM_SCAN_H
+#define NGROM_SCAN_H
+
+#include<string>
+#include<vector>
+
+namespace NGROM_NS
+{
+   int runScanCommand(const std::vector<std::string>& args);
+}
+
+#endif // NGROM_SCAN_H
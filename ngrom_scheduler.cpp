@@ -0,0 +1,266 @@
+// New GROM - Conversion scheduling
+
+#include "ngrom_scheduler.h"
+#include "ngrom_cache.h"
+#include "ngrom_durable.h"
+#include "ngrom_stats.h"
+#include "ngrom_trace.h"
+#include "ngrom_walk.h"
+#include<iostream> // for std::cout and std::err
+#include<sstream>
+#include<thread>
+#include<atomic>
+#include<fstream>
+#include<stdlib.h> // for strtoull
+
+// -----------------------------------------------------------------------------
+// Function: finishOutputs
+// Description: Commits the outputs still pending in durable mode, then drops
+//              the outputs still in the page cache (with a cache dropper).
+// Return: true if committed (or not in durable mode); false otherwise.
+// -----------------------------------------------------------------------------
+static bool finishOutputs(const NGROM_NS::ConvertOptions& options)
+{
+   bool retval = (options.committer == NULL) || options.committer->flush();
+
+   if (options.cacheDropper != NULL)
+   {
+      options.cacheDropper->finish();
+   }
+
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: prefetchInputs
+// Description: Reads ahead the inputs after the one just taken, with a
+//              prefetcher.
+// -----------------------------------------------------------------------------
+static void prefetchInputs(NGROM_NS::FileQueue& fileQueue, const NGROM_NS::ConvertOptions& options)
+{
+   if (options.prefetcher != NULL)
+   {
+      options.prefetcher->update(fileQueue);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: runConversions
+// Description: Converts the queued files (see convertFile) until the queue is
+//              closed and empty, options.numJobs at a time.  On the first
+//              failed conversion, the queue is cancelled (so no new
+//              conversions start, and the producer stops); conversions already
+//              running are finished.  In durable mode, the outputs still
+//              waiting for a group commit are committed at the end (either
+//              way, so that finished conversions are kept).
+// Return: true if all conversions (and commits) succeeded; false otherwise.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::runConversions(FileQueue& fileQueue, const ConvertOptions& options)
+{
+   StatPassTimer passTimer(CONVERT_PASS);
+
+   size_t fileIndex = 0;
+   std::string filename;
+
+   if (options.numJobs <= 1)
+   {
+      while (fileQueue.pop(fileIndex, filename))
+      {
+         prefetchInputs(fileQueue, options);
+         if (!convertFile(filename, fileIndex, options, std::cout, std::cerr))
+         {
+            fileQueue.cancel();
+            finishOutputs(options);
+            return false;
+         }
+      }
+      return finishOutputs(options);
+   }
+
+   ConvertSync sync;
+   ConvertOptions parallelOptions = options;
+   parallelOptions.sync = &sync;
+
+   std::mutex outputMutex;
+   std::atomic<bool> failed(false);
+
+   std::vector<std::thread> threads;
+   for (unsigned int i = 0; i < options.numJobs; i++)
+   {
+      threads.push_back(std::thread([&]()
+      {
+         size_t jobFileIndex = 0;
+         std::string jobFilename;
+
+         while (fileQueue.pop(jobFileIndex, jobFilename))
+         {
+            prefetchInputs(fileQueue, parallelOptions);
+
+            // Each file's messages are printed together, once it's done.
+            std::ostringstream jobOut;
+            std::ostringstream jobErr;
+            bool rc = convertFile(jobFilename, jobFileIndex, parallelOptions, jobOut, jobErr);
+
+            {
+               std::lock_guard<std::mutex> lock(outputMutex);
+               std::cout << jobOut.str() << std::flush;
+               std::cerr << jobErr.str() << std::flush;
+            }
+
+            if (!rc)
+            {
+               failed = true;
+               fileQueue.cancel();
+               break;
+            }
+         }
+      }));
+   }
+
+   for (std::thread& thread : threads)
+   {
+      thread.join();
+   }
+
+   // (Before sync goes away; the commits journal through it.)
+   bool committed = finishOutputs(parallelOptions);
+   return !failed && committed;
+}
+
+// -----------------------------------------------------------------------------
+// Function: MemoryBudget::MemoryBudget
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::MemoryBudget::MemoryBudget(uint64_t maxBytes)
+ : m_maxBytes(maxBytes),
+   m_numReservedBytes(0),
+   m_nextTicket(0),
+   m_servingTicket(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: MemoryBudget::reserve
+// Description: Reserves numBytes (at most the whole budget), waiting for the
+//              earlier reservations, and then for enough to be free.
+// Return: Bytes reserved (pass to release).
+// -----------------------------------------------------------------------------
+uint64_t NGROM_NS::MemoryBudget::reserve(uint64_t numBytes)
+{
+   if (numBytes > m_maxBytes)
+   {
+      numBytes = m_maxBytes;
+   }
+
+   TraceSpan waitSpan("wait for memory", "wait");
+   std::unique_lock<std::mutex> lock(m_mutex);
+   uint64_t ticket = m_nextTicket++;
+   m_cond.wait(lock, [&] { return (ticket == m_servingTicket) && ((m_numReservedBytes + numBytes) <= m_maxBytes); });
+   waitSpan.end();
+
+   m_numReservedBytes += numBytes;
+   m_servingTicket++;
+   m_cond.notify_all();
+   return numBytes;
+}
+
+// -----------------------------------------------------------------------------
+// Function: MemoryBudget::release
+// Description: Gives back a reservation.
+// -----------------------------------------------------------------------------
+void NGROM_NS::MemoryBudget::release(uint64_t numBytes)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_numReservedBytes -= numBytes;
+   m_cond.notify_all();
+}
+
+// -----------------------------------------------------------------------------
+// Function: parseMemorySize
+// Description: Parses a size in bytes, optionally followed by K, M, or G
+//              (binary units; e.g., "512M").
+// Return: true if valid; false otherwise.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::parseMemorySize(const std::string& sizeString, uint64_t& numBytes)
+{
+   char* sizeEnd = NULL;
+   unsigned long long size = strtoull(sizeString.c_str(), &sizeEnd, 10);
+   if (sizeString.empty() || (sizeEnd == sizeString.c_str()) || (sizeString[0] == '-'))
+   {
+      return false;
+   }
+
+   std::string suffix(sizeEnd);
+   unsigned int shift = 0;
+   if ((suffix == "K") || (suffix == "k")) { shift = 10; }
+   else if ((suffix == "M") || (suffix == "m")) { shift = 20; }
+   else if ((suffix == "G") || (suffix == "g")) { shift = 30; }
+   else if (!suffix.empty()) { return false; }
+
+   if ((size == 0) || (size > (UINT64_MAX >> shift)))
+   {
+      return false;
+   }
+
+   numBytes = (uint64_t)size << shift;
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getCgroupMemoryLimit
+// Description: Gets the memory limit of this process's cgroup: memory.max
+//              (cgroup v2), or memory.limit_in_bytes (v1); the first of
+//              these found is used.
+// Return: The limit in bytes, or 0 if there is none (or it can't be read).
+// -----------------------------------------------------------------------------
+uint64_t NGROM_NS::getCgroupMemoryLimit()
+{
+   std::string v2Path;
+   std::string v1Path;
+
+   std::ifstream cgroupFile("/proc/self/cgroup");
+   std::string line;
+   while (std::getline(cgroupFile, line))
+   {
+      // "hierarchy:controllers:path"; v2 is "0::path".
+      size_t firstColon = line.find(':');
+      size_t secondColon = (firstColon == std::string::npos) ? std::string::npos : line.find(':', firstColon + 1);
+      if (secondColon == std::string::npos)
+      {
+         continue;
+      }
+
+      std::string controllers = line.substr(firstColon + 1, secondColon - firstColon - 1);
+      std::string path = line.substr(secondColon + 1);
+      if (controllers.empty() && (line.compare(0, firstColon, "0") == 0))
+      {
+         v2Path = "/sys/fs/cgroup" + path + "/memory.max";
+      }
+      else if (("," + controllers + ",").find(",memory,") != std::string::npos)
+      {
+         v1Path = "/sys/fs/cgroup/memory" + path + "/memory.limit_in_bytes";
+      }
+   }
+
+   // (In a container, its own cgroup is usually mounted as the root.)
+   for (const std::string& limitPath : { v2Path, std::string("/sys/fs/cgroup/memory.max"),
+                                         v1Path, std::string("/sys/fs/cgroup/memory/memory.limit_in_bytes") })
+   {
+      std::ifstream limitFile(limitPath.c_str());
+      std::string limitString;
+      if (limitPath.empty() || !(limitFile >> limitString))
+      {
+         continue;
+      }
+      if (limitString == "max")
+      {
+         return 0;
+      }
+
+      // (v1 reports "no limit" as a huge number.)
+      unsigned long long limit = strtoull(limitString.c_str(), NULL, 10);
+      return (limit >= (1ULL << 60)) ? 0 : limit;
+   }
+
+   return 0;
+}
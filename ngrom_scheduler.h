@@ -0,0 +1,110 @@
+// New GROM - Conversion scheduling
+//
+// Runs the conversions of the files in a FileQueue, options.numJobs at a time.
+// Files may still be arriving (e.g., from a recursive walk) while earlier ones
+// convert.  Parallel conversions share the manifest, journal, and dedup index
+// through a ConvertSync, and each file's messages are printed together.
+// With a MemoryBudget, each conversion first reserves the buffer memory it
+// will use (its data buffers, decompression and compression queues), waiting
+// while the conversions already running hold too much of the budget; so
+// parallel runs slow down, rather than fail, under a memory limit.
+
+#ifndef NGROM_SCHEDULER_H
+#define NGROM_SCHEDULER_H
+
+#include "ngrom.h"
+#include<stdint.h>
+#include<string>
+#include<mutex>
+#include<condition_variable>
+#include<unordered_set>
+
+namespace NGROM_NS
+{
+   // State shared by the conversions of a parallel run
+   struct ConvertSync
+   {
+      std::mutex stateMutex; // Guards the manifest, journal, dedup index, and claimedOutputs
+      std::unordered_set<std::string> claimedOutputs; // Output paths taken by this run
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: ConvertStateLock
+   // Description: Scoped lock on a parallel run's shared state; does nothing
+   //              when converting one file at a time.
+   // --------------------------------------------------------------------------
+   class ConvertStateLock
+   {
+   public:
+      explicit ConvertStateLock(const ConvertOptions& options) : m_sync(options.sync), m_locked(false) { lock(); }
+      ~ConvertStateLock() { unlock(); }
+
+      void lock() { if ((m_sync != NULL) && !m_locked) { m_sync->stateMutex.lock(); m_locked = true; } }
+      void unlock() { if (m_locked) { m_sync->stateMutex.unlock(); m_locked = false; } }
+
+      ConvertStateLock(const ConvertStateLock&) = delete;
+      ConvertStateLock& operator=(const ConvertStateLock&) = delete;
+
+   private:
+      ConvertSync* m_sync;
+      bool m_locked;
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: MemoryBudget
+   // Description: Bytes of buffer memory that running conversions may hold
+   //              at once.  Reservations are granted in the order requested
+   //              (so a large one isn't passed over forever), each waiting
+   //              until enough is free; one larger than the whole budget
+   //              waits until it's all free, then gets it all.
+   // --------------------------------------------------------------------------
+   class MemoryBudget
+   {
+   public:
+      explicit MemoryBudget(uint64_t maxBytes);
+
+      uint64_t reserve(uint64_t numBytes); // Blocks; returns the bytes reserved
+      void release(uint64_t numBytes);
+      uint64_t maxBytes() const { return m_maxBytes; }
+
+      MemoryBudget(const MemoryBudget&) = delete;
+      MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+   private:
+      uint64_t m_maxBytes;
+      std::mutex m_mutex; // Guards the members below
+      std::condition_variable m_cond;
+      uint64_t m_numReservedBytes;
+      uint64_t m_nextTicket;    // Given to the next reservation
+      uint64_t m_servingTicket; // Reservation to be granted next
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: MemoryReservation
+   // Description: Scoped reservation from a conversion's budget; does nothing
+   //              without one.
+   // --------------------------------------------------------------------------
+   class MemoryReservation
+   {
+   public:
+      MemoryReservation(MemoryBudget* budget, uint64_t numBytes)
+       : m_budget(budget), m_numBytes((budget != NULL) ? budget->reserve(numBytes) : 0) {}
+      ~MemoryReservation() { release(); }
+
+      void release() { if (m_numBytes > 0) { m_budget->release(m_numBytes); m_numBytes = 0; } }
+
+      MemoryReservation(const MemoryReservation&) = delete;
+      MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+   private:
+      MemoryBudget* m_budget;
+      uint64_t m_numBytes;
+   };
+
+   bool parseMemorySize(const std::string& sizeString, uint64_t& numBytes);
+   uint64_t getCgroupMemoryLimit();
+
+   bool runConversions(FileQueue& fileQueue, const ConvertOptions& options);
+}
+
+#endif // NGROM_SCHEDULER_H
@@ -0,0 +1,171 @@
+// New GROM - Deterministic work sharding
+
+#include "ngrom_shard.h"
+#include "ngrom_hash.h"
+#include "ngrom_input.h"
+#include<stdint.h>
+#include<stdlib.h> // for strtoull
+#include<errno.h>
+#include<iostream> // for std::cout and std::err
+#include<algorithm>
+
+// A shard only takes more files while its bytes are under an even share plus
+// this fraction (bounded loads).
+static const double SHARD_LOAD_SLACK = 0.1;
+
+// Most shards (each file ranks every shard)
+static const size_t MAX_SHARDS = 65536;
+
+namespace
+{
+   struct ShardFile
+   {
+      uint64_t size;
+      uint64_t pathHash;
+      std::string path; // Relative (see getRelativeInputPath)
+      size_t listIndex;
+   };
+
+   // Biggest files first; ties broken by path hash (not by list position), so
+   // the order doesn't depend on how each node happened to list the files.
+   bool shardFileOrder(const ShardFile& lhs, const ShardFile& rhs)
+   {
+      if (lhs.size != rhs.size)
+      {
+         return lhs.size > rhs.size;
+      }
+      if (lhs.pathHash != rhs.pathHash)
+      {
+         return lhs.pathHash < rhs.pathHash;
+      }
+      return lhs.path < rhs.path;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: parseShardSpec
+// Description: Parses an "i/N" shard specification (1 <= i <= N <=
+//              MAX_SHARDS).
+// Return: true if the specification is valid; false otherwise.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::parseShardSpec(const std::string& shardSpec, size_t& shardNumber, size_t& numShards)
+{
+   size_t slashPos = shardSpec.find('/');
+   if ((slashPos == std::string::npos) || (slashPos == 0) || (slashPos + 1 >= shardSpec.length()))
+   {
+      return false;
+   }
+
+   std::string numberString = shardSpec.substr(0, slashPos);
+   std::string countString = shardSpec.substr(slashPos + 1);
+   if ((numberString.find_first_not_of("0123456789") != std::string::npos) ||
+       (countString.find_first_not_of("0123456789") != std::string::npos))
+   {
+      return false;
+   }
+
+   errno = 0;
+   unsigned long long number = strtoull(numberString.c_str(), NULL, 10);
+   unsigned long long count = strtoull(countString.c_str(), NULL, 10);
+   if ((errno == ERANGE) || (count > MAX_SHARDS))
+   {
+      return false;
+   }
+
+   shardNumber = number;
+   numShards = count;
+
+   return (shardNumber >= 1) && (shardNumber <= numShards);
+}
+
+// -----------------------------------------------------------------------------
+// Function: selectShard
+// Description: Picks this shard's subset of the supplied files, by rendezvous
+//              (highest random weight) hashing: each file ranks the shards by
+//              a hash of its path (relative to the root directory it was found
+//              under; see getRelativeInputPath) and the shard number, and goes to
+//              its first choice, unless that shard already has more than its
+//              share of bytes (plus SHARD_LOAD_SLACK), in which case it goes to
+//              its next choice below the bound.  Files are placed biggest
+//              first, weighted by their real (decompressed, or zip member)
+//              size.  Every process given the same set of files (in any order,
+//              under any mount point) computes the same assignment, and adding
+//              or removing files moves few of the others.  (Because of the
+//              bound, a file's shard can depend on the other files, so all
+//              processes must be given the same set.)  Unreadable files count
+//              as empty, so they are still reported by exactly one shard.
+// Return: The files of this shard, in their original list order.
+// -----------------------------------------------------------------------------
+std::vector<std::string> NGROM_NS::selectShard(const std::vector<std::string>& filenameList,
+                                               const std::vector<std::string>& rootDirs,
+                                               size_t shardNumber,
+                                               size_t numShards)
+{
+   std::vector<ShardFile> files(filenameList.size());
+   uint64_t totalBytes = 0;
+
+   for (size_t i = 0; i < filenameList.size(); i++)
+   {
+      files[i].size = getInputDataSize(filenameList[i]);
+      files[i].path = getRelativeInputPath(filenameList[i], rootDirs);
+      files[i].pathHash = ContentHasher::hash(files[i].path.data(), files[i].path.length());
+      files[i].listIndex = i;
+      totalBytes += files[i].size;
+   }
+
+   std::sort(files.begin(), files.end(), shardFileOrder);
+
+   // (Some shard is always under the bound: together they're under the total.)
+   double maxShardBytes = (1.0 + SHARD_LOAD_SLACK) * (double)totalBytes / (double)numShards;
+   std::vector<uint64_t> shardBytes(numShards + 1, 0);
+
+   std::vector<bool> selected(filenameList.size(), false);
+
+   for (const ShardFile& file : files)
+   {
+      // Best shard under the bound (or, if none is, e.g. all files are
+      // empty, best of all)
+      size_t bestShard = 0;
+      uint64_t bestScore = 0;
+      size_t topShard = 0;
+      uint64_t topScore = 0;
+      for (size_t shard = 1; shard <= numShards; shard++)
+      {
+         uint64_t score = ContentHasher::hash(file.path.data(), file.path.length(), shard);
+         if ((topShard == 0) || (score > topScore))
+         {
+            topShard = shard;
+            topScore = score;
+         }
+         if (((double)shardBytes[shard] < maxShardBytes) && ((bestShard == 0) || (score > bestScore)))
+         {
+            bestShard = shard;
+            bestScore = score;
+         }
+      }
+
+      if (bestShard == 0)
+      {
+         bestShard = topShard;
+      }
+
+      shardBytes[bestShard] += file.size;
+      selected[file.listIndex] = (bestShard == shardNumber);
+   }
+   uint64_t selectedBytes = shardBytes[shardNumber];
+
+   std::vector<std::string> retval;
+   for (size_t i = 0; i < filenameList.size(); i++)
+   {
+      if (selected[i])
+      {
+         retval.push_back(filenameList[i]);
+      }
+   }
+
+   std::cout << "Shard " << shardNumber << "/" << numShards << ": " << retval.size()
+             << " of " << filenameList.size() << " file(s), " << selectedBytes
+             << " of " << totalBytes << " bytes" << std::endl;
+
+   return retval;
+}
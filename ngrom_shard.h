@@ -0,0 +1,28 @@
+// New GROM - Deterministic work sharding
+//
+// Splits an input file list across N independent ngrom processes (e.g., one
+// per node) so that every file is handled by exactly one of them, each gets
+// about the same number of bytes to convert, and a file keeps its shard as
+// files are added to or removed from the collection (rendezvous hashing).
+// Files are keyed by their paths relative to the directories walked (or their
+// file names), so nodes may mount the collection at different paths; they
+// must all list the same files, though.
+
+#ifndef NGROM_SHARD_H
+#define NGROM_SHARD_H
+
+#include<stddef.h>
+#include<string>
+#include<vector>
+
+namespace NGROM_NS
+{
+   bool parseShardSpec(const std::string& shardSpec, size_t& shardNumber, size_t& numShards);
+
+   std::vector<std::string> selectShard(const std::vector<std::string>& filenameList,
+                                        const std::vector<std::string>& rootDirs,
+                                        size_t shardNumber,
+                                        size_t numShards);
+}
+
+#endif // NGROM_SHARD_H
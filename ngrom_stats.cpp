@@ -0,0 +1,552 @@
+// New GROM - Run statistics (--stats)
+
+#include "ngrom_stats.h"
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<fstream>
+#include<iomanip>
+#include<iostream> // for std::endl
+#include<memory>
+#include<mutex>
+#include<string>
+#include<vector>
+
+// HDR histogram layout: values below SUB_BUCKET_COUNT are exact; above, each
+// power of two is split into SUB_BUCKET_COUNT/2 buckets (~3% wide).  Values
+// of 2^MAX_VALUE_BITS ns (~18 minutes) or more go in the last bucket.
+static const unsigned int SUB_BUCKET_BITS = 5;
+static const uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+static const uint64_t SUB_BUCKET_HALF_COUNT = SUB_BUCKET_COUNT / 2;
+static const unsigned int MAX_VALUE_BITS = 40;
+static const size_t NUM_BUCKETS = SUB_BUCKET_COUNT + ((MAX_VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_HALF_COUNT);
+
+static const char* const PASS_NAMES[NGROM_NS::NUM_STAT_PASSES] = { "check", "convert", "info" };
+static const char* const STAGE_NAMES[NGROM_NS::NUM_STAT_STAGES] = { "open", "header", "check", "decode", "write", "close" };
+
+// Stats recorded?
+static std::atomic<bool> s_statsEnabled(false);
+
+namespace
+{
+   // -------------------------------------------------------------------------
+   // Struct: Histogram
+   // Description: Stage times (ns) of a thread's files.  Only the owning
+   //              thread writes it (so no read-modify-write is needed); the
+   //              atomics just let the report read it safely.
+   // -------------------------------------------------------------------------
+   struct Histogram
+   {
+      Histogram();
+      void record(uint64_t numNanos);
+
+      std::atomic<uint64_t> counts[NUM_BUCKETS];
+      std::atomic<uint64_t> numValues;
+      std::atomic<uint64_t> totalNanos;
+      std::atomic<uint64_t> maxNanos;
+   };
+
+   // -------------------------------------------------------------------------
+   // Struct: ThreadStats
+   // Description: A thread's histograms and totals, per pass.
+   // -------------------------------------------------------------------------
+   struct ThreadStats
+   {
+      ThreadStats();
+
+      Histogram stages[NGROM_NS::NUM_STAT_PASSES][NGROM_NS::NUM_STAT_STAGES];
+      std::atomic<uint64_t> numFiles[NGROM_NS::NUM_STAT_PASSES];
+      std::atomic<uint64_t> numBytesIn[NGROM_NS::NUM_STAT_PASSES];
+      std::atomic<uint64_t> numBytesOut[NGROM_NS::NUM_STAT_PASSES];
+   };
+
+   // -------------------------------------------------------------------------
+   // Struct: PassTotals
+   // Description: A pass's wall time and syscalls (summed over its runs).
+   // -------------------------------------------------------------------------
+   struct PassTotals
+   {
+      PassTotals() : numRuns(0), wallNanos(0), numReads(0), numWrites(0) {}
+
+      unsigned int numRuns;
+      uint64_t wallNanos;
+      uint64_t numReads;
+      uint64_t numWrites;
+   };
+
+   // -------------------------------------------------------------------------
+   // Class: StatsRegistry
+   // Description: Every thread's stats (kept after the thread ends), and the
+   //              pass totals.
+   // -------------------------------------------------------------------------
+   class StatsRegistry
+   {
+   public:
+      static StatsRegistry& instance();
+
+      ThreadStats* addThread();
+      void addPass(NGROM_NS::StatPass pass, uint64_t wallNanos, uint64_t numReads, uint64_t numWrites);
+      void print(std::ostream& out);
+
+   private:
+      StatsRegistry() {}
+
+      std::mutex m_mutex; // Guards the members below
+      std::vector<std::unique_ptr<ThreadStats> > m_threads;
+      PassTotals m_passes[NGROM_NS::NUM_STAT_PASSES];
+   };
+
+   thread_local ThreadStats* t_threadStats = NULL;
+   thread_local NGROM_NS::FileStats* t_fileStats = NULL;
+   thread_local NGROM_NS::StatTimer* t_statTimer = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getNanos
+// Description: Gets the (monotonic) time in ns.
+// -----------------------------------------------------------------------------
+static uint64_t getNanos()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------------------------------------------------
+// Function: getBucketIndex
+// Description: Gets the histogram bucket of a value.
+// -----------------------------------------------------------------------------
+static size_t getBucketIndex(uint64_t value)
+{
+   if (value >= (1ULL << MAX_VALUE_BITS))
+   {
+      value = (1ULL << MAX_VALUE_BITS) - 1;
+   }
+
+   if (value < SUB_BUCKET_COUNT)
+   {
+      return value;
+   }
+
+   unsigned int magnitude = 63 - __builtin_clzll(value);
+   unsigned int shift = magnitude - (SUB_BUCKET_BITS - 1);
+   return SUB_BUCKET_COUNT + ((magnitude - SUB_BUCKET_BITS) * SUB_BUCKET_HALF_COUNT) +
+          ((value >> shift) - SUB_BUCKET_HALF_COUNT);
+}
+
+// -----------------------------------------------------------------------------
+// Function: getBucketHighestValue
+// Description: Gets the highest value in a histogram bucket.
+// -----------------------------------------------------------------------------
+static uint64_t getBucketHighestValue(size_t index)
+{
+   if (index < SUB_BUCKET_COUNT)
+   {
+      return index;
+   }
+
+   size_t offset = index - SUB_BUCKET_COUNT;
+   unsigned int magnitude = (offset / SUB_BUCKET_HALF_COUNT) + SUB_BUCKET_BITS;
+   uint64_t subBucket = (offset % SUB_BUCKET_HALF_COUNT) + SUB_BUCKET_HALF_COUNT;
+   unsigned int shift = magnitude - (SUB_BUCKET_BITS - 1);
+   return ((subBucket + 1) << shift) - 1;
+}
+
+// -----------------------------------------------------------------------------
+// Function: readSyscallCounts
+// Description: Gets the process's read and write syscall counts so far (from
+//              /proc/self/io).
+// Return: true if read; false otherwise.
+// -----------------------------------------------------------------------------
+static bool readSyscallCounts(uint64_t& numReads, uint64_t& numWrites)
+{
+   std::ifstream ioFile("/proc/self/io");
+   std::string name;
+   uint64_t value = 0;
+   int numFound = 0;
+
+   while (ioFile >> name >> value)
+   {
+      if (name == "syscr:") { numReads = value; numFound++; }
+      else if (name == "syscw:") { numWrites = value; numFound++; }
+   }
+
+   return (numFound == 2);
+}
+
+// -----------------------------------------------------------------------------
+// Function: getThreadStats
+// Description: Gets the calling thread's stats (registering it on first use).
+// -----------------------------------------------------------------------------
+static ThreadStats& getThreadStats()
+{
+   if (t_threadStats == NULL)
+   {
+      t_threadStats = StatsRegistry::instance().addThread();
+   }
+   return *t_threadStats;
+}
+
+// -----------------------------------------------------------------------------
+// Function: addRelaxed
+// Description: Adds to a counter only the calling thread writes.
+// -----------------------------------------------------------------------------
+static void addRelaxed(std::atomic<uint64_t>& counter, uint64_t value)
+{
+   counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------
+// Function: Histogram::Histogram
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+Histogram::Histogram()
+ : numValues(0),
+   totalNanos(0),
+   maxNanos(0)
+{
+   for (size_t i = 0; i < NUM_BUCKETS; i++)
+   {
+      counts[i] = 0;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: Histogram::record
+// Description: Records a value (owning thread only).
+// -----------------------------------------------------------------------------
+void Histogram::record(uint64_t numNanos)
+{
+   addRelaxed(counts[getBucketIndex(numNanos)], 1);
+   addRelaxed(numValues, 1);
+   addRelaxed(totalNanos, numNanos);
+   if (numNanos > maxNanos.load(std::memory_order_relaxed))
+   {
+      maxNanos.store(numNanos, std::memory_order_relaxed);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: ThreadStats::ThreadStats
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+ThreadStats::ThreadStats()
+{
+   for (unsigned int pass = 0; pass < NGROM_NS::NUM_STAT_PASSES; pass++)
+   {
+      numFiles[pass] = 0;
+      numBytesIn[pass] = 0;
+      numBytesOut[pass] = 0;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: StatsRegistry::instance
+// Description: Gets the registry.
+// -----------------------------------------------------------------------------
+StatsRegistry& StatsRegistry::instance()
+{
+   static StatsRegistry s_registry;
+   return s_registry;
+}
+
+// -----------------------------------------------------------------------------
+// Function: StatsRegistry::addThread
+// Description: Registers a thread's (new) stats.
+// -----------------------------------------------------------------------------
+ThreadStats* StatsRegistry::addThread()
+{
+   std::unique_ptr<ThreadStats> threadStats(new ThreadStats());
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_threads.push_back(std::move(threadStats));
+   return m_threads.back().get();
+}
+
+// -----------------------------------------------------------------------------
+// Function: StatsRegistry::addPass
+// Description: Adds a pass run's wall time and syscalls.
+// -----------------------------------------------------------------------------
+void StatsRegistry::addPass(NGROM_NS::StatPass pass, uint64_t wallNanos, uint64_t numReads, uint64_t numWrites)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_passes[pass].numRuns++;
+   m_passes[pass].wallNanos += wallNanos;
+   m_passes[pass].numReads += numReads;
+   m_passes[pass].numWrites += numWrites;
+}
+
+// -----------------------------------------------------------------------------
+// Function: StatsRegistry::print
+// Description: Merges the threads' stats and prints the report of each pass
+//              that ran.
+// -----------------------------------------------------------------------------
+void StatsRegistry::print(std::ostream& out)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   std::ios_base::fmtflags savedFlags = out.flags();
+   std::streamsize savedPrecision = out.precision();
+   out << std::fixed;
+
+   for (unsigned int pass = 0; pass < NGROM_NS::NUM_STAT_PASSES; pass++)
+   {
+      const PassTotals& totals = m_passes[pass];
+      if (totals.numRuns == 0)
+      {
+         continue;
+      }
+
+      uint64_t numFiles = 0;
+      uint64_t numBytesIn = 0;
+      uint64_t numBytesOut = 0;
+      for (const std::unique_ptr<ThreadStats>& threadStats : m_threads)
+      {
+         numFiles += threadStats->numFiles[pass];
+         numBytesIn += threadStats->numBytesIn[pass];
+         numBytesOut += threadStats->numBytesOut[pass];
+      }
+
+      double seconds = totals.wallNanos / 1e9;
+      double perSecond = (seconds > 0) ? (1 / seconds) : 0;
+
+      out << "NGROM stats (" << PASS_NAMES[pass] << "): " << numFiles << " files in "
+          << std::setprecision(3) << seconds << " s (" << std::setprecision(1) << (numFiles * perSecond) << " files/s)" << std::setprecision(2) << std::endl;
+      out << "  Data: " << (numBytesIn / 1e6) << " MB in (" << ((numBytesIn / 1e6) * perSecond) << " MB/s), "
+          << (numBytesOut / 1e6) << " MB out (" << ((numBytesOut / 1e6) * perSecond) << " MB/s)" << std::endl;
+      out << "  Syscalls: " << totals.numReads << " read, " << totals.numWrites << " write" << std::endl;
+      out << "  Stage        Files      p50 ms      p99 ms      max ms    total ms" << std::endl;
+
+      for (unsigned int stage = 0; stage < NGROM_NS::NUM_STAT_STAGES; stage++)
+      {
+         // Merge
+         std::vector<uint64_t> counts(NUM_BUCKETS, 0);
+         uint64_t numValues = 0;
+         uint64_t maxNanos = 0;
+         uint64_t totalNanos = 0;
+         for (const std::unique_ptr<ThreadStats>& threadStats : m_threads)
+         {
+            const Histogram& histogram = threadStats->stages[pass][stage];
+            for (size_t i = 0; i < NUM_BUCKETS; i++)
+            {
+               counts[i] += histogram.counts[i];
+            }
+            numValues += histogram.numValues;
+            totalNanos += histogram.totalNanos;
+            maxNanos = std::max(maxNanos, histogram.maxNanos.load());
+         }
+
+         if (numValues == 0)
+         {
+            continue;
+         }
+
+         // (A percentile is reported as its bucket's highest value.)
+         uint64_t percentileNanos[2] = { 0, 0 };
+         const double percentiles[2] = { 0.50, 0.99 };
+         for (int p = 0; p < 2; p++)
+         {
+            uint64_t rank = (uint64_t)(percentiles[p] * numValues + 0.999999);
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < NUM_BUCKETS; i++)
+            {
+               cumulative += counts[i];
+               if ((cumulative >= rank) && (cumulative > 0))
+               {
+                  percentileNanos[p] = std::min(getBucketHighestValue(i), maxNanos);
+                  break;
+               }
+            }
+         }
+
+         out << "  " << std::left << std::setw(8) << STAGE_NAMES[stage] << std::right
+             << std::setw(10) << numValues << std::setprecision(3)
+             << std::setw(12) << (percentileNanos[0] / 1e6)
+             << std::setw(12) << (percentileNanos[1] / 1e6)
+             << std::setw(12) << (maxNanos / 1e6)
+             << std::setw(12) << (totalNanos / 1e6) << std::endl;
+      }
+   }
+
+   out.flags(savedFlags);
+   out.precision(savedPrecision);
+}
+
+// -----------------------------------------------------------------------------
+// Function: enableStats
+// Description: Turns on stats recording (before any pass starts).
+// -----------------------------------------------------------------------------
+void NGROM_NS::enableStats()
+{
+   s_statsEnabled = true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: isStatsEnabled
+// Description: Checks if stats are recorded.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::isStatsEnabled()
+{
+   return s_statsEnabled;
+}
+
+// -----------------------------------------------------------------------------
+// Function: printStats
+// Description: Prints the stats report (once the passes are done).
+// -----------------------------------------------------------------------------
+void NGROM_NS::printStats(std::ostream& out)
+{
+   StatsRegistry::instance().print(out);
+}
+
+// -----------------------------------------------------------------------------
+// Function: StatsReport::~StatsReport
+// Description: Destructor; prints the report, if stats are on.
+// -----------------------------------------------------------------------------
+NGROM_NS::StatsReport::~StatsReport()
+{
+   if (s_statsEnabled)
+   {
+      printStats(m_out);
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: FileStats::FileStats
+// Description: Constructor; makes this the thread's current file.
+// -----------------------------------------------------------------------------
+NGROM_NS::FileStats::FileStats(StatPass pass, const std::string& filename)
+ : m_enabled(s_statsEnabled),
+   m_pass(pass),
+   m_outerFile(t_fileStats),
+   m_numBytesIn(0),
+   m_numBytesOut(0),
+   m_fileSpan(PASS_NAMES[pass], "file", filename)
+{
+   for (unsigned int stage = 0; stage < NUM_STAT_STAGES; stage++)
+   {
+      m_stageNanos[stage] = 0;
+      m_stageTimed[stage] = false;
+   }
+
+   if (m_enabled)
+   {
+      t_fileStats = this;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: FileStats::~FileStats
+// Description: Destructor; records the file's stage times and bytes.
+// -----------------------------------------------------------------------------
+NGROM_NS::FileStats::~FileStats()
+{
+   if (!m_enabled)
+   {
+      return;
+   }
+   t_fileStats = m_outerFile;
+
+   ThreadStats& threadStats = getThreadStats();
+   for (unsigned int stage = 0; stage < NUM_STAT_STAGES; stage++)
+   {
+      if (m_stageTimed[stage])
+      {
+         threadStats.stages[m_pass][stage].record(m_stageNanos[stage]);
+      }
+   }
+
+   addRelaxed(threadStats.numFiles[m_pass], 1);
+   addRelaxed(threadStats.numBytesIn[m_pass], m_numBytesIn);
+   addRelaxed(threadStats.numBytesOut[m_pass], m_numBytesOut);
+}
+
+// -----------------------------------------------------------------------------
+// Function: FileStats::addBytes
+// Description: Counts data read and written for the file.
+// -----------------------------------------------------------------------------
+void NGROM_NS::FileStats::addBytes(uint64_t numBytesIn, uint64_t numBytesOut)
+{
+   m_numBytesIn += numBytesIn;
+   m_numBytesOut += numBytesOut;
+}
+
+// -----------------------------------------------------------------------------
+// Function: StatTimer::StatTimer
+// Description: Constructor; starts timing (if the thread has a file).
+// -----------------------------------------------------------------------------
+NGROM_NS::StatTimer::StatTimer(StatStage stage)
+ : m_fileStats(t_fileStats),
+   m_stage(stage),
+   m_outerTimer(NULL),
+   m_startNanos(0),
+   m_innerNanos(0),
+   m_span(STAGE_NAMES[stage], "stage")
+{
+   if (m_fileStats != NULL)
+   {
+      m_outerTimer = t_statTimer;
+      t_statTimer = this;
+      m_startNanos = getNanos();
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: StatTimer::stop
+// Description: Stops timing: adds the time (less that of inner timers) to
+//              the stage, and the whole time to the outer timer's inner time.
+// -----------------------------------------------------------------------------
+void NGROM_NS::StatTimer::stop()
+{
+   m_span.end();
+   if (m_fileStats == NULL)
+   {
+      return;
+   }
+
+   uint64_t elapsedNanos = getNanos() - m_startNanos;
+   uint64_t ownNanos = (elapsedNanos > m_innerNanos) ? (elapsedNanos - m_innerNanos) : 0;
+   m_fileStats->m_stageNanos[m_stage] += ownNanos;
+   m_fileStats->m_stageTimed[m_stage] = true;
+
+   if (m_outerTimer != NULL)
+   {
+      m_outerTimer->m_innerNanos += elapsedNanos;
+   }
+   t_statTimer = m_outerTimer;
+   m_fileStats = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// Function: StatPassTimer::StatPassTimer
+// Description: Constructor; starts timing the pass.
+// -----------------------------------------------------------------------------
+NGROM_NS::StatPassTimer::StatPassTimer(StatPass pass)
+ : m_enabled(s_statsEnabled),
+   m_pass(pass),
+   m_startNanos(0),
+   m_startReads(0),
+   m_startWrites(0)
+{
+   if (m_enabled)
+   {
+      readSyscallCounts(m_startReads, m_startWrites);
+      m_startNanos = getNanos();
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: StatPassTimer::~StatPassTimer
+// Description: Destructor; records the pass's time and syscalls.
+// -----------------------------------------------------------------------------
+NGROM_NS::StatPassTimer::~StatPassTimer()
+{
+   if (!m_enabled)
+   {
+      return;
+   }
+
+   uint64_t wallNanos = getNanos() - m_startNanos;
+   uint64_t numReads = m_startReads;
+   uint64_t numWrites = m_startWrites;
+   readSyscallCounts(numReads, numWrites);
+   StatsRegistry::instance().addPass(m_pass, wallNanos, numReads - m_startReads, numWrites - m_startWrites);
+}
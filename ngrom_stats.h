@@ -0,0 +1,142 @@
+// New GROM - Run statistics (--stats)
+//
+// Each file handled by a pass (the format checks, the conversions, or the
+// --info listing) has its time split into stages: open, header read, format
+// check, decode, write, and close.  Timers nest, and a stage's time excludes
+// the stages timed inside it (e.g., decode excludes the writes it makes).
+// Each thread records its files' stage times into its own HDR (high dynamic
+// range: log-linear buckets, ~3% precision) histograms, with no locking or
+// shared writes; they're merged when the report is printed.  The report gives
+// p50/p99/max per stage and, per pass, files/s, MB/s, and the process's read
+// and write syscall counts.  With --trace, each file and each timed stage is
+// also a span in the timeline.
+
+#ifndef NGROM_STATS_H
+#define NGROM_STATS_H
+
+#include "ngrom_trace.h"
+#include<stdint.h>
+#include<iosfwd>
+#include<string>
+
+namespace NGROM_NS
+{
+   enum StatPass
+   {
+      CHECK_PASS,   // checkFormats
+      CONVERT_PASS, // convertFiles (and walk runs)
+      INFO_PASS,    // showInfoList
+      NUM_STAT_PASSES
+   };
+
+   enum StatStage
+   {
+      OPEN_STAGE,
+      HEADER_STAGE,
+      CHECK_STAGE,
+      DECODE_STAGE,
+      WRITE_STAGE,
+      CLOSE_STAGE,
+      NUM_STAT_STAGES
+   };
+
+   void enableStats();
+   bool isStatsEnabled();
+   void printStats(std::ostream& out);
+
+   // --------------------------------------------------------------------------
+   // Class: StatsReport
+   // Description: Prints the stats report (if stats are on) on destruction.
+   // --------------------------------------------------------------------------
+   class StatsReport
+   {
+   public:
+      explicit StatsReport(std::ostream& out) : m_out(out) {}
+      ~StatsReport();
+
+      StatsReport(const StatsReport&) = delete;
+      StatsReport& operator=(const StatsReport&) = delete;
+
+   private:
+      std::ostream& m_out;
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: FileStats
+   // Description: The stage times of the file a thread is handling (timed by
+   //              StatTimers on that thread); recorded into the thread's
+   //              histograms on destruction.  Only traced with stats off.
+   // --------------------------------------------------------------------------
+   class FileStats
+   {
+   public:
+      FileStats(StatPass pass, const std::string& filename);
+      ~FileStats();
+
+      void addBytes(uint64_t numBytesIn, uint64_t numBytesOut);
+
+      FileStats(const FileStats&) = delete;
+      FileStats& operator=(const FileStats&) = delete;
+
+   private:
+      friend class StatTimer;
+
+      bool m_enabled;
+      StatPass m_pass;
+      FileStats* m_outerFile; // Thread's current file before this one
+      uint64_t m_stageNanos[NUM_STAT_STAGES];
+      bool m_stageTimed[NUM_STAT_STAGES];
+      uint64_t m_numBytesIn;
+      uint64_t m_numBytesOut;
+      TraceSpan m_fileSpan;
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: StatTimer
+   // Description: Times a stage of the thread's current file, from
+   //              construction to stop() (or destruction).  Only traced
+   //              without a current file.
+   // --------------------------------------------------------------------------
+   class StatTimer
+   {
+   public:
+      explicit StatTimer(StatStage stage);
+      ~StatTimer() { stop(); }
+
+      void stop();
+
+      StatTimer(const StatTimer&) = delete;
+      StatTimer& operator=(const StatTimer&) = delete;
+
+   private:
+      FileStats* m_fileStats; // NULL = not timing
+      StatStage m_stage;
+      StatTimer* m_outerTimer;
+      uint64_t m_startNanos;
+      uint64_t m_innerNanos; // Timed by the timers inside this one
+      TraceSpan m_span;
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: StatPassTimer
+   // Description: Times a whole pass (wall time and syscalls).
+   // --------------------------------------------------------------------------
+   class StatPassTimer
+   {
+   public:
+      explicit StatPassTimer(StatPass pass);
+      ~StatPassTimer();
+
+      StatPassTimer(const StatPassTimer&) = delete;
+      StatPassTimer& operator=(const StatPassTimer&) = delete;
+
+   private:
+      bool m_enabled;
+      StatPass m_pass;
+      uint64_t m_startNanos;
+      uint64_t m_startReads;
+      uint64_t m_startWrites;
+   };
+}
+
+#endif // NGROM_STATS_H
@@ -0,0 +1,562 @@
+// New GROM - Tar stream conversion
+
+#include "ngrom_tar.h"
+#include "ngrom_input.h"
+#include<stdio.h>  // for FILE I/O
+#include<iostream> // for std::cout and std::err
+#include<vector>
+#include<errno.h>
+#include<stddef.h> // for offsetof
+#include<string.h>
+#include<unistd.h> // for dup
+
+// Tar archives are 512 byte blocks, written in 10 KB records.
+static const size_t TAR_BLOCK_BYTES = 512;
+static const size_t TAR_RECORD_BYTES = 20 * TAR_BLOCK_BYTES;
+
+// Stream buffer sizes (large sequential reads and writes)
+static const size_t TAR_BUFFER_BYTES = 1024 * 1024;
+
+// Members bigger than this are not ROMs; they're skipped without being held in memory.
+static const uint64_t MAX_TAR_ROM_BYTES = 64 * 1024 * 1024;
+
+// Header type flags
+static const char TAR_TYPE_FILE = '0';
+static const char TAR_TYPE_OLD_FILE = '\0';
+static const char TAR_TYPE_CONTIGUOUS = '7';
+static const char TAR_TYPE_DIR = '5';
+static const char TAR_TYPE_GNU_LONG_NAME = 'L';
+static const char TAR_TYPE_PAX_HEADER = 'x';
+static const char TAR_TYPE_PAX_GLOBAL = 'g';
+
+namespace
+{
+   // ustar header block
+   struct TarHeader
+   {
+      char name[100];
+      char mode[8];
+      char uid[8];
+      char gid[8];
+      char size[12];
+      char mtime[12];
+      char checksum[8];
+      char typeflag;
+      char linkname[100];
+      char magic[6];
+      char version[2];
+      char uname[32];
+      char gname[32];
+      char devmajor[8];
+      char devminor[8];
+      char prefix[155];
+      char padding[12];
+   };
+
+   // -------------------------------------------------------------------------
+   // Class: TarStream
+   // Description: A tar stream being read or written, with a large stream
+   //              buffer (which must outlive the FILE's use); counts the
+   //              bytes, for block padding.
+   // -------------------------------------------------------------------------
+   class TarStream
+   {
+   public:
+      TarStream() : m_file(NULL), m_numBytes(0), m_buffer(TAR_BUFFER_BYTES) {}
+
+      void attach(FILE* file) { m_file = file; setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size()); }
+      FILE* file() const { return m_file; }
+
+      bool read(void* bytes, size_t numBytes);
+      bool skip(uint64_t numBytes);
+      bool write(const void* bytes, size_t numBytes);
+      bool pad(size_t multipleBytes);
+
+   private:
+      FILE* m_file;
+      uint64_t m_numBytes;
+      std::vector<char> m_buffer;
+   };
+}
+
+// -----------------------------------------------------------------------------
+// Function: TarStream::read
+// Description: Reads exactly numBytes.
+// Return: true if read; false on error or end of stream.
+// -----------------------------------------------------------------------------
+bool TarStream::read(void* bytes, size_t numBytes)
+{
+   size_t numRead = fread(bytes, 1, numBytes, m_file);
+   m_numBytes += numRead;
+   return (numRead == numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: TarStream::skip
+// Description: Reads and drops numBytes (the stream may be a pipe).
+// Return: true if skipped; false on error or end of stream.
+// -----------------------------------------------------------------------------
+bool TarStream::skip(uint64_t numBytes)
+{
+   char discardBytes[TAR_RECORD_BYTES];
+   while (numBytes > 0)
+   {
+      size_t numChunk = (numBytes < sizeof(discardBytes)) ? numBytes : sizeof(discardBytes);
+      if (!read(discardBytes, numChunk))
+      {
+         return false;
+      }
+      numBytes -= numChunk;
+   }
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: TarStream::write
+// Description: Writes numBytes.
+// Return: true if written; false on error.
+// -----------------------------------------------------------------------------
+bool TarStream::write(const void* bytes, size_t numBytes)
+{
+   size_t numWritten = fwrite(bytes, 1, numBytes, m_file);
+   m_numBytes += numWritten;
+   return (numWritten == numBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: TarStream::pad
+// Description: Writes zeros up to the next multiple of multipleBytes.
+// Return: true if written; false on error.
+// -----------------------------------------------------------------------------
+bool TarStream::pad(size_t multipleBytes)
+{
+   static const char zeroBytes[TAR_RECORD_BYTES] = { 0 };
+   size_t numPadBytes = (multipleBytes - (m_numBytes % multipleBytes)) % multipleBytes;
+   return write(zeroBytes, numPadBytes);
+}
+
+// -----------------------------------------------------------------------------
+// Function: parseTarNumber
+// Description: Parses a numeric header field: octal text, or (GNU) base-256
+//              binary when the first byte has its high bit set.
+// -----------------------------------------------------------------------------
+static uint64_t parseTarNumber(const char* field, size_t fieldBytes)
+{
+   uint64_t retval = 0;
+
+   if ((unsigned char)field[0] & 0x80)
+   {
+      retval = (unsigned char)field[0] & 0x7F;
+      for (size_t i = 1; i < fieldBytes; i++)
+      {
+         retval = (retval << 8) | (unsigned char)field[i];
+      }
+      return retval;
+   }
+
+   for (size_t i = 0; (i < fieldBytes) && (field[i] != '\0'); i++)
+   {
+      if ((field[i] >= '0') && (field[i] <= '7'))
+      {
+         retval = (retval << 3) | (field[i] - '0');
+      }
+   }
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getHeaderChecksum
+// Description: Sums the header bytes, with the checksum field as spaces.
+// -----------------------------------------------------------------------------
+static unsigned int getHeaderChecksum(const TarHeader& header)
+{
+   const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&header);
+   unsigned int retval = 0;
+
+   for (size_t i = 0; i < sizeof(TarHeader); i++)
+   {
+      bool inChecksum = (i >= offsetof(TarHeader, checksum)) && (i < offsetof(TarHeader, checksum) + sizeof(header.checksum));
+      retval += inChecksum ? ' ' : bytes[i];
+   }
+   return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Function: getHeaderField
+// Description: Gets a (possibly not NUL terminated) text field.
+// -----------------------------------------------------------------------------
+static std::string getHeaderField(const char* field, size_t fieldBytes)
+{
+   return std::string(field, strnlen(field, fieldBytes));
+}
+
+// -----------------------------------------------------------------------------
+// Function: getPaxPath
+// Description: Finds the "path" record in pax extended header data
+//              ("<length> <key>=<value>\n" records).
+// Return: The path, or an empty string if there is none.
+// -----------------------------------------------------------------------------
+static std::string getPaxPath(const std::vector<char>& paxBytes)
+{
+   size_t pos = 0;
+   while (pos < paxBytes.size())
+   {
+      size_t recordLength = 0;
+      size_t spacePos = pos;
+      while ((spacePos < paxBytes.size()) && (paxBytes[spacePos] >= '0') && (paxBytes[spacePos] <= '9'))
+      {
+         recordLength = (recordLength * 10) + (paxBytes[spacePos] - '0');
+         spacePos++;
+      }
+
+      if ((pos + recordLength > paxBytes.size()) || (spacePos + 1 >= pos + recordLength) || (paxBytes[spacePos] != ' '))
+      {
+         break; // Malformed
+      }
+
+      std::string record(paxBytes.data() + spacePos + 1, paxBytes.data() + pos + recordLength - 1);
+      if (0 == record.compare(0, 5, "path="))
+      {
+         return record.substr(5);
+      }
+      pos += recordLength;
+   }
+
+   return "";
+}
+
+// -----------------------------------------------------------------------------
+// Function: writeMemberHeader
+// Description: Writes the header of an output member (metadata copied from
+//              the input member's header), with a GNU long name record first
+//              if the name doesn't fit in the ustar fields.
+// Return: true if written; false on error.
+// -----------------------------------------------------------------------------
+static bool writeMemberHeader(TarStream& tarOut, const TarHeader& inHeader, const std::string& name,
+                              char typeflag, uint64_t size)
+{
+   TarHeader header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.mode, inHeader.mode, sizeof(header.mode));
+   memcpy(header.uid, inHeader.uid, sizeof(header.uid));
+   memcpy(header.gid, inHeader.gid, sizeof(header.gid));
+   memcpy(header.mtime, inHeader.mtime, sizeof(header.mtime));
+   memcpy(header.uname, inHeader.uname, sizeof(header.uname));
+   memcpy(header.gname, inHeader.gname, sizeof(header.gname));
+   memcpy(header.magic, "ustar", 6);
+   memcpy(header.version, "00", 2);
+
+   // Long names go in the prefix and name fields (split at a '/'), or else
+   // in a GNU long name record.
+   bool longName = false;
+   if (name.length() <= sizeof(header.name))
+   {
+      memcpy(header.name, name.data(), name.length());
+   }
+   else
+   {
+      size_t slashPos = name.rfind('/', sizeof(header.prefix));
+      if ((slashPos != std::string::npos) && (slashPos > 0) && (name.length() - slashPos - 1 <= sizeof(header.name)))
+      {
+         memcpy(header.prefix, name.data(), slashPos);
+         memcpy(header.name, name.data() + slashPos + 1, name.length() - slashPos - 1);
+      }
+      else
+      {
+         longName = true;
+         memcpy(header.name, name.data(), sizeof(header.name));
+      }
+   }
+
+   if (longName)
+   {
+      TarHeader longNameHeader = header;
+      memset(longNameHeader.prefix, 0, sizeof(longNameHeader.prefix));
+      memcpy(longNameHeader.name, "././@LongLink", 13);
+      longNameHeader.typeflag = TAR_TYPE_GNU_LONG_NAME;
+      snprintf(longNameHeader.size, sizeof(longNameHeader.size), "%011llo", (unsigned long long)(name.length() + 1));
+      snprintf(longNameHeader.checksum, sizeof(longNameHeader.checksum), "%06o", getHeaderChecksum(longNameHeader));
+      longNameHeader.checksum[7] = ' ';
+
+      if (!tarOut.write(&longNameHeader, sizeof(longNameHeader)) ||
+          !tarOut.write(name.c_str(), name.length() + 1) ||
+          !tarOut.pad(TAR_BLOCK_BYTES))
+      {
+         return false;
+      }
+   }
+
+   header.typeflag = typeflag;
+   snprintf(header.size, sizeof(header.size), "%011llo", (unsigned long long)size);
+   snprintf(header.checksum, sizeof(header.checksum), "%06o", getHeaderChecksum(header));
+   header.checksum[7] = ' ';
+
+   return tarOut.write(&header, sizeof(header));
+}
+
+// -----------------------------------------------------------------------------
+// Function: checkMemberFormat
+// Description: The format check (as checkFormats) for a member's contents.
+// Return: true if the member passes.
+// -----------------------------------------------------------------------------
+static bool checkMemberFormat(NGROM_NS::RomFormat inputFormat, const std::vector<unsigned char>& fileBytes)
+{
+   if (fileBytes.size() < NUM_HEADER_BYTES)
+   {
+      return false;
+   }
+
+   if (inputFormat == NGROM_NS::SMD)
+   {
+      return (fileBytes[8] == 0xAA) && (fileBytes[9] == 0xBB) && (0 != memcmp(fileBytes.data() + 0x100, "SEGA", 4));
+   }
+
+   return (getLikelyDataFormat(fileBytes.data(), fileBytes.size()) != NGROM_NS::UNK_FMT);
+}
+
+// -----------------------------------------------------------------------------
+// Function: runTarConversion
+// Description: Converts the ROMs in the tar stream tarInPath (a file, which
+//              may be gzip-compressed, or "-" for stdin) into a tar stream of
+//              BINs at tarOutPath (or "-" for stdout).  Directories are kept;
+//              other members that aren't regular files, and files that aren't
+//              in a recognized format, are left out.
+// Return: Exit code: 0 if all converted; 2 on a failed format check (with
+//         STOP), a conversion error, or a read/write error.
+// -----------------------------------------------------------------------------
+int NGROM_NS::runTarConversion(const std::string& tarInPath, const std::string& tarOutPath,
+                               RomFormat inputFormat, FileCheckAction checkAction)
+{
+   // (With the tar going to stdout, messages go to stderr.)
+   std::ostream& log = (tarOutPath == "-") ? std::cerr : std::cout;
+
+   // (Standard input and output are used through FILEs of their own, so
+   // their buffers can be big, and are done with when these are closed.)
+   TarStream tarIn;
+   NGROM_NS::InputFile input;
+   FILE* stdinFile = NULL;
+   if (tarInPath == "-")
+   {
+      int stdinFd = dup(STDIN_FILENO);
+      stdinFile = (stdinFd < 0) ? NULL : fdopen(stdinFd, "r");
+   }
+
+   if ((tarInPath == "-") ? (stdinFile != NULL) : input.open(tarInPath))
+   {
+      tarIn.attach((stdinFile != NULL) ? stdinFile : input.file());
+   }
+   else
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to open tar input " << tarInPath << "... " << strerror(saved_errno) << std::endl;
+      return 2;
+   }
+
+   TarStream tarOut;
+   int stdoutFd = (tarOutPath == "-") ? dup(STDOUT_FILENO) : -1;
+   FILE* outFile = (tarOutPath == "-") ? ((stdoutFd < 0) ? NULL : fdopen(stdoutFd, "w")) : fopen(tarOutPath.c_str(), "w");
+   if (outFile == NULL)
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to open tar output " << tarOutPath << "... " << strerror(saved_errno) << std::endl;
+      if (stdinFile != NULL) { fclose(stdinFile); }
+      return 2;
+   }
+   tarOut.attach(outFile);
+
+   int retval = 0;
+   size_t numConverted = 0;
+   size_t numSkipped = 0;
+   std::string nextName; // From a GNU long name or pax header
+   std::vector<unsigned char> fileBytes;
+   std::vector<unsigned char> binBytes;
+
+   for (;;)
+   {
+      TarHeader header;
+      if (!tarIn.read(&header, sizeof(header)))
+      {
+         std::cerr << "NGROM ERROR: Tar input ended without an end-of-archive marker" << std::endl;
+         retval = 2;
+         break;
+      }
+
+      if (header.name[0] == '\0')
+      {
+         // End of archive; read the rest (e.g., so a writer into a pipe
+         // isn't cut off).
+         tarIn.skip(~0ULL);
+         break;
+      }
+
+      if (parseTarNumber(header.checksum, sizeof(header.checksum)) != getHeaderChecksum(header))
+      {
+         std::cerr << "NGROM ERROR: Corrupt tar header (bad checksum)" << std::endl;
+         retval = 2;
+         break;
+      }
+
+      uint64_t size = parseTarNumber(header.size, sizeof(header.size));
+      uint64_t paddedSize = (size + TAR_BLOCK_BYTES - 1) / TAR_BLOCK_BYTES * TAR_BLOCK_BYTES;
+
+      std::string name = nextName;
+      nextName.clear();
+      if (name.empty())
+      {
+         name = getHeaderField(header.name, sizeof(header.name));
+         if ((0 == memcmp(header.magic, "ustar", 6)) && (header.prefix[0] != '\0'))
+         {
+            name = getHeaderField(header.prefix, sizeof(header.prefix)) + "/" + name;
+         }
+      }
+
+      bool readOK = true;
+      if ((header.typeflag == TAR_TYPE_GNU_LONG_NAME) || (header.typeflag == TAR_TYPE_PAX_HEADER))
+      {
+         // The next member's name
+         std::vector<char> recordBytes(paddedSize);
+         readOK = (size <= MAX_TAR_ROM_BYTES) && tarIn.read(recordBytes.data(), paddedSize);
+         if (readOK)
+         {
+            recordBytes.resize(size);
+            nextName = (header.typeflag == TAR_TYPE_PAX_HEADER)
+                     ? getPaxPath(recordBytes)
+                     : std::string(recordBytes.data(), strnlen(recordBytes.data(), recordBytes.size()));
+         }
+      }
+      else if (header.typeflag == TAR_TYPE_DIR)
+      {
+         readOK = tarIn.skip(paddedSize);
+         if (!writeMemberHeader(tarOut, header, name, TAR_TYPE_DIR, 0))
+         {
+            retval = 2;
+         }
+      }
+      else if ((header.typeflag != TAR_TYPE_FILE) && (header.typeflag != TAR_TYPE_OLD_FILE) &&
+               (header.typeflag != TAR_TYPE_CONTIGUOUS))
+      {
+         // Links, devices, global pax headers, etc.
+         if (header.typeflag != TAR_TYPE_PAX_GLOBAL)
+         {
+            log << "Skipping " << name << " (not a regular file)" << std::endl;
+            numSkipped++;
+         }
+         readOK = tarIn.skip(paddedSize);
+      }
+      else if (size > MAX_TAR_ROM_BYTES)
+      {
+         log << "Skipping " << name << " (too big for a ROM)" << std::endl;
+         numSkipped++;
+         readOK = tarIn.skip(paddedSize);
+      }
+      else
+      {
+         fileBytes.resize(paddedSize);
+         readOK = tarIn.read(fileBytes.data(), paddedSize);
+         fileBytes.resize(size);
+
+         // Output member: same directory, converted file name
+         size_t slashPos = name.rfind('/');
+         std::string outName = ((slashPos == std::string::npos) ? "" : name.substr(0, slashPos + 1)) + getOutputFilename(name);
+         log << "Converting " << name << std::endl
+             << "        to " << outName << std::endl;
+
+         RomFormat fmt = (inputFormat == AUTO_FMT) ? getLikelyDataFormat(fileBytes.data(), fileBytes.size()) : inputFormat;
+         uint64_t romSize = getROMSize(fmt, fileBytes.size());
+
+         if (!readOK)
+         {
+            // (Reported below.)
+         }
+         else if ((checkAction != SKIP) && !checkMemberFormat(inputFormat, fileBytes))
+         {
+            if (checkAction == STOP)
+            {
+               log << "NGROM stopping due to failed " << getFormatName(inputFormat) << " format check" << std::endl;
+               retval = 2;
+            }
+            else
+            {
+               std::cerr << "  NGROM WARNING: failed " << getFormatName(inputFormat) << " format check; continuing..." << std::endl;
+            }
+         }
+
+         if ((retval != 0) || !readOK)
+         {
+            // Stopping
+         }
+         else if (fmt == UNK_FMT)
+         {
+            std::cerr << "  NGROM ERROR: Unrecognized file format..." << std::endl;
+            log << "  ... skipping." << std::endl;
+            numSkipped++;
+         }
+         else if ((romSize == 0) || (fileBytes.size() < NUM_HEADER_BYTES))
+         {
+            std::cerr << "  NGROM ERROR: Input file size (" << fileBytes.size() << " bytes) is not valid for "
+                      << getFormatName(fmt) << " (possible data corruption)." << std::endl;
+            retval = 2;
+         }
+         else
+         {
+            binBytes.resize(romSize);
+            decodeROMData(fmt, binBytes.data(), fileBytes.data(), romSize);
+
+            if (!writeMemberHeader(tarOut, header, outName, TAR_TYPE_FILE, romSize) ||
+                !tarOut.write(binBytes.data(), romSize) ||
+                !tarOut.pad(TAR_BLOCK_BYTES))
+            {
+               retval = 2;
+            }
+            else
+            {
+               log << "  Conversion complete!" << std::endl;
+               numConverted++;
+            }
+         }
+      }
+
+      if (!readOK)
+      {
+         int saved_errno = errno;
+         std::cerr << "NGROM ERROR: Failed to read tar input... "
+                   << (ferror(tarIn.file()) ? strerror(saved_errno) : "unexpected end of stream") << std::endl;
+         retval = 2;
+      }
+
+      if (retval != 0)
+      {
+         break;
+      }
+   }
+
+   // End of archive: two zero blocks, padded to a whole record.
+   static const char zeroBytes[2 * TAR_BLOCK_BYTES] = { 0 };
+   bool writeOK = tarOut.write(zeroBytes, sizeof(zeroBytes)) && tarOut.pad(TAR_RECORD_BYTES) && (0 == fflush(outFile));
+   if (!writeOK || ferror(outFile))
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to write tar output... " << strerror(saved_errno) << std::endl;
+      retval = 2;
+   }
+
+   if ((0 != fclose(outFile)) && (retval == 0))
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to close tar output... " << strerror(saved_errno) << std::endl;
+      retval = 2;
+   }
+
+   if (stdinFile != NULL)
+   {
+      fclose(stdinFile);
+   }
+   else if ((retval == 0) && !input.finish())
+   {
+      std::cerr << "NGROM ERROR: Tar input failed to decompress (possible data corruption)." << std::endl;
+      retval = 2;
+   }
+
+   log << "Tar: " << numConverted << " file(s) converted, " << numSkipped << " skipped" << std::endl;
+   return retval;
+}
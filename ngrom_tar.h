@@ -0,0 +1,22 @@
+// New GROM - Tar stream conversion
+//
+// "ngrom --tar-in IN --tar-out OUT" converts every ROM in a tar stream and
+// writes the BINs as another tar stream (either may be "-" for stdin/
+// stdout), so a whole batch moves as one sequential stream with large
+// buffered reads and writes: no per-file creates, fsyncs, or directory
+// updates.  Each member is converted in memory; its directory and metadata
+// are kept, and its name gets the usual .bin extension.
+
+#ifndef NGROM_TAR_H
+#define NGROM_TAR_H
+
+#include "ngrom.h"
+#include<string>
+
+namespace NGROM_NS
+{
+   int runTarConversion(const std::string& tarInPath, const std::string& tarOutPath,
+                        RomFormat inputFormat, FileCheckAction checkAction);
+}
+
+#endif // NGROM_TAR_H
@@ -0,0 +1,283 @@
+// New GROM - Timeline tracing (--trace)
+
+#include "ngrom_trace.h"
+#include<atomic>
+#include<chrono>
+#include<iostream> // for std::cerr
+#include<memory>
+#include<mutex>
+#include<vector>
+#include<errno.h>
+#include<string.h>
+#include<unistd.h>      // for getpid, syscall
+#include<sys/syscall.h> // for SYS_gettid
+
+// Spans recorded?
+static std::atomic<bool> s_traceEnabled(false);
+
+namespace
+{
+   // One recorded span
+   struct TraceEvent
+   {
+      const char* name;
+      const char* category;
+      std::string detail;
+      uint64_t startNanos;
+      uint64_t numNanos;
+   };
+
+   // -------------------------------------------------------------------------
+   // Struct: ThreadTrace
+   // Description: A thread's recorded spans.  (Its mutex is only contended
+   //              when the trace is written.)
+   // -------------------------------------------------------------------------
+   struct ThreadTrace
+   {
+      long threadId;
+      std::mutex mutex;
+      std::vector<TraceEvent> events;
+   };
+
+   // -------------------------------------------------------------------------
+   // Class: TraceRegistry
+   // Description: Every thread's spans (kept after the thread ends).
+   // -------------------------------------------------------------------------
+   class TraceRegistry
+   {
+   public:
+      static TraceRegistry& instance();
+
+      ThreadTrace* addThread();
+      void write(FILE* traceFile, uint64_t originNanos);
+
+   private:
+      TraceRegistry() {}
+
+      std::mutex m_mutex; // Guards m_threads
+      std::vector<std::unique_ptr<ThreadTrace> > m_threads;
+   };
+
+   thread_local ThreadTrace* t_threadTrace = NULL;
+}
+
+// Start of the trace (its time 0)
+static uint64_t s_originNanos = 0;
+
+// -----------------------------------------------------------------------------
+// Function: getNanos
+// Description: Gets the (monotonic) time in ns.
+// -----------------------------------------------------------------------------
+static uint64_t getNanos()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------------------------------------------------
+// Function: writeJSONString
+// Description: Writes a string as a (quoted, escaped) JSON string.
+// -----------------------------------------------------------------------------
+static void writeJSONString(FILE* traceFile, const std::string& text)
+{
+   fputc('"', traceFile);
+   for (unsigned char c : text)
+   {
+      if ((c == '"') || (c == '\\'))
+      {
+         fputc('\\', traceFile);
+         fputc(c, traceFile);
+      }
+      else if (c < 0x20)
+      {
+         fprintf(traceFile, "\\u%04x", c);
+      }
+      else
+      {
+         fputc(c, traceFile);
+      }
+   }
+   fputc('"', traceFile);
+}
+
+// -----------------------------------------------------------------------------
+// Function: TraceRegistry::instance
+// Description: Gets the registry.
+// -----------------------------------------------------------------------------
+TraceRegistry& TraceRegistry::instance()
+{
+   static TraceRegistry s_registry;
+   return s_registry;
+}
+
+// -----------------------------------------------------------------------------
+// Function: TraceRegistry::addThread
+// Description: Registers a thread's (new) span buffer.
+// -----------------------------------------------------------------------------
+ThreadTrace* TraceRegistry::addThread()
+{
+   std::unique_ptr<ThreadTrace> threadTrace(new ThreadTrace());
+   threadTrace->threadId = syscall(SYS_gettid);
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_threads.push_back(std::move(threadTrace));
+   return m_threads.back().get();
+}
+
+// -----------------------------------------------------------------------------
+// Function: TraceRegistry::write
+// Description: Writes every thread's spans as complete ("X") trace events,
+//              with times in microseconds since originNanos.
+// -----------------------------------------------------------------------------
+void TraceRegistry::write(FILE* traceFile, uint64_t originNanos)
+{
+   long processId = getpid();
+   bool firstEvent = true;
+
+   fprintf(traceFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   for (const std::unique_ptr<ThreadTrace>& threadTrace : m_threads)
+   {
+      std::lock_guard<std::mutex> threadLock(threadTrace->mutex);
+      for (const TraceEvent& event : threadTrace->events)
+      {
+         uint64_t startNanos = (event.startNanos > originNanos) ? (event.startNanos - originNanos) : 0;
+         fprintf(traceFile, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":%ld,\"tid\":%ld",
+                 firstEvent ? "" : ",\n", event.name, event.category,
+                 (unsigned long long)(startNanos / 1000), (unsigned int)(startNanos % 1000),
+                 (unsigned long long)(event.numNanos / 1000), (unsigned int)(event.numNanos % 1000),
+                 processId, threadTrace->threadId);
+
+         if (!event.detail.empty())
+         {
+            fprintf(traceFile, ",\"args\":{\"detail\":");
+            writeJSONString(traceFile, event.detail);
+            fputc('}', traceFile);
+         }
+         fputc('}', traceFile);
+         firstEvent = false;
+      }
+   }
+
+   fprintf(traceFile, "\n]}\n");
+}
+
+// -----------------------------------------------------------------------------
+// Function: isTraceEnabled
+// Description: Checks if spans are recorded.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::isTraceEnabled()
+{
+   return s_traceEnabled.load(std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------
+// Function: TraceSession::TraceSession
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::TraceSession::TraceSession()
+ : m_file(NULL)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: TraceSession::~TraceSession
+// Description: Destructor; turns tracing off and writes the trace file.
+// -----------------------------------------------------------------------------
+NGROM_NS::TraceSession::~TraceSession()
+{
+   if (m_file == NULL)
+   {
+      return;
+   }
+
+   s_traceEnabled = false;
+   TraceRegistry::instance().write(m_file, s_originNanos);
+
+   if (0 != fclose(m_file))
+   {
+      int saved_errno = errno;
+      std::cerr << "NGROM ERROR: Failed to write trace file " << m_path << "... " << strerror(saved_errno) << std::endl;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: TraceSession::start
+// Description: Creates the trace file (written at the end) and turns tracing
+//              on.
+// Return: true if created; false otherwise (errno is set).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::TraceSession::start(const std::string& path)
+{
+   m_file = fopen(path.c_str(), "w");
+   if (m_file == NULL)
+   {
+      return false;
+   }
+
+   m_path = path;
+   s_originNanos = getNanos();
+   s_traceEnabled = true;
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: TraceSpan::TraceSpan
+// Description: Constructor; starts the span (if tracing is on).
+// -----------------------------------------------------------------------------
+NGROM_NS::TraceSpan::TraceSpan(const char* name, const char* category)
+ : m_name(isTraceEnabled() ? name : NULL),
+   m_category(category),
+   m_startNanos(0)
+{
+   if (m_name != NULL)
+   {
+      m_startNanos = getNanos();
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: TraceSpan::TraceSpan
+// Description: Constructor; starts the span, with a detail (if tracing is
+//              on).
+// -----------------------------------------------------------------------------
+NGROM_NS::TraceSpan::TraceSpan(const char* name, const char* category, const std::string& detail)
+ : m_name(isTraceEnabled() ? name : NULL),
+   m_category(category),
+   m_startNanos(0)
+{
+   if (m_name != NULL)
+   {
+      m_detail = detail;
+      m_startNanos = getNanos();
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: TraceSpan::end
+// Description: Ends the span, adding it to the thread's buffer.
+// -----------------------------------------------------------------------------
+void NGROM_NS::TraceSpan::end()
+{
+   if (m_name == NULL)
+   {
+      return;
+   }
+
+   TraceEvent event;
+   event.name = m_name;
+   event.category = m_category;
+   event.detail.swap(m_detail);
+   event.startNanos = m_startNanos;
+   event.numNanos = getNanos() - m_startNanos;
+   m_name = NULL;
+
+   if (t_threadTrace == NULL)
+   {
+      t_threadTrace = TraceRegistry::instance().addThread();
+   }
+
+   std::lock_guard<std::mutex> lock(t_threadTrace->mutex);
+   t_threadTrace->events.push_back(std::move(event));
+}
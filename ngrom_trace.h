@@ -0,0 +1,69 @@
+// New GROM - Timeline tracing (--trace)
+//
+// Spans of work (each file, its stages, the reads, decodes, and writes within
+// them, syncs, compression chunks, and waits for work or memory) are
+// recorded with the thread they ran on, and written at the end of the run as
+// a Chrome trace-event JSON file (for Perfetto, or chrome://tracing).  Each
+// thread appends to its own event buffer; the buffers are only merged when
+// the file is written.  With tracing off, a span costs one flag check.
+
+#ifndef NGROM_TRACE_H
+#define NGROM_TRACE_H
+
+#include<stdint.h>
+#include<stdio.h> // for FILE
+#include<string>
+
+namespace NGROM_NS
+{
+   bool isTraceEnabled();
+
+   // --------------------------------------------------------------------------
+   // Class: TraceSession
+   // Description: The trace of a run: start() turns tracing on, and the trace
+   //              file is written on destruction.
+   // --------------------------------------------------------------------------
+   class TraceSession
+   {
+   public:
+      TraceSession();
+      ~TraceSession();
+
+      bool start(const std::string& path);
+
+      TraceSession(const TraceSession&) = delete;
+      TraceSession& operator=(const TraceSession&) = delete;
+
+   private:
+      FILE* m_file;
+      std::string m_path;
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: TraceSpan
+   // Description: Records a span from construction to end() (or
+   //              destruction) on the calling thread, if tracing is on.  name
+   //              and category must be string literals; detail (e.g., a file
+   //              name) is shown as the span's argument.
+   // --------------------------------------------------------------------------
+   class TraceSpan
+   {
+   public:
+      TraceSpan(const char* name, const char* category);
+      TraceSpan(const char* name, const char* category, const std::string& detail);
+      ~TraceSpan() { end(); }
+
+      void end();
+
+      TraceSpan(const TraceSpan&) = delete;
+      TraceSpan& operator=(const TraceSpan&) = delete;
+
+   private:
+      const char* m_name; // NULL = not recording
+      const char* m_category;
+      std::string m_detail;
+      uint64_t m_startNanos;
+   };
+}
+
+#endif // NGROM_TRACE_H
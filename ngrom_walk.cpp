@@ -0,0 +1,355 @@
+// New GROM - Parallel directory walking
+
+#include "ngrom_walk.h"
+#include "ngrom_trace.h"
+#include<iostream> // for std::err
+#include<sstream>
+#include<algorithm>
+#include<thread>
+#include<errno.h>
+#include<string.h>
+#include<stddef.h>      // for offsetof
+#include<dirent.h>      // for DT_* entry types
+#include<fcntl.h>       // for open, openat
+#include<fnmatch.h>     // for fnmatch
+#include<unistd.h>      // for close
+#include<sys/stat.h>    // for fstatat
+#include<sys/syscall.h> // for SYS_getdents64
+
+// Bytes of directory entries fetched per getdents64 call
+static const size_t DIRENT_BUFFER_BYTES = 64 * 1024;
+
+namespace
+{
+   // getdents64 record (not declared by all libc versions)
+   struct LinuxDirent64
+   {
+      uint64_t d_ino;
+      int64_t d_off;
+      unsigned short d_reclen;
+      unsigned char d_type;
+      char d_name[1]; // Actually d_reclen - offsetof(d_name) bytes, NUL terminated
+   };
+}
+
+// -----------------------------------------------------------------------------
+// Function: FileQueue::FileQueue
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::FileQueue::FileQueue()
+ : m_numPopped(0),
+   m_closed(false),
+   m_cancelled(false)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: FileQueue::push
+// Description: Adds a file to the end of the queue.
+// Return: true if queued; false if the queue was cancelled.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::FileQueue::push(const std::string& filename)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   if (m_cancelled)
+   {
+      return false;
+   }
+
+   m_files.push_back(filename);
+   m_cond.notify_one();
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: FileQueue::close
+// Description: Marks the end of the input; pop() returns false once the queue
+//              is empty.
+// -----------------------------------------------------------------------------
+void NGROM_NS::FileQueue::close()
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_closed = true;
+   m_cond.notify_all();
+}
+
+// -----------------------------------------------------------------------------
+// Function: FileQueue::cancel
+// Description: Drops any queued files; pop() returns false from now on, and
+//              push() refuses new files (so a producer knows to stop).
+// -----------------------------------------------------------------------------
+void NGROM_NS::FileQueue::cancel()
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_cancelled = true;
+   m_files.clear();
+   m_cond.notify_all();
+}
+
+// -----------------------------------------------------------------------------
+// Function: FileQueue::pop
+// Description: Takes the next file, waiting for one if the queue is empty but
+//              not yet closed.
+// Return: true if a file was taken; false if there are no more files.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::FileQueue::pop(size_t& fileIndex, std::string& filename)
+{
+   // (Waiting here means the walk isn't finding files fast enough.)
+   TraceSpan waitSpan("wait for file", "wait");
+   std::unique_lock<std::mutex> lock(m_mutex);
+   m_cond.wait(lock, [this] { return !m_files.empty() || m_closed || m_cancelled; });
+   waitSpan.end();
+
+   if (m_files.empty() || m_cancelled)
+   {
+      return false;
+   }
+
+   filename = m_files.front();
+   m_files.pop_front();
+   fileIndex = m_numPopped++;
+   return true;
+}
+
+// -----------------------------------------------------------------------------
+// Function: FileQueue::peek
+// Description: Gets (up to maxFiles of) the files that pop() will take next.
+// Return: fileIndex of the first of them.
+// -----------------------------------------------------------------------------
+size_t NGROM_NS::FileQueue::peek(size_t maxFiles, std::vector<std::string>& filenames)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   size_t numFiles = std::min(maxFiles, m_files.size());
+   filenames.assign(m_files.begin(), m_files.begin() + numFiles);
+   return m_numPopped;
+}
+
+// -----------------------------------------------------------------------------
+// Function: DirectoryWalker::DirHandle::~DirHandle
+// Description: Destructor; closes the directory once no pending subdirectory
+//              needs it.
+// -----------------------------------------------------------------------------
+NGROM_NS::DirectoryWalker::DirHandle::~DirHandle()
+{
+   close(fd);
+}
+
+// -----------------------------------------------------------------------------
+// Function: DirectoryWalker::DirectoryWalker
+// Description: Constructor.
+// -----------------------------------------------------------------------------
+NGROM_NS::DirectoryWalker::DirectoryWalker()
+ : m_numBusy(0),
+   m_stopped(false),
+   m_numDirs(0),
+   m_numErrors(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+// Function: DirectoryWalker::defaultNumThreads
+// Description: Gets the number of walker threads to use.  Directory reads are
+//              mostly latency bound, so small machines get more threads than
+//              CPUs.
+// -----------------------------------------------------------------------------
+unsigned int NGROM_NS::DirectoryWalker::defaultNumThreads()
+{
+   return std::max(4u, std::thread::hardware_concurrency());
+}
+
+// -----------------------------------------------------------------------------
+// Function: DirectoryWalker::isExcluded
+// Description: Checks a file or directory name against the exclude globs.
+// -----------------------------------------------------------------------------
+bool NGROM_NS::DirectoryWalker::isExcluded(const char* name) const
+{
+   for (const std::string& pattern : m_excludes)
+   {
+      if (0 == fnmatch(pattern.c_str(), name, 0))
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+// -----------------------------------------------------------------------------
+// Function: DirectoryWalker::isIncluded
+// Description: Checks a file name against the include globs (if there are
+//              none, every file is included).
+// -----------------------------------------------------------------------------
+bool NGROM_NS::DirectoryWalker::isIncluded(const char* name) const
+{
+   for (const std::string& pattern : m_includes)
+   {
+      if (0 == fnmatch(pattern.c_str(), name, 0))
+      {
+         return true;
+      }
+   }
+   return m_includes.empty();
+}
+
+// -----------------------------------------------------------------------------
+// Function: DirectoryWalker::reportError
+// Description: Prints an error (one whole line at a time across threads) and
+//              counts it.
+// -----------------------------------------------------------------------------
+void NGROM_NS::DirectoryWalker::reportError(const std::string& what, const std::string& path, int saved_errno)
+{
+   std::ostringstream message;
+   message << "NGROM ERROR: Failed to " << what << " " << path << "... " << strerror(saved_errno) << std::endl;
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   std::cerr << message.str();
+   m_numErrors++;
+}
+
+// -----------------------------------------------------------------------------
+// Function: DirectoryWalker::readDirectory
+// Description: Reads one directory: files go to the handler, and
+//              subdirectories are queued for any thread to pick up.
+// -----------------------------------------------------------------------------
+void NGROM_NS::DirectoryWalker::readDirectory(unsigned int workerIndex, PendingDir& dir,
+                                              std::vector<char>& direntBytes, const FileHandler& handler)
+{
+   int dirFd = !dir.parent
+             ? open(dir.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+             : openat(dir.parent->fd, dir.name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+   if (dirFd < 0)
+   {
+      reportError("open directory", dir.path, errno);
+      return;
+   }
+
+   // (The parent is closed once its last pending subdirectory is opened.)
+   dir.parent.reset();
+   std::shared_ptr<DirHandle> dirHandle = std::make_shared<DirHandle>(dirFd);
+
+   m_numDirs++;
+   std::string pathPrefix = (!dir.path.empty() && (dir.path.back() == '/')) ? dir.path : (dir.path + "/");
+
+   for (;;)
+   {
+      long numRead = syscall(SYS_getdents64, dirFd, direntBytes.data(), direntBytes.size());
+      if (numRead < 0)
+      {
+         if (errno == EINTR) { continue; }
+         reportError("read directory", dir.path, errno);
+         break;
+      }
+      if (numRead == 0)
+      {
+         break;
+      }
+
+      for (long pos = 0; pos < numRead; )
+      {
+         const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(direntBytes.data() + pos);
+         const char* entryName = direntBytes.data() + pos + offsetof(LinuxDirent64, d_name);
+         pos += entry->d_reclen;
+
+         if ((0 == strcmp(entryName, ".")) || (0 == strcmp(entryName, "..")) || isExcluded(entryName))
+         {
+            continue;
+         }
+
+         unsigned char entryType = entry->d_type;
+         if (entryType == DT_UNKNOWN)
+         {
+            // (Some filesystems don't report the type.)
+            struct stat entryStat;
+            if (0 == fstatat(dirFd, entryName, &entryStat, AT_SYMLINK_NOFOLLOW))
+            {
+               entryType = S_ISDIR(entryStat.st_mode) ? DT_DIR : (S_ISREG(entryStat.st_mode) ? DT_REG : DT_LNK);
+            }
+         }
+
+         if (entryType == DT_DIR)
+         {
+            PendingDir subdir;
+            subdir.parent = dirHandle;
+            subdir.name = entryName;
+            subdir.path = pathPrefix + entryName;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pendingDirs.push_back(subdir);
+            m_cond.notify_one();
+         }
+         else if ((entryType == DT_REG) && isIncluded(entryName))
+         {
+            if (!handler(workerIndex, dirFd, entryName, pathPrefix + entryName))
+            {
+               std::lock_guard<std::mutex> lock(m_mutex);
+               m_stopped = true;
+               m_pendingDirs.clear();
+               m_cond.notify_all();
+               return;
+            }
+         }
+      }
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: DirectoryWalker::work
+// Description: Thread body: reads pending directories until there are none
+//              and no other thread can add more.
+// -----------------------------------------------------------------------------
+void NGROM_NS::DirectoryWalker::work(unsigned int workerIndex, const FileHandler& handler)
+{
+   std::vector<char> direntBytes(DIRENT_BUFFER_BYTES);
+
+   std::unique_lock<std::mutex> lock(m_mutex);
+   for (;;)
+   {
+      m_cond.wait(lock, [this] { return !m_pendingDirs.empty() || (m_numBusy == 0) || m_stopped; });
+      if (m_pendingDirs.empty() || m_stopped)
+      {
+         break; // All done
+      }
+
+      // Depth first keeps few parent directories open at a time.
+      PendingDir dir = m_pendingDirs.back();
+      m_pendingDirs.pop_back();
+      m_numBusy++;
+
+      lock.unlock();
+      readDirectory(workerIndex, dir, direntBytes, handler);
+      dir.parent.reset();
+      lock.lock();
+
+      m_numBusy--;
+      if (m_pendingDirs.empty() && (m_numBusy == 0))
+      {
+         m_cond.notify_all();
+      }
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: DirectoryWalker::run
+// Description: Walks the directory trees, returning when all are done (or a
+//              handler stopped the walk).
+// -----------------------------------------------------------------------------
+void NGROM_NS::DirectoryWalker::run(const std::vector<std::string>& rootDirs, unsigned int numThreads,
+                                    const FileHandler& handler)
+{
+   for (std::vector<std::string>::const_reverse_iterator iter = rootDirs.rbegin(); iter != rootDirs.rend(); ++iter)
+   {
+      PendingDir root;
+      root.path = *iter;
+      m_pendingDirs.push_back(root);
+   }
+
+   std::vector<std::thread> threads;
+   for (unsigned int i = 0; i < numThreads; i++)
+   {
+      threads.push_back(std::thread(&DirectoryWalker::work, this, i, std::cref(handler)));
+   }
+
+   for (std::thread& thread : threads)
+   {
+      thread.join();
+   }
+}
@@ -0,0 +1,121 @@
+// New GROM - Parallel directory walking
+//
+// DirectoryWalker reads directory trees with a pool of threads (getdents64;
+// files and subdirectories are opened relative to their directory's fd), and
+// hands each regular file to a caller-supplied handler as it is found.
+// FileQueue carries found files to the conversions, so converting can start
+// while the walk is still running.
+
+#ifndef NGROM_WALK_H
+#define NGROM_WALK_H
+
+#include<stdint.h>
+#include<string>
+#include<vector>
+#include<deque>
+#include<memory>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+#include<atomic>
+
+namespace NGROM_NS
+{
+   // --------------------------------------------------------------------------
+   // Class: FileQueue
+   // Description: Thread-safe FIFO of input files.  Files are numbered in the
+   //              order they were pushed (the fileIndex used by the journal).
+   // --------------------------------------------------------------------------
+   class FileQueue
+   {
+   public:
+      FileQueue();
+
+      bool push(const std::string& filename); // false if cancelled
+      void close();  // No more files will be pushed
+      void cancel(); // Stop: drop queued files and refuse new ones
+      bool pop(size_t& fileIndex, std::string& filename); // Blocks; false when done
+      size_t peek(size_t maxFiles, std::vector<std::string>& filenames); // Next files, without taking them
+
+      FileQueue(const FileQueue&) = delete;
+      FileQueue& operator=(const FileQueue&) = delete;
+
+   private:
+      std::mutex m_mutex;
+      std::condition_variable m_cond;
+      std::deque<std::string> m_files;
+      size_t m_numPopped;
+      bool m_closed;
+      bool m_cancelled;
+   };
+
+   // --------------------------------------------------------------------------
+   // Class: DirectoryWalker
+   // Description: Multi-threaded directory tree walk.  Symbolic links are not
+   //              followed.  Exclude globs skip matching files and prune
+   //              matching directories; if any include globs are given, only
+   //              files matching one of them are handled.  Globs match names,
+   //              not paths (fnmatch).
+   // --------------------------------------------------------------------------
+   class DirectoryWalker
+   {
+   public:
+      // Called from the walker threads for each regular file; dirFd is open on
+      // the file's directory (for openat).  Return false to stop the walk.
+      typedef std::function<bool(unsigned int workerIndex, int dirFd,
+                                 const char* name, const std::string& path)> FileHandler;
+
+      DirectoryWalker();
+
+      static unsigned int defaultNumThreads();
+
+      void addInclude(const std::string& pattern) { m_includes.push_back(pattern); }
+      void addExclude(const std::string& pattern) { m_excludes.push_back(pattern); }
+
+      void run(const std::vector<std::string>& rootDirs, unsigned int numThreads,
+               const FileHandler& handler);
+
+      void reportError(const std::string& what, const std::string& path, int saved_errno);
+
+      uint64_t numDirs() const { return m_numDirs; }
+      uint64_t numErrors() const { return m_numErrors; }
+
+      DirectoryWalker(const DirectoryWalker&) = delete;
+      DirectoryWalker& operator=(const DirectoryWalker&) = delete;
+
+   private:
+      // Open directory fd, shared by its subdirectories still to be opened
+      struct DirHandle
+      {
+         explicit DirHandle(int fd) : fd(fd) {}
+         ~DirHandle();
+         int fd;
+      };
+
+      struct PendingDir
+      {
+         std::shared_ptr<DirHandle> parent; // NULL for a root directory
+         std::string name;                  // Relative to parent
+         std::string path;
+      };
+
+      bool isExcluded(const char* name) const;
+      bool isIncluded(const char* name) const;
+      void work(unsigned int workerIndex, const FileHandler& handler);
+      void readDirectory(unsigned int workerIndex, PendingDir& dir,
+                         std::vector<char>& direntBytes, const FileHandler& handler);
+
+      std::vector<std::string> m_includes;
+      std::vector<std::string> m_excludes;
+
+      std::mutex m_mutex;
+      std::condition_variable m_cond;
+      std::vector<PendingDir> m_pendingDirs; // Used as a stack (depth first)
+      size_t m_numBusy; // Threads currently reading a directory
+      bool m_stopped;
+      std::atomic<uint64_t> m_numDirs;
+      std::atomic<uint64_t> m_numErrors;
+   };
+}
+
+#endif // NGROM_WALK_H
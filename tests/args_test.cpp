@@ -0,0 +1,159 @@
+// New GROM - Tests for the built-in (NGROM_LITE) argument parser
+//
+// Parses sample command lines with the same kinds of options ngrom uses
+// (short flags, short and long options taking values) and checks the
+// results; command lines that should be rejected are parsed in a child
+// process, which must exit with code 1.  Exits nonzero if any test fails.
+//
+// Usage: ngrom_args_test
+
+#include "ngrom_args.h"
+#include<stdio.h>
+#include<unistd.h> // for fork, dup2, _exit
+#include<fcntl.h> // for open
+#include<sys/wait.h> // for waitpid
+#include<string>
+#include<vector>
+
+static int s_numFailures = 0;
+
+// The options, as ngrom declares them
+struct TestOptions
+{
+   NGROM_NS::ArgOption infoOption = NGROM_NS::ArgOption({"i", "info"}, "Info.");
+   NGROM_NS::ArgOption doChecksOption = NGROM_NS::ArgOption({"c", "checks"}, "Checks.", "action", "stop");
+   NGROM_NS::ArgOption recursiveOption = NGROM_NS::ArgOption({"r", "recursive"}, "Recursive.");
+   NGROM_NS::ArgOption outdirOption = NGROM_NS::ArgOption({"o", "outdir"}, "Output directory.", "dir");
+   NGROM_NS::ArgOption durableOption = NGROM_NS::ArgOption({"durable"}, "Durable.");
+
+   void addTo(NGROM_NS::ArgsParser& parser) const
+   {
+      parser.addOption(infoOption);
+      parser.addOption(doChecksOption);
+      parser.addOption(recursiveOption);
+      parser.addOption(outdirOption);
+      parser.addOption(durableOption);
+   }
+};
+
+// -----------------------------------------------------------------------------
+// Function: parse
+// Description: Parses the arguments (argv[0] is supplied) with a new parser.
+// -----------------------------------------------------------------------------
+static void parse(NGROM_NS::ArgsParser& parser, std::vector<std::string> args)
+{
+   args.insert(args.begin(), "ngrom_args_test");
+
+   std::vector<char*> argv;
+   for (std::string& arg : args)
+   {
+      argv.push_back(&arg[0]);
+   }
+   argv.push_back(NULL);
+
+   int argc = static_cast<int>(args.size());
+   parser.process(argc, argv.data());
+}
+
+// -----------------------------------------------------------------------------
+// Function: check
+// Description: Records (and reports) a failed test.
+// -----------------------------------------------------------------------------
+static void check(bool passed, const char* testName, const char* what)
+{
+   if (!passed)
+   {
+      fprintf(stderr, "FAILED: %s: %s\n", testName, what);
+      s_numFailures++;
+   }
+}
+
+// -----------------------------------------------------------------------------
+// Function: checkRejected
+// Description: Checks that parsing the arguments exits with code 1 (in a child
+//              process, with its error message discarded).
+// -----------------------------------------------------------------------------
+static void checkRejected(const char* testName, const std::vector<std::string>& args)
+{
+   pid_t pid = fork();
+   if (pid == 0)
+   {
+      int devNull = open("/dev/null", O_WRONLY);
+      if (devNull >= 0)
+      {
+         dup2(devNull, STDERR_FILENO);
+      }
+
+      TestOptions options;
+      NGROM_NS::ArgsParser parser("ngrom_args_test", "0", "Test.");
+      options.addTo(parser);
+      parse(parser, args);
+      _exit(0);
+   }
+
+   int status = 0;
+   bool exited = (pid > 0) && (waitpid(pid, &status, 0) == pid) && WIFEXITED(status);
+   check(exited && (WEXITSTATUS(status) == 1), testName, "not rejected");
+}
+
+int main()
+{
+   {
+      TestOptions options;
+      NGROM_NS::ArgsParser parser("ngrom_args_test", "0", "Test.");
+      options.addTo(parser);
+      parse(parser, {"-i", "-c", "skip", "file.smd"});
+      check(parser.isSet(options.infoOption), "separate", "-i not set");
+      check(parser.value(options.doChecksOption) == "skip", "separate", "-c value");
+      check(!parser.isSet(options.recursiveOption), "separate", "-r set");
+      check(parser.positionalArguments() == std::vector<std::string>({"file.smd"}), "separate", "positional arguments");
+   }
+
+   {
+      TestOptions options;
+      NGROM_NS::ArgsParser parser("ngrom_args_test", "0", "Test.");
+      options.addTo(parser);
+      parse(parser, {"-ir", "dir"});
+      check(parser.isSet(options.infoOption), "cluster", "-i not set");
+      check(parser.isSet(options.recursiveOption), "cluster", "-r not set");
+      check(parser.positionalArguments() == std::vector<std::string>({"dir"}), "cluster", "positional arguments");
+   }
+
+   {
+      TestOptions options;
+      NGROM_NS::ArgsParser parser("ngrom_args_test", "0", "Test.");
+      options.addTo(parser);
+      parse(parser, {"-ric", "skip", "dir"});
+      check(parser.isSet(options.infoOption), "cluster, value", "-i not set");
+      check(parser.isSet(options.recursiveOption), "cluster, value", "-r not set");
+      check(parser.value(options.doChecksOption) == "skip", "cluster, value", "-c value");
+      check(parser.positionalArguments() == std::vector<std::string>({"dir"}), "cluster, value", "positional arguments");
+   }
+
+   {
+      TestOptions options;
+      NGROM_NS::ArgsParser parser("ngrom_args_test", "0", "Test.");
+      options.addTo(parser);
+      parse(parser, {"-riofoo", "-c=warn", "--outdir=bar", "--", "-i"});
+      check(parser.isSet(options.infoOption), "attached values", "-i not set");
+      check(parser.isSet(options.recursiveOption), "attached values", "-r not set");
+      check(parser.values(options.outdirOption) == std::vector<std::string>({"foo", "bar"}), "attached values", "-o values");
+      check(parser.value(options.doChecksOption) == "warn", "attached values", "-c value");
+      check(parser.positionalArguments() == std::vector<std::string>({"-i"}), "attached values", "positional arguments");
+   }
+
+   checkRejected("unknown option in cluster", {"-ix", "file.smd"});
+   checkRejected("value for flag", {"-i=yes", "file.smd"});
+   checkRejected("value for long flag", {"--durable=yes", "file.smd"});
+   checkRejected("missing value in cluster", {"-ic"});
+   checkRejected("unknown long option", {"--bogus", "file.smd"});
+
+   if (s_numFailures != 0)
+   {
+      fprintf(stderr, "%d test(s) failed\n", s_numFailures);
+      return 1;
+   }
+
+   printf("All argument parser tests passed\n");
+   return 0;
+}
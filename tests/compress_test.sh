@@ -0,0 +1,47 @@
+#!/bin/sh
+# New GROM - Compressed output (--compress) tests
+#
+# gzip outputs (.bin.gz; at the default and the lowest and highest levels)
+# decompress with gunzip, and zstd outputs (.bin.zst; when built with zstd
+# and the zstd tool is installed) with zstd -d, to the same BINs as plain
+# conversions, including ones of many compression chunks; bad methods and
+# levels are rejected.
+#
+# Usage: tests/compress_test.sh ngrom_exe ngrom_gencorpus
+
+. "$(dirname "$0")/lib.sh"
+
+gen_corpus in 2
+"$GENCORPUS" --seed 3 --files 1 --min-size 1M --max-size 1M big > /dev/null || exit 2
+mv big/d000/rom000000.smd big.smd
+INPUTS="in/d000/rom000000.smd in/d000/rom000001.smd big.smd"
+convert_ref ref in/d000/*.smd big.smd
+
+for SPEC in gzip gzip:1 gzip:9; do
+   OUT=out-$(echo $SPEC | tr : -)
+   mkdir $OUT
+   run_ngrom 0 --compress $SPEC -o $OUT $INPUTS
+   expect_lines "$SPEC" "Conversion complete!" 3
+   expect_absent "$SPEC (uncompressed output)" $OUT/rom000000.bin
+   gunzip -t $OUT/*.bin.gz || fail "$SPEC (not valid gzip)"
+   gunzip -c $OUT/rom000000.bin.gz > rom000000.bin
+   gunzip -c $OUT/rom000001.bin.gz > rom000001.bin
+   gunzip -c $OUT/big.bin.gz > big.bin
+   expect_same "$SPEC" rom000000.bin ref/rom000000.bin
+   expect_same "$SPEC" rom000001.bin ref/rom000001.bin
+   expect_same "$SPEC (many chunks)" big.bin ref/big.bin
+done
+
+mkdir out-zstd
+if "$NGROM" --compress zstd -o out-zstd big.smd > /dev/null 2>&1 && command -v zstd > /dev/null 2>&1; then
+   zstd -q -d -c out-zstd/big.bin.zst > big.bin
+   expect_same "zstd (many chunks)" big.bin ref/big.bin
+else
+   echo "$TEST_NAME: no zstd support (or zstd tool); skipping the zstd checks"
+fi
+
+for SPEC in gzip:0 gzip:10 gzip: bzip2; do
+   run_ngrom 1 --compress $SPEC -o out-gzip in/d000/rom000000.smd
+done
+
+finish
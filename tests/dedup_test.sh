@@ -0,0 +1,60 @@
+#!/bin/sh
+# New GROM - Content dedup (--dedup) tests
+#
+# Byte-identical inputs (plain or compressed) are converted once, their
+# outputs hardlinked (sharing the first output's inode) or reflinked/copied
+# to the first output; an input of the same size but other content is
+# converted; and regenerating one linked output (a changed input, with
+# --manifest) replaces it rather than rewriting the shared inode.
+#
+# Usage: tests/dedup_test.sh ngrom_exe ngrom_gencorpus
+
+. "$(dirname "$0")/lib.sh"
+
+gen_corpus in 2
+mkdir dups out rout
+cp in/d000/rom000000.smd dups/a.smd
+cp in/d000/rom000000.smd dups/b.smd
+gzip -c in/d000/rom000000.smd > dups/c.smd.gz
+INPUTS="in/d000/rom000000.smd in/d000/rom000001.smd dups/a.smd dups/b.smd dups/c.smd.gz"
+convert_ref ref in/d000/*.smd
+
+# Hardlinks
+run_ngrom 0 --dedup hardlink -m man -o out $INPUTS
+expect_lines "hardlink" "Conversion complete!" 2
+expect_lines "hardlink" "Hardlinked to out/rom000000.bin" 3
+expect_same "hardlink (other content)" out/rom000001.bin ref/rom000001.bin
+FIRST_INODE=$(stat -c %i out/rom000000.bin)
+for OUT in a b c; do
+   expect_same "hardlink" out/$OUT.bin ref/rom000000.bin
+   [ "$(stat -c %i out/$OUT.bin)" = "$FIRST_INODE" ] || fail "hardlink ($OUT.bin not linked)"
+done
+
+# One duplicate changes: its output is replaced; the others keep the old data
+poke_byte dups/a.smd 600
+convert_ref aref dups/a.smd
+run_ngrom 0 --dedup hardlink -m man -o out $INPUTS
+expect_lines "changed duplicate" "Input changed since last conversion" 1
+expect_same "changed duplicate" out/a.bin aref/a.bin
+[ "$(stat -c %i out/a.bin)" != "$FIRST_INODE" ] || fail "changed duplicate (shared inode rewritten)"
+for OUT in rom000000 b c; do
+   expect_same "changed duplicate (other links)" out/$OUT.bin ref/rom000000.bin
+done
+
+# Reflinks (or copies)
+cp in/d000/rom000000.smd dups/a.smd
+run_ngrom 0 --dedup reflink -o rout $INPUTS
+expect_lines "reflink" "Conversion complete!" 2
+expect_lines "reflink" "\(Reflinked to\|Copied from\) rout/rom000000.bin" 3
+for OUT in a b c; do
+   expect_same "reflink" rout/$OUT.bin ref/rom000000.bin
+   [ "$(stat -c %i rout/$OUT.bin)" != "$(stat -c %i rout/rom000000.bin)" ] || fail "reflink ($OUT.bin shares an inode)"
+done
+
+# The same input twice (overwriting allowed): written once
+mkdir twice
+run_ngrom 0 --dedup hardlink -f warn -o twice in/d000/rom000000.smd in/d000/rom000000.smd
+expect_lines "same input twice" "Output already written by an identical input" 1
+expect_same "same input twice" twice/rom000000.bin ref/rom000000.bin
+
+finish
@@ -0,0 +1,55 @@
+#!/bin/sh
+# New GROM - Crash-safe output (--durable) tests
+#
+# Durable outputs (plain, compressed, dedup links; with --journal) are the
+# same as plain conversions and leave no temporary files behind; a failed
+# conversion leaves no output, and an output it was to replace is kept as it
+# was.
+#
+# Usage: tests/durable_test.sh ngrom_exe ngrom_gencorpus
+
+. "$(dirname "$0")/lib.sh"
+
+gen_corpus in 3
+mkdir out zout bad
+cp in/d000/rom000000.smd dup.smd
+convert_ref ref in/d000/*.smd
+
+# Checks that a directory only holds the listed files: what dir files...
+expect_only() {
+   WHAT=$1
+   DIR=$2
+   shift 2
+   [ "$(ls -A "$DIR" | sort | tr '\n' ' ')" = "$(for FILE in "$@"; do echo "$FILE"; done | sort | tr '\n' ' ')" ] ||
+      fail "$WHAT ($DIR holds $(ls -A "$DIR" | tr '\n' ' '))"
+}
+
+run_ngrom 0 --durable --journal j --dedup hardlink -o out in/d000/*.smd dup.smd
+expect_lines "durable" "Conversion complete!" 3
+expect_lines "durable" "Hardlinked to" 1
+expect_only "durable" out rom000000.bin rom000001.bin rom000002.bin dup.bin
+for REF in ref/*.bin; do
+   expect_same "durable" "out/$(basename "$REF")" "$REF"
+done
+expect_same "durable (dedup)" out/dup.bin ref/rom000000.bin
+[ "$(grep -c '^C' j)" -eq 4 ] || fail "durable (journal completions)"
+
+run_ngrom 0 --durable --compress gzip -o zout in/d000/rom000000.smd
+expect_only "durable, compressed" zout rom000000.bin.gz
+gunzip -c zout/rom000000.bin.gz > rom000000.bin
+expect_same "durable, compressed" rom000000.bin ref/rom000000.bin
+
+# A conversion failing part way through (a corrupt gzip input): nothing
+# committed, and the output it was to replace is left alone
+gzip -c in/d000/rom000001.smd > rom000001.smd.gz
+poke_byte rom000001.smd.gz $(($(stat -c %s rom000001.smd.gz) / 2))
+run_ngrom 2 --durable -c skip -o bad rom000001.smd.gz
+expect_only "failed conversion" bad
+
+echo "previous output" > bad/rom000001.bin
+cp bad/rom000001.bin previous.bin
+run_ngrom 2 --durable -c skip -f warn -o bad rom000001.smd.gz
+expect_only "failed conversion (replacing)" bad rom000001.bin
+expect_same "failed conversion (replacing)" bad/rom000001.bin previous.bin
+
+finish
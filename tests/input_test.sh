@@ -0,0 +1,51 @@
+#!/bin/sh
+# New GROM - Compressed input (gzip, zip member) tests
+#
+# Single- and multi-member gzip files and deflated and stored zip members
+# pass the format checks and convert to the same BINs as the plain files;
+# a zip member whose data doesn't match its CRC32 fails to convert.
+#
+# Usage: tests/input_test.sh ngrom_exe ngrom_gencorpus
+
+. "$(dirname "$0")/lib.sh"
+
+gen_corpus in 3
+mkdir gz zipped out
+convert_ref ref in/d000/*.smd
+
+# gzip: one member (rom000000), and several concatenated (rom000001)
+gzip -c in/d000/rom000000.smd > gz/rom000000.smd.gz
+head -c 50000 in/d000/rom000001.smd | gzip -c > gz/rom000001.smd.gz
+tail -c +50001 in/d000/rom000001.smd | head -c 40000 | gzip -c >> gz/rom000001.smd.gz
+tail -c +90001 in/d000/rom000001.smd | gzip -c >> gz/rom000001.smd.gz
+run_ngrom 0 -c stop -o out gz/rom000000.smd.gz gz/rom000001.smd.gz
+expect_lines "gzip" "Conversion complete!" 2
+expect_same "gzip (one member)" out/rom000000.bin ref/rom000000.bin
+expect_same "gzip (several members)" out/rom000001.bin ref/rom000001.bin
+
+run_ngrom 0 -i gz/rom000001.smd.gz
+expect_lines "gzip (info)" "ROM end address: 0x0001FFFF" 1
+
+# zip: a deflated member and a stored one
+if command -v zip > /dev/null 2>&1; then
+   rm -f out/*.bin
+   (cd in/d000 && zip -q -X ../../zipped/roms.zip rom000001.smd && zip -q -X -0 ../../zipped/roms.zip rom000002.smd)
+   run_ngrom 0 -c stop -o out zipped/roms.zip/rom000001.smd zipped/roms.zip/rom000002.smd
+   expect_lines "zip" "Conversion complete!" 2
+   expect_same "zip (deflated member)" out/rom000001.bin ref/rom000001.bin
+   expect_same "zip (stored member)" out/rom000002.bin ref/rom000002.bin
+
+   run_ngrom 2 -c stop -o out zipped/roms.zip/missing.smd
+   expect_lines "zip (missing member)" "No such file or directory" 1
+
+   # (The stored member's data follows its 30-byte local header and name.)
+   rm -f out/*.bin
+   DATA_OFFSET=$(($(stat -c %s zipped/roms.zip) - 131584 - 22 - 2 * (46 + 13)))
+   poke_byte zipped/roms.zip $((DATA_OFFSET + 1000))
+   run_ngrom 2 -c skip -o out zipped/roms.zip/rom000002.smd
+   expect_lines "zip (corrupt member)" "failed to decompress" 1
+else
+   echo "$TEST_NAME: zip not found; skipping the zip member checks"
+fi
+
+finish
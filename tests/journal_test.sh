@@ -0,0 +1,59 @@
+#!/bin/sh
+# New GROM - Resumable run (--journal, --resume) tests
+#
+# Resuming an interrupted run skips the completed conversions (and their
+# format checks), removes and redoes the one cut short, and does the rest;
+# both for a journal cut off by hand at a known point and for a run killed
+# (SIGKILL) part way through.
+#
+# Usage: tests/journal_test.sh ngrom_exe ngrom_gencorpus
+
+. "$(dirname "$0")/lib.sh"
+
+gen_corpus in 4
+mkdir out
+convert_ref ref in/d000/*.smd
+
+# A run interrupted while converting input 2: inputs 0 and 1 completed, the
+# output of 2 partially written, 3 not started.
+run_ngrom 0 --journal j -o out in/d000/*.smd
+expect_lines "journal run" "Conversion complete!" 4
+grep -q "^E$" j || fail "journal run (not recorded as finished)"
+awk '{ print } /^S\t2$/ { exit }' j > j.cut && mv j.cut j
+truncate -s 60000 out/rom000002.bin
+rm -f out/rom000003.bin
+poke_byte out/rom000001.bin 1000
+
+run_ngrom 0 --resume j
+expect_lines "resume" "2 of 4 conversion(s) already completed" 1
+expect_lines "resume" "Already completed (journal)" 2
+expect_lines "resume (checks)" "Checking file" 2
+expect_lines "resume" "Removing partial output" 1
+expect_lines "resume" "Conversion complete!" 2
+expect_same "resume (partial output)" out/rom000002.bin ref/rom000002.bin
+expect_same "resume (not started)" out/rom000003.bin ref/rom000003.bin
+cmp -s out/rom000001.bin ref/rom000001.bin && fail "resume (completed conversion redone)"
+grep -q "^E$" j || fail "resume (not recorded as finished)"
+
+# Files can't be given with --resume
+run_ngrom 1 --resume j in/d000/rom000000.smd
+
+# A run killed part way through (wherever that is), then resumed
+gen_corpus big 200 2
+mkdir kout
+convert_ref kref big/d000/*.smd
+"$NGROM" --journal kj -o kout big/d000/*.smd > /dev/null 2>&1 &
+PID=$!
+while kill -0 $PID 2> /dev/null && ! grep -q "^C" kj 2> /dev/null; do
+   sleep 0.01
+done
+kill -9 $PID 2> /dev/null
+wait $PID 2> /dev/null
+
+run_ngrom 0 --resume kj
+for REF in kref/*.bin; do
+   expect_same "killed run resumed" "kout/$(basename "$REF")" "$REF"
+done
+[ "$(ls kout | wc -l)" -eq 200 ] || fail "killed run resumed (extra outputs)"
+
+finish
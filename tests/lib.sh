@@ -0,0 +1,87 @@
+# New GROM - Shared setup and checks for the end-to-end tests (sourced by
+# each tests/*_test.sh)
+#
+# A test runs ngrom over small synthetic corpora (ngrom_gencorpus) in a
+# temporary directory of its own (removed when done), checking exit codes,
+# messages, and outputs, and exits nonzero if any check failed.  Conversions
+# are checked against plain conversions of the same inputs.
+#
+# Usage: tests/<name>_test.sh ngrom_exe ngrom_gencorpus
+
+if [ $# -ne 2 ] || [ ! -x "$1" ] || [ ! -x "$2" ]; then
+   echo "Usage: $0 ngrom_exe ngrom_gencorpus" >&2
+   exit 1
+fi
+NGROM=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+GENCORPUS=$(cd "$(dirname "$2")" && pwd)/$(basename "$2")
+
+TEST_NAME=$(basename "$0" .sh)
+NUM_FAILURES=0
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/ngrom-$TEST_NAME.XXXXXX") || exit 2
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 2
+
+# Records (and reports) a failed check: what
+fail() {
+   echo "FAILED: $TEST_NAME: $1" >&2
+   NUM_FAILURES=$((NUM_FAILURES + 1))
+}
+
+# Runs ngrom (messages to ngrom.log), checking its exit code: code args...
+run_ngrom() {
+   EXPECTED_RC=$1
+   shift
+   "$NGROM" "$@" > ngrom.log 2>&1
+   RC=$?
+   if [ $RC -ne "$EXPECTED_RC" ]; then
+      fail "ngrom $* exited with $RC, expected $EXPECTED_RC"
+      sed 's/^/   /' ngrom.log >&2
+   fi
+}
+
+# Checks how many of the last run's messages match a pattern: what pattern count
+expect_lines() {
+   NUM_LINES=$(grep -c -- "$2" ngrom.log)
+   if [ "$NUM_LINES" -ne "$3" ]; then
+      fail "$1 ($NUM_LINES lines matching \"$2\", expected $3)"
+   fi
+}
+
+# Checks that two files are identical: what file1 file2
+expect_same() {
+   cmp -s "$2" "$3" || fail "$1 ($2 differs from $3)"
+}
+
+# Checks that a file doesn't exist: what file
+expect_absent() {
+   [ ! -e "$2" ] || fail "$1 ($2 exists)"
+}
+
+# Writes count 128 KB SMD files as dir/d000/romNNNNNN.smd: dir count [seed]
+gen_corpus() {
+   "$GENCORPUS" --seed "${3:-1}" --files "$2" --min-size 128K --max-size 128K "$1" > /dev/null || exit 2
+}
+
+# Converts files plainly into dir (the reference outputs): dir files...
+convert_ref() {
+   REF_DIR=$1
+   shift
+   mkdir -p "$REF_DIR" || exit 2
+   "$NGROM" -o "$REF_DIR" "$@" > /dev/null 2>&1 || { echo "$TEST_NAME: reference conversion failed" >&2; exit 2; }
+}
+
+# Overwrites one byte of a file in place (same size): file offset
+poke_byte() {
+   printf 'Z' | dd of="$1" bs=1 seek="$2" conv=notrunc 2> /dev/null || exit 2
+}
+
+# Reports the result and exits
+finish() {
+   if [ $NUM_FAILURES -ne 0 ]; then
+      echo "$TEST_NAME: $NUM_FAILURES check(s) failed" >&2
+      exit 1
+   fi
+   echo "$TEST_NAME: all checks passed"
+   exit 0
+}
@@ -0,0 +1,88 @@
+#!/bin/sh
+# New GROM - Incremental conversion (--manifest) tests
+#
+# Reruns over unchanged inputs skip them (and their format checks); changed
+# inputs, and modified or missing outputs, are converted again; outputs of
+# deleted inputs are reported as stale; a v1 manifest is read and rewritten
+# as v2; and each zip member is tracked on its own.
+#
+# Usage: tests/manifest_test.sh ngrom_exe ngrom_gencorpus
+
+. "$(dirname "$0")/lib.sh"
+
+gen_corpus in 3
+mkdir out zout
+IN0=in/d000/rom000000.smd
+IN1=in/d000/rom000001.smd
+IN2=in/d000/rom000002.smd
+
+# First run: everything converted and recorded
+run_ngrom 0 -m man -o out $IN0 $IN1 $IN2
+expect_lines "first run" "Conversion complete!" 3
+[ "$(head -n 1 man)" = "# ngrom manifest v2" ] || fail "first run (manifest header)"
+[ "$(grep -c -v '^#' man)" -eq 3 ] || fail "first run (manifest records)"
+
+# Unchanged inputs: skipped, without format checks; touching doesn't count
+touch -d "2001-01-01 00:00" $IN1
+run_ngrom 0 -c stop -m man -o out $IN0 $IN1 $IN2
+expect_lines "unchanged" "Unchanged since last conversion" 3
+expect_lines "unchanged (checks)" "Checking file" 0
+
+# Changed input: converted again (and checked)
+poke_byte $IN1 600
+convert_ref ref $IN1
+run_ngrom 0 -c stop -m man -o out $IN0 $IN1 $IN2
+expect_lines "changed input" "Input changed since last conversion" 1
+expect_lines "changed input" "Unchanged since last conversion" 2
+expect_lines "changed input (checks)" "Checking file" 1
+expect_same "changed input" out/rom000001.bin ref/rom000001.bin
+
+# Modified (same size) and missing outputs: converted again
+cp out/rom000000.bin ref/rom000000.bin
+poke_byte out/rom000000.bin 1000
+rm -f out/rom000002.bin
+run_ngrom 0 -m man -o out $IN0 $IN1 $IN2
+expect_lines "output modified/missing" "Output missing or modified" 2
+expect_same "output modified" out/rom000000.bin ref/rom000000.bin
+[ -f out/rom000002.bin ] || fail "output missing (not regenerated)"
+
+# Deleted input: its output is reported as stale (and kept)
+rm -f $IN2
+run_ngrom 0 -m man -o out $IN0 $IN1
+expect_lines "deleted input" "Stale output (input no longer exists): out/rom000002.bin" 1
+[ -f out/rom000002.bin ] || fail "deleted input (stale output removed)"
+
+# v1 manifest (no output inode, mtime, or hash): trusted, rewritten as v2
+awk -F '\t' 'BEGIN { OFS = "\t" }
+   NR == 1 { print "# ngrom manifest v1"; next }
+   { print $1, $2, $3, $4, $5, $9, $10 }' man > man.v1 && mv man.v1 man
+run_ngrom 0 -m man -o out $IN0 $IN1
+expect_lines "v1 manifest" "Unchanged since last conversion" 2
+[ "$(head -n 1 man)" = "# ngrom manifest v2" ] || fail "v1 manifest (not rewritten as v2)"
+[ "$(grep -v '^#' man | awk -F '\t' '{ print NF }' | sort -u)" = "10" ] || fail "v1 manifest (v2 records)"
+
+# Zip members: each tracked by its own size and CRC32, not the archive's
+if command -v zip > /dev/null 2>&1; then
+   mkdir zipped
+   cp $IN0 $IN1 zipped/
+   (cd zipped && zip -q ../roms.zip rom000000.smd rom000001.smd)
+   run_ngrom 0 -m zman -o zout roms.zip/rom000000.smd roms.zip/rom000001.smd
+   expect_lines "zip members" "Conversion complete!" 2
+
+   cp $IN1 zipped/other.smd
+   (cd zipped && zip -q ../roms.zip other.smd)
+   run_ngrom 0 -m zman -o zout roms.zip/rom000000.smd roms.zip/rom000001.smd
+   expect_lines "zip archive changed" "Unchanged since last conversion" 2
+
+   poke_byte zipped/rom000001.smd 700
+   (cd zipped && zip -q ../roms.zip rom000001.smd)
+   convert_ref zref zipped/rom000001.smd
+   run_ngrom 0 -m zman -o zout roms.zip/rom000000.smd roms.zip/rom000001.smd
+   expect_lines "zip member changed" "Input changed since last conversion" 1
+   expect_lines "zip member changed" "Unchanged since last conversion" 1
+   expect_same "zip member changed" zout/rom000001.bin zref/rom000001.bin
+else
+   echo "$TEST_NAME: zip not found; skipping the zip member checks"
+fi
+
+finish
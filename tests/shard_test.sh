@@ -0,0 +1,35 @@
+#!/bin/sh
+# New GROM - Collection splitting (--shard) tests
+#
+# For each of several shard counts N, shards 1/N through N/N together convert
+# every file exactly once; the same files under another directory go to the
+# same shards; and bad shard specifications are rejected.
+#
+# Usage: tests/shard_test.sh ngrom_exe ngrom_gencorpus
+
+. "$(dirname "$0")/lib.sh"
+
+gen_corpus in 40
+mkdir -p moved/elsewhere
+cp -R in moved/elsewhere/in2
+ls in/d000 | sed 's/\.smd$/.bin/' | sort > all.txt
+
+for N in 1 2 3 7; do
+   I=1
+   while [ $I -le $N ]; do
+      mkdir "out$N-$I" "moved$N-$I"
+      run_ngrom 0 -c skip -r --shard $I/$N -o "out$N-$I" in
+      run_ngrom 0 -c skip -r --shard $I/$N -o "moved$N-$I" moved/elsewhere/in2
+      [ "$(ls "out$N-$I")" = "$(ls "moved$N-$I")" ] || fail "shard $I/$N (differs under another directory)"
+      I=$((I + 1))
+   done
+
+   ls out$N-* | grep '\.bin$' | sort > shards.txt
+   cmp -s shards.txt all.txt || fail "$N shards (don't cover every file exactly once)"
+done
+
+for SPEC in 0/3 4/3 1/0 3 1/65537 1/18446744073709551617 x/2; do
+   run_ngrom 1 -c skip --shard $SPEC -o out1-1 in/d000/rom000000.smd
+done
+
+finish
@@ -0,0 +1,51 @@
+#!/bin/sh
+# New GROM - Tar stream (--tar-in, --tar-out) tests
+#
+# A tar of SMDs (a file, plain or gzip-compressed, or stdin) converts to
+# a tar of the same BINs as plain conversions, under the same directories and
+# with the same modes and mtimes, and written to stdout as well as to a file;
+# a file failing the format checks stops the run.
+#
+# Usage: tests/tar_test.sh ngrom_exe ngrom_gencorpus
+
+. "$(dirname "$0")/lib.sh"
+
+gen_corpus in 3
+chmod 640 in/d000/rom000001.smd
+touch -d "2001-02-03 04:05:06" in/d000/rom000002.smd
+convert_ref ref in/d000/*.smd
+tar cf in.tar in
+tar czf in.tgz in
+
+# Checks a converted tar's files, modes, and mtimes: what tarFile
+check_tar() {
+   rm -rf x
+   mkdir x
+   tar xf "$2" -C x || { fail "$1 (not a valid tar)"; return; }
+   [ "$(cd x && find . -type f | sort)" = "$(cd in && find . -type f | sed 's|^\.|./in|; s/\.smd$/.bin/' | sort)" ] ||
+      fail "$1 (files)"
+   for REF in ref/*.bin; do
+      BIN=x/in/d000/$(basename "$REF")
+      SMD=in/d000/$(basename "$REF" .bin).smd
+      expect_same "$1" "$BIN" "$REF"
+      [ "$(stat -c %a.%Y "$BIN")" = "$(stat -c %a.%Y "$SMD")" ] || fail "$1 ($BIN mode or mtime)"
+   done
+}
+
+run_ngrom 0 --tar-in in.tar --tar-out out.tar
+expect_lines "tar" "3 file(s) converted" 1
+check_tar "tar" out.tar
+
+run_ngrom 0 --tar-in in.tgz --tar-out outz.tar
+check_tar "gzip tar" outz.tar
+
+"$NGROM" --tar-in - --tar-out - < in.tar > outs.tar 2> ngrom.log || fail "tar stdin/stdout (exit code)"
+expect_lines "tar stdin/stdout" "3 file(s) converted" 1
+check_tar "tar stdin/stdout" outs.tar
+
+echo "not a ROM" > in/readme.txt
+tar cf bad.tar in
+run_ngrom 2 --tar-in bad.tar --tar-out bad-out.tar
+expect_lines "non-ROM in tar" "failed SMD format check" 1
+
+finish